@@ -0,0 +1,190 @@
+// Heap traffic of one Daraja exchange and one callback, with and without a
+// per-exchange Arena. Operator new is counted per thread and every benchmark
+// reports `allocs/op`; the threaded runs show what the global allocator
+// costs once several workers allocate at once.
+//
+//   exchange  what AsyncDarajaClient does per call, minus the socket: build
+//             the B2C request, serialize it, parse a Daraja reply and decode
+//             it.
+//   callback  what a CallbackServer worker does per request: parse a B2C
+//             result POST on a kept-alive connection and read the callback.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "mpesa/arena.hpp"
+#include "mpesa/callbacks.hpp"
+#include "mpesa/daraja.hpp"
+#include "mpesa/http.hpp"
+#include "mpesa/json.hpp"
+
+namespace {
+
+thread_local std::uint64_t t_allocations = 0;
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  ++t_allocations;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+  throw std::bad_alloc();
+}
+// std::pmr::new_delete_resource() comes through here.
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  ++t_allocations;
+  const auto align = static_cast<std::size_t>(alignment);
+  if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) return p;
+  throw std::bad_alloc();
+}
+// GCC sees the malloc behind the replaced operator new and flags the pairing.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+
+namespace {
+
+constexpr std::string_view kToken = "c9SQxWWhmdVRlyh0zh8gZDTkubVF";
+
+constexpr std::string_view kReplyBody =
+    R"({"ConversationID":"AG_20261016_2010325b025970fbc403","OriginatorConversationID":)"
+    R"("5f3e9a52-8d0c-4b6e-a1f7-2c94d1e07b38","ResponseCode":"0","ResponseDescription":)"
+    R"("Accept the service request successfully."})";
+
+constexpr std::string_view kResultBody =
+    R"({"Result":{"ResultType":0,"ResultCode":0,"ResultDesc":"The service request is processed successfully.",)"
+    R"("OriginatorConversationID":"10571-7910404-1","ConversationID":"AG_20191219_00004e48cf7e3533f581",)"
+    R"("TransactionID":"NLJ41HAY6Q","ResultParameters":{"ResultParameter":[)"
+    R"({"Key":"TransactionAmount","Value":10},{"Key":"TransactionReceipt","Value":"NLJ41HAY6Q"},)"
+    R"({"Key":"B2CRecipientIsRegisteredCustomer","Value":"Y"},)"
+    R"({"Key":"ReceiverPartyPublicName","Value":"254708374149 - John Doe"},)"
+    R"({"Key":"TransactionCompletedDateTime","Value":"19.12.2019 11:45:50"}]},)"
+    R"("ReferenceData":{"ReferenceItem":{"Key":"QueueTimeoutURL",)"
+    R"("Value":"https:\/\/internalsandbox.safaricom.co.ke\/mpesa\/b2cresults\/v1\/submit"}}}})";
+
+// Headers as Daraja's gateway sends them.
+std::string reply() {
+  std::string wire =
+      "HTTP/1.1 200 OK\r\n"
+      "Date: Fri, 16 Oct 2026 09:12:44 GMT\r\n"
+      "Content-Type: application/json;charset=UTF-8\r\n"
+      "Connection: keep-alive\r\n"
+      "Cache-Control: no-store\r\n"
+      "Strict-Transport-Security: max-age=31536000; includeSubDomains\r\n"
+      "X-Content-Type-Options: nosniff\r\n"
+      "X-Frame-Options: DENY\r\n"
+      "Content-Length: ";
+  wire.append(std::to_string(kReplyBody.size())).append("\r\n\r\n").append(kReplyBody);
+  return wire;
+}
+
+std::string result_post() {
+  std::string wire =
+      "POST /mpesa/b2c/result HTTP/1.1\r\n"
+      "Host: payouts.example.com\r\n"
+      "User-Agent: Apache-HttpClient/4.5.13 (Java/1.8.0_292)\r\n"
+      "Accept-Encoding: gzip,deflate\r\n"
+      "Content-Type: application/json\r\n"
+      "X-Forwarded-For: 196.201.214.200\r\n"
+      "Content-Length: ";
+  wire.append(std::to_string(kResultBody.size())).append("\r\n\r\n").append(kResultBody);
+  return wire;
+}
+
+mpesa::B2CRequest b2c_request() {
+  mpesa::B2CRequest r;
+  r.originator_conversation_id = "5f3e9a52-8d0c-4b6e-a1f7-2c94d1e07b38";
+  r.initiator_name = "testapi";
+  r.security_credential =
+      "Sx9AwbD7nWUzM2gXq3vO+5yPxN0sJb1T8dLkR4fH6cQeYmZiVt2uKo7GjAlEpBrC"
+      "wF3hNsD9qX0vL5yT1zU8mO4iP6aS2dR7eW3kJ9gH5fQ1lZ0xC8vB4nM2bV6cX1zA==";
+  r.command_id = "BusinessPayment";
+  r.amount = 1250;
+  r.party_a = "600998";
+  r.party_b = "254708374149";
+  r.remarks = "Disbursement";
+  r.queue_timeout_url = "https://payouts.example.com/b2c/timeout";
+  r.result_url = "https://payouts.example.com/b2c/result";
+  r.occasion = "October payroll";
+  return r;
+}
+
+void report(benchmark::State& state, std::uint64_t before) {
+  const auto allocs = static_cast<double>(t_allocations - before);
+  state.counters["allocs/op"] =
+      benchmark::Counter(allocs / static_cast<double>(state.iterations()), benchmark::Counter::kAvgThreads);
+}
+
+void exchange(const mpesa::B2CRequest& request, std::string_view reply, std::pmr::memory_resource* resource) {
+  mpesa::HttpRequest http(resource);
+  mpesa::build_api_request(request, kToken, http);
+  std::pmr::string wire(resource);
+  mpesa::serialize_request(http, "api.safaricom.co.ke", true, wire, "mpesa-cpp-sdk/0.1");
+  benchmark::DoNotOptimize(wire.data());
+  mpesa::HttpParser parser(mpesa::HttpParser::Kind::kResponse, resource);
+  parser.feed(reply.data(), reply.size());
+  const mpesa::AcceptedResponse out = mpesa::decode_response<mpesa::B2CRequest>(parser.response());
+  benchmark::DoNotOptimize(out.conversation_id.data());
+}
+
+void BM_ExchangeHeap(benchmark::State& state) {
+  const auto request = b2c_request();
+  const std::string wire = reply();
+  exchange(request, wire, std::pmr::get_default_resource());  // warm the thread's render buffer
+  const auto before = t_allocations;
+  for (auto _ : state) exchange(request, wire, std::pmr::get_default_resource());
+  report(state, before);
+}
+BENCHMARK(BM_ExchangeHeap)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_ExchangeArena(benchmark::State& state) {
+  const auto request = b2c_request();
+  const std::string wire = reply();
+  {
+    mpesa::Arena<> arena;
+    exchange(request, wire, &arena);
+  }
+  const auto before = t_allocations;
+  for (auto _ : state) {
+    mpesa::Arena<> arena;
+    exchange(request, wire, &arena);
+  }
+  report(state, before);
+}
+BENCHMARK(BM_ExchangeArena)->ThreadRange(1, 8)->UseRealTime();
+
+// One connection's parser, reset between requests as the server does.
+template <bool kArena>
+void BM_Callback(benchmark::State& state) {
+  const std::string wire = result_post();
+  mpesa::Arena<> arena;
+  std::pmr::memory_resource* const resource = kArena ? &arena : std::pmr::get_default_resource();
+  mpesa::HttpParser parser(mpesa::HttpParser::Kind::kRequest, resource);
+  const auto one = [&] {
+    parser.feed(wire.data(), wire.size());
+    {
+      mpesa::json::Reader reader(parser.request().body, resource);
+      mpesa::ResultCallback event;
+      mpesa::read_callback(reader, event);
+      benchmark::DoNotOptimize(event.conversation_id.data());
+    }
+    parser.reset();
+    if (kArena) arena.release();
+  };
+  one();
+  const auto before = t_allocations;
+  for (auto _ : state) one();
+  report(state, before);
+}
+BENCHMARK(BM_Callback<false>)->Name("BM_CallbackHeap")->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_Callback<true>)->Name("BM_CallbackArena")->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,130 @@
+// How far one thread gets with the coroutine client: N STK Push calls are
+// kept in flight from a single event loop against the local HTTPS stand-in,
+// going through token lookup, body building, the connection queue and
+// response decoding.
+//
+//   async_bench [--requests N] [--max-connections C]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "mpesa/async_daraja_client.hpp"
+#include "mpesa/http_client.hpp"
+#include "mpesa/sim/https_server.hpp"
+
+namespace {
+
+struct Result {
+  double p50_us = 0;
+  double p99_us = 0;
+  double rps = 0;
+  std::uint64_t connections = 0;
+  std::size_t errors = 0;
+};
+
+double percentile(const std::vector<double>& sorted, double q) {
+  if (sorted.empty()) return 0;
+  return sorted[static_cast<std::size_t>(q * static_cast<double>(sorted.size() - 1))];
+}
+
+mpesa::StkPushRequest stk_request() {
+  mpesa::StkPushRequest r;
+  r.business_short_code = "174379";
+  r.passkey = "bfb279f9aa9bdbcf158e97dd71a467cd2e0c893059b10f78e6b72ada1ed2c919";
+  r.amount = 1;
+  r.party_a = "254708374149";
+  r.callback_url = "https://example.com/callback";
+  r.account_reference = "Test";
+  r.transaction_desc = "Test";
+  return r;
+}
+
+mpesa::Task<void> worker(mpesa::EventLoop& loop, mpesa::AsyncDarajaClient& client, int count, std::vector<double>& latencies,
+                         std::size_t& errors, int& running) {
+  for (int i = 0; i < count; ++i) {
+    const auto t0 = std::chrono::steady_clock::now();
+    bool ok = false;
+    try {
+      ok = (co_await client.stk_push(stk_request())).accepted();
+    } catch (const std::exception&) {
+    }
+    if (!ok) ++errors;
+    latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+  }
+  if (--running == 0) loop.stop();
+}
+
+Result run(const mpesa::sim::HttpsServer& server, mpesa::TokenManager& tokens, int in_flight,
+           int requests, std::size_t max_connections) {
+  mpesa::EventLoop loop;
+  mpesa::HttpClientOptions options;
+  options.pool.tls.ca_pem = server.ca_pem();
+  options.pool.max_connections_per_endpoint = max_connections;
+  mpesa::AsyncHttpClient http(loop, options);
+  mpesa::AsyncDarajaClient client(http, tokens, server.endpoint());
+
+  std::vector<double> latencies;
+  latencies.reserve(static_cast<std::size_t>(requests));
+  Result r;
+  const int per_task = requests / in_flight;
+  const auto started = std::chrono::steady_clock::now();
+  int running = in_flight;
+  for (int t = 0; t < in_flight; ++t) loop.spawn(worker(loop, client, per_task, latencies, r.errors, running));
+  loop.run();
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  std::sort(latencies.begin(), latencies.end());
+  r.p50_us = percentile(latencies, 0.50);
+  r.p99_us = percentile(latencies, 0.99);
+  r.rps = static_cast<double>(latencies.size()) / elapsed;
+  r.connections = http.stats().connections_opened;
+  return r;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int requests = 4096;
+  std::size_t max_connections = 64;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--requests") == 0) requests = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--max-connections") == 0) max_connections = std::strtoul(argv[i + 1], nullptr, 10);
+  }
+
+  mpesa::sim::HttpsServer server([](const mpesa::HttpRequest& request) {
+    mpesa::HttpResponse response;
+    response.status = 200;
+    response.headers = {{"Content-Type", "application/json"}};
+    if (request.target.starts_with("/oauth/")) {
+      response.body = R"({"access_token":"c9SQxWWhmdVRlyh0zh8gZDTkubVF","expires_in":"3599"})";
+    } else {
+      response.body =
+          R"({"MerchantRequestID":"29115-34620561-1","CheckoutRequestID":"ws_CO_191220191020363925",)"
+          R"("ResponseCode":"0","ResponseDescription":"Success. Request accepted for processing",)"
+          R"("CustomerMessage":"Success. Request accepted for processing"})";
+    }
+    return response;
+  });
+  server.start();
+
+  mpesa::HttpClientOptions token_options;
+  token_options.pool.tls.ca_pem = server.ca_pem();
+  mpesa::HttpClient token_http(token_options);
+  mpesa::TokenManager tokens(token_http, server.endpoint(), mpesa::Credentials{"key", "secret"});
+
+  std::printf("%d STK Push calls from one loop thread, <= %zu connections, TLS stand-in on 127.0.0.1:%u\n\n",
+              requests, max_connections, server.port());
+  std::printf("%-10s %10s %10s %12s %12s %8s\n", "in_flight", "p50_us", "p99_us", "req/s", "connections",
+              "errors");
+  for (const int in_flight : {1, 16, 64, 256}) {
+    const Result r = run(server, tokens, in_flight, std::max(requests, in_flight), max_connections);
+    std::printf("%-10d %10.1f %10.1f %12.0f %12llu %8zu\n", in_flight, r.p50_us, r.p99_us, r.rps,
+                static_cast<unsigned long long>(r.connections), r.errors);
+  }
+  server.stop();
+  return 0;
+}
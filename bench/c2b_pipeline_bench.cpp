@@ -0,0 +1,168 @@
+// Paybill rush through the C2B ingestion pipeline. Producers offer
+// pre-rendered confirmations (every tenth a redelivery of an earlier one)
+// straight into a C2BPipeline, then the same load arrives over HTTP through
+// CallbackServer's body route. A sink that takes `--sink-us` per batch
+// stands in for the database; slow it down to watch backpressure turn into
+// refusals and 503s.
+//
+//   c2b_pipeline_bench [--confirmations N] [--producers P] [--connections C]
+//                      [--capacity Q] [--sink-us U]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mpesa/c2b_pipeline.hpp"
+#include "mpesa/callback_server.hpp"
+#include "mpesa/http_client.hpp"
+
+namespace {
+
+constexpr const char* kConfirmationPath = "/mpesa/c2b/confirmation";
+
+std::string confirmation(std::size_t i) {
+  char id[24];
+  std::snprintf(id, sizeof(id), "RK%08zX", i);
+  std::string body = R"({"TransactionType":"Pay Bill","TransID":")";
+  body.append(id);
+  body.append(R"(","TransTime":"20261016063845","TransAmount":")");
+  body.append(std::to_string(10 + i % 5000)).append(i % 3 == 0 ? ".50" : "");
+  body.append(
+      R"(","BusinessShortCode":"600638","BillRefNumber":"invoice008","InvoiceNumber":"","OrgAccountBalance":"49197.00",)"
+      R"("ThirdPartyTransID":"","MSISDN":"2547*****149","FirstName":"John","MiddleName":"","LastName":"Doe"})");
+  return body;
+}
+
+// Every tenth body repeats the TransID of the one five before it.
+std::vector<std::string> corpus(std::size_t count) {
+  std::vector<std::string> bodies;
+  bodies.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) bodies.push_back(confirmation(i % 10 == 9 ? i - 5 : i));
+  return bodies;
+}
+
+struct Sink {
+  std::chrono::microseconds per_batch{0};
+  std::atomic<std::int64_t> cents{0};
+
+  void operator()(std::span<mpesa::C2BTransaction* const> batch) {
+    std::int64_t sum = 0;
+    for (const auto* t : batch) sum += t->amount_cents;
+    cents.fetch_add(sum, std::memory_order_relaxed);
+    if (per_batch.count() > 0) std::this_thread::sleep_for(per_batch);
+  }
+};
+
+double us(std::uint64_t ns) { return static_cast<double>(ns) / 1000.0; }
+
+void print_stats(const mpesa::C2BPipelineStats& s) {
+  std::printf("%-10s %10s %8s %8s %10s %10s %10s\n", "stage", "processed", "dropped", "depth", "p50_us", "p99_us",
+              "max_us");
+  for (std::size_t i = 0; i < mpesa::kC2BStageCount; ++i) {
+    const auto& st = s.stages[i];
+    std::printf("%-10s %10llu %8llu %8zu %10.1f %10.1f %10.1f\n", mpesa::to_string(static_cast<mpesa::C2BStage>(i)),
+                static_cast<unsigned long long>(st.processed), static_cast<unsigned long long>(st.dropped),
+                st.depth, us(st.latency.percentile(0.50)), us(st.latency.percentile(0.99)), us(st.latency.max()));
+  }
+  std::printf("%-10s %10llu %8s %8s %10.1f %10.1f %10.1f\n", "end2end", static_cast<unsigned long long>(s.sunk), "",
+              "", us(s.end_to_end.percentile(0.50)), us(s.end_to_end.percentile(0.99)), us(s.end_to_end.max()));
+  std::printf("offered=%llu refused=%llu sunk=%llu\n", static_cast<unsigned long long>(s.offered),
+              static_cast<unsigned long long>(s.refused), static_cast<unsigned long long>(s.sunk));
+}
+
+void run_direct(const std::vector<std::string>& bodies, int producers, const mpesa::C2BPipelineOptions& options,
+                std::chrono::microseconds sink_us) {
+  Sink sink{sink_us};
+  mpesa::C2BPipeline pipeline(options, {.sink = std::ref(sink)});
+  std::atomic<std::size_t> next{0};
+  std::atomic<std::size_t> refused{0};
+  const auto started = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&] {
+      for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < bodies.size();) {
+        if (!pipeline.offer(bodies[i])) refused.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  pipeline.stop();
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  std::printf("direct: %zu confirmations from %d producers, capacity %zu, sink %lld us/batch\n", bodies.size(),
+              producers, options.capacity, static_cast<long long>(sink_us.count()));
+  std::printf("  %.0f confirmations/s, %zu refused, KES %.2f sunk\n\n", static_cast<double>(bodies.size()) / elapsed,
+              refused.load(), static_cast<double>(sink.cents.load()) / 100.0);
+  print_stats(pipeline.stats());
+}
+
+void run_http(const std::vector<std::string>& bodies, int connections, const mpesa::C2BPipelineOptions& options,
+              std::chrono::microseconds sink_us) {
+  Sink sink{sink_us};
+  mpesa::C2BPipeline pipeline(options, {.sink = std::ref(sink)});
+  mpesa::CallbackServer server({.bind_address = "127.0.0.1"});
+  server.on_c2b_confirmation_body(kConfirmationPath,
+                                  [&](std::string_view body) { return pipeline.offer(body); });
+  server.start();
+
+  mpesa::HttpClient client(mpesa::HttpClientOptions{});
+  const mpesa::Endpoint endpoint{"127.0.0.1", server.port(), false};
+  std::atomic<std::size_t> next{0};
+  std::atomic<std::size_t> busy{0};
+  std::atomic<std::size_t> errors{0};
+  const auto started = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int c = 0; c < connections; ++c) {
+    threads.emplace_back([&] {
+      mpesa::HttpRequest request;
+      request.method = "POST";
+      request.target = kConfirmationPath;
+      request.headers = {{"Content-Type", "application/json"}};
+      for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < bodies.size();) {
+        request.body = bodies[i];
+        try {
+          const int status = client.send(endpoint, request).status;
+          if (status == 503) busy.fetch_add(1, std::memory_order_relaxed);
+          else if (status != 200) errors.fetch_add(1, std::memory_order_relaxed);
+        } catch (const std::exception&) {
+          errors.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  server.stop();
+  pipeline.stop();
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  std::printf("\nhttp: %zu confirmations over %d keep-alive connections, %u workers\n", bodies.size(), connections,
+              server.workers());
+  std::printf("  %.0f confirmations/s, %zu answered 503, %zu errors\n\n", static_cast<double>(bodies.size()) / elapsed,
+              busy.load(), errors.load());
+  print_stats(pipeline.stats());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::size_t confirmations = 200'000;
+  int producers = 4;
+  int connections = 8;
+  long sink_us = 0;
+  mpesa::C2BPipelineOptions options;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--confirmations") == 0) confirmations = std::strtoul(argv[i + 1], nullptr, 10);
+    else if (std::strcmp(argv[i], "--producers") == 0) producers = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--connections") == 0) connections = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--capacity") == 0) options.capacity = std::strtoul(argv[i + 1], nullptr, 10);
+    else if (std::strcmp(argv[i], "--sink-us") == 0) sink_us = std::atol(argv[i + 1]);
+  }
+  const auto bodies = corpus(confirmations);
+  run_direct(bodies, std::max(producers, 1), options, std::chrono::microseconds(sink_us));
+  run_http(bodies, std::max(connections, 1), options, std::chrono::microseconds(sink_us));
+  return 0;
+}
@@ -0,0 +1,132 @@
+// Month-end callback storm against the receiver: client threads replay STK
+// results, C2B confirmations and B2C results over keep-alive connections
+// as fast as the server acknowledges them.
+//
+//   callback_bench [--requests N] [--connections C] [--workers W]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mpesa/callback_server.hpp"
+#include "mpesa/http_client.hpp"
+
+namespace {
+
+constexpr const char* kStkPath = "/mpesa/stk";
+constexpr const char* kConfirmationPath = "/mpesa/c2b/confirmation";
+constexpr const char* kResultPath = "/mpesa/b2c/result";
+
+const char* const kStkBody =
+    R"({"Body":{"stkCallback":{"MerchantRequestID":"29115-34620561-1","CheckoutRequestID":"ws_CO_191220191020363925",)"
+    R"("ResultCode":0,"ResultDesc":"The service request is processed successfully.","CallbackMetadata":{"Item":[)"
+    R"({"Name":"Amount","Value":1.00},{"Name":"MpesaReceiptNumber","Value":"NLJ7RT61SV"},{"Name":"Balance"},)"
+    R"({"Name":"TransactionDate","Value":20191219102115},{"Name":"PhoneNumber","Value":254708374149}]}}}})";
+
+const char* const kConfirmationBody =
+    R"({"TransactionType":"Pay Bill","TransID":"RKTQDM7W6S","TransTime":"20191122063845","TransAmount":"10",)"
+    R"("BusinessShortCode":"600638","BillRefNumber":"invoice008","InvoiceNumber":"","OrgAccountBalance":"49197.00",)"
+    R"("ThirdPartyTransID":"","MSISDN":"2547*****149","FirstName":"John","MiddleName":"","LastName":"Doe"})";
+
+const char* const kResultBody =
+    R"({"Result":{"ResultType":0,"ResultCode":0,"ResultDesc":"The service request is processed successfully.",)"
+    R"("OriginatorConversationID":"10571-7910404-1","ConversationID":"AG_20191219_00004e48cf7e3533f581",)"
+    R"("TransactionID":"NLJ41HAY6Q","ResultParameters":{"ResultParameter":[)"
+    R"({"Key":"TransactionAmount","Value":10},{"Key":"TransactionReceipt","Value":"NLJ41HAY6Q"},)"
+    R"({"Key":"B2CRecipientIsRegisteredCustomer","Value":"Y"},{"Key":"B2CChargesPaidAccountAvailableFunds","Value":-4510.00},)"
+    R"({"Key":"ReceiverPartyPublicName","Value":"254708374149 - John Doe"},)"
+    R"({"Key":"TransactionCompletedDateTime","Value":"19.12.2019 11:45:50"},)"
+    R"({"Key":"B2CUtilityAccountAvailableFunds","Value":10116.00},{"Key":"B2CWorkingAccountAvailableFunds","Value":900000.00}]},)"
+    R"("ReferenceData":{"ReferenceItem":{"Key":"QueueTimeoutURL","Value":"https://internalsandbox.safaricom.co.ke/mpesa/b2cresults/v1/submit"}}}})";
+
+double percentile(const std::vector<double>& sorted, double q) {
+  if (sorted.empty()) return 0;
+  return sorted[static_cast<std::size_t>(q * static_cast<double>(sorted.size() - 1))];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int requests = 60000;
+  int connections = 8;
+  unsigned workers = 0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--requests") == 0) requests = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--connections") == 0) connections = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--workers") == 0) workers = static_cast<unsigned>(std::atoi(argv[i + 1]));
+  }
+  connections = std::max(connections, 1);
+
+  std::atomic<std::uint64_t> amount_digits{0};  // keeps handlers from being optimised away
+  mpesa::CallbackServer server({.bind_address = "127.0.0.1", .workers = workers});
+  server.on_stk_callback(kStkPath, [&](const mpesa::StkCallback& cb) {
+    amount_digits.fetch_add(cb.amount.size(), std::memory_order_relaxed);
+  });
+  server.on_c2b_confirmation(kConfirmationPath, [&](const mpesa::C2BNotification& n) {
+    amount_digits.fetch_add(n.trans_amount.size(), std::memory_order_relaxed);
+  });
+  server.on_result(kResultPath, [&](const mpesa::ResultCallback& r) {
+    amount_digits.fetch_add(r.parameter("TransactionAmount").size(), std::memory_order_relaxed);
+  });
+  server.start();
+
+  mpesa::HttpClientOptions options;
+  mpesa::HttpClient client(options);
+  const mpesa::Endpoint endpoint{"127.0.0.1", server.port(), false};
+  const struct {
+    const char* path;
+    const char* body;
+  } payloads[] = {{kStkPath, kStkBody}, {kConfirmationPath, kConfirmationBody}, {kResultPath, kResultBody}};
+
+  const int per_connection = requests / connections;
+  std::vector<std::vector<double>> latencies(static_cast<std::size_t>(connections));
+  std::atomic<std::size_t> errors{0};
+  const auto started = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int c = 0; c < connections; ++c) {
+    threads.emplace_back([&, c] {
+      auto& lat = latencies[static_cast<std::size_t>(c)];
+      lat.reserve(static_cast<std::size_t>(per_connection));
+      mpesa::HttpRequest request;
+      request.method = "POST";
+      request.headers = {{"Content-Type", "application/json"}};
+      for (int i = 0; i < per_connection; ++i) {
+        const auto& p = payloads[static_cast<std::size_t>(i + c) % std::size(payloads)];
+        request.target = p.path;
+        request.body = p.body;
+        const auto t0 = std::chrono::steady_clock::now();
+        try {
+          if (client.send(endpoint, request).status != 200) ++errors;
+        } catch (const std::exception&) {
+          ++errors;
+        }
+        lat.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  server.stop();
+
+  std::vector<double> all;
+  for (const auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+  std::sort(all.begin(), all.end());
+  const auto s = server.stats();
+  std::printf("%zu callbacks over %d keep-alive connections, %u workers\n\n", all.size(), connections,
+              server.workers());
+  std::printf("%12s %10s %10s %10s %10s %8s\n", "req/s", "p50_us", "p99_us", "p999_us", "max_us", "errors");
+  std::printf("%12.0f %10.1f %10.1f %10.1f %10.1f %8zu\n", static_cast<double>(all.size()) / elapsed,
+              percentile(all, 0.50), percentile(all, 0.99), percentile(all, 0.999), all.empty() ? 0 : all.back(),
+              errors.load());
+  std::printf("\nevents: stk=%llu c2b_confirmation=%llu result=%llu rejected=%llu handler_errors=%llu\n",
+              static_cast<unsigned long long>(s.stk_callbacks),
+              static_cast<unsigned long long>(s.c2b_confirmations), static_cast<unsigned long long>(s.results),
+              static_cast<unsigned long long>(s.rejected), static_cast<unsigned long long>(s.handler_errors));
+  return errors.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+// SecurityCredential cost: RSA encryption on every request against the
+// per-initiator cache, and certificate rotation re-encrypting N initiators
+// as one batch. Uses a throwaway 2048-bit RSA certificate (Safaricom's are
+// 2048-bit too); the credential is decrypted once to check the round trip.
+
+#include <benchmark/benchmark.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mpesa/security_credential.hpp"
+
+namespace {
+
+struct TestCertificate {
+  std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key{nullptr, &EVP_PKEY_free};
+  std::string pem;
+};
+
+TestCertificate make_certificate() {
+  TestCertificate out;
+  EVP_PKEY* raw = nullptr;
+  std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> kctx(EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr),
+                                                                   &EVP_PKEY_CTX_free);
+  EVP_PKEY_keygen_init(kctx.get());
+  EVP_PKEY_CTX_set_rsa_keygen_bits(kctx.get(), 2048);
+  EVP_PKEY_keygen(kctx.get(), &raw);
+  out.key.reset(raw);
+  std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), &X509_free);
+  X509_set_version(cert.get(), 2);
+  X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert.get()), 3600);
+  X509_set_pubkey(cert.get(), raw);
+  X509_sign(cert.get(), raw, EVP_sha256());
+  std::unique_ptr<BIO, decltype(&BIO_free)> bio(BIO_new(BIO_s_mem()), &BIO_free);
+  PEM_write_bio_X509(bio.get(), cert.get());
+  char* data = nullptr;
+  const long size = BIO_get_mem_data(bio.get(), &data);
+  out.pem.assign(data, static_cast<std::size_t>(size));
+  return out;
+}
+
+const TestCertificate& certificate() {
+  static const TestCertificate c = make_certificate();
+  return c;
+}
+
+std::string decrypt(EVP_PKEY* key, const std::string& credential) {
+  std::vector<unsigned char> cipher(credential.size());
+  const int n = EVP_DecodeBlock(cipher.data(), reinterpret_cast<const unsigned char*>(credential.data()),
+                                static_cast<int>(credential.size()));
+  std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx(EVP_PKEY_CTX_new(key, nullptr), &EVP_PKEY_CTX_free);
+  EVP_PKEY_decrypt_init(ctx.get());
+  EVP_PKEY_CTX_set_rsa_padding(ctx.get(), RSA_PKCS1_PADDING);
+  std::string plain(512, '\0');
+  std::size_t size = plain.size();
+  // Base64 decoding pads the output; the ciphertext is exactly the key size.
+  const std::size_t cipher_size = static_cast<std::size_t>(EVP_PKEY_size(key));
+  if (n < 0 || EVP_PKEY_decrypt(ctx.get(), reinterpret_cast<unsigned char*>(plain.data()), &size, cipher.data(),
+                                cipher_size) != 1) {
+    return {};
+  }
+  plain.resize(size);
+  return plain;
+}
+
+void BM_EncryptPerRequest(benchmark::State& state) {
+  mpesa::SecurityCredentials credentials(certificate().pem);
+  for (auto _ : state) benchmark::DoNotOptimize(credentials.encrypt("Safaricom999!*!"));
+}
+BENCHMARK(BM_EncryptPerRequest);
+
+void BM_CachedCredential(benchmark::State& state) {
+  static mpesa::SecurityCredentials credentials(certificate().pem);
+  for (auto _ : state) benchmark::DoNotOptimize(credentials.get("testapi", "Safaricom999!*!"));
+  if (state.thread_index() == 0) state.counters["encryptions"] = static_cast<double>(credentials.encryptions());
+}
+BENCHMARK(BM_CachedCredential)->ThreadRange(1, 4)->UseRealTime();
+
+void BM_RotateCertificate(benchmark::State& state) {
+  mpesa::SecurityCredentials credentials(certificate().pem);
+  std::vector<mpesa::InitiatorPassword> initiators;
+  for (int i = 0; i < state.range(0); ++i) initiators.push_back({"initiator" + std::to_string(i), "pw" + std::to_string(i)});
+  credentials.set(initiators);
+  for (auto _ : state) credentials.rotate_certificate(certificate().pem);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RotateCertificate)->Arg(1)->Arg(64)->Arg(512)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  mpesa::SecurityCredentials credentials(certificate().pem);
+  const std::string credential = credentials.get("testapi", "Safaricom999!*!");
+  if (decrypt(certificate().key.get(), credential) != "Safaricom999!*!" ||
+      credentials.get("testapi", "Safaricom999!*!") != credential || credentials.encryptions() != 1) {
+    std::fprintf(stderr, "credential round trip failed\n");
+    return 1;
+  }
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,242 @@
+// A payroll run against the local HTTPS stand-in: N B2C transfers streamed
+// from CSV through DisbursementEngine, with a share of the requests
+// throttled (429 or spike arrest, and retried) and every accepted transfer
+// followed by a result callback after a delay. A smaller share is carried
+// out and then answered only after the client has timed out, as when
+// Daraja takes a request and the reply is lost. Prints throughput and the
+// acceptance and completion latency histograms.
+//
+//   disbursement_bench [--transfers N] [--concurrency C] [--rate R]
+//                      [--error-rate P] [--stall-rate P] [--result-delay-ms D]
+//                      [--journal FILE]
+//
+// The run fails if any transfer was carried out other than exactly once.
+// With --journal, transfers are journaled (and durable) before they are
+// sent; the run fails if any is left in flight there at the end.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "mpesa/disbursement.hpp"
+#include "mpesa/http_client.hpp"
+#include "mpesa/json.hpp"
+#include "mpesa/prepared_request.hpp"
+#include "mpesa/sim/https_server.hpp"
+
+namespace {
+
+struct PendingResult {
+  std::chrono::steady_clock::time_point due;
+  std::string originator_id;
+  std::string conversation_id;
+  bool success;
+};
+
+/// Result callbacks the stand-in owes, delivered in order of acceptance.
+class ResultQueue {
+ public:
+  void push(PendingResult r) {
+    {
+      std::lock_guard lock(mutex_);
+      queue_.push_back(std::move(r));
+    }
+    cv_.notify_one();
+  }
+
+  void deliver(mpesa::DisbursementEngine& engine) {
+    std::unique_lock lock(mutex_);
+    while (!closed_) {
+      if (queue_.empty()) {
+        cv_.wait(lock);
+        continue;
+      }
+      PendingResult r = std::move(queue_.front());
+      queue_.pop_front();
+      lock.unlock();
+      std::this_thread::sleep_until(r.due);
+      mpesa::ResultCallback callback;
+      callback.result_type = 0;
+      callback.result_code = r.success ? 0 : 2001;
+      callback.result_desc = r.success ? "The service request is processed successfully." : "The initiator information is invalid.";
+      callback.originator_conversation_id = r.originator_id;
+      callback.conversation_id = r.conversation_id;
+      callback.transaction_id = r.success ? "NLJ41HAY6Q" : "";
+      engine.on_result(callback);
+      lock.lock();
+    }
+  }
+
+  void close() {
+    {
+      std::lock_guard lock(mutex_);
+      closed_ = true;
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<PendingResult> queue_;
+  bool closed_ = false;
+};
+
+std::string payroll_csv(int transfers) {
+  std::string csv = "PartyB,Amount,Remarks\n";
+  for (int i = 0; i < transfers; ++i) {
+    csv += "2547" + std::to_string(10'000'000 + i) + "," + std::to_string(500 + i % 9'500) + ",\"Salary, October\"\n";
+  }
+  return csv;
+}
+
+double ms(std::uint64_t ns) { return static_cast<double>(ns) / 1e6; }
+
+void print_latency(const char* name, const mpesa::Histogram& h) {
+  std::printf("%-12s %8llu %9.2f %9.2f %9.2f %9.2f %9.2f\n", name, static_cast<unsigned long long>(h.count()),
+              ms(h.percentile(0.50)), ms(h.percentile(0.90)), ms(h.percentile(0.99)), ms(h.percentile(0.999)),
+              ms(h.max()));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int transfers = 20'000;
+  double error_rate = 0.02;
+  double stall_rate = 0.001;
+  int result_delay_ms = 20;
+  const char* journal_path = nullptr;
+  mpesa::DisbursementOptions options;
+  options.concurrency = 64;
+  options.retry_backoff = std::chrono::milliseconds(5);
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--transfers") == 0) transfers = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--concurrency") == 0) options.concurrency = static_cast<unsigned>(std::atoi(argv[i + 1]));
+    else if (std::strcmp(argv[i], "--rate") == 0) options.max_rate = std::atof(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--error-rate") == 0) error_rate = std::atof(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--stall-rate") == 0) stall_rate = std::atof(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--result-delay-ms") == 0) result_delay_ms = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--journal") == 0) journal_path = argv[i + 1];
+  }
+  std::unique_ptr<mpesa::RequestJournal> journal;
+  if (journal_path != nullptr) {
+    journal = std::make_unique<mpesa::RequestJournal>(journal_path);
+    options.journal = journal.get();
+  }
+
+  // Replies are held back past the client's request timeout.
+  constexpr auto kRequestTimeout = std::chrono::seconds(2);
+  constexpr auto kStall = std::chrono::seconds(3);
+
+  ResultQueue results;
+  std::atomic<std::uint64_t> requests{0};
+  std::atomic<std::uint64_t> stalls{0};
+  std::mutex processed_mutex;
+  std::unordered_map<std::string, int> processed;  // by OriginatorConversationID
+  mpesa::sim::HttpsServer server([&](const mpesa::HttpRequest& request) {
+    mpesa::HttpResponse response;
+    response.status = 200;
+    response.headers = {{"Content-Type", "application/json"}};
+    if (request.target.starts_with("/oauth/")) {
+      response.body = R"({"access_token":"c9SQxWWhmdVRlyh0zh8gZDTkubVF","expires_in":"3599"})";
+      return response;
+    }
+    const std::uint64_t n = requests.fetch_add(1, std::memory_order_relaxed);
+    // Deterministic fault injection: every k-th request is throttled,
+    // alternating between a 429 and the gateway's spike-arrest 500.
+    const std::uint64_t every = error_rate > 0 ? static_cast<std::uint64_t>(1 / error_rate) : 0;
+    if (every != 0 && n % every == every - 1) {
+      response.status = (n / every) % 2 == 0 ? 429 : 500;
+      response.body = R"({"requestId":"1","errorCode":"500.003.02","errorMessage":"Spike arrest violation"})";
+      return response;
+    }
+    const mpesa::json::Value body = mpesa::json::parse(request.body);
+    const std::string originator = body.at("OriginatorConversationID").as_string();
+    const std::string conversation = "AG_20241016_" + std::to_string(n);
+    response.body = R"({"ConversationID":")" + conversation + R"(","OriginatorConversationID":")" + originator +
+                    R"(","ResponseCode":"0","ResponseDescription":"Accept the service request successfully."})";
+    {
+      std::lock_guard lock(processed_mutex);
+      ++processed[originator];
+    }
+    results.push({std::chrono::steady_clock::now() + std::chrono::milliseconds(result_delay_ms), originator,
+                  conversation, n % 50 != 0});
+    const std::uint64_t stall_every = stall_rate > 0 ? static_cast<std::uint64_t>(1 / stall_rate) : 0;
+    if (stall_every != 0 && n % stall_every == stall_every / 2) {
+      stalls.fetch_add(1, std::memory_order_relaxed);
+      std::this_thread::sleep_for(kStall);
+    }
+    return response;
+  });
+  server.start();
+
+  mpesa::HttpClientOptions http_options;
+  http_options.pool.tls.ca_pem = server.ca_pem();
+  http_options.pool.max_connections_per_endpoint = options.concurrency;
+  http_options.request_timeout = kRequestTimeout;
+  mpesa::HttpClient token_http(http_options);
+  mpesa::TokenManager tokens(token_http, server.endpoint(), mpesa::Credentials{"key", "secret"});
+
+  mpesa::EventLoop loop;
+  mpesa::AsyncHttpClient http(loop, http_options);
+  mpesa::AsyncDarajaClient daraja(http, tokens, server.endpoint());
+  mpesa::DisbursementEngine engine(daraja, options);
+  std::thread delivery([&] { results.deliver(engine); });
+
+  mpesa::B2CRequest defaults;
+  defaults.initiator_name = "testapi";
+  defaults.security_credential = "Sx9AwbD7nWUzM2gXq3vO+5yPxN0sJb1T8dLkR4fH6cQeYmZiVt2uKo7GjAlEpBrC==";
+  mpesa::set_command<mpesa::command::SalaryPayment>(defaults);
+  defaults.party_a = "600998";
+  defaults.queue_timeout_url = "https://payouts.example.com/b2c/timeout";
+  defaults.result_url = "https://payouts.example.com/b2c/result";
+  std::istringstream csv(payroll_csv(transfers));
+
+  std::printf(
+      "%d B2C transfers from CSV, %u in flight, rate cap %s, %.1f%% throttled, %.2f%% stalled, results after %d ms\n\n",
+      transfers, options.concurrency, options.max_rate > 0 ? std::to_string(options.max_rate).c_str() : "none",
+      error_rate * 100, stall_rate * 100, result_delay_ms);
+  loop.sync_wait(engine.run(mpesa::CsvDisbursementSource(csv, defaults)));
+  const bool complete = engine.wait_for_results(std::chrono::seconds(60));
+  results.close();
+  delivery.join();
+
+  const mpesa::DisbursementReport r = engine.report();
+  using S = mpesa::DisbursementStatus;
+  std::printf("total %zu: succeeded %zu, failed %zu, rejected %zu, unconfirmed %zu, outstanding %zu\n", r.total,
+              r.count(S::kSucceeded), r.count(S::kFailed), r.count(S::kRejected), r.count(S::kUnconfirmed),
+              r.count(S::kPending) + r.count(S::kAccepted));
+  std::size_t not_once = 0;
+  std::lock_guard lock(processed_mutex);
+  engine.visit([&](const mpesa::Disbursement& d) {
+    const auto it = processed.find(d.request.originator_conversation_id);
+    not_once += it == processed.end() || it->second != 1;
+  });
+  std::printf("replies stalled past the timeout %llu, transfers not carried out exactly once %zu\n",
+              static_cast<unsigned long long>(stalls.load()), not_once);
+  std::printf("attempts %llu, retries %llu, throttled %llu\n", static_cast<unsigned long long>(r.attempts),
+              static_cast<unsigned long long>(r.retries), static_cast<unsigned long long>(r.throttled));
+  std::printf("submitted in %.2f s (%.0f accepted/s), completed in %.2f s (%.0f results/s)%s\n\n",
+              r.submit_time.count(), r.accept_rate(), r.completion_time.count(), r.completion_rate(),
+              complete ? "" : ", timed out waiting for results");
+  std::printf("%-12s %8s %9s %9s %9s %9s %9s\n", "latency_ms", "count", "p50", "p90", "p99", "p99.9", "max");
+  print_latency("accepted", r.accept_latency);
+  print_latency("completed", r.completion_latency);
+  server.stop();
+  std::size_t in_flight = 0;
+  if (journal) {
+    journal.reset();
+    in_flight = mpesa::RequestJournal::read(journal_path).size();
+    std::printf("\njournal: %zu transfers left in flight\n", in_flight);
+  }
+  return complete && not_once == 0 && r.count(S::kRejected) == 0 && in_flight == 0 ? 0 : 1;
+}
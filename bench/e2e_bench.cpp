@@ -0,0 +1,429 @@
+// End-to-end suite against the local Daraja simulator: every operation is
+// driven through AsyncDarajaClient with C calls in flight, the simulator
+// posts each outcome to a CallbackServer, and the request serialization and
+// callback decoding steps are timed on their own. Prints a table and, with
+// --json, writes every figure as a flat `{"metrics": {name: value}}` file.
+// --baseline compares against an earlier file and exits 1 when a throughput
+// figure (`*.rps`, `*.per_s`) fell or a latency/cost figure (`*_us`, `*_ns`)
+// rose by more than --tolerance (default 0.2 = 20%).
+//
+//   e2e_bench [--requests N] [--in-flight C] [--latency-us L]
+//             [--json FILE] [--baseline FILE] [--tolerance T]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mpesa/async_daraja_client.hpp"
+#include "mpesa/callback_server.hpp"
+#include "mpesa/callbacks.hpp"
+#include "mpesa/histogram.hpp"
+#include "mpesa/http_client.hpp"
+#include "mpesa/json.hpp"
+#include "mpesa/sim/daraja_simulator.hpp"
+
+namespace {
+
+constexpr const char* kPasskey = "bfb279f9aa9bdbcf158e97dd71a467cd2e0c893059b10f78e6b72ada1ed2c919";
+constexpr const char* kCredential = "Sx9AwbD7nWUzM2gXq3vO+5yPxN0sJb1T8dLkR4fH6cQeYmZiVt2uKo7GjAlEpBrC==";
+
+using MetricList = std::vector<std::pair<std::string, double>>;
+
+/// Shared by the request factories: where callbacks go and the checkout IDs
+/// the STK Push phase produced for the STK Query phase.
+struct Context {
+  std::string callback_base;
+  std::vector<std::string> checkout_ids;
+};
+
+mpesa::StkPushRequest stk_push(const Context& ctx, int i) {
+  mpesa::StkPushRequest r;
+  r.business_short_code = "174379";
+  r.passkey = kPasskey;
+  r.amount = 1 + i % 1000;
+  r.party_a = "254708374149";
+  r.callback_url = ctx.callback_base + "/stk";
+  r.account_reference = "INV" + std::to_string(i);
+  r.transaction_desc = "Payment";
+  return r;
+}
+
+mpesa::StkQueryRequest stk_query(const Context& ctx, int i) {
+  mpesa::StkQueryRequest r;
+  r.business_short_code = "174379";
+  r.passkey = kPasskey;
+  r.checkout_request_id = ctx.checkout_ids[static_cast<std::size_t>(i) % ctx.checkout_ids.size()];
+  return r;
+}
+
+mpesa::C2BRegisterUrlRequest c2b_register(const Context& ctx, int i) {
+  mpesa::C2BRegisterUrlRequest r;
+  r.short_code = std::to_string(600'000 + i % 16);
+  r.confirmation_url = ctx.callback_base + "/c2b/confirmation";
+  r.validation_url = ctx.callback_base + "/c2b/validation";
+  return r;
+}
+
+mpesa::C2BSimulateRequest c2b_simulate(const Context&, int i) {
+  mpesa::C2BSimulateRequest r;
+  r.short_code = std::to_string(600'000 + i % 16);
+  r.amount = 10 + i % 500;
+  r.msisdn = "254708374149";
+  r.bill_ref_number = "ACC" + std::to_string(i);
+  return r;
+}
+
+mpesa::B2CRequest b2c(const Context& ctx, int i) {
+  mpesa::B2CRequest r;
+  r.originator_conversation_id = "e2e-" + std::to_string(i);
+  r.initiator_name = "testapi";
+  r.security_credential = kCredential;
+  r.amount = 100 + i % 1000;
+  r.party_a = "600998";
+  r.party_b = "254708374149";
+  r.remarks = "Payout";
+  r.queue_timeout_url = ctx.callback_base + "/timeout";
+  r.result_url = ctx.callback_base + "/result";
+  return r;
+}
+
+mpesa::B2BRequest b2b(const Context& ctx, int i) {
+  mpesa::B2BRequest r;
+  r.initiator = "testapi";
+  r.security_credential = kCredential;
+  r.amount = 100 + i % 1000;
+  r.party_a = "600998";
+  r.party_b = "000000";
+  r.account_reference = "353353";
+  r.remarks = "Supplies";
+  r.queue_timeout_url = ctx.callback_base + "/timeout";
+  r.result_url = ctx.callback_base + "/result";
+  return r;
+}
+
+mpesa::TransactionStatusRequest transaction_status(const Context& ctx, int i) {
+  mpesa::TransactionStatusRequest r;
+  r.initiator = "testapi";
+  r.security_credential = kCredential;
+  r.transaction_id = "OEI2AK4Q" + std::to_string(i % 100);
+  r.party_a = "600998";
+  r.remarks = "Status";
+  r.queue_timeout_url = ctx.callback_base + "/timeout";
+  r.result_url = ctx.callback_base + "/result";
+  return r;
+}
+
+mpesa::AccountBalanceRequest account_balance(const Context& ctx, int) {
+  mpesa::AccountBalanceRequest r;
+  r.initiator = "testapi";
+  r.security_credential = kCredential;
+  r.party_a = "600998";
+  r.remarks = "Balance";
+  r.queue_timeout_url = ctx.callback_base + "/timeout";
+  r.result_url = ctx.callback_base + "/result";
+  return r;
+}
+
+mpesa::ReversalRequest reversal(const Context& ctx, int i) {
+  mpesa::ReversalRequest r;
+  r.initiator = "testapi";
+  r.security_credential = kCredential;
+  r.transaction_id = "OEI2AK4Q" + std::to_string(i % 100);
+  r.amount = 100;
+  r.receiver_party = "600998";
+  r.remarks = "Refund";
+  r.queue_timeout_url = ctx.callback_base + "/timeout";
+  r.result_url = ctx.callback_base + "/result";
+  return r;
+}
+
+struct PhaseResult {
+  mpesa::Histogram latency;
+  std::size_t errors = 0;
+  double seconds = 0;
+};
+
+template <class Request>
+mpesa::Task<void> drive(mpesa::EventLoop& loop, mpesa::AsyncDarajaClient& client, Context& ctx,
+                        Request (*make)(const Context&, int), int first, int count, PhaseResult& result,
+                        int& running) {
+  for (int i = first; i < first + count; ++i) {
+    const auto t0 = mpesa::Clock::now();
+    try {
+      auto response = co_await client.call(make(ctx, i));
+      if constexpr (std::is_same_v<Request, mpesa::StkPushRequest>) {
+        ctx.checkout_ids.push_back(std::move(response.checkout_request_id));
+      }
+    } catch (const std::exception&) {
+      ++result.errors;
+    }
+    result.latency.record(mpesa::Clock::now() - t0);
+  }
+  if (--running == 0) loop.stop();
+}
+
+template <class Request>
+PhaseResult run_phase(mpesa::EventLoop& loop, mpesa::AsyncDarajaClient& client, Context& ctx,
+                      Request (*make)(const Context&, int), int requests, int in_flight) {
+  PhaseResult result;
+  const int per_task = std::max(1, requests / in_flight);
+  int running = in_flight;
+  const auto started = mpesa::Clock::now();
+  for (int t = 0; t < in_flight; ++t) {
+    loop.spawn(drive(loop, client, ctx, make, t * per_task, per_task, result, running));
+  }
+  loop.run();
+  result.seconds = std::chrono::duration<double>(mpesa::Clock::now() - started).count();
+  return result;
+}
+
+/// Best of a few rounds of `iterations` calls, in nanoseconds per call.
+double time_per_op(int iterations, const std::function<void()>& op) {
+  double best = 1e300;
+  for (int round = 0; round < 5; ++round) {
+    const auto t0 = mpesa::Clock::now();
+    for (int i = 0; i < iterations; ++i) op();
+    const double ns = std::chrono::duration<double, std::nano>(mpesa::Clock::now() - t0).count();
+    best = std::min(best, ns / iterations);
+  }
+  return best;
+}
+
+template <class Request>
+double serialize_cost(const Request& request) {
+  mpesa::HttpRequest out;
+  return time_per_op(100'000, [&] { mpesa::build_api_request(request, "c9SQxWWhmdVRlyh0zh8gZDTkubVF", out); });
+}
+
+template <class Event>
+double parse_cost(const std::string& body) {
+  return time_per_op(100'000, [&] {
+    mpesa::json::Reader reader(body);
+    Event event;
+    mpesa::read_callback(reader, event);
+  });
+}
+
+const char* const kStkBody =
+    R"({"Body":{"stkCallback":{"MerchantRequestID":"29115-34620561-1","CheckoutRequestID":"ws_CO_191220191020363925",)"
+    R"("ResultCode":0,"ResultDesc":"The service request is processed successfully.","CallbackMetadata":{"Item":[)"
+    R"({"Name":"Amount","Value":1.00},{"Name":"MpesaReceiptNumber","Value":"NLJ7RT61SV"},{"Name":"Balance"},)"
+    R"({"Name":"TransactionDate","Value":20191219102115},{"Name":"PhoneNumber","Value":254708374149}]}}}})";
+
+const char* const kConfirmationBody =
+    R"({"TransactionType":"Pay Bill","TransID":"RKTQDM7W6S","TransTime":"20191122063845","TransAmount":"10",)"
+    R"("BusinessShortCode":"600638","BillRefNumber":"invoice008","InvoiceNumber":"","OrgAccountBalance":"49197.00",)"
+    R"("ThirdPartyTransID":"","MSISDN":"2547*****149","FirstName":"John","MiddleName":"","LastName":"Doe"})";
+
+const char* const kResultBody =
+    R"({"Result":{"ResultType":0,"ResultCode":0,"ResultDesc":"The service request is processed successfully.",)"
+    R"("OriginatorConversationID":"10571-7910404-1","ConversationID":"AG_20191219_00004e48cf7e3533f581",)"
+    R"("TransactionID":"NLJ41HAY6Q","ResultParameters":{"ResultParameter":[)"
+    R"({"Key":"TransactionAmount","Value":10},{"Key":"TransactionReceipt","Value":"NLJ41HAY6Q"},)"
+    R"({"Key":"B2CRecipientIsRegisteredCustomer","Value":"Y"},{"Key":"B2CChargesPaidAccountAvailableFunds","Value":-4510.00},)"
+    R"({"Key":"ReceiverPartyPublicName","Value":"254708374149 - John Doe"},)"
+    R"({"Key":"TransactionCompletedDateTime","Value":"19.12.2019 11:45:50"},)"
+    R"({"Key":"B2CUtilityAccountAvailableFunds","Value":10116.00},{"Key":"B2CWorkingAccountAvailableFunds","Value":900000.00}]},)"
+    R"("ReferenceData":{"ReferenceItem":{"Key":"QueueTimeoutURL","Value":"https://internalsandbox.safaricom.co.ke/mpesa/b2cresults/v1/submit"}}}})";
+
+double us(std::uint64_t ns) { return static_cast<double>(ns) / 1e3; }
+
+void write_json(const std::string& path, const MetricList& metrics) {
+  std::string out = "{\"metrics\":{";
+  char number[64];
+  for (std::size_t i = 0; i < metrics.size(); ++i) {
+    if (i != 0) out += ',';
+    out += "\n  ";
+    mpesa::json::append_quoted(out, metrics[i].first);
+    std::snprintf(number, sizeof(number), ":%.6g", metrics[i].second);
+    out += number;
+  }
+  out += "\n}}\n";
+  std::ofstream(path) << out;
+}
+
+bool higher_is_better(std::string_view name) { return name.ends_with(".rps") || name.ends_with(".per_s"); }
+bool lower_is_better(std::string_view name) { return name.ends_with("_us") || name.ends_with("_ns"); }
+
+/// Prints each tracked figure that moved past `tolerance`; false if any got
+/// worse.
+bool compare(const std::string& path, const MetricList& metrics, double tolerance) {
+  std::ifstream file(path);
+  if (!file) {
+    std::fprintf(stderr, "cannot read baseline %s\n", path.c_str());
+    return false;
+  }
+  std::stringstream text;
+  text << file.rdbuf();
+  const mpesa::json::Value baseline = mpesa::json::parse(text.str()).at("metrics");
+  bool ok = true;
+  std::printf("\n%-36s %12s %12s %8s\n", "vs baseline", "baseline", "now", "change");
+  for (const auto& [name, value] : metrics) {
+    const mpesa::json::Value* old = baseline.find(name);
+    if (old == nullptr || !(higher_is_better(name) || lower_is_better(name))) continue;
+    const double before = old->as_double();
+    if (before <= 0) continue;
+    const double change = (value - before) / before;
+    const bool worse = higher_is_better(name) ? change < -tolerance : change > tolerance;
+    if (worse || std::abs(change) > tolerance) {
+      std::printf("%-36s %12.2f %12.2f %+7.1f%%%s\n", name.c_str(), before, value, change * 100,
+                  worse ? "  REGRESSION" : "");
+    }
+    ok = ok && !worse;
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int requests = 10'000;
+  int in_flight = 32;
+  int latency_us = 0;
+  std::string json_path;
+  std::string baseline_path;
+  double tolerance = 0.2;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--requests") == 0) requests = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--in-flight") == 0) in_flight = std::max(1, std::atoi(argv[i + 1]));
+    else if (std::strcmp(argv[i], "--latency-us") == 0) latency_us = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--json") == 0) json_path = argv[i + 1];
+    else if (std::strcmp(argv[i], "--baseline") == 0) baseline_path = argv[i + 1];
+    else if (std::strcmp(argv[i], "--tolerance") == 0) tolerance = std::atof(argv[i + 1]);
+  }
+
+  std::atomic<std::uint64_t> callbacks{0};
+  std::atomic<std::int64_t> first_callback{0};
+  std::atomic<std::int64_t> last_callback{0};
+  auto arrived = [&] {
+    const std::int64_t now = mpesa::Clock::now().time_since_epoch().count();
+    std::int64_t expected = 0;
+    first_callback.compare_exchange_strong(expected, now);
+    last_callback.store(now);
+    callbacks.fetch_add(1);
+  };
+  mpesa::CallbackServer receiver({.bind_address = "127.0.0.1", .workers = 2});
+  receiver.on_stk_callback("/stk", [&](const mpesa::StkCallback&) { arrived(); });
+  receiver.on_c2b_validation("/c2b/validation", [&](const mpesa::C2BNotification&) {
+    arrived();
+    return mpesa::C2BValidation::kAccept;
+  });
+  receiver.on_c2b_confirmation("/c2b/confirmation", [&](const mpesa::C2BNotification&) { arrived(); });
+  receiver.on_result("/result", [&](const mpesa::ResultCallback&) { arrived(); });
+  receiver.on_queue_timeout("/timeout", [&](const mpesa::ResultCallback&) { arrived(); });
+  receiver.start();
+
+  mpesa::sim::DarajaSimulatorOptions sim_options;
+  sim_options.passkey = kPasskey;
+  sim_options.latency = std::chrono::microseconds(latency_us);
+  sim_options.callback_workers = 8;
+  mpesa::sim::DarajaSimulator simulator(sim_options);
+  simulator.start();
+
+  mpesa::HttpClientOptions http_options;
+  http_options.pool.tls.ca_pem = simulator.ca_pem();
+  http_options.pool.max_connections_per_endpoint = static_cast<std::size_t>(in_flight);
+  mpesa::HttpClient token_http(http_options);
+  mpesa::TokenManager tokens(token_http, simulator.endpoint(), mpesa::Credentials{"key", "secret"});
+  tokens.get();
+  mpesa::EventLoop loop;
+  mpesa::AsyncHttpClient http(loop, http_options);
+  mpesa::AsyncDarajaClient client(http, tokens, simulator.endpoint());
+  Context ctx;
+  ctx.callback_base = "http://127.0.0.1:" + std::to_string(receiver.port());
+
+  std::printf("%d calls per operation, %d in flight, simulator latency %d us\n\n", requests, in_flight, latency_us);
+  std::printf("%-20s %10s %10s %10s %10s %10s %8s\n", "operation", "req/s", "p50_us", "p90_us", "p99_us",
+              "p99.9_us", "errors");
+  MetricList metrics;
+  bool clean = true;
+  auto report = [&](const char* name, const PhaseResult& r) {
+    const double rps = static_cast<double>(r.latency.count()) / r.seconds;
+    const mpesa::Histogram& h = r.latency;
+    std::printf("%-20s %10.0f %10.1f %10.1f %10.1f %10.1f %8zu\n", name, rps, us(h.percentile(0.50)),
+                us(h.percentile(0.90)), us(h.percentile(0.99)), us(h.percentile(0.999)), r.errors);
+    const std::string prefix = name;
+    metrics.emplace_back(prefix + ".rps", rps);
+    metrics.emplace_back(prefix + ".p50_us", us(h.percentile(0.50)));
+    metrics.emplace_back(prefix + ".p99_us", us(h.percentile(0.99)));
+    metrics.emplace_back(prefix + ".p999_us", us(h.percentile(0.999)));
+    metrics.emplace_back(prefix + ".errors", static_cast<double>(r.errors));
+    clean = clean && r.errors == 0;
+  };
+
+  // Blocking token fetches, one connection: what a cold TokenManager pays.
+  {
+    PhaseResult r;
+    mpesa::HttpRequest request;
+    request.target = "/oauth/v1/generate?grant_type=client_credentials";
+    request.headers = {{"Authorization", "Basic a2V5OnNlY3JldA=="}};
+    const int count = std::max(1, requests / 10);
+    const auto started = mpesa::Clock::now();
+    for (int i = 0; i < count; ++i) {
+      const auto t0 = mpesa::Clock::now();
+      try {
+        if (token_http.send(simulator.endpoint(), request).status != 200) ++r.errors;
+      } catch (const std::exception&) {
+        ++r.errors;
+      }
+      r.latency.record(mpesa::Clock::now() - t0);
+    }
+    r.seconds = std::chrono::duration<double>(mpesa::Clock::now() - started).count();
+    report("oauth", r);
+  }
+  report("stk_push", run_phase(loop, client, ctx, stk_push, requests, in_flight));
+  if (!ctx.checkout_ids.empty()) report("stk_query", run_phase(loop, client, ctx, stk_query, requests, in_flight));
+  report("c2b_register_url", run_phase(loop, client, ctx, c2b_register, requests, in_flight));
+  report("c2b_simulate", run_phase(loop, client, ctx, c2b_simulate, requests, in_flight));
+  report("b2c", run_phase(loop, client, ctx, b2c, requests, in_flight));
+  report("b2b", run_phase(loop, client, ctx, b2b, requests, in_flight));
+  report("transaction_status", run_phase(loop, client, ctx, transaction_status, requests, in_flight));
+  report("account_balance", run_phase(loop, client, ctx, account_balance, requests, in_flight));
+  report("reversal", run_phase(loop, client, ctx, reversal, requests, in_flight));
+
+  const bool drained = simulator.drain(std::chrono::seconds(60));
+  const double window = std::chrono::duration<double>(
+                            mpesa::Clock::duration(last_callback.load() - first_callback.load()))
+                            .count();
+  const mpesa::MetricsSnapshot snapshot = mpesa::Metrics::global().snapshot();
+  const mpesa::Histogram& handled = snapshot.phase(mpesa::Phase::kCallbackTotal);
+  const double callback_rate = window > 0 ? static_cast<double>(callbacks.load()) / window : 0;
+  std::printf("\ncallbacks: %llu received at %.0f/s, handled in p50 %.1f us, p99 %.1f us; %llu failed%s\n",
+              static_cast<unsigned long long>(callbacks.load()), callback_rate, us(handled.percentile(0.50)),
+              us(handled.percentile(0.99)), static_cast<unsigned long long>(simulator.stats().callback_failures),
+              drained ? "" : ", timed out draining");
+  metrics.emplace_back("callbacks.per_s", callback_rate);
+  metrics.emplace_back("callbacks.handle_p50_us", us(handled.percentile(0.50)));
+  metrics.emplace_back("callbacks.handle_p99_us", us(handled.percentile(0.99)));
+  clean = clean && drained && simulator.stats().callback_failures == 0;
+
+  std::printf("\n%-28s %10s\n", "step", "ns/op");
+  auto step = [&](const char* name, double ns) {
+    std::printf("%-28s %10.1f\n", name, ns);
+    metrics.emplace_back(name, ns);
+  };
+  step("serialize.stk_push_ns", serialize_cost(stk_push(ctx, 1)));
+  step("serialize.c2b_simulate_ns", serialize_cost(c2b_simulate(ctx, 1)));
+  step("serialize.b2c_ns", serialize_cost(b2c(ctx, 1)));
+  step("serialize.reversal_ns", serialize_cost(reversal(ctx, 1)));
+  step("parse.stk_callback_ns", parse_cost<mpesa::StkCallback>(kStkBody));
+  step("parse.c2b_confirmation_ns", parse_cost<mpesa::C2BNotification>(kConfirmationBody));
+  step("parse.result_ns", parse_cost<mpesa::ResultCallback>(kResultBody));
+
+  simulator.stop();
+  receiver.stop();
+  if (!json_path.empty()) write_json(json_path, metrics);
+  if (!baseline_path.empty() && !compare(baseline_path, metrics, tolerance)) return 1;
+  return clean ? 0 : 1;
+}
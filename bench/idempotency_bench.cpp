@@ -0,0 +1,126 @@
+// Cost of the duplicate check in front of callback handlers: admitting new
+// IDs, rejecting redeliveries, and a storm where a share of the IDs repeat,
+// from one or many threads. main() first checks the index against a
+// std::unordered_set on a mixed stream before timing anything.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "mpesa/idempotency.hpp"
+
+namespace {
+
+constexpr std::size_t kIds = 1 << 20;
+
+/// CheckoutRequestID-shaped keys, generated once.
+const std::vector<std::string>& ids() {
+  static const std::vector<std::string> all = [] {
+    std::vector<std::string> v;
+    v.reserve(kIds);
+    for (std::size_t i = 0; i < kIds; ++i) v.push_back("ws_CO_191220191020" + std::to_string(363925 + i * 7919));
+    return v;
+  }();
+  return all;
+}
+
+void BM_FirstSeen(benchmark::State& state) {
+  static mpesa::IdempotencyIndex* index = nullptr;
+  if (state.thread_index() == 0) index = new mpesa::IdempotencyIndex({.capacity = kIds * 4});
+  const auto& keys = ids();
+  // Each thread walks its own stride so every call admits a new key until
+  // the keys run out and wrap into duplicates.
+  std::size_t i = static_cast<std::size_t>(state.thread_index());
+  const std::size_t step = static_cast<std::size_t>(state.threads());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(index->first_seen(mpesa::IdKind::kCheckoutRequestId, keys[i % kIds]));
+    i += step;
+  }
+  if (state.thread_index() == 0) {
+    state.counters["duplicates"] = static_cast<double>(index->stats().duplicates);
+    delete index;
+  }
+}
+BENCHMARK(BM_FirstSeen)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_Duplicate(benchmark::State& state) {
+  static mpesa::IdempotencyIndex index({.capacity = kIds * 2});
+  static const bool filled = [] {
+    for (const auto& id : ids()) index.first_seen(mpesa::IdKind::kConversationId, id);
+    return true;
+  }();
+  benchmark::DoNotOptimize(filled);
+  const auto& keys = ids();
+  std::size_t i = static_cast<std::size_t>(state.thread_index()) * 7;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(index.first_seen(mpesa::IdKind::kConversationId, keys[i % kIds]));
+    i += 13;
+  }
+}
+BENCHMARK(BM_Duplicate)->ThreadRange(1, 8)->UseRealTime();
+
+// Redelivery storm: one call in eight repeats an ID from the last few
+// hundred, the way Daraja retries a slow acknowledgement.
+void BM_Storm(benchmark::State& state) {
+  mpesa::IdempotencyIndex index({.capacity = kIds});
+  const auto& keys = ids();
+  std::size_t next = 0;
+  std::uint64_t x = 88172645463325252ULL;
+  for (auto _ : state) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    const bool repeat = next > 512 && (x & 7) == 0;
+    const std::string& id = repeat ? keys[next - 1 - (x >> 3) % 512] : keys[next++ % kIds];
+    benchmark::DoNotOptimize(index.first_seen(mpesa::IdKind::kTransId, id));
+  }
+  state.counters["duplicates"] = static_cast<double>(index.stats().duplicates);
+}
+BENCHMARK(BM_Storm);
+
+bool agrees_with_set() {
+  mpesa::IdempotencyIndex index({.capacity = 1 << 16});
+  std::unordered_set<std::string> seen;
+  const auto& keys = ids();
+  std::uint64_t x = 2463534242ULL;
+  for (int n = 0; n < 200'000; ++n) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    const std::string& id = keys[x % 60'000];
+    if (index.first_seen(mpesa::IdKind::kTransId, id) != seen.insert(id).second) {
+      std::fprintf(stderr, "index disagrees with std::unordered_set on %s\n", id.c_str());
+      return false;
+    }
+  }
+  return index.stats().overflows == 0;
+}
+
+// A claimed ID reads as pending until committed, and is free again once
+// forgotten.
+bool claims_settle() {
+  using mpesa::IdClaim;
+  mpesa::IdempotencyIndex index({.capacity = 1 << 10});
+  const auto claim = [&](const char* id) { return index.claim(mpesa::IdKind::kConversationId, id); };
+  const bool ok = claim("AG_1") == IdClaim::kClaimed && claim("AG_1") == IdClaim::kPending &&
+                  (index.commit(mpesa::IdKind::kConversationId, "AG_1"), claim("AG_1") == IdClaim::kDone) &&
+                  claim("AG_2") == IdClaim::kClaimed &&
+                  (index.forget(mpesa::IdKind::kConversationId, "AG_2"), claim("AG_2") == IdClaim::kClaimed);
+  if (!ok) std::fprintf(stderr, "claim/commit/forget out of step\n");
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (!agrees_with_set() || !claims_settle()) return 1;
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,139 @@
+// Outbound request journal: threads journal B2C submissions, each waiting
+// for durability as it would before sending, then record the reply and,
+// for most, the result. Group commit shows as appends per msync. The second
+// part reopens a journal left with M requests in flight and times recovery.
+//
+//   journal_bench [--requests N] [--threads T] [--recover M] [--dir D] [--no-sync]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "mpesa/daraja.hpp"
+#include "mpesa/journal.hpp"
+
+namespace {
+
+mpesa::B2CRequest sample_request(std::string id) {
+  mpesa::B2CRequest r;
+  r.originator_conversation_id = std::move(id);
+  r.initiator_name = "testapi";
+  r.security_credential.assign(344, 'Q');  // base64 of an RSA-2048 block
+  r.amount = 1500;
+  r.party_a = "600996";
+  r.party_b = "254708374149";
+  r.remarks = "Salary";
+  r.queue_timeout_url = "https://example.com/b2c/timeout";
+  r.result_url = "https://example.com/b2c/result";
+  return r;
+}
+
+double percentile(const std::vector<double>& sorted, double q) {
+  if (sorted.empty()) return 0;
+  return sorted[static_cast<std::size_t>(q * static_cast<double>(sorted.size() - 1))];
+}
+
+double seconds_since(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int requests = 100000;
+  int threads = 8;
+  int recover = 100000;
+  std::string dir = std::filesystem::temp_directory_path().string();
+  bool sync = true;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--no-sync") == 0) sync = false;
+    else if (i + 1 == argc) break;
+    else if (std::strcmp(argv[i], "--requests") == 0) requests = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--threads") == 0) threads = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--recover") == 0) recover = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--dir") == 0) dir = argv[++i];
+  }
+  threads = std::max(threads, 1);
+  const std::string path = dir + "/journal_bench." + std::to_string(::getpid()) + ".journal";
+  const mpesa::JournalOptions options{.capacity = 16 << 20, .sync = sync};
+
+  // Every eighth request never gets its result and must survive reopening.
+  const int per_thread = requests / threads;
+  std::vector<std::vector<double>> latencies(static_cast<std::size_t>(threads));
+  mpesa::JournalStats stats;
+  double elapsed = 0;
+  {
+    mpesa::RequestJournal journal(path, options);
+    const auto started = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        auto& lat = latencies[static_cast<std::size_t>(t)];
+        lat.reserve(static_cast<std::size_t>(per_thread));
+        for (int i = 0; i < per_thread; ++i) {
+          const std::string id = "run-" + std::to_string(t) + "-" + std::to_string(i);
+          const mpesa::B2CRequest request = sample_request(id);
+          const auto t0 = std::chrono::steady_clock::now();
+          journal.wait_durable(journal.submitted(mpesa::MetricEndpoint::kB2C, id, mpesa::render_body(request)));
+          lat.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+          journal.accepted(id, "AG_20191219_" + id);
+          if (i % 8 != 0) journal.finished(id, 0);
+        }
+      });
+    }
+    for (auto& w : workers) w.join();
+    elapsed = seconds_since(started);
+    stats = journal.stats();
+  }
+  const std::size_t expected = static_cast<std::size_t>(threads) * static_cast<std::size_t>((per_thread + 7) / 8);
+  const std::size_t left = mpesa::RequestJournal::read(path).size();
+
+  std::vector<double> all;
+  for (const auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+  std::sort(all.begin(), all.end());
+  std::printf("%zu durable submissions from %d threads (%s)\n\n", all.size(), threads, sync ? "msync" : "no msync");
+  std::printf("%12s %12s %10s %10s %10s %14s %11s\n", "submits/s", "appends/s", "p50_us", "p99_us", "max_us",
+              "appends/commit", "compactions");
+  std::printf("%12.0f %12.0f %10.1f %10.1f %10.1f %14.1f %11llu\n", static_cast<double>(all.size()) / elapsed,
+              static_cast<double>(stats.appends) / elapsed, percentile(all, 0.50), percentile(all, 0.99),
+              all.empty() ? 0 : all.back(),
+              stats.commits ? static_cast<double>(stats.appends) / static_cast<double>(stats.commits) : 0,
+              static_cast<unsigned long long>(stats.compactions));
+  std::printf("in flight after reopening: %zu (expected %zu)\n\n", left, expected);
+  std::filesystem::remove(path);
+
+  // Recovery: a journal left with `recover` submitted and accepted requests.
+  {
+    mpesa::RequestJournal journal(path, {.capacity = 64 << 20, .sync = false});
+    for (int i = 0; i < recover; ++i) {
+      const std::string id = "crash-" + std::to_string(i);
+      journal.submitted(mpesa::MetricEndpoint::kB2C, id, mpesa::render_body(sample_request(id)));
+      journal.accepted(id, "AG_20191219_" + id);
+    }
+  }
+  auto t0 = std::chrono::steady_clock::now();
+  const std::size_t read = mpesa::RequestJournal::read(path).size();
+  const double read_s = seconds_since(t0);
+  t0 = std::chrono::steady_clock::now();
+  std::size_t reopened = 0;
+  {
+    mpesa::RequestJournal journal(path, options);
+    reopened = journal.recovered().size();
+  }
+  const double reopen_s = seconds_since(t0);
+  std::filesystem::remove(path);
+  std::printf("%10s %10s %12s\n", "entries", "read_ms", "reopen_ms");
+  std::printf("%10zu %10.1f %12.1f\n", read, read_s * 1e3, reopen_s * 1e3);
+
+  const bool ok = left == expected && read == static_cast<std::size_t>(recover) && reopened == read;
+  if (!ok) std::fprintf(stderr, "journal lost or kept entries it should not have\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+// Schema-specialized decoding (json::Reader + constexpr field tables)
+// against the generic DOM (json::parse + member lookups) on the recorded
+// callback payloads in bench/corpus. Both sides extract the same fields;
+// main() checks they agree before timing anything.
+//
+//   json_bench [--corpus DIR] [google benchmark flags]
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mpesa/callbacks.hpp"
+#include "mpesa/json.hpp"
+
+#ifndef MPESA_CORPUS_DIR
+#define MPESA_CORPUS_DIR "bench/corpus"
+#endif
+
+namespace {
+
+enum class Kind { kStk, kC2B, kResult };
+
+struct Sample {
+  std::string name;
+  Kind kind;
+  std::string body;
+};
+
+// What a handler typically needs from each payload, as plain values.
+struct Digest {
+  std::string id;
+  int result_code = 0;
+  std::string amount;
+  std::size_t parameters = 0;
+  bool operator==(const Digest&) const = default;
+};
+
+std::string_view text(const mpesa::json::Value& obj, std::string_view key) {
+  const mpesa::json::Value* v = obj.find(key);
+  return v == nullptr || !(v->is_string() || v->is_number()) ? std::string_view() : v->scalar_text();
+}
+
+int to_int(std::string_view s) {
+  int v = 0;
+  std::from_chars(s.data(), s.data() + s.size(), v);
+  return v;
+}
+
+Digest dom_decode(const Sample& s) {
+  const mpesa::json::Value doc = mpesa::json::parse(s.body);
+  Digest d;
+  switch (s.kind) {
+    case Kind::kStk: {
+      const auto& cb = doc.at("Body").at("stkCallback");
+      d.id = text(cb, "CheckoutRequestID");
+      d.result_code = to_int(text(cb, "ResultCode"));
+      text(cb, "MerchantRequestID");
+      text(cb, "ResultDesc");
+      if (const auto* meta = cb.find("CallbackMetadata")) {
+        for (const auto& item : meta->at("Item").as_array()) {
+          if (text(item, "Name") == "Amount") d.amount = text(item, "Value");
+        }
+      }
+      break;
+    }
+    case Kind::kC2B:
+      d.id = text(doc, "TransID");
+      d.amount = text(doc, "TransAmount");
+      for (const char* key : {"TransactionType", "TransTime", "BusinessShortCode", "BillRefNumber", "InvoiceNumber",
+                              "OrgAccountBalance", "ThirdPartyTransID", "MSISDN", "FirstName", "MiddleName",
+                              "LastName"}) {
+        text(doc, key);
+      }
+      break;
+    case Kind::kResult: {
+      const auto& r = doc.at("Result");
+      d.id = text(r, "ConversationID");
+      d.result_code = to_int(text(r, "ResultCode"));
+      for (const char* key : {"ResultType", "ResultDesc", "OriginatorConversationID", "TransactionID"}) text(r, key);
+      const auto* params = r.find("ResultParameters");
+      const auto* list = params == nullptr ? nullptr : params->find("ResultParameter");
+      auto visit = [&](const mpesa::json::Value& p) {
+        if (text(p, "Key") == "TransactionAmount" || text(p, "Key") == "Amount") d.amount = text(p, "Value");
+        ++d.parameters;
+      };
+      if (list != nullptr && list->is_array()) {
+        for (const auto& p : list->as_array()) visit(p);
+      } else if (list != nullptr) {
+        visit(*list);
+      }
+      break;
+    }
+  }
+  return d;
+}
+
+Digest schema_decode(const Sample& s) {
+  mpesa::json::Reader reader(s.body);
+  Digest d;
+  switch (s.kind) {
+    case Kind::kStk: {
+      mpesa::StkCallback cb;
+      mpesa::read_callback(reader, cb);
+      d.id = cb.checkout_request_id;
+      d.result_code = cb.result_code;
+      d.amount = cb.amount;
+      break;
+    }
+    case Kind::kC2B: {
+      mpesa::C2BNotification n;
+      mpesa::read_callback(reader, n);
+      d.id = n.trans_id;
+      d.amount = n.trans_amount;
+      break;
+    }
+    case Kind::kResult: {
+      mpesa::ResultCallback r;
+      mpesa::read_callback(reader, r);
+      d.id = r.conversation_id;
+      d.result_code = r.result_code;
+      d.amount = r.parameter("TransactionAmount");
+      if (d.amount.empty()) d.amount = r.parameter("Amount");
+      d.parameters = r.parameters().size();
+      break;
+    }
+  }
+  return d;
+}
+
+// Parse only, to separate tree building from the member lookups.
+void BM_Dom(benchmark::State& state, const Sample* s) {
+  for (auto _ : state) {
+    const mpesa::json::Value doc = mpesa::json::parse(s->body);
+    benchmark::DoNotOptimize(&doc);
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * s->body.size()));
+}
+
+void BM_DomFields(benchmark::State& state, const Sample* s) {
+  for (auto _ : state) benchmark::DoNotOptimize(dom_decode(*s));
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * s->body.size()));
+}
+
+void BM_Schema(benchmark::State& state, const Sample* s) {
+  mpesa::StkCallback stk;
+  mpesa::C2BNotification c2b;
+  mpesa::ResultCallback result;
+  for (auto _ : state) {
+    mpesa::json::Reader reader(s->body);
+    switch (s->kind) {
+      case Kind::kStk:
+        mpesa::read_callback(reader, stk);
+        benchmark::DoNotOptimize(stk.checkout_request_id.data());
+        break;
+      case Kind::kC2B:
+        mpesa::read_callback(reader, c2b);
+        benchmark::DoNotOptimize(c2b.trans_id.data());
+        break;
+      case Kind::kResult:
+        mpesa::read_callback(reader, result);
+        benchmark::DoNotOptimize(result.conversation_id.data());
+        break;
+    }
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * s->body.size()));
+}
+
+std::vector<Sample> load_corpus(const std::filesystem::path& dir) {
+  std::vector<Sample> samples;
+  for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+    if (entry.path().extension() != ".json") continue;
+    std::ifstream in(entry.path(), std::ios::binary);
+    std::ostringstream body;
+    body << in.rdbuf();
+    const std::string name = entry.path().stem().string();
+    const Kind kind = name.starts_with("stk_") ? Kind::kStk : name.starts_with("c2b_") ? Kind::kC2B : Kind::kResult;
+    samples.push_back({name, kind, body.str()});
+  }
+  std::sort(samples.begin(), samples.end(), [](const Sample& a, const Sample& b) { return a.name < b.name; });
+  return samples;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string corpus = MPESA_CORPUS_DIR;
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::strcmp(argv[i], "--corpus") == 0) {
+      corpus = argv[i + 1];
+      for (int j = i; j + 2 <= argc; ++j) argv[j] = argv[j + 2];
+      argc -= 2;
+      break;
+    }
+  }
+  static const std::vector<Sample> samples = load_corpus(corpus);
+  if (samples.empty()) {
+    std::fprintf(stderr, "no .json payloads in %s\n", corpus.c_str());
+    return 1;
+  }
+  for (const Sample& s : samples) {
+    if (!(dom_decode(s) == schema_decode(s))) {
+      std::fprintf(stderr, "%s: schema decoder disagrees with the DOM\n", s.name.c_str());
+      return 1;
+    }
+    benchmark::RegisterBenchmark(("dom/" + s.name).c_str(), BM_Dom, &s);
+    benchmark::RegisterBenchmark(("dom+fields/" + s.name).c_str(), BM_DomFields, &s);
+    benchmark::RegisterBenchmark(("schema/" + s.name).c_str(), BM_Schema, &s);
+  }
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
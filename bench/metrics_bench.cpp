@@ -0,0 +1,80 @@
+// What the built-in instrumentation adds to a call: recording a phase, a
+// call and a result code from one or many threads, plus the cost of reading
+// it back as a snapshot or a Prometheus scrape.
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "mpesa/metrics.hpp"
+
+namespace {
+
+mpesa::Metrics& metrics() {
+  static mpesa::Metrics m;
+  return m;
+}
+
+void BM_RecordPhase(benchmark::State& state) {
+  std::uint64_t ns = 1'000 + static_cast<std::uint64_t>(state.thread_index());
+  for (auto _ : state) {
+    metrics().record(mpesa::Phase::kTotal, std::chrono::nanoseconds(ns));
+    ns = ns * 6364136223846793005ULL % 5'000'000'000ULL;  // spread over the buckets
+  }
+}
+BENCHMARK(BM_RecordPhase)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_CountCall(benchmark::State& state) {
+  for (auto _ : state) {
+    metrics().count_call(mpesa::MetricEndpoint::kB2C, std::chrono::milliseconds(180), false);
+  }
+}
+BENCHMARK(BM_CountCall)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_CountCode(benchmark::State& state) {
+  for (auto _ : state) {
+    metrics().count_code(mpesa::MetricEndpoint::kStkQuery, mpesa::CodeKind::kResult, "1032");
+  }
+}
+BENCHMARK(BM_CountCode)->ThreadRange(1, 8)->UseRealTime();
+
+// Everything one Daraja call records: connect-free exchange, parse, status,
+// result code and the call itself, including the clock reads.
+void BM_RecordCall(benchmark::State& state) {
+  mpesa::Metrics& m = metrics();
+  for (auto _ : state) {
+    mpesa::CallTimer timer(&m, mpesa::MetricEndpoint::kB2C);
+    const auto started = mpesa::Clock::now();
+    m.record(mpesa::Phase::kTtfb, mpesa::Clock::now() - started);
+    m.record(mpesa::Phase::kTotal, mpesa::Clock::now() - started);
+    m.count_code(mpesa::MetricEndpoint::kB2C, mpesa::CodeKind::kHttpStatus, 200);
+    m.record(mpesa::Phase::kParse, mpesa::Clock::now() - started);
+    m.count_code(mpesa::MetricEndpoint::kB2C, mpesa::CodeKind::kResult, "0");
+    timer.succeeded();
+  }
+}
+BENCHMARK(BM_RecordCall)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_Snapshot(benchmark::State& state) {
+  metrics().record(mpesa::Phase::kDns, std::chrono::milliseconds(3));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(metrics().snapshot());
+  }
+}
+BENCHMARK(BM_Snapshot);
+
+void BM_Prometheus(benchmark::State& state) {
+  std::string out;
+  for (auto _ : state) {
+    out.clear();
+    metrics().write_prometheus(out);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.counters["bytes"] = static_cast<double>(out.size());
+}
+BENCHMARK(BM_Prometheus);
+
+}  // namespace
+
+BENCHMARK_MAIN();
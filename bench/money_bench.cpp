@@ -0,0 +1,183 @@
+// Money against the double round trip it replaces: parsing Daraja amounts
+// ("1.00", "10.5", "-4510.00"), formatting them with two decimals, and
+// summing and comparing columns of them. Before timing anything, parsing
+// and formatting are checked on every form of random amounts and on
+// malformed text, and the SIMD kernels against the scalar ones; a
+// mismatch exits non-zero. The check also counts amounts that
+// strtod * 100 gets wrong when truncated to cents.
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mpesa/money.hpp"
+
+namespace {
+
+// The same amount as Daraja may write it.
+std::vector<std::string> forms(std::int64_t cents) {
+  const bool negative = cents < 0;
+  const std::uint64_t m = negative ? 0 - static_cast<std::uint64_t>(cents) : static_cast<std::uint64_t>(cents);
+  const std::string sign = negative ? "-" : "";
+  const std::string whole = std::to_string(m / 100);
+  const unsigned fraction = static_cast<unsigned>(m % 100);
+  std::vector<std::string> out;
+  out.push_back(sign + whole + "." + std::to_string(fraction / 10) + std::to_string(fraction % 10));
+  if (fraction % 10 == 0) out.push_back(sign + whole + "." + std::to_string(fraction / 10));
+  if (fraction == 0) out.push_back(sign + whole);
+  return out;
+}
+
+int verify() {
+  std::mt19937_64 rng(42);
+  int mismatches = 0;
+  const auto check = [&](bool ok, const char* what, const std::string& detail) {
+    if (!ok && mismatches++ < 10) std::fprintf(stderr, "mismatch: %s %s\n", what, detail.c_str());
+  };
+
+  std::size_t double_errors = 0;
+  std::size_t texts = 0;
+  for (int i = 0; i < 300'000; ++i) {
+    std::int64_t cents = 0;
+    switch (i % 3) {
+      case 0: cents = static_cast<std::int64_t>(rng() % 100'000'00); break;  // up to 100k shillings
+      case 1: cents = static_cast<std::int64_t>(rng() % 1'000'000'000'000'00) - 500'000'000'000'00; break;
+      default: cents = static_cast<std::int64_t>(rng() % 1000); break;
+    }
+    const mpesa::Money money = mpesa::Money::from_cents(cents);
+    const std::string text = money.to_string();
+    check(text == forms(cents).front(), "format", text);
+    for (const std::string& form : forms(cents)) {
+      const auto parsed = mpesa::Money::parse(form);
+      check(parsed && *parsed == money, "parse", form);
+      ++texts;
+      double_errors += static_cast<std::int64_t>(std::strtod(form.c_str(), nullptr) * 100) != cents;
+    }
+  }
+  for (const char* bad : {"", "-", ".", "1.", "1.234", "1e3", "+5", " 5", "5 ", "1..2", "12a", "--1", "1-",
+                          "12345678901234567", "0x10", "1,000.00", "NaN", ".5", "-.50"}) {
+    check(!mpesa::Money::parse(bad), "accepted", bad);
+  }
+  check(mpesa::Money::from_cents(INT64_MIN).to_string() == "-92233720368547758.08", "format", "INT64_MIN");
+  check(mpesa::Money::from_shillings(INT64_MAX / 100 + 1).cents() ==
+            static_cast<std::int64_t>(static_cast<std::uint64_t>(INT64_MAX / 100 + 1) * 100),
+        "from_shillings", "wraps");
+
+  for (std::size_t n = 0; n <= 200; ++n) {
+    std::vector<mpesa::Money> a(n);
+    std::vector<mpesa::Money> b(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      a[i] = mpesa::Money::from_cents(static_cast<std::int64_t>(rng()));
+      b[i] = rng() % 5 == 0 ? mpesa::Money::from_cents(a[i].cents() ^ 1) : a[i];
+    }
+    check(mpesa::sum(a) == mpesa::sum_scalar(a), "sum, size", std::to_string(n));
+    std::vector<std::size_t> fast;
+    std::vector<std::size_t> slow;
+    mpesa::find_mismatches(a, b, fast);
+    mpesa::find_mismatches_scalar(a, b, slow);
+    check(fast == slow, "mismatches, size", std::to_string(n));
+  }
+  std::printf("strtod * 100 truncated to the wrong cent on %zu of %zu amounts\n", double_errors, texts);
+  return mismatches;
+}
+
+std::vector<std::string> amounts(std::size_t count) {
+  std::mt19937_64 rng(7);
+  std::vector<std::string> out;
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto f = forms(static_cast<std::int64_t>(rng() % 250'000'00));
+    out.push_back(f[rng() % f.size()]);
+  }
+  return out;
+}
+
+constexpr std::size_t kAmounts = 4096;
+
+void BM_ParseStrtod(benchmark::State& state) {
+  const auto texts = amounts(kAmounts);
+  std::int64_t total = 0;
+  for (auto _ : state) {
+    for (const std::string& t : texts) total += std::llround(std::strtod(t.c_str(), nullptr) * 100);
+  }
+  benchmark::DoNotOptimize(total);
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kAmounts));
+}
+BENCHMARK(BM_ParseStrtod);
+
+void BM_ParseMoney(benchmark::State& state) {
+  const auto texts = amounts(kAmounts);
+  mpesa::Money total;
+  for (auto _ : state) {
+    for (const std::string& t : texts) total += mpesa::Money::parse(t).value_or(mpesa::Money());
+  }
+  benchmark::DoNotOptimize(total);
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kAmounts));
+}
+BENCHMARK(BM_ParseMoney);
+
+void BM_FormatSnprintf(benchmark::State& state) {
+  std::vector<double> values;
+  for (const std::string& t : amounts(kAmounts)) values.push_back(std::strtod(t.c_str(), nullptr));
+  char buf[32];
+  for (auto _ : state) {
+    for (const double v : values) benchmark::DoNotOptimize(std::snprintf(buf, sizeof(buf), "%.2f", v));
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kAmounts));
+}
+BENCHMARK(BM_FormatSnprintf);
+
+void BM_FormatMoney(benchmark::State& state) {
+  std::vector<mpesa::Money> values;
+  for (const std::string& t : amounts(kAmounts)) values.push_back(*mpesa::Money::parse(t));
+  char buf[mpesa::Money::kMaxFormattedSize];
+  for (auto _ : state) {
+    for (const mpesa::Money m : values) benchmark::DoNotOptimize(m.format(buf));
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kAmounts));
+}
+BENCHMARK(BM_FormatMoney);
+
+template <mpesa::Money (*Sum)(std::span<const mpesa::Money>) noexcept>
+void BM_Sum(benchmark::State& state) {
+  std::vector<mpesa::Money> values(static_cast<std::size_t>(state.range(0)), mpesa::Money::from_cents(150));
+  for (auto _ : state) benchmark::DoNotOptimize(Sum(values));
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_Sum<mpesa::sum_scalar>)->Name("BM_SumScalar")->Arg(1 << 16);
+BENCHMARK(BM_Sum<mpesa::sum>)->Name("BM_Sum")->Arg(1 << 16);
+
+template <std::size_t (*Find)(std::span<const mpesa::Money>, std::span<const mpesa::Money>,
+                              std::vector<std::size_t>&)>
+void BM_FindMismatches(benchmark::State& state) {
+  const auto n = static_cast<std::size_t>(state.range(0));
+  std::vector<mpesa::Money> a(n, mpesa::Money::from_cents(150));
+  std::vector<mpesa::Money> b = a;
+  for (std::size_t i = 0; i < n; i += 1000) b[i] += mpesa::Money::from_cents(1);
+  std::vector<std::size_t> out;
+  for (auto _ : state) {
+    out.clear();
+    benchmark::DoNotOptimize(Find(a, b, out));
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_FindMismatches<mpesa::find_mismatches_scalar>)->Name("BM_FindMismatchesScalar")->Arg(1 << 16);
+BENCHMARK(BM_FindMismatches<mpesa::find_mismatches>)->Name("BM_FindMismatches")->Arg(1 << 16);
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (const int mismatches = verify(); mismatches != 0) {
+    std::fprintf(stderr, "%d mismatches\n", mismatches);
+    return 1;
+  }
+  std::printf("parsing, formatting and kernels match\n");
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,152 @@
+// Adaptive rate limiting and circuit breaking against the local simulator,
+// each scenario run with and without a RateLimiter on the async client:
+//
+//   quota   the simulator's spike arrest allows --quota calls/s and the
+//           client keeps --in-flight STK Pushes going; the limiter starts
+//           well above the quota and has to find it from the 429s.
+//   outage  every call is answered 500 after --latency-us; the breaker
+//           should fail calls locally instead of queueing on Daraja.
+//
+// Reports accepted calls/s, replies throttled or failed by the simulator,
+// calls refused locally, latency, and the lane's rate and breaker trips.
+//
+//   rate_limiter_bench [--seconds S] [--in-flight C] [--quota R] [--latency-us L]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "mpesa/async_daraja_client.hpp"
+#include "mpesa/http_client.hpp"
+#include "mpesa/rate_limiter.hpp"
+#include "mpesa/sim/daraja_simulator.hpp"
+
+namespace {
+
+constexpr const char* kPasskey = "bfb279f9aa9bdbcf158e97dd71a467cd2e0c893059b10f78e6b72ada1ed2c919";
+
+struct Tally {
+  std::vector<double> latencies;  ///< every call, in microseconds
+  std::size_t accepted = 0;
+  std::size_t errors = 0;  ///< answered with an error by the simulator
+  std::size_t refused = 0;  ///< failed locally by the limiter
+  int running = 0;
+};
+
+double percentile(const std::vector<double>& sorted, double q) {
+  if (sorted.empty()) return 0;
+  return sorted[static_cast<std::size_t>(q * static_cast<double>(sorted.size() - 1))];
+}
+
+mpesa::Task<void> worker(mpesa::EventLoop& loop, mpesa::AsyncDarajaClient& client,
+                         std::chrono::steady_clock::time_point until, Tally& tally) {
+  int i = 0;
+  while (std::chrono::steady_clock::now() < until) {
+    mpesa::StkPushRequest r;
+    r.business_short_code = "174379";
+    r.passkey = kPasskey;
+    r.amount = 1 + ++i % 1000;
+    r.party_a = "254708374149";
+    r.callback_url = "https://example.com/mpesa/stk";
+    r.account_reference = "INV" + std::to_string(i);
+    r.transaction_desc = "Payment";
+    const auto t0 = std::chrono::steady_clock::now();
+    bool refused = false;
+    try {
+      ++((co_await client.stk_push(std::move(r))).accepted() ? tally.accepted : tally.errors);
+    } catch (const mpesa::Error& e) {
+      refused = e.code() == mpesa::ErrorCode::kUnavailable;
+      ++(refused ? tally.refused : tally.errors);
+    }
+    tally.latencies.push_back(
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+    // A caller told to back off does, briefly.
+    if (refused) co_await loop.sleep_for(std::chrono::milliseconds(5));
+  }
+  if (--tally.running == 0) loop.stop();
+}
+
+void run(const char* scenario, const mpesa::sim::DarajaSimulatorOptions& sim_options, bool limited,
+         double seconds, int in_flight) {
+  mpesa::sim::DarajaSimulator simulator(sim_options);
+  simulator.start();
+  mpesa::HttpClientOptions http_options;
+  http_options.pool.tls.ca_pem = simulator.ca_pem();
+  http_options.pool.max_connections_per_endpoint = static_cast<std::size_t>(in_flight);
+  http_options.metrics = nullptr;
+  mpesa::HttpClient token_http(http_options);
+  mpesa::TokenManager tokens(token_http, simulator.endpoint(), mpesa::Credentials{"key", "secret"});
+  mpesa::EventLoop loop;
+  mpesa::AsyncHttpClient http(loop, http_options);
+  std::unique_ptr<mpesa::RateLimiter> limiter;
+  if (limited) {
+    limiter = std::make_unique<mpesa::RateLimiter>(mpesa::RateLimiterOptions{
+        .initial_rate = 2'000, .max_rate = 5'000, .increase = 20, .adjust_period = std::chrono::milliseconds(250)});
+  }
+  mpesa::AsyncDarajaClient client(http, tokens, simulator.endpoint(), limiter.get());
+  tokens.get();
+
+  Tally tally;
+  tally.running = in_flight;
+  const auto started = std::chrono::steady_clock::now();
+  const auto until = started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                   std::chrono::duration<double>(seconds));
+  for (int t = 0; t < in_flight; ++t) loop.spawn(worker(loop, client, until, tally));
+  loop.run();
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  const mpesa::sim::DarajaSimulatorStats s = simulator.stats();
+  simulator.stop();
+
+  std::sort(tally.latencies.begin(), tally.latencies.end());
+  double rate = 0;
+  unsigned long long trips = 0;
+  if (limiter) {
+    const mpesa::RateLane& lane = limiter->lane(mpesa::MetricEndpoint::kStkPush, "174379");
+    rate = lane.rate();
+    trips = lane.stats().trips;
+  }
+  std::printf("%-7s %-8s %10.0f %10llu %10llu %10zu %10.0f %10.0f %10.0f %6llu\n", scenario,
+              limited ? "limiter" : "none", static_cast<double>(tally.accepted) / elapsed,
+              static_cast<unsigned long long>(s.throttled), static_cast<unsigned long long>(s.injected_errors),
+              tally.refused, percentile(tally.latencies, 0.50), percentile(tally.latencies, 0.99), rate, trips);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  double seconds = 4;
+  int in_flight = 64;
+  double quota = 500;
+  int latency_us = 2'000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--seconds") == 0) seconds = std::atof(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--in-flight") == 0) in_flight = std::max(1, std::atoi(argv[i + 1]));
+    else if (std::strcmp(argv[i], "--quota") == 0) quota = std::atof(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--latency-us") == 0) latency_us = std::atoi(argv[i + 1]);
+  }
+
+  mpesa::sim::DarajaSimulatorOptions quota_options;
+  quota_options.passkey = kPasskey;
+  quota_options.latency = std::chrono::microseconds(latency_us);
+  quota_options.max_rate = quota;
+  quota_options.burst = quota / 10;
+
+  mpesa::sim::DarajaSimulatorOptions outage_options;
+  outage_options.passkey = kPasskey;
+  outage_options.latency = std::chrono::microseconds(latency_us);
+  outage_options.error_rate = 1;
+
+  std::printf("%.1f s per run, %d calls in flight, quota %.0f calls/s, latency %d us\n\n", seconds, in_flight, quota,
+              latency_us);
+  std::printf("%-7s %-8s %10s %10s %10s %10s %10s %10s %10s %6s\n", "case", "client", "ok/s", "429s", "500s",
+              "refused", "p50_us", "p99_us", "rate", "trips");
+  run("quota", quota_options, false, seconds, in_flight);
+  run("quota", quota_options, true, seconds, in_flight);
+  run("outage", outage_options, false, seconds, in_flight);
+  run("outage", outage_options, true, seconds, in_flight);
+  return 0;
+}
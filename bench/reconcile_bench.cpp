@@ -0,0 +1,194 @@
+// Month-end reconciliation: writes an org portal statement export with
+// `--rows` transactions (paybill receipts, B2C payouts with their charge
+// rows, a few failed lines) and a ledger that disagrees with it in known
+// places, then reconciles them on 1 thread and on `--threads`. Every
+// discrepancy kind is planted once per thousand rows, plus statement
+// duplicates whose second row, with a different amount, comes much later
+// in the file. The counts found are checked against the counts planted,
+// and the two reports against each other.
+//
+//   reconcile_bench [--rows N] [--threads T] [--file PATH]
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <thread>
+#include <vector>
+
+#include "mpesa/reconcile.hpp"
+
+namespace {
+
+std::string receipt(std::size_t i) {
+  char id[24];
+  std::snprintf(id, sizeof(id), "SJ%08zX", i);
+  return id;
+}
+
+// "1,234.50"
+std::string money(std::int64_t cents, bool negative) {
+  const std::string digits = std::to_string(cents / 100);
+  std::string out(negative ? "-" : "");
+  for (std::size_t i = 0; i < digits.size(); ++i) {
+    if (i != 0 && (digits.size() - i) % 3 == 0) out.push_back(',');
+    out.push_back(digits[i]);
+  }
+  char frac[8];
+  std::snprintf(frac, sizeof(frac), ".%02d", static_cast<int>(cents % 100));
+  return out.append(frac);
+}
+
+struct Planted {
+  std::array<std::size_t, mpesa::kDiscrepancyKinds> counts{};
+  std::size_t matched = 0;
+  void add(mpesa::DiscrepancyKind kind) { ++counts[static_cast<std::size_t>(kind)]; }
+};
+
+Planted write_statement(const char* path, std::size_t rows, std::vector<mpesa::LedgerEntry>& ledger) {
+  std::FILE* f = std::fopen(path, "w");
+  if (f == nullptr) {
+    std::perror(path);
+    std::exit(1);
+  }
+  std::fputs(
+      "Account Holder:,ACME DISTRIBUTORS LTD\nShort Code:,600638\n"
+      "Time Period:,01-10-2026 - 31-10-2026\n\n"
+      "Receipt No.,Completion Time,Initiation Time,Details,Transaction Status,Paid In,Withdrawn,Balance,"
+      "Balance Confirmed,Reason Type,Other Party Info,Linked Transaction ID,A/C No.\n",
+      f);
+  Planted planted;
+  std::string line;
+  // Repeated rows, by the row they go after.
+  std::multimap<std::size_t, std::string> later;
+  for (std::size_t i = 0; i < rows; ++i) {
+    for (auto it = later.begin(); it != later.end() && it->first < i; it = later.erase(it)) {
+      std::fwrite(it->second.data(), 1, it->second.size(), f);
+    }
+    const std::string id = receipt(i);
+    const bool payout = i % 20 == 7;
+    const std::int64_t cents = 1000 + static_cast<std::int64_t>(i % 250'000) * 37;
+    const bool failed = i % 1000 == 500;
+    line.assign(id).append(",2026-10-14 09:12:44,2026-10-14 09:12:44,");
+    line.append(payout ? "Business Payment to 2547*****149 - John Doe" : "Pay Bill from 2547*****149 - John Doe Acc. INV10023");
+    line.append(failed ? ",Failed," : ",Completed,");
+    const std::string amount = money(cents, payout);
+    line.append(payout ? ",\"" : "\"").append(amount).append(payout ? "\"" : "\",");
+    line.append(",\"4,109,223.50\",Yes,");
+    line.append(payout ? "Business Payment,254708374149 - John Doe,," : "Pay Bill Online,254708374149 - John Doe,,INV10023");
+    line.push_back('\n');
+    std::fwrite(line.data(), 1, line.size(), f);
+    if (payout) {
+      line.assign(id).append(
+          ",2026-10-14 09:12:44,2026-10-14 09:12:44,Business Payment Charge,Completed,,"
+          "\"-22.40\",\"4,109,201.10\",Yes,Business Payment Charge,,,\n");
+      std::fwrite(line.data(), 1, line.size(), f);
+    }
+    if (failed) continue;
+
+    switch (i % 1000) {
+      case 1: planted.add(mpesa::DiscrepancyKind::kMissingFromLedger); continue;
+      case 2:
+        ledger.push_back({id, cents + 100});
+        planted.add(mpesa::DiscrepancyKind::kAmountMismatch);
+        continue;
+      case 3:
+        ledger.push_back({id, cents});
+        ledger.push_back({id, cents});
+        planted.add(mpesa::DiscrepancyKind::kDuplicateInLedger);
+        break;
+      case 4:
+        std::fwrite(line.data(), 1, line.size(), f);
+        ledger.push_back({id, cents});
+        planted.add(mpesa::DiscrepancyKind::kDuplicateInStatement);
+        break;
+      case 5:
+        ledger.push_back({id, cents});
+        ledger.push_back({receipt(rows + i), cents});
+        planted.add(mpesa::DiscrepancyKind::kMissingFromStatement);
+        break;
+      case 6: {
+        // Only the first row matches; the later one, with another amount,
+        // is the duplicate whichever thread reads it.
+        const std::string amount = money(cents, false);
+        std::string repeat = line;
+        repeat.replace(repeat.find(amount), amount.size(), money(cents + 500, false));
+        later.emplace(i + 1 + (i * 2'654'435'761ULL) % (rows / 2 + 1), std::move(repeat));
+        ledger.push_back({id, cents});
+        planted.add(mpesa::DiscrepancyKind::kDuplicateInStatement);
+        break;
+      }
+      default: ledger.push_back({id, cents}); break;
+    }
+    ++planted.matched;
+  }
+  for (const auto& [after, repeat] : later) std::fwrite(repeat.data(), 1, repeat.size(), f);
+  std::fclose(f);
+  // Callbacks arrive out of statement order.
+  for (std::size_t i = 0; i + 1 < ledger.size(); i += 2) std::swap(ledger[i], ledger[ledger.size() - 1 - i]);
+  return planted;
+}
+
+bool same(const mpesa::Discrepancy& a, const mpesa::Discrepancy& b) {
+  return std::tie(a.kind, a.trans_id, a.statement_cents, a.ledger_cents, a.statement_offset, a.ledger_index) ==
+         std::tie(b.kind, b.trans_id, b.statement_cents, b.ledger_cents, b.statement_offset, b.ledger_index);
+}
+
+bool run(const mpesa::StatementFile& statement, const std::vector<mpesa::LedgerEntry>& ledger, unsigned threads,
+         const Planted& planted, mpesa::ReconciliationReport& report) {
+  report = mpesa::reconcile(statement, ledger, {.threads = threads});
+  const double total = report.parse_time.count() + report.join_time.count();
+  std::printf("%8u %10zu %10zu %10.3f %10.3f %12.0f", threads, report.statement_rows, report.ledger_entries,
+              report.parse_time.count(), report.join_time.count(),
+              static_cast<double>(report.statement_rows + report.ledger_entries) / total);
+  bool ok = report.matched == planted.matched && report.malformed_rows == 0;
+  for (std::size_t k = 0; k < mpesa::kDiscrepancyKinds; ++k) {
+    std::printf(" %7zu", report.counts[k]);
+    ok = ok && report.counts[k] == planted.counts[k];
+  }
+  std::printf(" %s\n", ok ? "ok" : "MISMATCH");
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::size_t rows = 1'000'000;
+  unsigned threads = std::thread::hardware_concurrency();
+  const char* path = "/tmp/mpesa_statement_bench.csv";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--rows") == 0) rows = std::strtoul(argv[i + 1], nullptr, 10);
+    else if (std::strcmp(argv[i], "--threads") == 0) threads = static_cast<unsigned>(std::atoi(argv[i + 1]));
+    else if (std::strcmp(argv[i], "--file") == 0) path = argv[i + 1];
+  }
+  threads = std::max(threads, 1u);
+
+  std::vector<mpesa::LedgerEntry> ledger;
+  ledger.reserve(rows);
+  const Planted planted = write_statement(path, rows, ledger);
+  const mpesa::StatementFile statement(path);
+  std::printf("statement %s: %zu transactions, %.1f MB; ledger %zu entries\n\n", path, rows,
+              static_cast<double>(statement.rows_text().size()) / 1e6, ledger.size());
+  std::printf("%8s %10s %10s %10s %10s %12s", "threads", "rows", "ledger", "parse_s", "join_s", "records/s");
+  for (std::size_t k = 0; k < mpesa::kDiscrepancyKinds; ++k) {
+    std::printf(" %7.7s", mpesa::to_string(static_cast<mpesa::DiscrepancyKind>(k)));
+  }
+  std::printf("\n");
+  mpesa::ReconciliationReport single;
+  bool ok = run(statement, ledger, 1, planted, single);
+  if (threads > 1) {
+    mpesa::ReconciliationReport parallel;
+    ok = run(statement, ledger, threads, planted, parallel) && ok;
+    const bool identical =
+        std::equal(single.discrepancies.begin(), single.discrepancies.end(), parallel.discrepancies.begin(),
+                   parallel.discrepancies.end(), same);
+    std::printf("\n1-thread and %u-thread reports %s\n", threads, identical ? "are identical" : "DIFFER");
+    ok = ok && identical;
+  }
+  std::remove(path);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+// Request serialization cost and heap traffic. Global operator new is
+// counted, and every benchmark reports `allocs/op`: the reused-buffer paths
+// must show 0, the fresh-object path shows what they save.
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "mpesa/daraja.hpp"
+#include "mpesa/http.hpp"
+#include "mpesa/prepared_request.hpp"
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocations{0};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+  throw std::bad_alloc();
+}
+// std::pmr::new_delete_resource() comes through here.
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  const auto align = static_cast<std::size_t>(alignment);
+  if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) return p;
+  throw std::bad_alloc();
+}
+// GCC sees the malloc behind the replaced operator new and flags the pairing.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+
+namespace {
+
+mpesa::B2CRequest b2c_request() {
+  mpesa::B2CRequest r;
+  r.originator_conversation_id = "5f3e9a52-8d0c-4b6e-a1f7-2c94d1e07b38";
+  r.initiator_name = "testapi";
+  r.security_credential =
+      "Sx9AwbD7nWUzM2gXq3vO+5yPxN0sJb1T8dLkR4fH6cQeYmZiVt2uKo7GjAlEpBrC"
+      "wF3hNsD9qX0vL5yT1zU8mO4iP6aS2dR7eW3kJ9gH5fQ1lZ0xC8vB4nM2bV6cX1zA==";
+  r.command_id = "BusinessPayment";
+  r.amount = 1250;
+  r.party_a = "600998";
+  r.party_b = "254708374149";
+  r.remarks = "Disbursement";
+  r.queue_timeout_url = "https://payouts.example.com/b2c/timeout";
+  r.result_url = "https://payouts.example.com/b2c/result";
+  r.occasion = "October payroll";
+  return r;
+}
+
+mpesa::StkPushRequest stk_request() {
+  mpesa::StkPushRequest r;
+  r.business_short_code = "174379";
+  r.passkey = "bfb279f9aa9bdbcf158e97dd71a467cd2e0c893059b10f78e6b72ada1ed2c919";
+  r.amount = 100;
+  r.party_a = "254708374149";
+  r.callback_url = "https://shop.example.com/mpesa/stk";
+  r.account_reference = "INV-20451";
+  r.transaction_desc = "Order 20451";
+  return r;  // empty timestamp: stamped with the current time on every body
+}
+
+void report(benchmark::State& state, std::uint64_t before, std::size_t bytes) {
+  const auto allocs = g_allocations.load(std::memory_order_relaxed) - before;
+  state.counters["allocs/op"] = static_cast<double>(allocs) / static_cast<double>(state.iterations());
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * bytes));
+}
+
+void BM_RenderStkPushBody(benchmark::State& state) {
+  const auto request = stk_request();
+  std::size_t bytes = mpesa::render_body(request).size();  // warm the thread's buffers
+  const auto before = g_allocations.load(std::memory_order_relaxed);
+  for (auto _ : state) {
+    const std::string_view body = mpesa::render_body(request);
+    benchmark::DoNotOptimize(body.data());
+    bytes = body.size();
+  }
+  report(state, before, bytes);
+}
+BENCHMARK(BM_RenderStkPushBody);
+
+void BM_RenderB2CBody(benchmark::State& state) {
+  const auto request = b2c_request();
+  std::size_t bytes = mpesa::render_body(request).size();
+  const auto before = g_allocations.load(std::memory_order_relaxed);
+  for (auto _ : state) {
+    const std::string_view body = mpesa::render_body(request);
+    benchmark::DoNotOptimize(body.data());
+    bytes = body.size();
+  }
+  report(state, before, bytes);
+}
+BENCHMARK(BM_RenderB2CBody);
+
+// Same body from a B2CTemplate: the sender's fields were escaped once, up
+// front, and only the payout's are written per call.
+void BM_RenderB2CPayoutBody(benchmark::State& state) {
+  const auto request = b2c_request();
+  const mpesa::B2CTemplate<mpesa::command::BusinessPayment> sender({request.initiator_name,
+                                                                    request.security_credential, request.party_a,
+                                                                    request.queue_timeout_url, request.result_url});
+  const auto payout = sender.payout(request.party_b, request.amount, request.remarks, request.occasion,
+                                    request.originator_conversation_id);
+  if (mpesa::render_body(payout) != std::string(mpesa::render_body(request))) {
+    state.SkipWithError("payout body differs from the B2CRequest body");
+    return;
+  }
+  std::size_t bytes = mpesa::render_body(payout).size();
+  const auto before = g_allocations.load(std::memory_order_relaxed);
+  for (auto _ : state) {
+    const std::string_view body = mpesa::render_body(payout);
+    benchmark::DoNotOptimize(body.data());
+    bytes = body.size();
+  }
+  report(state, before, bytes);
+}
+BENCHMARK(BM_RenderB2CPayoutBody);
+
+// What DarajaClient does per call: request object and wire buffer reused.
+void BM_SerializeB2CReused(benchmark::State& state) {
+  const auto request = b2c_request();
+  const std::string token = "c9SQxWWhmdVRlyh0zh8gZDTkubVF";
+  mpesa::HttpRequest http;
+  std::string wire;
+  mpesa::build_api_request(request, token, http);
+  mpesa::serialize_request(http, "api.safaricom.co.ke", true, wire, "mpesa-cpp");
+  const auto before = g_allocations.load(std::memory_order_relaxed);
+  for (auto _ : state) {
+    mpesa::build_api_request(request, token, http);
+    wire.clear();
+    mpesa::serialize_request(http, "api.safaricom.co.ke", true, wire, "mpesa-cpp");
+    benchmark::DoNotOptimize(wire.data());
+  }
+  report(state, before, wire.size());
+}
+BENCHMARK(BM_SerializeB2CReused);
+
+// Baseline: a fresh request object and wire string per call.
+void BM_SerializeB2CFresh(benchmark::State& state) {
+  const auto request = b2c_request();
+  const std::string token = "c9SQxWWhmdVRlyh0zh8gZDTkubVF";
+  std::size_t bytes = 0;
+  const auto before = g_allocations.load(std::memory_order_relaxed);
+  for (auto _ : state) {
+    const mpesa::HttpRequest http = mpesa::make_api_request(request, token);
+    std::string wire;
+    mpesa::serialize_request(http, "api.safaricom.co.ke", true, wire, "mpesa-cpp");
+    benchmark::DoNotOptimize(wire.data());
+    bytes = wire.size();
+  }
+  report(state, before, bytes);
+}
+BENCHMARK(BM_SerializeB2CFresh);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,166 @@
+// End-to-end run against the local Daraja simulator: a mix of STK Push and
+// B2C calls kept in flight from one loop thread, with the simulator adding
+// latency, injected 500s, spike arrest and failed outcomes, and posting every
+// outcome back to a CallbackServer. Reports call throughput and latency,
+// the time until the last callback arrived, and the simulator's counters.
+//
+//   simulator_bench [--requests N] [--in-flight C] [--latency-us L]
+//                   [--error-rate P] [--rate R] [--callback-delay-ms D]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "mpesa/async_daraja_client.hpp"
+#include "mpesa/callback_server.hpp"
+#include "mpesa/http_client.hpp"
+#include "mpesa/sim/daraja_simulator.hpp"
+
+namespace {
+
+constexpr const char* kPasskey = "bfb279f9aa9bdbcf158e97dd71a467cd2e0c893059b10f78e6b72ada1ed2c919";
+
+struct Tally {
+  std::vector<double> latencies;
+  std::size_t accepted = 0;
+  std::size_t rejected = 0;
+  int running = 0;
+};
+
+double percentile(const std::vector<double>& sorted, double q) {
+  if (sorted.empty()) return 0;
+  return sorted[static_cast<std::size_t>(q * static_cast<double>(sorted.size() - 1))];
+}
+
+mpesa::Task<void> worker(mpesa::EventLoop& loop, mpesa::AsyncDarajaClient& client, std::uint16_t callback_port,
+                         int first, int count, Tally& tally) {
+  const std::string base = "http://127.0.0.1:" + std::to_string(callback_port);
+  for (int i = first; i < first + count; ++i) {
+    const auto t0 = std::chrono::steady_clock::now();
+    bool ok = false;
+    try {
+      if (i % 2 == 0) {
+        mpesa::StkPushRequest r;
+        r.business_short_code = "174379";
+        r.passkey = kPasskey;
+        r.amount = 1 + i % 1000;
+        r.party_a = "254708374149";
+        r.callback_url = base + "/mpesa/stk";
+        r.account_reference = "INV" + std::to_string(i);
+        r.transaction_desc = "Payment";
+        ok = (co_await client.stk_push(std::move(r))).accepted();
+      } else {
+        mpesa::B2CRequest r;
+        r.originator_conversation_id = "bench-" + std::to_string(i);
+        r.initiator_name = "testapi";
+        r.security_credential = "Sx9AwbD7nWUzM2gXq3vO+5yPxN0sJb1T8dLkR4fH6cQeYmZiVt2uKo7GjAlEpBrC==";
+        r.amount = 100 + i % 1000;
+        r.party_a = "600998";
+        r.party_b = "254708374149";
+        r.remarks = "Payout";
+        r.queue_timeout_url = base + "/mpesa/b2c/timeout";
+        r.result_url = base + "/mpesa/b2c/result";
+        ok = (co_await client.b2c(std::move(r))).accepted();
+      }
+    } catch (const std::exception&) {
+    }
+    ++(ok ? tally.accepted : tally.rejected);
+    tally.latencies.push_back(
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+  }
+  if (--tally.running == 0) loop.stop();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int requests = 20'000;
+  int in_flight = 64;
+  mpesa::sim::DarajaSimulatorOptions sim_options;
+  sim_options.passkey = kPasskey;
+  sim_options.latency = std::chrono::microseconds(200);
+  sim_options.latency_jitter = std::chrono::microseconds(800);
+  sim_options.error_rate = 0.01;
+  sim_options.throttle_rate = 0.01;
+  sim_options.failure_rate = 0.05;
+  sim_options.queue_timeout_rate = 0.01;
+  sim_options.callback_delay = std::chrono::milliseconds(10);
+  sim_options.callback_jitter = std::chrono::milliseconds(40);
+  sim_options.callback_workers = 8;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--requests") == 0) requests = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--in-flight") == 0) in_flight = std::max(1, std::atoi(argv[i + 1]));
+    else if (std::strcmp(argv[i], "--latency-us") == 0) sim_options.latency = std::chrono::microseconds(std::atoi(argv[i + 1]));
+    else if (std::strcmp(argv[i], "--error-rate") == 0) sim_options.error_rate = std::atof(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--rate") == 0) sim_options.max_rate = std::atof(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--callback-delay-ms") == 0) sim_options.callback_delay = std::chrono::milliseconds(std::atoi(argv[i + 1]));
+  }
+
+  std::atomic<std::uint64_t> callbacks{0};
+  mpesa::CallbackServer receiver({.bind_address = "127.0.0.1", .workers = 2});
+  receiver.on_stk_callback("/mpesa/stk", [&](const mpesa::StkCallback&) { callbacks.fetch_add(1); });
+  receiver.on_result("/mpesa/b2c/result", [&](const mpesa::ResultCallback&) { callbacks.fetch_add(1); });
+  receiver.on_queue_timeout("/mpesa/b2c/timeout", [&](const mpesa::ResultCallback&) { callbacks.fetch_add(1); });
+  receiver.start();
+
+  mpesa::sim::DarajaSimulator simulator(sim_options);
+  simulator.start();
+
+  mpesa::HttpClientOptions http_options;
+  http_options.pool.tls.ca_pem = simulator.ca_pem();
+  http_options.pool.max_connections_per_endpoint = static_cast<std::size_t>(in_flight);
+  mpesa::HttpClient token_http(http_options);
+  mpesa::TokenManager tokens(token_http, simulator.endpoint(), mpesa::Credentials{"key", "secret"});
+  mpesa::EventLoop loop;
+  mpesa::AsyncHttpClient http(loop, http_options);
+  mpesa::AsyncDarajaClient client(http, tokens, simulator.endpoint());
+
+  std::printf("%d calls (STK Push / B2C), %d in flight, latency %lld+%lld us, %.1f%% 500s, %.1f%% throttled, "
+              "callbacks after %lld+%lld ms\n\n",
+              requests, in_flight, static_cast<long long>(sim_options.latency.count()),
+              static_cast<long long>(sim_options.latency_jitter.count()), sim_options.error_rate * 100,
+              sim_options.throttle_rate * 100, static_cast<long long>(sim_options.callback_delay.count()),
+              static_cast<long long>(sim_options.callback_jitter.count()));
+
+  Tally tally;
+  tally.latencies.reserve(static_cast<std::size_t>(requests));
+  tally.running = in_flight;
+  const int per_task = std::max(1, requests / in_flight);
+  const auto started = std::chrono::steady_clock::now();
+  for (int t = 0; t < in_flight; ++t) loop.spawn(worker(loop, client, receiver.port(), t * per_task, per_task, tally));
+  loop.run();
+  const double submit_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  const bool drained = simulator.drain(std::chrono::seconds(60));
+  const double complete_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  std::sort(tally.latencies.begin(), tally.latencies.end());
+  std::printf("calls: %zu accepted, %zu rejected in %.2f s (%.0f calls/s), p50 %.0f us, p99 %.0f us\n",
+              tally.accepted, tally.rejected, submit_s, static_cast<double>(tally.latencies.size()) / submit_s,
+              percentile(tally.latencies, 0.50), percentile(tally.latencies, 0.99));
+  std::printf("callbacks: %llu received, last after %.2f s%s\n\n",
+              static_cast<unsigned long long>(callbacks.load()), complete_s,
+              drained ? "" : " (timed out waiting for the simulator)");
+
+  const mpesa::sim::DarajaSimulatorStats s = simulator.stats();
+  using E = mpesa::MetricEndpoint;
+  std::printf("simulator: oauth %llu, stk_push %llu, b2c %llu, unauthorized %llu, throttled %llu, "
+              "injected 500s %llu, bad requests %llu\n",
+              static_cast<unsigned long long>(s.calls_to(E::kOAuth)),
+              static_cast<unsigned long long>(s.calls_to(E::kStkPush)),
+              static_cast<unsigned long long>(s.calls_to(E::kB2C)),
+              static_cast<unsigned long long>(s.unauthorized), static_cast<unsigned long long>(s.throttled),
+              static_cast<unsigned long long>(s.injected_errors), static_cast<unsigned long long>(s.bad_requests));
+  std::printf("posted: stk %llu, result %llu, queue timeout %llu, failed %llu\n",
+              static_cast<unsigned long long>(s.callbacks_to(E::kStkCallback)),
+              static_cast<unsigned long long>(s.callbacks_to(E::kResultCallback)),
+              static_cast<unsigned long long>(s.callbacks_to(E::kQueueTimeout)),
+              static_cast<unsigned long long>(s.callback_failures));
+
+  simulator.stop();
+  receiver.stop();
+  return drained && s.bad_requests == 0 && s.callback_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// STK password generation: the straightforward per-call derivation against
+// StkPasswordGenerator, STK Push bodies for one shortcode and for many
+// taken in turn on one thread, and scalar against SIMD base64. Before timing
+// anything, every fast path is checked byte for byte against a reference
+// (strftime for timestamps, OpenSSL's EVP_EncodeBlock for base64); a
+// mismatch exits non-zero.
+
+#include <benchmark/benchmark.h>
+#include <openssl/evp.h>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mpesa/base64.hpp"
+#include "mpesa/daraja.hpp"
+#include "mpesa/stk_password.hpp"
+
+namespace {
+
+constexpr std::string_view kShortCode = "174379";
+constexpr std::string_view kPasskey = "bfb279f9aa9bdbcf158e97dd71a467cd2e0c893059b10f78e6b72ada1ed2c919";
+
+std::string reference_timestamp(std::chrono::system_clock::time_point when) {
+  const std::time_t local = std::chrono::system_clock::to_time_t(when) + 3 * 3600;
+  std::tm tm{};
+  gmtime_r(&local, &tm);
+  char buf[16];
+  std::strftime(buf, sizeof(buf), "%Y%m%d%H%M%S", &tm);
+  return buf;
+}
+
+std::string reference_base64(std::string_view in) {
+  std::vector<unsigned char> out(mpesa::base64_encoded_size(in.size()) + 1);
+  const int n = EVP_EncodeBlock(out.data(), reinterpret_cast<const unsigned char*>(in.data()), static_cast<int>(in.size()));
+  return {reinterpret_cast<const char*>(out.data()), static_cast<std::size_t>(n)};
+}
+
+std::string reference_password(std::string_view short_code, std::string_view passkey, std::string_view timestamp) {
+  return reference_base64(std::string(short_code) + std::string(passkey) + std::string(timestamp));
+}
+
+int verify() {
+  std::mt19937_64 rng(42);
+  int mismatches = 0;
+  const auto check = [&](bool ok, const char* what, const std::string& detail) {
+    if (!ok && mismatches++ < 10) std::fprintf(stderr, "mismatch: %s %s\n", what, detail.c_str());
+  };
+
+  for (std::size_t n = 0; n <= 1024; ++n) {
+    std::string in(n, '\0');
+    for (char& c : in) c = static_cast<char>(rng());
+    std::string simd(mpesa::base64_encoded_size(n), '\0');
+    std::string scalar = simd;
+    mpesa::base64_encode(in, simd.data());
+    mpesa::base64_encode_scalar(in, scalar.data());
+    const std::string expected = reference_base64(in);
+    check(simd == expected, "base64 simd, size", std::to_string(n));
+    check(scalar == expected, "base64 scalar, size", std::to_string(n));
+  }
+
+  // Random instants over two centuries, plus every second across a leap day.
+  std::vector<std::chrono::system_clock::time_point> instants;
+  for (int i = 0; i < 100'000; ++i) {
+    instants.emplace_back(std::chrono::seconds(static_cast<std::int64_t>(rng() % 4'102'444'800)));
+  }
+  const auto leap = std::chrono::sys_days{std::chrono::year{2024} / 2 / 29};
+  for (int s = -86'400; s < 2 * 86'400; s += 7) instants.push_back(leap + std::chrono::seconds(s));
+  for (const auto when : instants) {
+    const std::string expected = reference_timestamp(when);
+    check(mpesa::daraja_timestamp(when) == expected, "timestamp", expected);
+  }
+
+  // Every prefix length the generator accepts, so each 0-2 byte carry is hit.
+  for (std::size_t length = 0; length <= mpesa::StkPassword::kMaxPrefixSize; ++length) {
+    std::string passkey(length > kShortCode.size() ? length - kShortCode.size() : 0, 'k');
+    for (char& c : passkey) c = static_cast<char>('0' + rng() % 75);
+    const std::string_view short_code = kShortCode.substr(0, std::min(length, kShortCode.size()));
+    const mpesa::StkPasswordGenerator generator(short_code, passkey);
+    mpesa::StkPassword password;
+    for (int i = 0; i < 50; ++i) {
+      const auto when = instants[static_cast<std::size_t>(rng() % instants.size())];
+      generator.get(password, when);
+      const std::string timestamp = reference_timestamp(when);
+      check(password.timestamp() == timestamp, "generator timestamp", timestamp);
+      check(password.value() == reference_password(short_code, passkey, timestamp), "generator password, prefix",
+            std::to_string(length));
+      check(mpesa::stk_password(short_code, passkey, timestamp) == password.value(), "stk_password, prefix",
+            std::to_string(length));
+    }
+  }
+  return mismatches;
+}
+
+// The derivation the generator replaces: format the time, concatenate, encode.
+void BM_PasswordPerCall(benchmark::State& state) {
+  for (auto _ : state) {
+    const std::string timestamp = reference_timestamp(std::chrono::system_clock::now());
+    std::string raw;
+    raw.append(kShortCode).append(kPasskey).append(timestamp);
+    benchmark::DoNotOptimize(mpesa::base64_encode(raw));
+  }
+}
+BENCHMARK(BM_PasswordPerCall);
+
+void BM_PasswordGenerator(benchmark::State& state) {
+  static const mpesa::StkPasswordGenerator generator(kShortCode, kPasskey);
+  mpesa::StkPassword password;
+  for (auto _ : state) {
+    generator.get(password);
+    benchmark::DoNotOptimize(password);
+  }
+}
+BENCHMARK(BM_PasswordGenerator)->ThreadRange(1, 4)->UseRealTime();
+
+// STK Push bodies rotating over `range(0)` shortcodes, as a service calling
+// for many tenants does on one thread.
+void BM_StkPushBody(benchmark::State& state) {
+  std::vector<mpesa::StkPushRequest> requests(static_cast<std::size_t>(state.range(0)));
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    requests[i].business_short_code = std::to_string(600'000 + i);
+    requests[i].passkey = kPasskey;
+    requests[i].amount = 100;
+    requests[i].party_a = "254708374149";
+    requests[i].callback_url = "https://example.com/mpesa/stk";
+    requests[i].account_reference = "INV10023";
+    requests[i].transaction_desc = "Payment";
+  }
+  std::string body;
+  std::size_t i = 0;
+  for (auto _ : state) {
+    body.clear();
+    mpesa::write_body(requests[i], body);
+    benchmark::DoNotOptimize(body.data());
+    if (++i == requests.size()) i = 0;
+  }
+}
+BENCHMARK(BM_StkPushBody)->Arg(1)->Arg(200);
+
+template <std::size_t (*Encode)(std::string_view, char*) noexcept>
+void BM_Base64(benchmark::State& state) {
+  const std::string in(static_cast<std::size_t>(state.range(0)), 'x');
+  std::string out(mpesa::base64_encoded_size(in.size()), '\0');
+  for (auto _ : state) {
+    Encode(in, out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * in.size()));
+}
+BENCHMARK(BM_Base64<mpesa::base64_encode_scalar>)->Name("BM_Base64Scalar")->Arg(84)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_Base64<mpesa::base64_encode>)->Name("BM_Base64")->Arg(84)->Arg(1024)->Arg(16384);
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (const int mismatches = verify(); mismatches != 0) {
+    std::fprintf(stderr, "%d mismatches against the reference encoding\n", mismatches);
+    return 1;
+  }
+  std::printf("fast paths match the reference encoding\n");
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
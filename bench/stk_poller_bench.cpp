@@ -0,0 +1,173 @@
+// STK Push with lost callbacks: N pushes go to the local simulator, which
+// posts each outcome to a CallbackServer after a delay; the receiver drops a
+// share of them, as if they never arrived. StkStatusPoller resolves every
+// payment from its callback or by querying, from one loop thread. Reports
+// how each was resolved, the queries spent, the time until the last outcome
+// and the process's thread count (constant in N), then times track() plus
+// on_callback() without any I/O.
+//
+//   stk_poller_bench [--payments N] [--lost P] [--in-flight C] [--callback-delay-ms D]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "mpesa/callback_server.hpp"
+#include "mpesa/http_client.hpp"
+#include "mpesa/sim/daraja_simulator.hpp"
+#include "mpesa/stk_poller.hpp"
+
+namespace {
+
+constexpr const char* kPasskey = "bfb279f9aa9bdbcf158e97dd71a467cd2e0c893059b10f78e6b72ada1ed2c919";
+
+int thread_count() {
+  std::ifstream status("/proc/self/status");
+  for (std::string line; std::getline(status, line);) {
+    if (line.rfind("Threads:", 0) == 0) return std::atoi(line.c_str() + 8);
+  }
+  return 0;
+}
+
+struct Run {
+  int remaining = 0;  ///< pushes still to send
+  std::atomic<int> outcomes{0};
+  int payments = 0;
+  int max_threads = 0;
+};
+
+mpesa::Task<void> pusher(mpesa::AsyncDarajaClient& client, mpesa::StkStatusPoller& poller, std::uint16_t port,
+                         Run& run) {
+  while (run.remaining > 0) {
+    const int i = run.remaining--;
+    mpesa::StkPushRequest push;
+    push.business_short_code = "174379";
+    push.passkey = kPasskey;
+    push.amount = 1 + i % 1000;
+    push.party_a = "254708374149";
+    push.callback_url = "http://127.0.0.1:" + std::to_string(port) + "/mpesa/stk";
+    push.account_reference = "INV" + std::to_string(i);
+    push.transaction_desc = "Payment";
+    try {
+      const mpesa::StkPushResponse r = co_await client.stk_push(push);
+      mpesa::StkQueryRequest query;
+      query.business_short_code = push.business_short_code;
+      query.passkey = kPasskey;
+      query.checkout_request_id = r.checkout_request_id;
+      poller.track(std::move(query), [&run](const mpesa::StkOutcome&) { run.outcomes.fetch_add(1); });
+    } catch (const std::exception& e) {
+      std::fprintf(stderr, "push failed: %s\n", e.what());
+      run.outcomes.fetch_add(1);
+    }
+    run.max_threads = std::max(run.max_threads, thread_count() * (i % 256 == 0));
+  }
+}
+
+mpesa::Task<void> wait_for(mpesa::EventLoop& loop, Run& run) {
+  while (run.outcomes.load() < run.payments) co_await loop.sleep_for(std::chrono::milliseconds(5));
+}
+
+// track() and on_callback() for IDs that never reach a tick: the per-payment
+// bookkeeping cost.
+void time_bookkeeping(mpesa::AsyncDarajaClient& client) {
+  constexpr int kOps = 200'000;
+  mpesa::StkStatusPoller poller(client, {.first_poll = std::chrono::hours(1), .give_up_after = std::chrono::hours(2)});
+  std::vector<std::string> ids;
+  ids.reserve(kOps);
+  for (int i = 0; i < kOps; ++i) ids.push_back("ws_CO_16102026" + std::to_string(100000000 + i));
+  int resolved = 0;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (const std::string& id : ids) {
+    mpesa::StkQueryRequest q;
+    q.business_short_code = "174379";
+    q.checkout_request_id = id;
+    poller.track(std::move(q), [&resolved](const mpesa::StkOutcome&) { ++resolved; });
+  }
+  const auto t1 = std::chrono::steady_clock::now();
+  mpesa::StkCallback cb;
+  for (const std::string& id : ids) {
+    cb.checkout_request_id = id;
+    poller.on_callback(cb);
+  }
+  const auto t2 = std::chrono::steady_clock::now();
+  std::printf("bookkeeping: track %.0f ns, on_callback %.0f ns per payment (%d resolved)\n",
+              std::chrono::duration<double, std::nano>(t1 - t0).count() / kOps,
+              std::chrono::duration<double, std::nano>(t2 - t1).count() / kOps, resolved);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int payments = 5'000;
+  double lost = 0.2;
+  int in_flight = 32;
+  int callback_delay_ms = 200;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--payments") == 0) payments = std::max(1, std::atoi(argv[i + 1]));
+    else if (std::strcmp(argv[i], "--lost") == 0) lost = std::atof(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--in-flight") == 0) in_flight = std::max(1, std::atoi(argv[i + 1]));
+    else if (std::strcmp(argv[i], "--callback-delay-ms") == 0) callback_delay_ms = std::atoi(argv[i + 1]);
+  }
+
+  mpesa::sim::DarajaSimulatorOptions sim_options;
+  sim_options.passkey = kPasskey;
+  sim_options.latency = std::chrono::microseconds(500);
+  sim_options.callback_delay = std::chrono::milliseconds(callback_delay_ms);
+  sim_options.callback_jitter = std::chrono::milliseconds(callback_delay_ms * 4);
+  sim_options.failure_rate = 0.1;
+  mpesa::sim::DarajaSimulator simulator(sim_options);
+  simulator.start();
+
+  mpesa::HttpClientOptions http_options;
+  http_options.pool.tls.ca_pem = simulator.ca_pem();
+  http_options.pool.max_connections_per_endpoint = static_cast<std::size_t>(in_flight);
+  mpesa::HttpClient token_http(http_options);
+  mpesa::TokenManager tokens(token_http, simulator.endpoint(), mpesa::Credentials{"key", "secret"});
+  mpesa::EventLoop loop;
+  mpesa::AsyncHttpClient http(loop, http_options);
+  mpesa::AsyncDarajaClient client(http, tokens, simulator.endpoint());
+
+  // Queries start once a callback is clearly overdue.
+  const auto overdue = std::chrono::milliseconds(callback_delay_ms * 6);
+  mpesa::StkStatusPoller poller(client, {.first_poll = overdue,
+                                         .backoff = 1.5,
+                                         .max_interval = overdue * 2,
+                                         .give_up_after = std::chrono::seconds(60),
+                                         .max_in_flight = static_cast<unsigned>(in_flight),
+                                         .tick = std::chrono::milliseconds(10)});
+  const std::uint64_t keep_below = static_cast<std::uint64_t>((1 - lost) * 1000);
+  mpesa::CallbackServer receiver({.bind_address = "127.0.0.1", .workers = 2});
+  receiver.on_stk_callback("/mpesa/stk", [&](const mpesa::StkCallback& cb) {
+    if (std::hash<std::string_view>{}(cb.checkout_request_id) % 1000 < keep_below) poller.on_callback(cb);
+  });
+  receiver.start();
+
+  std::printf("%d STK pushes, %.0f%% of callbacks lost, callbacks after %d+%d ms, polls from %lld ms\n\n", payments,
+              lost * 100, callback_delay_ms, callback_delay_ms * 4, static_cast<long long>(overdue.count()));
+  Run run;
+  run.payments = payments;
+  run.remaining = payments;
+  const auto started = std::chrono::steady_clock::now();
+  for (int t = 0; t < in_flight; ++t) loop.spawn(pusher(client, poller, receiver.port(), run));
+  loop.sync_wait(wait_for(loop, run));
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  const mpesa::StkPollerStats s = poller.stats();
+  std::printf("resolved %d in %.2f s: %llu by callback, %llu by query, %llu expired\n", run.outcomes.load(), elapsed,
+              static_cast<unsigned long long>(s.by_callback), static_cast<unsigned long long>(s.by_query),
+              static_cast<unsigned long long>(s.expired));
+  std::printf("queries %llu (%.2f per polled payment), deferred %llu, threads %d\n\n",
+              static_cast<unsigned long long>(s.queries),
+              s.by_query + s.expired ? static_cast<double>(s.queries) / static_cast<double>(s.by_query + s.expired) : 0,
+              static_cast<unsigned long long>(s.deferred), std::max(run.max_threads, thread_count()));
+  receiver.stop();
+  simulator.stop();
+
+  time_bookkeeping(client);
+  return s.expired == 0 && s.pending == 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+// Many shortcodes against the local simulator: one HttpClient, TokenManager
+// and DarajaClient per shortcode, as a service does without a registry,
+// against one TenantRegistry over a shared HttpClient. Both send the same
+// STK Pushes round-robin across the shortcodes from one thread and report
+// throughput, connections opened, token fetches and the threads the
+// process runs. Then B2C payouts built from a per-tenant B2CTemplate go
+// through the same registry, and a registry lookup is timed.
+//
+//   tenant_bench [--tenants N] [--calls C]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mpesa/prepared_request.hpp"
+#include "mpesa/sim/daraja_simulator.hpp"
+#include "mpesa/tenant_registry.hpp"
+
+namespace {
+
+constexpr const char* kPasskey = "bfb279f9aa9bdbcf158e97dd71a467cd2e0c893059b10f78e6b72ada1ed2c919";
+
+int threads() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("Threads:", 0) == 0) return std::atoi(line.c_str() + 8);
+  }
+  return 0;
+}
+
+std::vector<std::string> short_codes(int tenants) {
+  std::vector<std::string> out;
+  for (int i = 0; i < tenants; ++i) out.push_back(std::to_string(600'000 + i));
+  return out;
+}
+
+mpesa::StkPushRequest push(int i) {
+  mpesa::StkPushRequest r;
+  r.amount = 1 + i % 1000;
+  r.party_a = "254708374149";
+  r.callback_url = "https://example.com/mpesa/stk";
+  r.account_reference = "INV" + std::to_string(i);
+  r.transaction_desc = "Payment";
+  return r;
+}
+
+mpesa::HttpClientOptions http_options(const mpesa::sim::DarajaSimulator& simulator) {
+  mpesa::HttpClientOptions options;
+  options.pool.tls.ca_pem = simulator.ca_pem();
+  options.metrics = nullptr;
+  return options;
+}
+
+void report(const char* name, std::size_t accepted, double elapsed, std::uint64_t connections,
+            const mpesa::sim::DarajaSimulator& simulator, int thread_count) {
+  std::printf("%-10s %10.0f %12llu %12llu %8d\n", name, static_cast<double>(accepted) / elapsed,
+              static_cast<unsigned long long>(connections),
+              static_cast<unsigned long long>(simulator.stats().calls_to(mpesa::MetricEndpoint::kOAuth)),
+              thread_count);
+}
+
+// A client stack per shortcode, each with its own pool and token refresher.
+void per_shortcode(const std::vector<std::string>& codes, int calls) {
+  mpesa::sim::DarajaSimulatorOptions sim_options;
+  sim_options.passkey = kPasskey;
+  mpesa::sim::DarajaSimulator simulator(sim_options);
+  simulator.start();
+
+  struct Stack {
+    mpesa::HttpClient http;
+    mpesa::TokenManager tokens;
+    mpesa::DarajaClient daraja;
+    Stack(const mpesa::HttpClientOptions& options, const mpesa::Endpoint& endpoint)
+        : http(options), tokens(http, endpoint, mpesa::Credentials{"key", "secret"}), daraja(http, tokens, endpoint) {}
+  };
+  std::vector<std::unique_ptr<Stack>> stacks;
+  for (std::size_t i = 0; i < codes.size(); ++i) {
+    stacks.push_back(std::make_unique<Stack>(http_options(simulator), simulator.endpoint()));
+  }
+
+  std::size_t accepted = 0;
+  const auto started = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; ++i) {
+    const std::size_t t = static_cast<std::size_t>(i) % codes.size();
+    mpesa::StkPushRequest r = push(i);
+    r.business_short_code = codes[t];
+    r.passkey = kPasskey;
+    accepted += stacks[t]->daraja.stk_push(r).accepted();
+  }
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  std::uint64_t connections = 0;
+  for (const auto& stack : stacks) connections += stack->http.pool().stats().connections_opened;
+  report("separate", accepted, elapsed, connections, simulator, threads());
+  simulator.stop();
+}
+
+void registry(const std::vector<std::string>& codes, int calls) {
+  mpesa::sim::DarajaSimulatorOptions sim_options;
+  sim_options.passkey = kPasskey;
+  mpesa::sim::DarajaSimulator simulator(sim_options);
+  simulator.start();
+
+  mpesa::HttpClient http(http_options(simulator));
+  mpesa::TenantRegistry tenants(http, simulator.endpoint(), [](std::string_view short_code) {
+    mpesa::TenantConfig config;
+    config.short_code = std::string(short_code);
+    config.credentials = mpesa::Credentials{"key", "secret"};
+    config.passkey = kPasskey;
+    config.initiator_name = "testapi";
+    config.security_credential = "Sx9AwbD7nWUzM2gXq3vO+5yPxN0sJb1T8dLkR4fH6cQeYmZiVt2uKo7GjAlEpBrC==";
+    return std::optional<mpesa::TenantConfig>(std::move(config));
+  });
+
+  std::size_t accepted = 0;
+  const auto started = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; ++i) {
+    mpesa::StkPushRequest r = push(i);
+    r.business_short_code = codes[static_cast<std::size_t>(i) % codes.size()];
+    accepted += tenants.call(std::move(r)).accepted();
+  }
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  report("registry", accepted, elapsed, http.pool().stats().connections_opened, simulator, threads());
+
+  // A payroll template per tenant, rendered once from its configuration;
+  // the payouts route by the template's PartyA.
+  using Payroll = mpesa::B2CTemplate<mpesa::command::SalaryPayment>;
+  std::vector<std::unique_ptr<Payroll>> payrolls;
+  for (const std::string& code : codes) {
+    const mpesa::TenantConfig& config = tenants.get(code).config();
+    mpesa::B2CSender sender;
+    sender.initiator_name = config.initiator_name;
+    sender.security_credential = config.security_credential;
+    sender.party_a = config.short_code;
+    sender.queue_timeout_url = "https://payouts.example.com/b2c/timeout";
+    sender.result_url = "https://payouts.example.com/b2c/result";
+    payrolls.push_back(std::make_unique<Payroll>(sender));
+  }
+  std::size_t paid = 0;
+  const auto payroll_started = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; ++i) {
+    const Payroll& payroll = *payrolls[static_cast<std::size_t>(i) % payrolls.size()];
+    paid += tenants.call(payroll.payout("254708374149", 1'000 + i % 500, "October salary")).accepted();
+  }
+  const double payroll_elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - payroll_started).count();
+  std::printf("\nB2C payouts from per-tenant templates: %.0f calls/s, %zu of %d accepted\n",
+              static_cast<double>(paid) / payroll_elapsed, paid, calls);
+  simulator.stop();
+
+  constexpr int kLookups = 2'000'000;
+  std::size_t found = 0;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < kLookups; ++i) {
+    found += tenants.get(codes[static_cast<std::size_t>(i) % codes.size()]).short_code().size();
+  }
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  if (found == 0) std::abort();
+  std::printf("registry lookup: %.1f ns over %zu tenants\n", ns / kLookups, tenants.size());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int tenants = 200;
+  int calls = 4'000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--tenants") == 0) tenants = std::max(1, std::atoi(argv[i + 1]));
+    else if (std::strcmp(argv[i], "--calls") == 0) calls = std::max(1, std::atoi(argv[i + 1]));
+  }
+  const std::vector<std::string> codes = short_codes(tenants);
+
+  std::printf("%d shortcodes, %d STK Pushes round-robin from one thread\n\n", tenants, calls);
+  std::printf("%-10s %10s %12s %12s %8s\n", "client", "calls/s", "connections", "token_calls", "threads");
+  per_shortcode(codes, calls);
+  registry(codes, calls);
+  return 0;
+}
@@ -0,0 +1,86 @@
+// Cost of the token read path on every payment call, and how many token
+// endpoint requests a thundering herd at expiry turns into.
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "mpesa/http_client.hpp"
+#include "mpesa/sim/https_server.hpp"
+#include "mpesa/token_manager.hpp"
+
+namespace {
+
+struct Env {
+  mpesa::sim::HttpsServer server{[](const mpesa::HttpRequest&) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));  // token endpoint latency
+    mpesa::HttpResponse r;
+    r.status = 200;
+    r.headers = {{"Content-Type", "application/json"}};
+    r.body = R"({"access_token":"c9SQxWWhmdVRlyh0zh8gZDTkubVF","expires_in":"3599"})";
+    return r;
+  }};
+  std::unique_ptr<mpesa::HttpClient> http;
+
+  Env() {
+    server.start();
+    mpesa::HttpClientOptions options;
+    options.pool.tls.ca_pem = server.ca_pem();
+    http = std::make_unique<mpesa::HttpClient>(options);
+  }
+};
+
+Env& env() {
+  static Env e;
+  return e;
+}
+
+void BM_TokenGetWarm(benchmark::State& state) {
+  static std::unique_ptr<mpesa::TokenManager> tokens;
+  if (state.thread_index() == 0) {
+    tokens = std::make_unique<mpesa::TokenManager>(*env().http, env().server.endpoint(),
+                                                   mpesa::Credentials{"key", "secret"});
+    tokens->get();
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tokens->get());
+  }
+  if (state.thread_index() == 0) {
+    state.counters["fetches"] = static_cast<double>(tokens->fetch_count());
+  }
+}
+BENCHMARK(BM_TokenGetWarm)->ThreadRange(1, 8)->UseRealTime();
+
+// Every iteration expires the token and releases `threads` callers at once.
+void BM_ExpiryStampede(benchmark::State& state) {
+  const int threads = static_cast<int>(state.range(0));
+  mpesa::TokenManager tokens(*env().http, env().server.endpoint(), mpesa::Credentials{"key", "secret"},
+                             {.background_refresh = false});
+  std::uint64_t stampedes = 0;
+  for (auto _ : state) {
+    mpesa::AccessToken current;
+    if (tokens.try_get(current)) tokens.invalidate(current);
+    std::atomic<bool> go{false};
+    std::vector<std::thread> callers;
+    for (int t = 0; t < threads; ++t) {
+      callers.emplace_back([&] {
+        while (!go.load(std::memory_order_acquire)) {
+        }
+        benchmark::DoNotOptimize(tokens.get());
+      });
+    }
+    go.store(true, std::memory_order_release);
+    for (auto& c : callers) c.join();
+    ++stampedes;
+  }
+  state.counters["fetches_per_expiry"] =
+      static_cast<double>(tokens.fetch_count()) / static_cast<double>(stampedes);
+}
+BENCHMARK(BM_ExpiryStampede)->Arg(8)->Arg(64)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,166 @@
+// Dashboard queries over a month of callback data. `--rows` C2B
+// confirmations across `--paybills` shortcodes and a pool of customers are
+// kept twice: as row-per-object log records with string fields, the way
+// handlers usually log them, and in a TransactionStore. Each layout then
+// answers "total received per paybill per hour" and "total for one paybill
+// on one day"; answers are checked against each other.
+//
+//   transaction_store_bench [--rows N] [--paybills P] [--customers C]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mpesa/transaction_store.hpp"
+
+namespace {
+
+// What a confirmation handler writes to its log, one object per callback.
+struct LoggedTransaction {
+  std::string trans_id;
+  std::string trans_time;
+  std::string trans_amount;
+  std::string business_short_code;
+  std::string msisdn;
+  std::string source;
+  int result_code = 0;
+};
+
+using Seconds = std::chrono::duration<double>;
+
+template <class F>
+double time(F&& f) {
+  const auto t0 = std::chrono::steady_clock::now();
+  f();
+  return Seconds(std::chrono::steady_clock::now() - t0).count();
+}
+
+std::string two(unsigned v) {
+  char out[8];
+  std::snprintf(out, sizeof(out), "%02u", v % 100);
+  return out;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::size_t rows = 5'000'000;
+  std::size_t paybills = 40;
+  std::size_t customers = 200'000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--rows") == 0) rows = std::strtoul(argv[i + 1], nullptr, 10);
+    else if (std::strcmp(argv[i], "--paybills") == 0) paybills = std::strtoul(argv[i + 1], nullptr, 10);
+    else if (std::strcmp(argv[i], "--customers") == 0) customers = std::strtoul(argv[i + 1], nullptr, 10);
+  }
+  paybills = paybills == 0 ? 1 : paybills;
+  customers = customers == 0 ? 1 : customers;
+
+  // October 2026, callbacks in time order with a few seconds of jitter.
+  std::vector<LoggedTransaction> log;
+  log.reserve(rows);
+  const std::uint64_t span = 31ull * 86400;
+  for (std::size_t i = 0; i < rows; ++i) {
+    const std::uint64_t second = i * span / rows + (i * 7) % 5;
+    const std::uint64_t s = std::min(second, span - 1);
+    LoggedTransaction t;
+    char id[24];
+    std::snprintf(id, sizeof(id), "SJ%08zX", i);
+    t.trans_id = id;
+    t.trans_time = "202610" + two(static_cast<unsigned>(1 + s / 86400)) + two(static_cast<unsigned>(s / 3600 % 24)) +
+                   two(static_cast<unsigned>(s / 60 % 60)) + two(static_cast<unsigned>(s % 60));
+    t.trans_amount = std::to_string(10 + (i * 2654435761u) % 25'000);
+    if (i % 3 == 0) t.trans_amount.append(".50");
+    t.business_short_code = std::to_string(600'000 + (i * 40503u) % paybills);
+    t.msisdn = "2547" + std::to_string(10'000'000 + (i * 7919) % customers);
+    t.source = "C2B";
+    log.push_back(std::move(t));
+  }
+
+  mpesa::TransactionStore store;
+  const double ingest = time([&] {
+    store.reserve(rows);
+    for (const LoggedTransaction& t : log) {
+      mpesa::C2BNotification n;
+      n.trans_id = t.trans_id;
+      n.trans_time = t.trans_time;
+      n.trans_amount = t.trans_amount;
+      n.business_short_code = t.business_short_code;
+      n.msisdn = t.msisdn;
+      store.append(n);
+    }
+  });
+
+  // Heap blocks of strings too long for the small-string buffer included.
+  std::size_t log_bytes = log.capacity() * sizeof(LoggedTransaction);
+  for (const LoggedTransaction& t : log) {
+    for (const std::string* s : {&t.trans_id, &t.trans_time, &t.trans_amount, &t.business_short_code, &t.msisdn,
+                                 &t.source}) {
+      if (s->capacity() > 15) log_bytes += s->capacity() + 1;
+    }
+  }
+  std::printf("%zu transactions, %zu paybills, %zu customers; ingest %.0f rows/s\n", rows, paybills,
+              store.msisdns().size(), static_cast<double>(rows) / ingest);
+  std::printf("memory: row objects %.1f MB, column store %.1f MB\n\n", static_cast<double>(log_bytes) / 1e6,
+              static_cast<double>(store.memory_bytes()) / 1e6);
+
+  bool ok = true;
+  std::printf("%-34s %12s %12s\n", "query", "objects_ms", "columns_ms");
+
+  // Total received per paybill per hour.
+  std::map<std::pair<std::string, std::string>, std::pair<std::uint64_t, std::int64_t>> by_hour;
+  const double objects_hourly = time([&] {
+    for (const LoggedTransaction& t : log) {
+      if (t.result_code != 0) continue;
+      auto& g = by_hour[{t.business_short_code, t.trans_time.substr(0, 10)}];
+      ++g.first;
+      g.second += mpesa::parse_amount_cents(t.trans_amount);
+    }
+  });
+  std::vector<mpesa::HourlyTotal> hourly;
+  const double columns_hourly = time([&] { hourly = store.hourly_totals({}); });
+  ok = ok && hourly.size() == by_hour.size();
+  auto it = by_hour.begin();
+  for (std::size_t g = 0; ok && g < hourly.size(); ++g, ++it) {
+    ok = hourly[g].short_code == it->first.first && hourly[g].count == it->second.first &&
+         hourly[g].amount_cents == it->second.second &&
+         hourly[g].hour == mpesa::parse_daraja_time(it->first.second + "0000") / 3600;
+  }
+  std::printf("%-34s %12.2f %12.2f\n", "per paybill per hour, month", objects_hourly * 1e3, columns_hourly * 1e3);
+
+  // One paybill, one day.
+  const std::string paybill = std::to_string(600'000 + paybills / 2);
+  const std::string day = "20261015";
+  mpesa::TransactionTotals expected;
+  const double objects_day = time([&] {
+    for (const LoggedTransaction& t : log) {
+      if (t.result_code != 0 || t.business_short_code != paybill || t.trans_time.compare(0, 8, day) != 0) continue;
+      ++expected.count;
+      expected.amount_cents += mpesa::parse_amount_cents(t.trans_amount);
+    }
+  });
+  const mpesa::TransactionFilter one_day{.from = mpesa::parse_daraja_time(day + "000000"),
+                                         .to = mpesa::parse_daraja_time(day + "000000") + 86400,
+                                         .short_code = paybill};
+  mpesa::TransactionTotals simd;
+  mpesa::TransactionTotals scalar;
+  const double columns_day = time([&] { simd = store.total(one_day); });
+  std::printf("%-34s %12.2f %12.3f\n", "one paybill, one day", objects_day * 1e3, columns_day * 1e3);
+
+  // The whole month for that paybill: no block can be skipped.
+  mpesa::TransactionFilter month{.short_code = paybill};
+  mpesa::TransactionTotals month_simd;
+  const double simd_month = time([&] { month_simd = store.total(month); });
+  const double scalar_month = time([&] { scalar = store.total_scalar(month); });
+  std::printf("%-34s %12s %12.2f\n", "one paybill, month (AVX2)", "", simd_month * 1e3);
+  std::printf("%-34s %12s %12.2f\n", "one paybill, month (scalar)", "", scalar_month * 1e3);
+
+  ok = ok && simd.count == expected.count && simd.amount_cents == expected.amount_cents &&
+       month_simd.count == scalar.count && month_simd.amount_cents == scalar.amount_cents;
+  std::printf("\n%s\n", ok ? "ok" : "MISMATCH");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+// Time to answer a C2B validation request, down to p99.99. Daraja applies
+// the shortcode's default action when validation is slow, so the tail is
+// what matters.
+//
+//   in-process  parse the POST, decode it, decide and render the reply, as a
+//               CallbackServer worker does; compiled C2BValidator rules
+//               against a typical handler over std::unordered_set<std::string>.
+//   loopback    round trips to a CallbackServer with one pinned worker
+//               answering from rules, one request in flight.
+//
+//   validation_bench [--iterations N] [--requests R] [--accounts A]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "mpesa/arena.hpp"
+#include "mpesa/c2b_validator.hpp"
+#include "mpesa/callback_server.hpp"
+#include "mpesa/histogram.hpp"
+#include "mpesa/http.hpp"
+#include "mpesa/http_client.hpp"
+#include "mpesa/json.hpp"
+
+namespace {
+
+constexpr const char* kValidationPath = "/mpesa/c2b/validation";
+
+std::string account(std::size_t i) { return "INV" + std::to_string(100'000 + i); }
+
+std::string validation_body(std::string_view bill_ref, std::string_view amount, std::string_view msisdn) {
+  std::string body = R"({"TransactionType":"Pay Bill","TransID":"RKTQDM7W6S","TransTime":"20261016063845","TransAmount":")";
+  body.append(amount).append(R"(","BusinessShortCode":"600638","BillRefNumber":")").append(bill_ref);
+  body.append(R"(","InvoiceNumber":"","OrgAccountBalance":"","ThirdPartyTransID":"","MSISDN":")").append(msisdn);
+  body.append(R"(","FirstName":"John","MiddleName":"","LastName":"Doe"})");
+  return body;
+}
+
+std::string post(const std::string& body) {
+  std::string wire =
+      "POST /mpesa/c2b/validation HTTP/1.1\r\n"
+      "Host: payments.example.com\r\n"
+      "Content-Type: application/json\r\n"
+      "Content-Length: ";
+  wire.append(std::to_string(body.size())).append("\r\n\r\n").append(body);
+  return wire;
+}
+
+// Accepts, unknown accounts (lower-cased, as customers type them), a bad
+// amount and a blocked number.
+std::vector<std::string> bodies(std::size_t accounts) {
+  std::vector<std::string> out;
+  for (std::size_t i = 0; i < 64; ++i) {
+    std::string ref = account(i * 7919 % accounts);
+    if (i % 4 == 1) ref[0] = 'i';
+    if (i % 8 == 3) ref = "UNKNOWN" + std::to_string(i);
+    const char* amount = i % 16 == 5 ? "250001.00" : "1500.00";
+    const char* msisdn = i % 32 == 7 ? "2547*****000" : "2547*****149";
+    out.push_back(validation_body(ref, amount, msisdn));
+  }
+  return out;
+}
+
+mpesa::C2BValidationRules rules(std::size_t accounts) {
+  mpesa::C2BValidationRules r;
+  r.short_codes = {"600638"};
+  r.max_amount_cents = 250'000'00;
+  r.blocked_msisdns = {"2547*****000"};
+  for (std::size_t i = 0; i < accounts; ++i) r.accounts.push_back(account(i));
+  return r;
+}
+
+double us(std::uint64_t ns) { return static_cast<double>(ns) / 1000.0; }
+
+void print_latency(const char* name, const mpesa::Histogram& h) {
+  std::printf("%-12s %9llu %9.2f %9.2f %9.2f %9.2f %9.2f\n", name, static_cast<unsigned long long>(h.count()),
+              us(h.percentile(0.50)), us(h.percentile(0.99)), us(h.percentile(0.999)), us(h.percentile(0.9999)),
+              us(h.max()));
+}
+
+template <class Decide>
+mpesa::Histogram in_process(const std::vector<std::string>& wires, int iterations, Decide decide) {
+  mpesa::Arena<> arena;
+  mpesa::HttpParser parser(mpesa::HttpParser::Kind::kRequest, &arena);
+  std::string out;
+  out.reserve(512);
+  mpesa::Histogram h;
+  for (int i = 0; i < iterations; ++i) {
+    const std::string& wire = wires[static_cast<std::size_t>(i) % wires.size()];
+    const auto t0 = mpesa::Clock::now();
+    parser.feed(wire.data(), wire.size());
+    {
+      mpesa::json::Reader reader(parser.request().body, &arena);
+      mpesa::C2BNotification n;
+      mpesa::read_callback(reader, n);
+      out.append(mpesa::validation_response_body(decide(n)));
+    }
+    parser.reset();
+    arena.release();
+    h.record(mpesa::Clock::now() - t0);
+    out.clear();
+  }
+  return h;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 1'000'000;
+  int requests = 100'000;
+  std::size_t accounts = 100'000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--iterations") == 0) iterations = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--requests") == 0) requests = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--accounts") == 0) accounts = std::strtoul(argv[i + 1], nullptr, 10);
+  }
+  accounts = std::max<std::size_t>(accounts, 1);
+
+  const auto samples = bodies(accounts);
+  std::vector<std::string> wires;
+  for (const auto& b : samples) wires.push_back(post(b));
+
+  const mpesa::C2BValidator validator(rules(accounts));
+  // What a hand-written handler usually looks like.
+  std::unordered_set<std::string> open_accounts;
+  for (std::size_t i = 0; i < accounts; ++i) open_accounts.insert(account(i));
+  const std::function<mpesa::C2BValidation(const mpesa::C2BNotification&)> handler =
+      [&](const mpesa::C2BNotification& n) {
+        if (n.business_short_code != "600638") return mpesa::C2BValidation::kRejectShortCode;
+        const double amount = std::strtod(std::string(n.trans_amount).c_str(), nullptr);
+        if (amount < 0.01 || amount > 250'000) return mpesa::C2BValidation::kRejectAmount;
+        if (n.msisdn == "2547*****000") return mpesa::C2BValidation::kRejectMsisdn;
+        std::string ref(n.bill_ref_number);
+        std::transform(ref.begin(), ref.end(), ref.begin(), [](unsigned char c) { return std::toupper(c); });
+        return open_accounts.count(ref) != 0 ? mpesa::C2BValidation::kAccept : mpesa::C2BValidation::kRejectAccount;
+      };
+
+  std::size_t accepted = 0;
+  for (const auto& b : samples) {
+    mpesa::json::Reader reader(b);
+    mpesa::C2BNotification n;
+    mpesa::read_callback(reader, n);
+    if (validator.decide(n) != handler(n)) {
+      std::fprintf(stderr, "rules and handler disagree on %s\n", b.c_str());
+      return 1;
+    }
+    accepted += validator.decide(n) == mpesa::C2BValidation::kAccept;
+  }
+
+  std::printf("%zu accounts, %zu of %zu sample requests accepted\n\n", accounts, accepted, samples.size());
+  std::printf("%-12s %9s %9s %9s %9s %9s %9s\n", "in-process", "count", "p50_us", "p99_us", "p999_us", "p9999_us",
+              "max_us");
+  in_process(wires, iterations / 10, [&](const auto& n) { return validator.decide(n); });  // warm up
+  print_latency("rules", in_process(wires, iterations, [&](const auto& n) { return validator.decide(n); }));
+  print_latency("handler", in_process(wires, iterations, handler));
+
+  mpesa::CallbackServer server({.bind_address = "127.0.0.1", .workers = 1, .pin_workers = true, .metrics = nullptr});
+  server.on_c2b_validation(kValidationPath, mpesa::C2BValidator(rules(accounts)));
+  server.start();
+  mpesa::HttpClient client(mpesa::HttpClientOptions{});
+  const mpesa::Endpoint endpoint{"127.0.0.1", server.port(), false};
+  mpesa::HttpRequest request;
+  request.method = "POST";
+  request.target = kValidationPath;
+  request.headers = {{"Content-Type", "application/json"}};
+  mpesa::Histogram rtt;
+  std::size_t errors = 0;
+  for (int i = 0; i < requests; ++i) {
+    request.body = samples[static_cast<std::size_t>(i) % samples.size()];
+    const auto t0 = mpesa::Clock::now();
+    if (client.send(endpoint, request).status != 200) ++errors;
+    if (i >= requests / 10) rtt.record(mpesa::Clock::now() - t0);
+  }
+  server.stop();
+  std::printf("\n%-12s %9s %9s %9s %9s %9s %9s\n", "loopback", "count", "p50_us", "p99_us", "p999_us", "p9999_us",
+              "max_us");
+  print_latency("round trip", rtt);
+  std::printf("errors=%zu\n", errors);
+  return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace mpesa {
+
+/// Monotonic allocator for one exchange: the HTTP request and response of a
+/// Daraja call, or the parsed request and JSON scratch of one callback.
+/// Allocating bumps a pointer, deallocating does nothing, and `release()`
+/// (or destruction) frees everything at once. The first `InlineBytes` come
+/// from storage inside the object, so a typical message never reaches the
+/// global heap; past that the arena grows in blocks from operator new.
+///
+/// Containers built on it (`std::pmr::string`, `HttpRequest(&arena)`, ...)
+/// must be gone, or at least never touched again, before it is released.
+/// Not thread-safe: one arena per call or per connection.
+template <std::size_t InlineBytes = 8192>
+class Arena final : public std::pmr::memory_resource {
+ public:
+  Arena() noexcept : resource_(storage_, sizeof(storage_), std::pmr::new_delete_resource()) {}
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /// Returns every allocation and starts over in the inline storage.
+  void release() noexcept { resource_.release(); }
+
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    return resource_.allocate(bytes, alignment);
+  }
+  void do_deallocate(void*, std::size_t, std::size_t) override {}
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+  alignas(std::max_align_t) std::byte storage_[InlineBytes];
+  std::pmr::monotonic_buffer_resource resource_;
+};
+
+}  // namespace mpesa
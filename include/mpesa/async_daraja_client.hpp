@@ -0,0 +1,97 @@
+#pragma once
+
+#include <exception>
+#include <optional>
+
+#include "mpesa/arena.hpp"
+#include "mpesa/async_http_client.hpp"
+#include "mpesa/daraja.hpp"
+#include "mpesa/endpoint.hpp"
+#include "mpesa/rate_limiter.hpp"
+#include "mpesa/task.hpp"
+#include "mpesa/token_manager.hpp"
+
+namespace mpesa {
+
+/// Coroutine counterpart of `DarajaClient`. Requests are taken by value so a
+/// task never outlives its arguments. The token comes from the lock-free
+/// cache; only a cold or expired cache hands the blocking fetch to the loop's
+/// worker thread. Use from the client's loop only. With a `RateLimiter`,
+/// a call that must wait for its slot sleeps on the loop rather than
+/// blocking it.
+class AsyncDarajaClient {
+ public:
+  AsyncDarajaClient(AsyncHttpClient& http, TokenManager& tokens, Endpoint endpoint, RateLimiter* limiter = nullptr)
+      : http_(http), tokens_(tokens), endpoint_(std::move(endpoint)), limiter_(limiter) {}
+
+  Task<StkPushResponse> stk_push(StkPushRequest r) { return call(std::move(r)); }
+  Task<StkQueryResponse> stk_query(StkQueryRequest r) { return call(std::move(r)); }
+  Task<AcceptedResponse> c2b_register_urls(C2BRegisterUrlRequest r) { return call(std::move(r)); }
+  Task<AcceptedResponse> c2b_simulate(C2BSimulateRequest r) { return call(std::move(r)); }
+  Task<AcceptedResponse> b2c(B2CRequest r) { return call(std::move(r)); }
+  Task<AcceptedResponse> b2b(B2BRequest r) { return call(std::move(r)); }
+  Task<AcceptedResponse> transaction_status(TransactionStatusRequest r) { return call(std::move(r)); }
+  Task<AcceptedResponse> account_balance(AccountBalanceRequest r) { return call(std::move(r)); }
+  Task<AcceptedResponse> reversal(ReversalRequest r) { return call(std::move(r)); }
+
+  template <class Request>
+  Task<typename Operation<Request>::Response> call(Request request) {
+    if (limiter_ == nullptr) co_return co_await send(std::move(request));
+    RateLane& lane = limiter_->lane(Operation<Request>::kMetric, shortcode_of(request));
+    const Clock::duration wait = lane.admit();
+    if (wait > Clock::duration::zero()) co_await http_.loop().sleep_for(wait);
+    std::optional<typename Operation<Request>::Response> out;
+    std::exception_ptr error;
+    try {
+      out.emplace(co_await send(std::move(request)));
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lane.completed(error);
+    if (error) std::rethrow_exception(error);
+    co_return std::move(*out);
+  }
+
+  const Endpoint& endpoint() const noexcept { return endpoint_; }
+  EventLoop& loop() noexcept { return http_.loop(); }
+  RateLimiter* limiter() const noexcept { return limiter_; }
+
+ private:
+  template <class Request>
+  Task<typename Operation<Request>::Response> send(Request request) {
+    Metrics* const metrics = http_.options().metrics;
+    CallTimer timer(metrics, Operation<Request>::kMetric);
+    AccessToken token = co_await this->token();
+    // Request, wire bytes and reply all live in the frame's arena and go
+    // with it.
+    Arena<> arena;
+    HttpRequest http_request(&arena);
+    build_api_request(request, token.value(), http_request);
+    HttpResponse response = co_await http_.send(endpoint_, http_request, arena);
+    if (response.status == 401) {
+      tokens_.invalidate(token);
+      token = co_await this->token();
+      // build_api_request puts Authorization first.
+      http_request.headers[0].value.assign("Bearer ").append(token.value());
+      response = co_await http_.send(endpoint_, http_request, arena);
+    }
+    auto out = decode_response<Request>(response, metrics);
+    timer.succeeded();
+    co_return out;
+  }
+
+  Task<AccessToken> token() {
+    AccessToken token;
+    if (!tokens_.try_get(token)) {
+      token = co_await http_.loop().run_blocking([this] { return tokens_.get(); });
+    }
+    co_return token;
+  }
+
+  AsyncHttpClient& http_;
+  TokenManager& tokens_;
+  Endpoint endpoint_;
+  RateLimiter* limiter_;
+};
+
+}  // namespace mpesa
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <coroutine>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mpesa/connection.hpp"
+#include "mpesa/connection_pool.hpp"
+#include "mpesa/event_loop.hpp"
+#include "mpesa/http.hpp"
+#include "mpesa/http_client.hpp"
+#include "mpesa/task.hpp"
+
+namespace mpesa {
+
+/// Coroutine HTTP/1.1 client bound to one `EventLoop`. Same keep-alive and
+/// retry rules as `HttpClient`, but nothing blocks: any number of requests
+/// can be in flight from one thread, multiplexed over at most
+/// `pool.max_connections_per_endpoint` connections per host (the rest queue
+/// for a free connection). Not thread-safe; use it from its loop only.
+class AsyncHttpClient {
+ public:
+  explicit AsyncHttpClient(EventLoop& loop, HttpClientOptions options = {});
+  AsyncHttpClient(const AsyncHttpClient&) = delete;
+  AsyncHttpClient& operator=(const AsyncHttpClient&) = delete;
+  ~AsyncHttpClient();
+
+  /// Arguments are taken by value so callers may pass temporaries.
+  Task<HttpResponse> send(Endpoint endpoint, HttpRequest request);
+  /// Same without the copies: the wire form and the response are allocated
+  /// from `arena`. `endpoint`, `request` and `arena` must outlive the task
+  /// (true when it is awaited at once) and `arena` the response.
+  Task<HttpResponse> send(const Endpoint& endpoint, const HttpRequest& request, std::pmr::memory_resource& arena) {
+    return exchange(endpoint, request, &arena);
+  }
+
+  EventLoop& loop() noexcept { return loop_; }
+  const HttpClientOptions& options() const noexcept { return options_; }
+  PoolStats stats() const noexcept { return stats_; }
+
+ private:
+  struct Waiter {
+    std::coroutine_handle<> handle;
+    std::unique_ptr<Connection> connection;
+    EventLoop::TimerId timer = 0;
+    bool timed_out = false;
+  };
+  struct Host {
+    std::vector<std::unique_ptr<Connection>> idle;
+    std::size_t open = 0;
+    std::list<Waiter*> waiters;
+    std::vector<SocketAddress> addresses;
+    Clock::time_point resolved_at{};
+    std::shared_ptr<TlsSessionSlot> session = std::make_shared<TlsSessionSlot>();
+  };
+
+  Host& host(const Endpoint& endpoint);
+  Task<HttpResponse> exchange(const Endpoint& endpoint, const HttpRequest& request, std::pmr::memory_resource* arena);
+  Task<HttpResponse> attempt(const Endpoint& endpoint, Host& host, const HttpRequest& request,
+                             std::pmr::memory_resource* arena, Clock::time_point deadline, bool& retryable);
+  Task<ConnectionPool::Lease> acquire(const Endpoint& endpoint, Host& host, Clock::time_point deadline);
+  Task<std::unique_ptr<Connection>> connect(const Endpoint& endpoint, Host& host,
+                                            Clock::time_point deadline, std::chrono::nanoseconds& resolve);
+  Task<void> wait_for_slot(Host& host, Waiter& waiter, Clock::time_point deadline);
+  EventLoop::IoAwaiter ready(Connection& connection, IoStatus status, Clock::time_point deadline);
+  void release(Host& host, std::unique_ptr<Connection> connection);
+  void discard(Host& host, std::unique_ptr<Connection> connection);
+  void close(std::unique_ptr<Connection> connection);
+
+  EventLoop& loop_;
+  HttpClientOptions options_;
+  std::optional<TlsContext> tls_;
+  std::unordered_map<Endpoint, std::unique_ptr<Host>, EndpointHash> hosts_;
+  std::vector<char> read_buffer_;
+  PoolStats stats_;
+};
+
+}  // namespace mpesa
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace mpesa {
+
+constexpr std::size_t base64_encoded_size(std::size_t n) noexcept { return (n + 2) / 3 * 4; }
+
+/// Standard (RFC 4648, padded) base64. Writes exactly
+/// `base64_encoded_size(in.size())` bytes to `out` and returns that count.
+/// Uses AVX2 for inputs of 28 bytes or more when the CPU has it.
+std::size_t base64_encode(std::string_view in, char* out) noexcept;
+/// Portable one-group-at-a-time encoder; the reference the SIMD path must
+/// match byte for byte.
+std::size_t base64_encode_scalar(std::string_view in, char* out) noexcept;
+
+std::string base64_encode(std::string_view in);
+
+}  // namespace mpesa
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "mpesa/bounded_queue.hpp"
+#include "mpesa/callbacks.hpp"
+#include "mpesa/connection.hpp"
+#include "mpesa/histogram.hpp"
+#include "mpesa/idempotency.hpp"
+
+namespace mpesa {
+
+/// One C2B confirmation on its way through a `C2BPipeline`.
+struct C2BTransaction {
+  /// The confirmation as received; `notification` views into it.
+  std::string body;
+  C2BNotification notification;
+  /// `TransAmount` in cents, set by the validate stage.
+  std::int64_t amount_cents = 0;
+  /// For the enrich step to fill, e.g. the customer account the
+  /// BillRefNumber resolves to.
+  std::string account;
+  std::uint64_t tag = 0;
+  Clock::time_point received;
+  /// When it entered its current stage's queue.
+  Clock::time_point stage_entered;
+  /// Decoded copies of fields that had JSON escapes; `notification` may
+  /// view into it.
+  std::string unescaped;
+};
+
+enum class C2BStage : std::uint8_t { kParse, kValidate, kDedupe, kEnrich, kSink };
+inline constexpr std::size_t kC2BStageCount = 5;
+const char* to_string(C2BStage stage) noexcept;
+
+/// Why a confirmation left the pipeline without reaching the sink.
+enum class C2BDropReason : std::uint8_t {
+  kMalformed,  ///< not a C2B confirmation payload
+  kInvalid,    ///< failed validation
+  kDuplicate,  ///< TransID already seen
+  /// `enrich` threw, or the sink still failed when the pipeline stopped.
+  /// Daraja has had its 200 and will not send these again, so `dropped`
+  /// is their only record: persist them there. The TransID is forgotten,
+  /// so a replay of the same confirmation is not taken for a duplicate.
+  kEnrichFailed,
+  kSinkFailed,
+};
+
+struct C2BPipelineOptions {
+  /// Confirmations in the pipeline at once; `offer` waits, then refuses,
+  /// once this many are queued or being worked on.
+  std::size_t capacity = 16'384;
+  /// Most confirmations a stage takes per round and the sink gets per call.
+  std::size_t max_batch = 256;
+  /// How long `offer` waits for room before refusing.
+  std::chrono::microseconds offer_timeout{2'000};
+  /// A batch the sink throws on is offered again after this, doubling up
+  /// to `sink_retry_max_backoff`, until the sink takes it.
+  std::chrono::milliseconds sink_retry_backoff{50};
+  std::chrono::milliseconds sink_retry_max_backoff{5'000};
+  /// Business shortcodes accepted; empty accepts any.
+  std::vector<std::string> short_codes;
+  /// TransIDs seen are recorded here; null makes the pipeline keep its own
+  /// index with default options. May be shared with a `CallbackServer`.
+  IdempotencyIndex* dedupe = nullptr;
+};
+
+struct C2BStageStats {
+  /// Confirmations that left the stage, passed on or dropped.
+  std::uint64_t processed = 0;
+  std::uint64_t dropped = 0;
+  /// Waiting in the stage's input queue.
+  std::size_t depth = 0;
+  /// Nanoseconds from entering the stage's queue to leaving the stage.
+  Histogram latency;
+};
+
+struct C2BPipelineStats {
+  std::array<C2BStageStats, kC2BStageCount> stages;
+  std::uint64_t offered = 0;
+  /// `offer` calls that timed out on a full pipeline.
+  std::uint64_t refused = 0;
+  std::uint64_t sunk = 0;
+  /// Sink calls that threw and were retried.
+  std::uint64_t sink_retries = 0;
+  std::size_t in_flight = 0;
+  /// Nanoseconds from `offer` to the sink returning.
+  Histogram end_to_end;
+
+  const C2BStageStats& stage(C2BStage s) const noexcept { return stages[static_cast<std::size_t>(s)]; }
+};
+
+/// Streaming ingestion for C2B confirmations: parse, validate, dedupe,
+/// enrich and sink, each on its own thread.
+///
+/// `offer` copies the raw body into a pooled transaction and queues it;
+/// the HTTP worker never decodes. Stages are linked by bounded lock-free
+/// rings (MPMC into parse, SPSC after that) carrying pointers into a fixed
+/// pool of `capacity` transactions, so steady-state ingestion allocates
+/// nothing and memory is bounded. When the sink falls behind, the pool
+/// empties and `offer` first waits (stalling the receiver's reads, which
+/// TCP passes back to the sender) and then refuses, which the receiver
+/// answers with 503 so Daraja redelivers.
+///
+///   C2BPipeline pipeline({.short_codes = {"600638"}}, {.sink = write_to_db});
+///   callbacks.on_c2b_confirmation_body("/mpesa/c2b/confirm",
+///                                      [&](std::string_view body) { return pipeline.offer(body); });
+///
+/// Built-in checks come first in each step: a TransID, a positive amount
+/// and an accepted shortcode; duplicates by TransID. The steps' functions
+/// run on their stage's thread and may block it; `sink` is required. A
+/// throwing `validate` counts as a rejection.
+///
+/// Every confirmation has been acknowledged by the time it is queued, so a
+/// throwing sink is retried with backoff and the batch kept until it goes
+/// through. Meanwhile the pool fills and `offer` refuses, which holds new
+/// confirmations back at Daraja. Only `stop()` gives up on a failing sink:
+/// the batch gets one more try and then goes to `dropped`.
+class C2BPipeline {
+ public:
+  struct Steps {
+    /// Extra validation after the built-in checks; false drops.
+    std::function<bool(const C2BTransaction&)> validate{};
+    std::function<void(C2BTransaction&)> enrich{};
+    /// Receives batches in arrival order; may throw to have the batch
+    /// retried.
+    std::function<void(std::span<C2BTransaction* const>)> sink{};
+    /// Called for every confirmation that does not reach the sink.
+    std::function<void(const C2BTransaction&, C2BDropReason)> dropped{};
+  };
+
+  /// Starts the stage threads. Throws `Error(kInvalidArgument)` without a
+  /// sink.
+  C2BPipeline(C2BPipelineOptions options, Steps steps);
+  C2BPipeline(const C2BPipeline&) = delete;
+  C2BPipeline& operator=(const C2BPipeline&) = delete;
+  /// `stop()`.
+  ~C2BPipeline();
+
+  /// Thread-safe. Queues `body`; false if the pipeline stayed full for
+  /// `offer_timeout` or is stopping.
+  bool offer(std::string_view body);
+  /// Stops taking offers, lets everything queued reach the sink or be
+  /// dropped, and joins the stage threads. Cuts a sink retry's backoff
+  /// short.
+  void stop();
+
+  C2BPipelineStats stats() const;
+
+ private:
+  using Item = C2BTransaction*;
+  struct Stage {
+    std::thread thread;
+    alignas(64) std::atomic<std::uint64_t> processed{0};
+    std::atomic<std::uint64_t> dropped{0};
+    mutable std::mutex mutex;
+    Histogram latency;  ///< guarded by `mutex`, taken once per batch
+  };
+
+  void run_parse();
+  void run_validate();
+  void run_dedupe();
+  void run_enrich();
+  void run_sink();
+  /// Runs `stage` over `in` until `upstream_done()` and `in` is empty.
+  /// `process` filters each batch in place, dropping what does not go on;
+  /// the rest get their latency recorded and go to `forward`.
+  template <class Queue, class Done, class Process, class Forward>
+  void drive(Stage& stage, Queue& in, Done upstream_done, Process process, Forward forward);
+  static void pass(SpscQueue<Item>& out, Item item);
+  void drop(Stage& stage, Item item, C2BDropReason reason);
+  void recycle(Item item);
+  bool valid(const C2BTransaction& t) const;
+
+  const C2BPipelineOptions options_;
+  const Steps steps_;
+  std::unique_ptr<IdempotencyIndex> own_index_;
+  IdempotencyIndex* index_;
+  std::unique_ptr<C2BTransaction[]> pool_;
+  MpmcQueue<Item> free_;
+  MpmcQueue<Item> ingress_;
+  SpscQueue<Item> to_validate_;
+  SpscQueue<Item> to_dedupe_;
+  SpscQueue<Item> to_enrich_;
+  SpscQueue<Item> to_sink_;
+  std::array<Stage, kC2BStageCount> stages_;
+  /// `done_[i]`: stage i has exited, so its output queue only drains now.
+  std::array<std::atomic<bool>, kC2BStageCount> done_{};
+  std::atomic<bool> accepting_{true};
+  std::atomic<unsigned> offering_{0};  ///< `offer` calls in progress
+  alignas(64) std::atomic<std::uint64_t> offered_{0};
+  std::atomic<std::uint64_t> refused_{0};
+  std::atomic<std::uint64_t> sunk_{0};
+  std::atomic<std::uint64_t> sink_retries_{0};
+  /// Wakes a sink retry's backoff on `stop()`.
+  std::mutex stop_mutex_;
+  std::condition_variable stop_cv_;
+  mutable std::mutex end_to_end_mutex_;
+  Histogram end_to_end_;
+  std::once_flag stopped_;
+};
+
+}  // namespace mpesa
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mpesa/callbacks.hpp"
+
+namespace mpesa {
+
+/// Accept/reject rules for C2B validation requests. Checks run in this
+/// order and the first failure decides the answer.
+struct C2BValidationRules {
+  /// BusinessShortCode must be one of these; empty accepts any (C2B00015).
+  std::vector<std::string> short_codes;
+  /// TransAmount bounds in cents, inclusive; a max of 0 means no upper
+  /// bound. An amount that does not parse is rejected (C2B00013).
+  std::int64_t min_amount_cents = 1;
+  std::int64_t max_amount_cents = 0;
+  /// MSISDNs turned away (C2B00011). Match the form Daraja sends, which may
+  /// be masked ("2547*****149").
+  std::vector<std::string> blocked_msisdns;
+  std::vector<std::string> blocked_msisdn_prefixes;
+  /// BillRefNumber must equal one of `accounts` or start with one of
+  /// `account_prefixes` (C2B00012); both empty accepts any.
+  std::vector<std::string> accounts;
+  std::vector<std::string> account_prefixes;
+  /// Customers type the account number; compare it ignoring ASCII case.
+  bool fold_account_case = true;
+};
+
+/// `C2BValidationRules` compiled for answering inside Daraja's validation
+/// timeout. Every string list becomes a flat open-addressing table over one
+/// buffer; a prefix list is a table of prefixes plus the distinct prefix
+/// lengths, so a lookup costs one probe per length rather than one compare
+/// per prefix. `decide` reads only, allocates nothing and never throws, so
+/// one validator may serve any number of threads.
+///
+///   callbacks.on_c2b_validation("/mpesa/c2b/validation",
+///                               mpesa::C2BValidator({.short_codes = {"600638"}, .accounts = open_accounts()}));
+class C2BValidator {
+ public:
+  /// Accepts everything with a positive amount.
+  C2BValidator();
+  /// Throws `Error(kInvalidArgument)` for empty strings or inverted bounds.
+  explicit C2BValidator(const C2BValidationRules& rules);
+
+  C2BValidation decide(const C2BNotification& notification) const noexcept;
+
+ private:
+  // Keys are (offset, length) into `text_`, so copies stay valid.
+  class Table {
+   public:
+    void build(const std::vector<std::string>& keys, bool fold, std::string& text);
+    bool empty() const noexcept { return count_ == 0; }
+    bool contains(std::string_view key, const std::string& text) const noexcept;
+    bool contains_prefix_of(std::string_view key, const std::string& text) const noexcept;
+
+   private:
+    struct Slot {
+      std::uint32_t hash = 0;
+      std::uint32_t offset = 0;
+      std::uint32_t length = 0;  ///< 0 = empty
+    };
+    bool find(std::string_view key, std::uint32_t hash, const std::string& text) const noexcept;
+
+    std::vector<Slot> slots_;
+    std::vector<std::uint32_t> lengths_;  ///< distinct, ascending
+    std::size_t count_ = 0;
+    bool fold_ = false;
+  };
+
+  std::string text_;
+  Table short_codes_;
+  Table blocked_msisdns_;
+  Table blocked_msisdn_prefixes_;
+  Table accounts_;
+  Table account_prefixes_;
+  std::int64_t min_cents_ = 1;
+  std::int64_t max_cents_ = 0;
+};
+
+}  // namespace mpesa
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "mpesa/c2b_validator.hpp"
+#include "mpesa/callbacks.hpp"
+#include "mpesa/idempotency.hpp"
+#include "mpesa/metrics.hpp"
+
+namespace mpesa {
+
+struct CallbackServerOptions {
+  std::string bind_address = "0.0.0.0";
+  /// 0 picks an ephemeral port; see `CallbackServer::port()`.
+  std::uint16_t port = 0;
+  /// Worker threads, each with its own epoll set (0 = one per core).
+  unsigned workers = 0;
+  /// Pin worker i to CPU i (mod the CPU count).
+  bool pin_workers = false;
+  int backlog = 4096;
+  /// Keep-alive connections silent for this long are closed.
+  std::chrono::milliseconds idle_timeout{60'000};
+  /// Receives per-route counts, result codes and decode/handling times.
+  /// Null disables recording.
+  Metrics* metrics = &Metrics::global();
+  /// When set, a callback whose CheckoutRequestID (STK), TransID (C2B
+  /// confirmation) or ConversationID (results, queue timeouts) was already
+  /// handled is acknowledged without running its handler. One whose handler
+  /// is still running elsewhere is answered 503 so Daraja retries it; the ID
+  /// counts as handled only once the handler returns, and a handler that
+  /// throws un-records it so the redelivery goes through. Validations are
+  /// never suppressed. Must outlive the server; may be shared.
+  IdempotencyIndex* idempotency = nullptr;
+};
+
+struct CallbackServerStats {
+  std::uint64_t connections_accepted = 0;
+  std::uint64_t requests = 0;
+  std::uint64_t stk_callbacks = 0;
+  std::uint64_t c2b_validations = 0;
+  std::uint64_t c2b_confirmations = 0;
+  std::uint64_t results = 0;
+  std::uint64_t timeouts = 0;
+  /// Malformed HTTP or payloads (answered 400) and unknown paths (404).
+  std::uint64_t rejected = 0;
+  /// Handlers that threw (answered 500 so Daraja may redeliver).
+  std::uint64_t handler_errors = 0;
+  /// Redeliveries acknowledged without running the handler.
+  std::uint64_t duplicates = 0;
+  /// Confirmations a body handler could not take, and redeliveries of a
+  /// callback whose handler was still running (answered 503).
+  std::uint64_t busy = 0;
+};
+
+/// Embeddable HTTP/1.1 receiver for Daraja callbacks. Each worker owns an
+/// epoll set that accepts from the shared listening socket (EPOLLEXCLUSIVE,
+/// so one connection wakes one worker) and serves its connections to
+/// completion, so a request never changes threads. Payloads are decoded into
+/// typed events and handlers run inline on the worker; keep them short and
+/// hand slow work to a queue. The acknowledgement is sent once the handler
+/// returns. Plain HTTP: terminate TLS at the load balancer in front.
+///
+/// Register handlers before `start()`; they must be thread-safe.
+class CallbackServer {
+ public:
+  using StkHandler = std::function<void(const StkCallback&)>;
+  using ValidationHandler = std::function<C2BValidation(const C2BNotification&)>;
+  using ConfirmationHandler = std::function<void(const C2BNotification&)>;
+  using ResultHandler = std::function<void(const ResultCallback&)>;
+  /// Gets the raw request body; false answers 503 so Daraja redelivers.
+  using BodyHandler = std::function<bool(std::string_view body)>;
+
+  explicit CallbackServer(CallbackServerOptions options = {});
+  CallbackServer(const CallbackServer&) = delete;
+  CallbackServer& operator=(const CallbackServer&) = delete;
+  ~CallbackServer();
+
+  /// Routes are matched on the exact request path (query string ignored).
+  void on_stk_callback(std::string path, StkHandler handler);
+  void on_c2b_validation(std::string path, ValidationHandler handler);
+  /// Validation answered by compiled rules instead of a handler: no
+  /// callback, no allocation, and a reply rendered once up front.
+  void on_c2b_validation(std::string path, C2BValidator validator);
+  void on_c2b_confirmation(std::string path, ConfirmationHandler handler);
+  /// Confirmations handed over undecoded, e.g. to `C2BPipeline::offer`,
+  /// which parses and dedupes them off the worker thread. The body view is
+  /// only valid during the call. `idempotency` is not consulted.
+  void on_c2b_confirmation_body(std::string path, BodyHandler handler);
+  void on_result(std::string path, ResultHandler handler);
+  void on_queue_timeout(std::string path, ResultHandler handler);
+
+  /// Binds and starts the workers. Throws `Error(kConnect)` if binding fails.
+  void start();
+  /// Stops accepting, closes all connections and joins the workers.
+  void stop();
+
+  std::uint16_t port() const noexcept { return port_; }
+  unsigned workers() const noexcept { return static_cast<unsigned>(workers_.size()); }
+  CallbackServerStats stats() const noexcept;
+
+ private:
+  enum class Kind { kStk, kValidation, kValidationRules, kConfirmation, kConfirmationBody, kResult, kTimeout };
+  struct Route {
+    std::string path;
+    Kind kind;
+    StkHandler stk;
+    ValidationHandler validation;
+    ConfirmationHandler confirmation;
+    ResultHandler result;
+    BodyHandler body;
+    C2BValidator rules;
+  };
+  struct Worker;
+  struct Peer;
+
+  static MetricEndpoint metric_endpoint(Kind kind) noexcept;
+  void add_route(Route route);
+  const Route* find_route(std::string_view path) const noexcept;
+  void run_worker(Worker& worker);
+  void accept_ready(Worker& worker);
+  /// These return false once the peer has been closed.
+  bool read_ready(Worker& worker, Peer& peer);
+  bool flush(Worker& worker, Peer& peer);
+  void handle(Worker& worker, Peer& peer);
+  void close(Worker& worker, Peer& peer);
+  void sweep_idle(Worker& worker);
+
+  CallbackServerOptions options_;
+  std::vector<Route> routes_;
+  int listen_fd_ = -1;
+  int stop_fd_ = -1;
+  std::uint16_t port_ = 0;
+  std::atomic<bool> running_{false};
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+}  // namespace mpesa
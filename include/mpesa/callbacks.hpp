@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include "mpesa/json.hpp"
+
+namespace mpesa {
+
+// Payloads Daraja POSTs back to the URLs given in requests. Fields are views
+// into the request body and are valid only while the handler runs; copy
+// what must outlive it. Absent optional fields are empty.
+
+/// STK Push outcome, posted to the request's `CallBackURL`.
+struct StkCallback {
+  std::string_view merchant_request_id;
+  std::string_view checkout_request_id;
+  /// 0 = paid; e.g. 1032 = cancelled by the customer, 1037 = unreachable.
+  int result_code = 0;
+  std::string_view result_desc;
+  // `CallbackMetadata` items, present when the payment succeeded.
+  std::string_view amount;
+  std::string_view mpesa_receipt_number;
+  std::string_view transaction_date;  ///< YYYYMMDDHHMMSS
+  std::string_view phone_number;
+
+  bool succeeded() const noexcept { return result_code == 0; }
+};
+
+/// C2B payment, posted to the validation URL (before completion, when
+/// external validation is enabled) and to the confirmation URL.
+struct C2BNotification {
+  std::string_view transaction_type;
+  std::string_view trans_id;
+  std::string_view trans_time;
+  std::string_view trans_amount;
+  std::string_view business_short_code;
+  std::string_view bill_ref_number;
+  std::string_view invoice_number;
+  std::string_view org_account_balance;
+  std::string_view third_party_trans_id;
+  std::string_view msisdn;
+  std::string_view first_name;
+  std::string_view middle_name;
+  std::string_view last_name;
+};
+
+/// Answer to a C2B validation request. Rejections carry Daraja's codes.
+enum class C2BValidation {
+  kAccept,
+  kRejectMsisdn,       ///< C2B00011
+  kRejectAccount,      ///< C2B00012
+  kRejectAmount,       ///< C2B00013
+  kRejectKyc,          ///< C2B00014
+  kRejectShortCode,    ///< C2B00015
+  kRejectOther,        ///< C2B00016
+};
+
+/// JSON body Daraja expects in reply to a validation request.
+std::string_view validation_response_body(C2BValidation decision) noexcept;
+/// Its `ResultCode`: "0" or "C2B000xx".
+std::string_view validation_result_code(C2BValidation decision) noexcept;
+
+/// A `TransAmount` ("10", "10.5", "10.00") in cents; -1 if it is not a
+/// plain non-negative amount with at most two decimals.
+std::int64_t parse_amount_cents(std::string_view amount) noexcept;
+
+struct ResultParameter {
+  std::string_view key;
+  std::string_view value;
+};
+
+/// Outcome of B2C, B2B, transaction status, account balance and reversal
+/// requests, posted to `ResultURL` (and, on queue timeout, `QueueTimeOutURL`).
+struct ResultCallback {
+  static constexpr std::size_t kMaxParameters = 24;
+
+  int result_type = 0;
+  int result_code = 0;
+  std::string_view result_desc;
+  std::string_view originator_conversation_id;
+  std::string_view conversation_id;
+  std::string_view transaction_id;
+  std::array<ResultParameter, kMaxParameters> parameter_storage{};
+  std::size_t parameter_count = 0;
+
+  bool succeeded() const noexcept { return result_code == 0; }
+  /// `ResultParameters.ResultParameter[]`, in payload order. Entries past
+  /// `kMaxParameters` are dropped.
+  std::span<const ResultParameter> parameters() const noexcept {
+    return {parameter_storage.data(), parameter_count};
+  }
+  /// Value of the named parameter, or empty.
+  std::string_view parameter(std::string_view key) const noexcept;
+};
+
+/// Decode a callback body straight into the event, without building a DOM.
+/// Views point into the reader's input (or its scratch buffer for strings
+/// with escapes), so both must outlive the event. Throw `Error(kParse)` on
+/// malformed JSON or when a required member is missing.
+void read_callback(json::Reader& reader, StkCallback& out);
+void read_callback(json::Reader& reader, C2BNotification& out);
+void read_callback(json::Reader& reader, ResultCallback& out);
+
+}  // namespace mpesa
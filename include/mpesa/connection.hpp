@@ -0,0 +1,103 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "mpesa/endpoint.hpp"
+#include "mpesa/tls.hpp"
+
+struct ssl_st;
+
+namespace mpesa {
+
+using Clock = std::chrono::steady_clock;
+
+struct SocketAddress {
+  sockaddr_storage storage{};
+  socklen_t length = 0;
+};
+
+/// Blocking name resolution. Throws `Error(kResolve)`.
+std::vector<SocketAddress> resolve(const Endpoint& endpoint);
+
+/// Where the time to establish a connection went.
+struct ConnectTimings {
+  std::chrono::nanoseconds connect{0};
+  std::chrono::nanoseconds tls{0};
+  bool tls_resumed = false;
+};
+
+/// Outcome of one non-blocking step: finished, or blocked until the socket
+/// becomes readable / writable.
+enum class IoStatus { kDone, kWantRead, kWantWrite };
+
+/// One TCP (optionally TLS) connection over a non-blocking socket.
+///
+/// The `*_step` primitives never block; they are driven either by the
+/// deadline-bounded blocking wrappers below (poll(2)) or by the event loop in
+/// `AsyncHttpClient`. Failures throw `Error`.
+class Connection {
+ public:
+  /// Creates a socket and starts connecting to `address`. Returns
+  /// `kWantWrite` in `status` while the connect is in progress.
+  static std::unique_ptr<Connection> start(const Endpoint& endpoint, const SocketAddress& address,
+                                           IoStatus& status);
+
+  /// Blocking: connects to the first reachable address and completes the
+  /// TLS handshake when `tls` is non-null. `session` receives resumable
+  /// sessions and supplies one to resume from, if present.
+  static std::unique_ptr<Connection> open(const Endpoint& endpoint,
+                                          const std::vector<SocketAddress>& addresses,
+                                          const TlsContext* tls,
+                                          std::shared_ptr<TlsSessionSlot> session,
+                                          Clock::time_point deadline);
+
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+  ~Connection();
+
+  /// Call once the socket is writable after `start` returned `kWantWrite`.
+  void finish_connect();
+  void start_tls(const TlsContext& tls, std::shared_ptr<TlsSessionSlot> session);
+  IoStatus handshake_step();
+  /// Writes as much of `data` as the socket takes and drops it from `data`.
+  IoStatus write_step(std::string_view& data);
+  /// On `kDone`, `n` holds the bytes read; 0 means orderly end of stream.
+  IoStatus read_step(char* buffer, std::size_t capacity, std::size_t& n);
+
+  void write_all(std::string_view data, Clock::time_point deadline);
+  /// Returns 0 on orderly end of stream.
+  std::size_t read_some(char* buffer, std::size_t capacity, Clock::time_point deadline);
+
+  /// Non-blocking check run before an idle connection is reused: false if
+  /// the peer closed it or sent unsolicited bytes.
+  bool idle_healthy();
+
+  int fd() const noexcept { return fd_; }
+  const Endpoint& endpoint() const noexcept { return endpoint_; }
+  const ConnectTimings& timings() const noexcept { return timings_; }
+  ConnectTimings& timings() noexcept { return timings_; }
+  Clock::time_point last_used() const noexcept { return last_used_; }
+  void touch() noexcept { last_used_ = Clock::now(); }
+  std::uint64_t requests_served() const noexcept { return requests_; }
+  void count_request() noexcept { ++requests_; }
+
+ private:
+  Connection(Endpoint endpoint, int fd) : endpoint_(std::move(endpoint)), fd_(fd) {}
+
+  void wait(IoStatus status, Clock::time_point deadline) const;
+
+  Endpoint endpoint_;
+  int fd_ = -1;
+  ssl_st* ssl_ = nullptr;
+  std::shared_ptr<TlsSessionSlot> session_;
+  ConnectTimings timings_;
+  Clock::time_point last_used_ = Clock::now();
+  std::uint64_t requests_ = 0;
+};
+
+}  // namespace mpesa
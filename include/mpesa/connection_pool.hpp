@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "mpesa/connection.hpp"
+#include "mpesa/endpoint.hpp"
+#include "mpesa/tls.hpp"
+
+namespace mpesa {
+
+struct PoolOptions {
+  TlsOptions tls;
+  /// When false every request opens (and closes) its own connection.
+  bool keep_alive = true;
+  /// Idle connections kept per endpoint; extras are closed on release.
+  std::size_t max_idle_per_endpoint = 64;
+  /// Cap on open connections per endpoint for `AsyncHttpClient`; further
+  /// requests queue for a free connection (0 = unbounded). The blocking pool
+  /// is bounded by its calling threads instead.
+  std::size_t max_connections_per_endpoint = 64;
+  /// Idle connections older than this are closed instead of reused. Keep it
+  /// below the server's keep-alive timeout to avoid racing its close.
+  std::chrono::milliseconds idle_timeout{30'000};
+  std::chrono::milliseconds connect_timeout{10'000};
+  /// Resolved addresses are reused for this long before resolving again.
+  std::chrono::milliseconds dns_ttl{60'000};
+};
+
+struct PoolStats {
+  std::uint64_t connections_opened = 0;
+  std::uint64_t full_handshakes = 0;
+  std::uint64_t resumed_handshakes = 0;
+  std::uint64_t reused = 0;
+  std::uint64_t discarded_stale = 0;
+  std::uint64_t dns_lookups = 0;
+};
+
+/// Keep-alive connection pool, one idle stack per endpoint. Connections are
+/// handed out exclusively and returned with `release`. Idle connections are
+/// reused most-recently-used first so the warmest sockets stay busy and the
+/// rest age out. Thread-safe.
+class ConnectionPool {
+ public:
+  explicit ConnectionPool(PoolOptions options = {});
+  ConnectionPool(const ConnectionPool&) = delete;
+  ConnectionPool& operator=(const ConnectionPool&) = delete;
+  ~ConnectionPool();
+
+  struct Lease {
+    std::unique_ptr<Connection> connection;
+    bool reused = false;
+    /// Time spent resolving the host for a new connection (zero on reuse or
+    /// DNS cache hit).
+    std::chrono::nanoseconds resolve{0};
+  };
+
+  /// Returns a healthy idle connection or opens a new one.
+  Lease acquire(const Endpoint& endpoint, Clock::time_point deadline);
+
+  /// Returns a connection that finished a request cleanly and may be reused.
+  void release(std::unique_ptr<Connection> connection);
+
+  /// Closes all idle connections and forgets cached sessions and addresses.
+  void clear();
+
+  PoolStats stats() const noexcept;
+  const PoolOptions& options() const noexcept { return options_; }
+
+ private:
+  struct HostPool {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Connection>> idle;
+    std::vector<SocketAddress> addresses;
+    Clock::time_point resolved_at{};
+    std::shared_ptr<TlsSessionSlot> session = std::make_shared<TlsSessionSlot>();
+  };
+
+  HostPool& host(const Endpoint& endpoint);
+
+  PoolOptions options_;
+  std::optional<TlsContext> tls_;
+  std::mutex hosts_mutex_;
+  std::unordered_map<Endpoint, std::unique_ptr<HostPool>, EndpointHash> hosts_;
+
+  std::atomic<std::uint64_t> opened_{0};
+  std::atomic<std::uint64_t> full_handshakes_{0};
+  std::atomic<std::uint64_t> resumed_handshakes_{0};
+  std::atomic<std::uint64_t> reused_{0};
+  std::atomic<std::uint64_t> stale_{0};
+  std::atomic<std::uint64_t> dns_lookups_{0};
+};
+
+}  // namespace mpesa
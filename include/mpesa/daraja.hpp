@@ -0,0 +1,321 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "mpesa/error.hpp"
+#include "mpesa/http.hpp"
+#include "mpesa/metrics.hpp"
+
+namespace mpesa {
+
+// Request and response shapes for the Daraja operations, shared by the
+// blocking `DarajaClient` and the coroutine-based `AsyncDarajaClient`.
+// Shortcodes and MSISDNs are carried as strings; amounts are whole shillings.
+
+/// Lipa na M-Pesa Online (STK Push). `Password` and `Timestamp` are derived
+/// from `passkey` when the request is sent.
+struct StkPushRequest {
+  std::string business_short_code;
+  std::string passkey;
+  std::string transaction_type = "CustomerPayBillOnline";
+  std::int64_t amount = 0;
+  std::string party_a;
+  std::string party_b;
+  std::string phone_number;
+  std::string callback_url;
+  std::string account_reference;
+  std::string transaction_desc;
+  /// "YYYYMMDDHHMMSS" in Kenyan time; filled in at send time when empty.
+  std::string timestamp;
+};
+
+struct StkPushResponse {
+  std::string merchant_request_id;
+  std::string checkout_request_id;
+  std::string response_code;
+  std::string response_description;
+  std::string customer_message;
+  bool accepted() const noexcept { return response_code == "0"; }
+};
+
+struct StkQueryRequest {
+  std::string business_short_code;
+  std::string passkey;
+  std::string checkout_request_id;
+  std::string timestamp;
+};
+
+struct StkQueryResponse {
+  std::string response_code;
+  std::string response_description;
+  std::string merchant_request_id;
+  std::string checkout_request_id;
+  std::string result_code;
+  std::string result_desc;
+};
+
+struct C2BRegisterUrlRequest {
+  std::string short_code;
+  /// What M-Pesa does when validation is unreachable: "Completed" or "Cancelled".
+  std::string response_type = "Completed";
+  std::string confirmation_url;
+  std::string validation_url;
+};
+
+struct C2BSimulateRequest {
+  std::string short_code;
+  std::string command_id = "CustomerPayBillOnline";
+  std::int64_t amount = 0;
+  std::string msisdn;
+  std::string bill_ref_number;
+};
+
+struct B2CRequest {
+  /// Optional caller-chosen correlation ID, echoed in the result callback.
+  std::string originator_conversation_id;
+  std::string initiator_name;
+  std::string security_credential;
+  /// "SalaryPayment", "BusinessPayment" or "PromotionPayment".
+  std::string command_id = "BusinessPayment";
+  std::int64_t amount = 0;
+  std::string party_a;
+  std::string party_b;
+  std::string remarks;
+  std::string queue_timeout_url;
+  std::string result_url;
+  std::string occasion;
+};
+
+struct B2BRequest {
+  std::string initiator;
+  std::string security_credential;
+  /// e.g. "BusinessPayBill" or "BusinessBuyGoods".
+  std::string command_id = "BusinessPayBill";
+  std::string sender_identifier_type = "4";
+  std::string receiver_identifier_type = "4";
+  std::int64_t amount = 0;
+  std::string party_a;
+  std::string party_b;
+  std::string account_reference;
+  std::string requester;
+  std::string remarks;
+  std::string queue_timeout_url;
+  std::string result_url;
+};
+
+struct TransactionStatusRequest {
+  std::string initiator;
+  std::string security_credential;
+  std::string command_id = "TransactionStatusQuery";
+  std::string transaction_id;
+  std::string original_conversation_id;
+  std::string party_a;
+  std::string identifier_type = "4";
+  std::string result_url;
+  std::string queue_timeout_url;
+  std::string remarks;
+  std::string occasion;
+};
+
+struct AccountBalanceRequest {
+  std::string initiator;
+  std::string security_credential;
+  std::string command_id = "AccountBalance";
+  std::string party_a;
+  std::string identifier_type = "4";
+  std::string remarks;
+  std::string queue_timeout_url;
+  std::string result_url;
+};
+
+struct ReversalRequest {
+  std::string initiator;
+  std::string security_credential;
+  std::string command_id = "TransactionReversal";
+  std::string transaction_id;
+  std::int64_t amount = 0;
+  std::string receiver_party;
+  std::string receiver_identifier_type = "11";
+  std::string result_url;
+  std::string queue_timeout_url;
+  std::string remarks;
+  std::string occasion;
+};
+
+/// Synchronous acknowledgement for operations whose outcome arrives later on
+/// a callback (B2C, B2B, Transaction Status, Account Balance, Reversal) and
+/// for the C2B register/simulate calls.
+struct AcceptedResponse {
+  std::string originator_conversation_id;
+  std::string conversation_id;
+  std::string response_code;
+  std::string response_description;
+  bool accepted() const noexcept { return response_code == "0"; }
+};
+
+/// Maps a request type to its path, metrics label and response type.
+template <class Request>
+struct Operation;
+
+template <>
+struct Operation<StkPushRequest> {
+  static constexpr std::string_view kPath = "/mpesa/stkpush/v1/processrequest";
+  static constexpr MetricEndpoint kMetric = MetricEndpoint::kStkPush;
+  using Response = StkPushResponse;
+};
+template <>
+struct Operation<StkQueryRequest> {
+  static constexpr std::string_view kPath = "/mpesa/stkpushquery/v1/query";
+  static constexpr MetricEndpoint kMetric = MetricEndpoint::kStkQuery;
+  using Response = StkQueryResponse;
+};
+template <>
+struct Operation<C2BRegisterUrlRequest> {
+  static constexpr std::string_view kPath = "/mpesa/c2b/v1/registerurl";
+  static constexpr MetricEndpoint kMetric = MetricEndpoint::kC2BRegisterUrl;
+  using Response = AcceptedResponse;
+};
+template <>
+struct Operation<C2BSimulateRequest> {
+  static constexpr std::string_view kPath = "/mpesa/c2b/v1/simulate";
+  static constexpr MetricEndpoint kMetric = MetricEndpoint::kC2BSimulate;
+  using Response = AcceptedResponse;
+};
+template <>
+struct Operation<B2CRequest> {
+  static constexpr std::string_view kPath = "/mpesa/b2c/v1/paymentrequest";
+  static constexpr MetricEndpoint kMetric = MetricEndpoint::kB2C;
+  using Response = AcceptedResponse;
+};
+template <>
+struct Operation<B2BRequest> {
+  static constexpr std::string_view kPath = "/mpesa/b2b/v1/paymentrequest";
+  static constexpr MetricEndpoint kMetric = MetricEndpoint::kB2B;
+  using Response = AcceptedResponse;
+};
+template <>
+struct Operation<TransactionStatusRequest> {
+  static constexpr std::string_view kPath = "/mpesa/transactionstatus/v1/query";
+  static constexpr MetricEndpoint kMetric = MetricEndpoint::kTransactionStatus;
+  using Response = AcceptedResponse;
+};
+template <>
+struct Operation<AccountBalanceRequest> {
+  static constexpr std::string_view kPath = "/mpesa/accountbalance/v1/query";
+  static constexpr MetricEndpoint kMetric = MetricEndpoint::kAccountBalance;
+  using Response = AcceptedResponse;
+};
+template <>
+struct Operation<ReversalRequest> {
+  static constexpr std::string_view kPath = "/mpesa/reversal/v1/request";
+  static constexpr MetricEndpoint kMetric = MetricEndpoint::kReversal;
+  using Response = AcceptedResponse;
+};
+
+constexpr std::size_t kTimestampSize = 14;
+
+/// Daraja timestamp ("YYYYMMDDHHMMSS", East Africa Time) for `when`.
+std::string daraja_timestamp(std::chrono::system_clock::time_point when);
+/// Writes the `kTimestampSize` characters of the timestamp to `out`.
+void write_daraja_timestamp(std::chrono::system_clock::time_point when, char* out) noexcept;
+
+/// `base64(shortcode + passkey + timestamp)`.
+std::string stk_password(std::string_view short_code, std::string_view passkey,
+                         std::string_view timestamp);
+/// Appends the STK password to `out`, staging the raw bytes in a per-thread
+/// buffer.
+void append_stk_password(std::string& out, std::string_view short_code, std::string_view passkey,
+                         std::string_view timestamp);
+
+/// JSON request bodies, appended to `out`. Nothing is allocated beyond
+/// growing `out`, so a buffer reused across requests settles at zero
+/// allocations per body.
+void write_body(const StkPushRequest& request, std::string& out);
+void write_body(const StkQueryRequest& request, std::string& out);
+void write_body(const C2BRegisterUrlRequest& request, std::string& out);
+void write_body(const C2BSimulateRequest& request, std::string& out);
+void write_body(const B2CRequest& request, std::string& out);
+void write_body(const B2BRequest& request, std::string& out);
+void write_body(const TransactionStatusRequest& request, std::string& out);
+void write_body(const AccountBalanceRequest& request, std::string& out);
+void write_body(const ReversalRequest& request, std::string& out);
+
+/// Builds the POST for `path` with bearer auth and a JSON body.
+HttpRequest make_api_request(std::string_view path, std::string_view access_token, std::string_view body);
+/// Same, into `out` with an empty body, reusing the storage of its strings
+/// and header list.
+void reset_api_request(HttpRequest& out, std::string_view path, std::string_view access_token);
+
+/// Decodes a Daraja reply. Throws `ApiError` for non-200 statuses and
+/// `Error(kParse)` for malformed bodies.
+void read_response(const HttpResponse& response, StkPushResponse& out);
+void read_response(const HttpResponse& response, StkQueryResponse& out);
+void read_response(const HttpResponse& response, AcceptedResponse& out);
+
+/// Body of `request` in this thread's scratch buffer, valid until the next
+/// call on the same thread.
+template <class Request>
+std::string_view render_body(const Request& request) {
+  thread_local std::string buffer;
+  buffer.clear();
+  write_body(request, buffer);
+  return buffer;
+}
+
+/// Fills `out` for `request`. A long-lived `out` (one per thread, say), or
+/// one on the call's arena, serializes without touching the heap once its
+/// buffers have grown.
+template <class Request>
+void build_api_request(const Request& request, std::string_view access_token, HttpRequest& out) {
+  reset_api_request(out, Operation<Request>::kPath, access_token);
+  out.body.assign(render_body(request));
+}
+
+template <class Request>
+HttpRequest make_api_request(const Request& request, std::string_view access_token) {
+  HttpRequest out;
+  build_api_request(request, access_token, out);
+  return out;
+}
+
+template <class Request>
+typename Operation<Request>::Response decode_response(const HttpResponse& response) {
+  typename Operation<Request>::Response out;
+  read_response(response, out);
+  return out;
+}
+
+namespace detail {
+inline std::string_view result_code(const StkPushResponse& r) noexcept { return r.response_code; }
+inline std::string_view result_code(const StkQueryResponse& r) noexcept {
+  return r.result_code.empty() ? r.response_code : r.result_code;
+}
+inline std::string_view result_code(const AcceptedResponse& r) noexcept { return r.response_code; }
+}  // namespace detail
+
+/// `decode_response`, also timing the decode and counting the HTTP status
+/// and the reply's result code (or a rejection's `errorCode`) in `metrics`
+/// when it is non-null.
+template <class Request>
+typename Operation<Request>::Response decode_response(const HttpResponse& response, Metrics* metrics) {
+  if (metrics == nullptr) return decode_response<Request>(response);
+  constexpr MetricEndpoint endpoint = Operation<Request>::kMetric;
+  metrics->count_code(endpoint, CodeKind::kHttpStatus, response.status);
+  const auto started = Clock::now();
+  typename Operation<Request>::Response out;
+  try {
+    read_response(response, out);
+  } catch (const ApiError& e) {
+    metrics->count_code(endpoint, CodeKind::kResult, e.error_code());
+    throw;
+  }
+  metrics->record(Phase::kParse, Clock::now() - started);
+  metrics->count_code(endpoint, CodeKind::kResult, detail::result_code(out));
+  return out;
+}
+
+}  // namespace mpesa
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <exception>
+#include <thread>
+
+#include "mpesa/arena.hpp"
+#include "mpesa/daraja.hpp"
+#include "mpesa/endpoint.hpp"
+#include "mpesa/error.hpp"
+#include "mpesa/http_client.hpp"
+#include "mpesa/rate_limiter.hpp"
+#include "mpesa/token_manager.hpp"
+
+namespace mpesa {
+
+/// Blocking Daraja client. Each call takes the cached token, sends one
+/// request over the shared connection pool and decodes the reply; a 401 drops
+/// the token and retries once (the request was not processed). Thread-safe.
+/// With a `RateLimiter`, each call first sleeps until its lane's slot.
+class DarajaClient {
+ public:
+  DarajaClient(HttpClient& http, TokenManager& tokens, Endpoint endpoint, RateLimiter* limiter = nullptr)
+      : http_(http), tokens_(tokens), endpoint_(std::move(endpoint)), limiter_(limiter) {}
+
+  StkPushResponse stk_push(const StkPushRequest& r) { return call(r); }
+  StkQueryResponse stk_query(const StkQueryRequest& r) { return call(r); }
+  AcceptedResponse c2b_register_urls(const C2BRegisterUrlRequest& r) { return call(r); }
+  AcceptedResponse c2b_simulate(const C2BSimulateRequest& r) { return call(r); }
+  AcceptedResponse b2c(const B2CRequest& r) { return call(r); }
+  AcceptedResponse b2b(const B2BRequest& r) { return call(r); }
+  AcceptedResponse transaction_status(const TransactionStatusRequest& r) { return call(r); }
+  AcceptedResponse account_balance(const AccountBalanceRequest& r) { return call(r); }
+  AcceptedResponse reversal(const ReversalRequest& r) { return call(r); }
+
+  template <class Request>
+  typename Operation<Request>::Response call(const Request& request) {
+    if (limiter_ == nullptr) return send(request);
+    RateLane& lane = limiter_->lane(Operation<Request>::kMetric, shortcode_of(request));
+    const Clock::duration wait = lane.admit();
+    if (wait > Clock::duration::zero()) std::this_thread::sleep_for(wait);
+    try {
+      auto out = send(request);
+      lane.succeeded();
+      return out;
+    } catch (...) {
+      lane.completed(std::current_exception());
+      throw;
+    }
+  }
+
+  const Endpoint& endpoint() const noexcept { return endpoint_; }
+  RateLimiter* limiter() const noexcept { return limiter_; }
+
+ private:
+  template <class Request>
+  typename Operation<Request>::Response send(const Request& request) {
+    Metrics* const metrics = http_.options().metrics;
+    CallTimer timer(metrics, Operation<Request>::kMetric);
+    AccessToken token = tokens_.get();
+    // Reused per thread so steady-state serialization does not allocate.
+    thread_local HttpRequest http_request;
+    build_api_request(request, token.value(), http_request);
+    // The reply lives only until it is decoded.
+    Arena<> arena;
+    HttpResponse response = http_.send(endpoint_, http_request, &arena);
+    if (response.status == 401) {
+      tokens_.invalidate(token);
+      token = tokens_.get();
+      // build_api_request puts Authorization first.
+      http_request.headers[0].value.assign("Bearer ").append(token.value());
+      response = http_.send(endpoint_, http_request, &arena);
+    }
+    auto out = decode_response<Request>(response, metrics);
+    timer.succeeded();
+    return out;
+  }
+
+  HttpClient& http_;
+  TokenManager& tokens_;
+  Endpoint endpoint_;
+  RateLimiter* limiter_;
+};
+
+}  // namespace mpesa
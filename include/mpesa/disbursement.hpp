@@ -0,0 +1,230 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mpesa/async_daraja_client.hpp"
+#include "mpesa/callbacks.hpp"
+#include "mpesa/histogram.hpp"
+#include "mpesa/journal.hpp"
+#include "mpesa/task.hpp"
+
+namespace mpesa {
+
+struct DisbursementOptions {
+  /// B2C requests in flight at once, over the client's connection pool.
+  unsigned concurrency = 16;
+  /// Submission rate cap in requests per second (0 = unpaced). Set it to
+  /// the app's Daraja quota.
+  double max_rate = 0;
+  /// Attempts per transfer, including the first.
+  unsigned max_attempts = 4;
+  /// Delay before the first retry, doubled for each further one. A throttled
+  /// reply also holds back every worker for this long.
+  std::chrono::milliseconds retry_backoff{250};
+  /// Prefix for the OriginatorConversationIDs given to transfers that lack
+  /// one ("<prefix>-<index>", suffixed if a caller already used it). Empty
+  /// picks one from the clock; keep it stable to make re-running the same
+  /// batch safe.
+  std::string id_prefix;
+  /// When set, each transfer is journaled and durable before its first
+  /// attempt, acknowledgements and outcomes are journaled as they arrive,
+  /// and unconfirmed transfers stay in flight there for a Transaction
+  /// Status query. Not owned.
+  RequestJournal* journal = nullptr;
+};
+
+enum class DisbursementStatus {
+  kPending,    ///< Not yet accepted by Daraja.
+  kAccepted,   ///< Accepted; waiting for the result callback.
+  kSucceeded,  ///< Result callback with ResultCode 0.
+  kFailed,     ///< Result callback with a non-zero ResultCode.
+  kRejected,   ///< Refused by the API or never sent; no callback will come.
+  /// Sent, but the reply was lost (timeout, dropped connection, 5xx), so
+  /// Daraja may have paid. Not retried; check it with a Transaction Status
+  /// query. A result callback that does arrive still settles it.
+  kUnconfirmed,
+};
+
+const char* to_string(DisbursementStatus status) noexcept;
+
+struct Disbursement {
+  B2CRequest request;
+  DisbursementStatus status = DisbursementStatus::kPending;
+  unsigned attempts = 0;
+  std::string conversation_id;
+  int result_code = 0;
+  std::string result_desc;
+  std::string transaction_id;
+  /// Last submission error, for rejected and unconfirmed transfers.
+  std::string error;
+  Clock::time_point submitted_at{};  ///< first attempt
+  Clock::time_point accepted_at{};
+  Clock::time_point completed_at{};
+};
+
+struct DisbursementReport {
+  std::size_t total = 0;
+  std::array<std::size_t, 6> by_status{};  ///< indexed by DisbursementStatus
+  std::uint64_t attempts = 0;
+  std::uint64_t retries = 0;
+  /// Replies that were 429 or a Daraja spike-arrest/quota error.
+  std::uint64_t throttled = 0;
+  /// From the start of the run to the last acceptance or rejection.
+  std::chrono::duration<double> submit_time{};
+  /// From the start of the run to the latest result callback.
+  std::chrono::duration<double> completion_time{};
+  /// First attempt to acceptance by the API, in nanoseconds.
+  Histogram accept_latency;
+  /// First attempt to result callback, in nanoseconds.
+  Histogram completion_latency;
+
+  std::size_t count(DisbursementStatus status) const noexcept {
+    return by_status[static_cast<std::size_t>(status)];
+  }
+  /// Transfers accepted per second of submission.
+  double accept_rate() const noexcept;
+  /// Result callbacks per second since the start of the run.
+  double completion_rate() const noexcept;
+};
+
+/// Pulls the next transfer into `out`; false at the end of the batch.
+using DisbursementSource = std::function<bool(B2CRequest& out)>;
+
+/// Streams transfers from CSV. The first line names the columns: `PartyB`
+/// and `Amount` (whole shillings) are required; `Remarks`, `Occasion`,
+/// `CommandID` and `OriginatorConversationID` are optional. Other fields come
+/// from `defaults`. Fields may be double-quoted ("" escapes a quote) but not
+/// span lines. Throws `Error(kParse)` naming the line on malformed input.
+class CsvDisbursementSource {
+ public:
+  CsvDisbursementSource(std::istream& in, B2CRequest defaults);
+
+  bool operator()(B2CRequest& out);
+
+ private:
+  enum class Column { kPartyB, kAmount, kRemarks, kOccasion, kCommandId, kOriginatorId };
+
+  void read_header();
+
+  std::istream& in_;
+  B2CRequest defaults_;
+  std::vector<Column> columns_;
+  std::vector<std::string> fields_;
+  std::string line_;
+  std::size_t line_number_ = 0;
+};
+
+/// Bulk B2C payouts over an `AsyncDarajaClient`.
+///
+/// `run` pulls transfers from a source and keeps `concurrency` requests in
+/// flight, paced to `max_rate`. Only failures that leave no doubt the
+/// transfer did not happen are retried, with backoff: those before the
+/// request was sent (resolve, connect, TLS, no free connection) and
+/// throttling replies. A B2C that was sent and then timed out, lost its
+/// connection or drew a 5xx may have been paid, so it is never resent; it
+/// ends `kUnconfirmed`, in flight in the journal, for a status query. Each
+/// transfer carries an OriginatorConversationID that stays the same across
+/// attempts, to match its result callback; a transfer whose ID repeats an
+/// earlier one in the batch is rejected without being sent.
+///
+/// Results arrive asynchronously: feed `on_result` from the
+/// `CallbackServer`'s result route (it is thread-safe) and it matches each
+/// callback to its transfer by OriginatorConversationID or ConversationID.
+///
+/// server.on_result("/b2c/result", [&](const ResultCallback& r) { engine.on_result(r); });
+/// DisbursementReport submitted = loop.sync_wait(engine.run(CsvDisbursementSource(file, defaults)));
+/// engine.wait_for_results(std::chrono::minutes(5));
+class DisbursementEngine {
+ public:
+  explicit DisbursementEngine(AsyncDarajaClient& daraja, DisbursementOptions options = {});
+  DisbursementEngine(const DisbursementEngine&) = delete;
+  DisbursementEngine& operator=(const DisbursementEngine&) = delete;
+
+  /// Submits everything `source` yields, on the client's loop. Completes
+  /// once each transfer is accepted or rejected; an exception from the
+  /// source stops the intake and is rethrown after in-flight requests end.
+  Task<DisbursementReport> run(DisbursementSource source);
+  Task<DisbursementReport> run(std::vector<B2CRequest> batch);
+
+  /// Records a B2C result callback. Any thread. Returns false when the
+  /// callback belongs to no transfer of this engine.
+  bool on_result(const ResultCallback& result);
+
+  /// Blocks until every accepted transfer has its result, or `timeout`.
+  /// Returns true if nothing is left outstanding.
+  bool wait_for_results(std::chrono::milliseconds timeout);
+
+  DisbursementReport report() const;
+  /// Calls `fn` for each transfer in intake order, under the engine's lock.
+  void visit(const std::function<void(const Disbursement&)>& fn) const;
+
+ private:
+  struct Failure {
+    bool retry = false;
+    bool throttled = false;
+    /// Daraja refused the request or it was never sent, so no money moved.
+    bool settled = false;
+    std::string message;
+  };
+  struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const noexcept { return std::hash<std::string_view>{}(s); }
+  };
+  struct JoinAwaiter {
+    DisbursementEngine& engine;
+    bool await_ready() const noexcept { return engine.running_ == 0; }
+    void await_suspend(std::coroutine_handle<> h) noexcept { engine.join_ = h; }
+    void await_resume() const noexcept {}
+  };
+
+  Task<void> worker(DisbursementSource& source);
+  Task<void> submit(std::size_t index);
+  std::size_t add(B2CRequest request);
+  Clock::time_point reserve_slot();
+  void accept(std::size_t index, const AcceptedResponse& response);
+  void reject(std::size_t index, std::string reason);
+  void unconfirmed(std::size_t index, std::string reason);
+  void set_status(Disbursement& item, DisbursementStatus status);
+  static Failure classify(std::exception_ptr error);
+
+  AsyncDarajaClient& daraja_;
+  DisbursementOptions options_;
+
+  // Shared with callback threads.
+  mutable std::mutex mutex_;
+  std::condition_variable results_cv_;
+  std::deque<Disbursement> items_;
+  std::unordered_map<std::string, std::size_t, StringHash, std::equal_to<>> index_;  ///< conversation IDs -> items_
+  std::array<std::size_t, 6> by_status_{};
+  std::uint64_t attempts_ = 0;
+  std::uint64_t retries_ = 0;
+  std::uint64_t throttled_ = 0;
+  bool submitting_ = false;
+  Clock::time_point started_{};
+  Clock::time_point submitted_{};
+  Clock::time_point last_result_{};
+  Histogram accept_latency_;
+  Histogram completion_latency_;
+
+  // Loop thread only.
+  Clock::time_point next_slot_{};
+  unsigned running_ = 0;
+  std::coroutine_handle<> join_{};
+  bool source_done_ = false;
+  std::exception_ptr source_error_;
+};
+
+}  // namespace mpesa
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace mpesa {
+
+/// Host the SDK talks to. Connections are pooled per endpoint.
+struct Endpoint {
+  std::string host;
+  std::uint16_t port = 443;
+  bool tls = true;
+
+  friend bool operator==(const Endpoint&, const Endpoint&) = default;
+
+  std::string authority() const {
+    const bool default_port = (tls && port == 443) || (!tls && port == 80);
+    return default_port ? host : host + ":" + std::to_string(port);
+  }
+};
+
+enum class Environment { kSandbox, kProduction };
+
+/// Daraja's host for each environment, fixed at compile time.
+template <Environment E>
+struct EnvironmentTraits;
+
+template <>
+struct EnvironmentTraits<Environment::kSandbox> {
+  static constexpr std::string_view kHost = "sandbox.safaricom.co.ke";
+};
+template <>
+struct EnvironmentTraits<Environment::kProduction> {
+  static constexpr std::string_view kHost = "api.safaricom.co.ke";
+};
+
+template <Environment E>
+Endpoint endpoint_for() {
+  return Endpoint{std::string(EnvironmentTraits<E>::kHost), 443, true};
+}
+
+inline Endpoint endpoint_for(Environment env) {
+  return env == Environment::kProduction ? endpoint_for<Environment::kProduction>()
+                                         : endpoint_for<Environment::kSandbox>();
+}
+
+struct EndpointHash {
+  std::size_t operator()(const Endpoint& e) const noexcept {
+    return std::hash<std::string>{}(e.host) ^ (std::size_t{e.port} << 1) ^ (e.tls ? 0x9e37u : 0u);
+  }
+};
+
+}  // namespace mpesa
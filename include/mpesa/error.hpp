@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+namespace mpesa {
+
+/// Broad classification of SDK failures, so callers can decide whether a
+/// failed call is worth retrying without parsing messages.
+enum class ErrorCode {
+  kInvalidArgument,
+  kResolve,
+  kConnect,
+  kTls,
+  kTimeout,
+  kConnectionClosed,
+  kProtocol,
+  kHttpStatus,
+  kParse,
+  kAuth,
+  kInternal,
+  /// Refused locally without sending: circuit breaker open or rate limit.
+  kUnavailable,
+};
+
+const char* to_string(ErrorCode code) noexcept;
+
+/// The single exception type thrown by the SDK.
+class Error : public std::runtime_error {
+ public:
+  Error(ErrorCode code, const std::string& message)
+      : std::runtime_error(std::string(to_string(code)) + ": " + message), code_(code) {}
+
+  ErrorCode code() const noexcept { return code_; }
+
+  /// True for failures that happened before the peer could have acted on the
+  /// request (name resolution, connect, TLS, a local refusal) or that are
+  /// plain timeouts.
+  bool transient() const noexcept {
+    return code_ == ErrorCode::kResolve || code_ == ErrorCode::kConnect ||
+           code_ == ErrorCode::kTls || code_ == ErrorCode::kTimeout ||
+           code_ == ErrorCode::kConnectionClosed || code_ == ErrorCode::kUnavailable;
+  }
+
+  /// True if the request may have reached the peer: the failure came after
+  /// the HTTP client started writing it, so a timeout or lost connection
+  /// says nothing about whether it was carried out. Such a POST must not be
+  /// resent blindly.
+  bool sent() const noexcept { return sent_; }
+  void set_sent(bool sent) noexcept { sent_ = sent; }
+
+ private:
+  ErrorCode code_;
+  bool sent_ = false;
+};
+
+/// Non-2xx reply from Daraja. `error_code` and `request_id` come from the
+/// `errorCode` / `requestId` members of the error body when present
+/// (e.g. "404.001.03").
+class ApiError : public Error {
+ public:
+  ApiError(int http_status, std::string error_code, const std::string& message,
+           std::string request_id = {})
+      : Error(ErrorCode::kHttpStatus, "HTTP " + std::to_string(http_status) +
+                                          (error_code.empty() ? "" : " " + error_code) + ": " + message),
+        http_status_(http_status),
+        error_code_(std::move(error_code)),
+        request_id_(std::move(request_id)) {}
+
+  int http_status() const noexcept { return http_status_; }
+  const std::string& error_code() const noexcept { return error_code_; }
+  const std::string& request_id() const noexcept { return request_id_; }
+
+ private:
+  int http_status_;
+  std::string error_code_;
+  std::string request_id_;
+};
+
+inline const char* to_string(ErrorCode code) noexcept {
+  switch (code) {
+    case ErrorCode::kInvalidArgument: return "invalid argument";
+    case ErrorCode::kResolve: return "resolve";
+    case ErrorCode::kConnect: return "connect";
+    case ErrorCode::kTls: return "tls";
+    case ErrorCode::kTimeout: return "timeout";
+    case ErrorCode::kConnectionClosed: return "connection closed";
+    case ErrorCode::kProtocol: return "protocol";
+    case ErrorCode::kHttpStatus: return "http status";
+    case ErrorCode::kParse: return "parse";
+    case ErrorCode::kAuth: return "auth";
+    case ErrorCode::kInternal: return "internal";
+    case ErrorCode::kUnavailable: return "unavailable";
+  }
+  return "unknown";
+}
+
+}  // namespace mpesa
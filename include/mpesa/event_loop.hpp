@@ -0,0 +1,229 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "mpesa/connection.hpp"
+#include "mpesa/task.hpp"
+
+namespace mpesa {
+
+/// Single-threaded epoll reactor that drives coroutines: socket readiness,
+/// timers, cross-thread posts and a helper thread for the few calls that
+/// must block (DNS, cold token fetches).
+///
+/// Everything except `post` and `stop` must be called on the thread running
+/// `run()` (or before it starts). To use several cores, run one loop per
+/// core, each with its own `AsyncHttpClient`.
+class EventLoop {
+ public:
+  using TimerId = std::uint64_t;
+  enum class Io { kRead, kWrite };
+
+  EventLoop();
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+  ~EventLoop();
+
+  /// Processes events until `stop()`. Rethrows the first exception that
+  /// escaped a spawned task.
+  void run();
+  /// Thread-safe. Makes `run()` return after the current iteration.
+  void stop();
+  /// Thread-safe. Runs `fn` on the loop thread.
+  void post(std::function<void()> fn);
+  /// Loop thread only. Resumes `h` on the next iteration, without a syscall.
+  void schedule(std::coroutine_handle<> h) { scheduled_.push_back(h); }
+
+  TimerId call_at(Clock::time_point when, std::function<void()> fn);
+  TimerId call_after(Clock::duration delay, std::function<void()> fn) {
+    return call_at(Clock::now() + delay, std::move(fn));
+  }
+  /// No-op if the timer already fired.
+  void cancel(TimerId id) noexcept;
+
+  /// Starts `task` now; it runs until its first suspension before this
+  /// returns. Exceptions escaping it are rethrown from `run()`.
+  void spawn(Task<void> task);
+
+  /// Runs the loop until `task` completes and returns its result. The loop
+  /// must not already be running.
+  template <class T>
+  T sync_wait(Task<T> task);
+
+  /// Number of spawned tasks that have not finished.
+  std::size_t active_tasks() const noexcept { return active_tasks_; }
+
+  struct SleepAwaiter {
+    EventLoop& loop;
+    Clock::time_point when;
+    bool await_ready() const noexcept { return when <= Clock::now(); }
+    void await_suspend(std::coroutine_handle<> h) {
+      loop.call_at(when, [h] { h.resume(); });
+    }
+    void await_resume() const noexcept {}
+  };
+
+  SleepAwaiter sleep_until(Clock::time_point when) { return {*this, when}; }
+  SleepAwaiter sleep_for(Clock::duration delay) { return {*this, Clock::now() + delay}; }
+
+  struct IoAwaiter {
+    EventLoop& loop;
+    int fd;
+    Io io;
+    Clock::time_point deadline;
+    std::coroutine_handle<> handle{};
+    TimerId timer = 0;
+    bool ready = false;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+      handle = h;
+      loop.add_io_waiter(this);
+    }
+    /// True once the fd is ready, false if `deadline` passed first.
+    bool await_resume() const noexcept { return ready; }
+  };
+
+  IoAwaiter wait_io(int fd, Io io, Clock::time_point deadline = Clock::time_point::max()) {
+    return IoAwaiter{*this, fd, io, deadline};
+  }
+  /// Must be called before closing an fd that was passed to `wait_io`.
+  void forget_fd(int fd) noexcept;
+
+  template <class F>
+  auto run_blocking(F fn);
+
+ private:
+  struct FdState {
+    IoAwaiter* reader = nullptr;
+    IoAwaiter* writer = nullptr;
+    std::uint32_t registered = 0;
+    bool added = false;
+  };
+  struct TimerEntry {
+    Clock::time_point when;
+    TimerId id;
+    bool operator>(const TimerEntry& o) const noexcept { return when > o.when; }
+  };
+  struct Unit {};
+
+  template <class R, class F>
+  struct BlockingAwaiter {
+    using Stored = std::conditional_t<std::is_void_v<R>, Unit, R>;
+    EventLoop& loop;
+    F fn;
+    std::variant<std::monostate, Stored, std::exception_ptr> result{};
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+      loop.submit_blocking([this, h] {
+        try {
+          if constexpr (std::is_void_v<R>) {
+            fn();
+            result.template emplace<1>();
+          } else {
+            result.template emplace<1>(fn());
+          }
+        } catch (...) {
+          result.template emplace<2>(std::current_exception());
+        }
+        loop.post([h] { h.resume(); });
+      });
+    }
+    R await_resume() {
+      if (result.index() == 2) std::rethrow_exception(std::get<2>(result));
+      if constexpr (!std::is_void_v<R>) return std::move(std::get<1>(result));
+    }
+  };
+
+  template <class T>
+  struct SyncState {
+    std::optional<std::conditional_t<std::is_void_v<T>, Unit, T>> value;
+    std::exception_ptr error;
+    bool done = false;
+  };
+
+  template <class T>
+  static Task<void> complete_into(Task<T> task, SyncState<T>* state, EventLoop* loop);
+
+  void add_io_waiter(IoAwaiter* waiter);
+  void set_interest(int fd, FdState& state, std::uint32_t wanted);
+  void dispatch_io(int fd, std::uint32_t events, std::vector<std::coroutine_handle<>>& ready);
+  void run_due_timers();
+  void drain_posted();
+  void submit_blocking(std::function<void()> job);
+  void report(std::exception_ptr error) noexcept;
+  void task_finished() noexcept { --active_tasks_; }
+
+  struct Detached;
+  static Detached run_detached(EventLoop* loop, Task<void> task);
+
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;
+  std::atomic<bool> stop_requested_{false};
+  std::exception_ptr pending_error_;
+  std::size_t active_tasks_ = 0;
+
+  std::unordered_map<int, FdState> fds_;
+  std::vector<std::coroutine_handle<>> scheduled_;
+
+  TimerId next_timer_ = 1;
+  std::vector<TimerEntry> timer_heap_;
+  std::unordered_map<TimerId, std::function<void()>> timers_;
+
+  std::mutex posted_mutex_;
+  std::vector<std::function<void()>> posted_;
+
+  std::mutex blocking_mutex_;
+  std::condition_variable blocking_cv_;
+  std::deque<std::function<void()>> blocking_jobs_;
+  bool blocking_stop_ = false;
+  std::thread blocking_thread_;
+};
+
+template <class F>
+auto EventLoop::run_blocking(F fn) {
+  using R = std::invoke_result_t<F&>;
+  return BlockingAwaiter<R, F>{*this, std::move(fn)};
+}
+
+template <class T>
+Task<void> EventLoop::complete_into(Task<T> task, SyncState<T>* state, EventLoop* loop) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      co_await std::move(task);
+      state->value.emplace();
+    } else {
+      state->value.emplace(co_await std::move(task));
+    }
+  } catch (...) {
+    state->error = std::current_exception();
+  }
+  state->done = true;
+  loop->stop();
+}
+
+template <class T>
+T EventLoop::sync_wait(Task<T> task) {
+  SyncState<T> state;
+  spawn(complete_into(std::move(task), &state, this));
+  while (!state.done) run();
+  stop_requested_.store(false, std::memory_order_relaxed);
+  if (state.error) std::rethrow_exception(state.error);
+  if constexpr (!std::is_void_v<T>) return std::move(*state.value);
+}
+
+}  // namespace mpesa
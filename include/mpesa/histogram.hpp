@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "mpesa/connection.hpp"
+
+namespace mpesa {
+
+/// Log-linear histogram of non-negative values (latencies in nanoseconds).
+/// Each power of two is split into 16 buckets, so a reported percentile is
+/// within about 6% of the true value. Fixed size, no allocation; not
+/// thread-safe (keep one per thread and `merge`).
+class Histogram {
+ public:
+  static constexpr int kSubBucketBits = 4;
+  static constexpr std::size_t kSubBuckets = std::size_t{1} << kSubBucketBits;
+  static constexpr std::size_t kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  void record(std::uint64_t value) noexcept {
+    ++counts_[bucket_of(value)];
+    ++count_;
+    sum_ += value;
+    if (value < min_) min_ = value;
+    if (value > max_) max_ = value;
+  }
+  void record(Clock::duration elapsed) noexcept {
+    record(static_cast<std::uint64_t>(elapsed.count() < 0 ? 0 : elapsed.count()));
+  }
+  void merge(const Histogram& other) noexcept;
+  /// Folds in values known only by bucket, e.g. copied from a concurrent
+  /// recorder: `counts` per bucket plus their sum, min and max.
+  void merge(std::span<const std::uint64_t, kBuckets> counts, std::uint64_t sum, std::uint64_t min,
+             std::uint64_t max) noexcept;
+  void reset() noexcept { *this = Histogram{}; }
+
+  std::uint64_t count() const noexcept { return count_; }
+  std::uint64_t min() const noexcept { return count_ == 0 ? 0 : min_; }
+  std::uint64_t max() const noexcept { return max_; }
+  std::uint64_t sum() const noexcept { return sum_; }
+  double mean() const noexcept { return count_ == 0 ? 0 : static_cast<double>(sum_) / static_cast<double>(count_); }
+  /// Upper bound of the bucket holding quantile `q` (0..1), capped at `max()`.
+  std::uint64_t percentile(double q) const noexcept;
+  /// Values in buckets that lie entirely at or below `value`.
+  std::uint64_t count_at_most(std::uint64_t value) const noexcept;
+
+  static std::size_t bucket_of(std::uint64_t value) noexcept {
+    if (value < kSubBuckets) return static_cast<std::size_t>(value);
+    const int shift = 63 - __builtin_clzll(value) - kSubBucketBits;
+    return static_cast<std::size_t>(shift + 1) * kSubBuckets +
+           static_cast<std::size_t>((value >> shift) & (kSubBuckets - 1));
+  }
+  /// Largest value that lands in `bucket`.
+  static std::uint64_t bucket_upper(std::size_t bucket) noexcept;
+
+ private:
+  std::array<std::uint64_t, kBuckets> counts_{};
+  std::uint64_t count_ = 0;
+  std::uint64_t sum_ = 0;
+  std::uint64_t min_ = UINT64_MAX;
+  std::uint64_t max_ = 0;
+};
+
+}  // namespace mpesa
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mpesa {
+
+// Messages allocate from a `std::pmr::memory_resource`: the default heap
+// unless built with one, typically an `Arena` that lives as long as the
+// exchange. Copies go back to the default resource; moves keep the source's.
+
+struct Header {
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+  Header() = default;
+  explicit Header(const allocator_type& alloc) : name(alloc), value(alloc) {}
+  Header(std::string_view name, std::string_view value, const allocator_type& alloc = {})
+      : name(name, alloc), value(value, alloc) {}
+  Header(const Header&) = default;
+  Header(Header&&) noexcept = default;
+  Header(const Header& other, const allocator_type& alloc) : name(other.name, alloc), value(other.value, alloc) {}
+  Header(Header&& other, const allocator_type& alloc)
+      : name(std::move(other.name), alloc), value(std::move(other.value), alloc) {}
+  Header& operator=(const Header&) = default;
+  Header& operator=(Header&&) = default;
+
+  std::pmr::string name;
+  std::pmr::string value;
+};
+
+using Headers = std::pmr::vector<Header>;
+
+/// Case-insensitive header lookup. Returns nullptr when absent.
+const std::pmr::string* find_header(const Headers& headers, std::string_view name) noexcept;
+
+bool iequals(std::string_view a, std::string_view b) noexcept;
+
+struct HttpRequest {
+  HttpRequest() = default;
+  explicit HttpRequest(std::pmr::memory_resource* resource)
+      : method("GET", resource), target("/", resource), headers(resource), body(resource) {}
+
+  std::pmr::string method = "GET";
+  std::pmr::string target = "/";
+  Headers headers;
+  std::pmr::string body;
+};
+
+struct HttpResponse {
+  HttpResponse() = default;
+  explicit HttpResponse(std::pmr::memory_resource* resource) : reason(resource), headers(resource), body(resource) {}
+
+  int status = 0;
+  std::pmr::string reason;
+  Headers headers;
+  std::pmr::string body;
+  /// False when the peer asked to close the connection after this message.
+  bool keep_alive = true;
+};
+
+/// Appends an HTTP/1.1 request to `out`. `Host`, `Content-Length` and
+/// `Connection` are emitted by the serializer and must not be in `headers`.
+/// `user_agent`, when non-empty, is sent unless `headers` already has one.
+void serialize_request(const HttpRequest& request, std::string_view host, bool keep_alive,
+                       std::string& out, std::string_view user_agent = {});
+/// Same, into a buffer on the exchange's arena.
+void serialize_request(const HttpRequest& request, std::string_view host, bool keep_alive,
+                       std::pmr::string& out, std::string_view user_agent = {});
+
+/// Appends an HTTP/1.1 response to `out`, adding `Content-Length` and, when
+/// `keep_alive` is false, `Connection: close`.
+void serialize_response(const HttpResponse& response, std::string& out);
+
+/// Incremental HTTP/1.1 message parser shared by the client and the server
+/// side. Bytes are fed as they arrive; the message is complete once `done()`.
+/// Supports Content-Length, chunked and read-until-close bodies. With a
+/// `resource`, the message and the buffered head are allocated from it.
+class HttpParser {
+ public:
+  enum class Kind { kRequest, kResponse };
+
+  static constexpr std::size_t kMaxHeaderBytes = 64 * 1024;
+  static constexpr std::size_t kMaxBodyBytes = 16 * 1024 * 1024;
+
+  explicit HttpParser(Kind kind, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : kind_(kind), resource_(resource), pending_(resource), request_(resource), response_(resource) {}
+
+  /// Consumes up to `size` bytes and returns how many were used. Bytes past
+  /// the end of the current message are left unconsumed. Throws
+  /// `Error(kProtocol)` on malformed input.
+  std::size_t feed(const char* data, std::size_t size);
+
+  /// Signals end of stream. Completes a read-until-close body, otherwise
+  /// throws `Error(kConnectionClosed)` if a message was in progress.
+  void finish();
+
+  /// The response to a HEAD request carries no body regardless of headers.
+  void expect_no_body() noexcept { no_body_ = true; }
+
+  bool done() const noexcept { return state_ == State::kDone; }
+  /// True once any byte of the current message has been consumed.
+  bool started() const noexcept { return started_; }
+
+  /// Valid when `done()` and `Kind::kRequest`.
+  HttpRequest& request() noexcept { return request_; }
+  /// Valid when `done()` and `Kind::kResponse`.
+  HttpResponse& response() noexcept { return response_; }
+  /// Whether the connection may carry another message after this one.
+  bool keep_alive() const noexcept { return keep_alive_; }
+
+  /// Prepares for the next message on the same connection. Nothing the
+  /// parser holds points into `resource` afterwards, so an arena behind it
+  /// may be released.
+  void reset();
+
+ private:
+  enum class State { kHeaders, kBody, kChunkSize, kChunkData, kChunkDataEnd, kTrailers, kUntilClose, kDone };
+
+  void parse_head(std::string_view head);
+  Headers& headers() noexcept { return kind_ == Kind::kRequest ? request_.headers : response_.headers; }
+  std::pmr::string& body() noexcept { return kind_ == Kind::kRequest ? request_.body : response_.body; }
+
+  Kind kind_;
+  std::pmr::memory_resource* resource_;
+  State state_ = State::kHeaders;
+  bool started_ = false;
+  bool no_body_ = false;
+  bool keep_alive_ = true;
+  std::size_t remaining_ = 0;
+  std::pmr::string pending_;
+  HttpRequest request_;
+  HttpResponse response_;
+};
+
+}  // namespace mpesa
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <memory_resource>
+#include <string>
+
+#include "mpesa/connection_pool.hpp"
+#include "mpesa/endpoint.hpp"
+#include "mpesa/http.hpp"
+#include "mpesa/metrics.hpp"
+
+namespace mpesa {
+
+struct HttpClientOptions {
+  PoolOptions pool;
+  /// Upper bound for one request, including connection setup.
+  std::chrono::milliseconds request_timeout{30'000};
+  std::string user_agent = "mpesa-cpp-sdk/0.1";
+  /// Receives connection, time-to-first-byte and exchange timings, and the
+  /// Daraja clients' call counters. Null disables recording.
+  Metrics* metrics = &Metrics::global();
+};
+
+/// Blocking HTTP/1.1 client over a keep-alive connection pool. Safe to share
+/// between threads; each call leases its own connection.
+///
+/// A request that fails on a reused connection before any response byte
+/// arrives is retried once on a fresh connection, but only for idempotent
+/// methods. POSTs (every Daraja payment call) are never resent implicitly;
+/// stale sockets are weeded out before use by the pool's health probe and
+/// `idle_timeout` instead.
+class HttpClient {
+ public:
+  explicit HttpClient(HttpClientOptions options = {});
+
+  /// Sends `request` and returns the response, whatever its status.
+  /// Throws `Error` on transport failures. The response is allocated from
+  /// `arena`, which must outlive it.
+  HttpResponse send(const Endpoint& endpoint, const HttpRequest& request,
+                    std::pmr::memory_resource* arena = std::pmr::get_default_resource());
+
+  ConnectionPool& pool() noexcept { return pool_; }
+  const HttpClientOptions& options() const noexcept { return options_; }
+
+ private:
+  HttpResponse attempt(const Endpoint& endpoint, const HttpRequest& request, std::pmr::memory_resource* arena,
+                       Clock::time_point deadline, bool& retryable);
+
+  HttpClientOptions options_;
+  ConnectionPool pool_;
+};
+
+}  // namespace mpesa
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "mpesa/connection.hpp"
+
+namespace mpesa {
+
+/// Which identifier a key is; each kind is its own key space.
+enum class IdKind : std::uint8_t {
+  kCheckoutRequestId,  ///< STK callbacks
+  kTransId,            ///< C2B confirmations
+  kConversationId,     ///< B2C/B2B/status/balance/reversal results
+  /// ConversationID of a queue-timeout notice, kept apart so the real result
+  /// that may follow is still delivered.
+  kTimeoutConversationId,
+};
+
+struct IdempotencyOptions {
+  /// Live keys the index is sized for; the table holds twice this.
+  std::size_t capacity = 1 << 20;
+  /// Independent tables, picked by key hash (rounded up to a power of two).
+  unsigned shards = 16;
+  /// How long a key suppresses duplicates. Whole seconds; Daraja redelivers
+  /// within minutes.
+  std::chrono::seconds ttl{24 * 3600};
+};
+
+/// Outcome of `IdempotencyIndex::claim`.
+enum class IdClaim : std::uint8_t {
+  kClaimed,  ///< new; recorded as pending until `commit` or `forget`
+  kPending,  ///< claimed by a delivery whose handler has not finished
+  kDone,     ///< already handled
+};
+
+struct IdempotencyStats {
+  std::uint64_t admitted = 0;
+  std::uint64_t duplicates = 0;
+  /// Keys admitted without being recorded because their probe window was
+  /// full of live keys; raise `capacity` if this moves.
+  std::uint64_t overflows = 0;
+};
+
+/// Set of recently seen callback IDs for dropping redeliveries and
+/// double-submits before any handler runs.
+///
+/// Each shard is an open-addressing table of 64-bit words packing a 35-bit
+/// key fingerprint, a pending bit and a 28-bit expiry (seconds since
+/// construction). `first_seen` and `claim` are one hash plus a short linear
+/// probe of relaxed loads and a single CAS to claim a slot: lock-free and
+/// allocation-free. Expired slots are reclaimed in place by later inserts,
+/// so there is no sweeper. Two different IDs are mistaken for each other
+/// with probability about 2^-35 per probed slot; the index is a filter in front of the handler,
+/// not a substitute for a unique constraint in the database.
+class IdempotencyIndex {
+ public:
+  explicit IdempotencyIndex(IdempotencyOptions options = {});
+  IdempotencyIndex(const IdempotencyIndex&) = delete;
+  IdempotencyIndex& operator=(const IdempotencyIndex&) = delete;
+  ~IdempotencyIndex();
+
+  /// Records `id` and returns true, or returns false if it was recorded and
+  /// has not expired. Thread-safe. Empty IDs are always admitted.
+  bool first_seen(IdKind kind, std::string_view id, Clock::time_point now = Clock::now()) noexcept;
+  /// Like `first_seen`, but a new `id` is recorded as pending, so a
+  /// concurrent duplicate can be told to retry rather than dropped; `commit`
+  /// it once handled or `forget` it if handling failed.
+  IdClaim claim(IdKind kind, std::string_view id, Clock::time_point now = Clock::now()) noexcept;
+  /// Marks a claimed `id` handled.
+  void commit(IdKind kind, std::string_view id) noexcept;
+  bool contains(IdKind kind, std::string_view id, Clock::time_point now = Clock::now()) const noexcept;
+  /// Drops `id` so a redelivery is admitted again, e.g. after the handler
+  /// failed.
+  void forget(IdKind kind, std::string_view id) noexcept;
+
+  IdempotencyStats stats() const noexcept;
+  std::size_t slots() const noexcept { return shard_count_ * shard_slots_; }
+
+ private:
+  struct Shard;
+
+  std::uint32_t seconds(Clock::time_point now) const noexcept;
+  IdClaim insert(IdKind kind, std::string_view id, Clock::time_point now, bool pending) noexcept;
+  /// Slot holding `fingerprint` in the probe window of `hash`, or null.
+  std::atomic<std::uint64_t>* find(std::uint64_t hash, std::uint64_t fingerprint, std::uint32_t now) const noexcept;
+
+  Clock::time_point epoch_;
+  std::uint32_t ttl_;
+  std::size_t shard_count_;
+  std::size_t shard_slots_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+}  // namespace mpesa
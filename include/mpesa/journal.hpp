@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "mpesa/daraja.hpp"
+#include "mpesa/metrics.hpp"
+
+namespace mpesa {
+
+struct JournalOptions {
+  /// Size of the mapped file. When appends reach the end, the journal is
+  /// compacted to the entries still in flight (and doubled if those fill
+  /// more than half of it).
+  std::size_t capacity = 64 << 20;
+  /// Longest a record waits for the committer when nobody is blocked on it.
+  std::chrono::milliseconds commit_interval{5};
+  /// msync each commit. Off, records still survive a process crash (they are
+  /// in the page cache) but not a power loss.
+  bool sync = true;
+};
+
+/// A request that was journaled but never finished.
+struct JournalEntry {
+  MetricEndpoint operation{};
+  std::string originator_conversation_id;
+  /// Empty unless Daraja's acknowledgement was journaled.
+  std::string conversation_id;
+  /// The JSON body as sent.
+  std::string body;
+
+  bool accepted() const noexcept { return !conversation_id.empty(); }
+};
+
+struct JournalStats {
+  std::uint64_t appends = 0;
+  std::uint64_t commits = 0;
+  std::uint64_t bytes = 0;
+  std::uint64_t compactions = 0;
+};
+
+/// Write-ahead journal for outbound payment requests (B2C, B2B, ...), so a
+/// crash leaves a list of payments whose outcome is unknown to re-query with
+/// Transaction Status instead of resending them.
+///
+/// Records go into a memory-mapped file: an append reserves space with one
+/// atomic add, copies the record in and publishes it by storing its length
+/// last. A committer thread msyncs the published prefix in groups, so many
+/// appends share one flush; `wait_durable` blocks until a record's group is
+/// on disk and is what to call before sending. Records carry a CRC, and
+/// reading stops at the first torn or missing one.
+///
+///   RequestJournal journal("/var/lib/payouts/b2c.journal");
+///   for (const JournalEntry& e : journal.recovered()) requery(e);
+///   journal.wait_durable(journal.submitted(MetricEndpoint::kB2C, id, render_body(b2c)));
+///   AcceptedResponse r = daraja.b2c(b2c);
+///   journal.accepted(id, r.conversation_id);
+///   ... on the result callback: journal.finished(id, result.result_code);
+class RequestJournal {
+ public:
+  /// Position of a record in the journal's history; later records have
+  /// larger tickets.
+  using Ticket = std::uint64_t;
+
+  /// Opens or creates the journal at `path`. Entries still in flight are
+  /// read back into `recovered()` and the file is rewritten to hold only
+  /// them. Throws `Error(kInternal)` on I/O failures.
+  explicit RequestJournal(std::string path, JournalOptions options = {});
+  RequestJournal(const RequestJournal&) = delete;
+  RequestJournal& operator=(const RequestJournal&) = delete;
+  /// Commits outstanding records and closes the file.
+  ~RequestJournal();
+
+  /// In-flight entries found when the journal was opened, oldest first.
+  const std::vector<JournalEntry>& recovered() const noexcept { return recovered_; }
+
+  /// Thread-safe. A request about to be sent, keyed by its
+  /// OriginatorConversationID.
+  Ticket submitted(MetricEndpoint operation, std::string_view originator_conversation_id, std::string_view body);
+  /// Daraja acknowledged the request.
+  Ticket accepted(std::string_view originator_conversation_id, std::string_view conversation_id);
+  /// The outcome is known (result callback, or a definitive rejection); the
+  /// entry is no longer in flight.
+  Ticket finished(std::string_view originator_conversation_id, int result_code);
+
+  /// Blocks until the record behind `ticket` (and everything before it) is
+  /// durable.
+  void wait_durable(Ticket ticket);
+  bool durable(Ticket ticket) const noexcept { return durable_.load(std::memory_order_acquire) >= ticket; }
+
+  const std::string& path() const noexcept { return path_; }
+  JournalStats stats() const noexcept;
+
+  /// In-flight entries of the journal at `path`, without opening it for
+  /// writing. Empty when the file does not exist.
+  static std::vector<JournalEntry> read(const std::string& path);
+
+ private:
+  Ticket append(std::uint8_t type, MetricEndpoint operation, std::string_view id, int code, std::string_view data);
+  void compact(std::size_t min_free);
+  void map(int fd, std::size_t capacity);
+  void unmap() noexcept;
+  void commit_loop();
+  /// Publishes and flushes the complete prefix; caller holds `remap_` shared.
+  void commit();
+
+  std::string path_;
+  JournalOptions options_;
+  std::vector<JournalEntry> recovered_;
+
+  // Appenders hold this shared; compaction, which swaps the file, holds it
+  // exclusively.
+  std::shared_mutex remap_;
+  int fd_ = -1;
+  char* base_ = nullptr;
+  std::size_t capacity_ = 0;
+  std::atomic<std::size_t> tail_{0};  ///< next free byte
+  std::size_t scanned_ = 0;           ///< end of the published prefix
+  std::size_t flushed_ = 0;           ///< end of the msynced prefix
+  /// Ticket of physical offset 0 in the current file.
+  std::uint64_t origin_ = 0;
+  std::atomic<Ticket> durable_{0};
+
+  std::mutex commit_mutex_;
+  std::condition_variable commit_cv_;
+  std::condition_variable durable_cv_;
+  bool waiting_ = false;
+  bool stopping_ = false;
+  std::thread committer_;
+
+  std::atomic<std::uint64_t> appends_{0};
+  std::atomic<std::uint64_t> commits_{0};
+  std::atomic<std::uint64_t> bytes_{0};
+  std::atomic<std::uint64_t> compactions_{0};
+};
+
+/// Transaction Status query for a recovered entry: `query` with its
+/// OriginalConversationID set, remaining fields (initiator, credential,
+/// URLs) as given.
+TransactionStatusRequest status_query_for(const JournalEntry& entry, TransactionStatusRequest query);
+
+}  // namespace mpesa
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mpesa {
+class Money;
+}
+
+namespace mpesa::json {
+
+/// Generic JSON document node. Numbers keep their source text so integer
+/// amounts and IDs never round-trip through `double` unless asked to.
+class Value {
+ public:
+  enum class Type { kNull, kBool, kNumber, kString, kArray, kObject };
+  struct Member;
+
+  Value() = default;
+
+  Type type() const noexcept { return type_; }
+  bool is_null() const noexcept { return type_ == Type::kNull; }
+  bool is_string() const noexcept { return type_ == Type::kString; }
+  bool is_number() const noexcept { return type_ == Type::kNumber; }
+  bool is_object() const noexcept { return type_ == Type::kObject; }
+  bool is_array() const noexcept { return type_ == Type::kArray; }
+
+  /// Accessors throw `Error(kParse)` on a type mismatch.
+  bool as_bool() const;
+  const std::string& as_string() const;
+  std::int64_t as_int64() const;
+  double as_double() const;
+  /// A string or number amount such as `"TransAmount": "10.00"` or
+  /// `"Amount": 1.00`, read exactly; see `Money::parse`.
+  Money as_money() const;
+  const std::vector<Value>& as_array() const;
+  const std::vector<Member>& as_object() const;
+
+  /// Text of a string or number, e.g. Daraja's `"ResultCode": 0` and
+  /// `"ResponseCode": "0"` both yield "0".
+  const std::string& scalar_text() const;
+
+  /// Object member lookup; nullptr if absent or not an object.
+  const Value* find(std::string_view key) const noexcept;
+  /// Like `find`, but throws `Error(kParse)` when the member is missing.
+  const Value& at(std::string_view key) const;
+
+ private:
+  friend class Parser;
+
+  Type type_ = Type::kNull;
+  bool bool_ = false;
+  std::string text_;
+  std::vector<Value> array_;
+  std::vector<Member> object_;
+};
+
+struct Value::Member {
+  std::string key;
+  Value value;
+};
+
+/// Parses a complete JSON document. Throws `Error(kParse)`.
+Value parse(std::string_view text);
+
+/// Pull parser for documents of a known shape: the caller walks the members
+/// it expects and skips the rest, so nothing is built. Strings come back as
+/// views into the input; only a string containing escapes is decoded, into
+/// the reader's scratch buffer. Views stay valid while both the input and
+/// the reader live. Throws `Error(kParse)`; skipped values are only checked
+/// for balanced brackets and quotes. See `json_schema.hpp` for the typed
+/// layer on top. The scratch buffer comes from `scratch`, the exchange's
+/// arena when there is one.
+class Reader {
+ public:
+  explicit Reader(std::string_view text,
+                  std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) noexcept
+      : begin_(text.data()), p_(text.data()), end_(text.data() + text.size()), scratch_(scratch) {}
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+
+  /// Type of the next value, without consuming it.
+  Value::Type peek();
+
+  /// `begin_object(); while (next_member(key)) { /* consume value */ }`
+  void begin_object();
+  /// Reads the next key and its ':'; false (and consumes '}') at the end.
+  bool next_member(std::string_view& key);
+  /// `begin_array(); while (next_element()) { /* consume value */ }`
+  void begin_array();
+  bool next_element();
+
+  /// String contents, or the source text of a number or bool; empty for
+  /// null. Throws on objects and arrays.
+  std::string_view scalar();
+  /// Consumes any value.
+  void skip();
+  /// Requires that only whitespace remains.
+  void finish();
+
+ private:
+  char next_char();
+  std::string_view string();
+  [[noreturn]] void fail(const char* what) const;
+
+  const char* begin_;
+  const char* p_;
+  const char* end_;
+  // True right after '{' or '[': the next member/element takes no comma.
+  bool fresh_ = false;
+  std::pmr::string scratch_;
+};
+
+/// Appends `text` to `out` as a quoted JSON string.
+void append_quoted(std::string& out, std::string_view text);
+
+}  // namespace mpesa::json
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include "mpesa/error.hpp"
+#include "mpesa/json.hpp"
+
+namespace mpesa::json {
+
+// Typed decoding on top of `Reader`. A schema is a constexpr tuple of field
+// descriptors; `read_object` unrolls the key comparisons at compile time and
+// decodes each matching member straight into the target struct. Members not
+// in the schema are skipped. Three kinds of field:
+//
+//   field("Name", &T::member)   scalar into a string_view, string or integer
+//   nested("Name", schema)      object whose members land in the same T
+//   custom("Name", fn)          fn(Reader&, T&) consumes the value
+//
+// constexpr auto kSchema = std::tuple{field("TransID", &Payment::id),
+//                                     nested("Meta", kMetaSchema)};
+// read_object(reader, payment, kSchema);
+
+template <class T, class M>
+struct MemberField {
+  std::string_view name;
+  M T::*member;
+};
+
+template <class Fields>
+struct NestedField {
+  std::string_view name;
+  Fields fields;
+};
+
+template <class T>
+struct CustomField {
+  std::string_view name;
+  void (*read)(Reader&, T&);
+};
+
+template <class T, class M>
+constexpr MemberField<T, M> field(std::string_view name, M T::*member) {
+  return {name, member};
+}
+
+template <class Fields>
+constexpr NestedField<Fields> nested(std::string_view name, Fields fields) {
+  return {name, fields};
+}
+
+template <class T>
+constexpr CustomField<T> custom(std::string_view name, void (*read)(Reader&, T&)) {
+  return {name, read};
+}
+
+/// Reads a scalar into `out`. Integers may arrive quoted ("ResultCode": "0").
+template <class M>
+void read_value(Reader& reader, M& out) {
+  if constexpr (std::is_same_v<M, std::string_view>) {
+    out = reader.scalar();
+  } else if constexpr (std::is_same_v<M, std::string>) {
+    out.assign(reader.scalar());
+  } else if constexpr (std::is_integral_v<M>) {
+    const std::string_view text = reader.scalar();
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    if (ec != std::errc() || end != text.data() + text.size()) {
+      throw Error(ErrorCode::kParse, "expected an integer, got '" + std::string(text) + "'");
+    }
+  } else {
+    static_assert(sizeof(M) == 0, "unsupported schema member type");
+  }
+}
+
+template <class T, class Fields>
+void read_object(Reader& reader, T& out, const Fields& fields);
+
+namespace detail {
+
+template <class T, class M>
+void apply(Reader& reader, T& out, const MemberField<T, M>& f) {
+  read_value(reader, out.*f.member);
+}
+
+template <class T, class Fields>
+void apply(Reader& reader, T& out, const NestedField<Fields>& f) {
+  read_object(reader, out, f.fields);
+}
+
+template <class T>
+void apply(Reader& reader, T& out, const CustomField<T>& f) {
+  f.read(reader, out);
+}
+
+}  // namespace detail
+
+/// Decodes the object at the reader's position into `out`. A null value
+/// leaves `out` untouched.
+template <class T, class Fields>
+void read_object(Reader& reader, T& out, const Fields& fields) {
+  if (reader.peek() == Value::Type::kNull) {
+    reader.skip();
+    return;
+  }
+  reader.begin_object();
+  std::string_view key;
+  while (reader.next_member(key)) {
+    const bool matched = std::apply(
+        [&](const auto&... f) { return ((key == f.name && (detail::apply(reader, out, f), true)) || ...); },
+        fields);
+    if (!matched) reader.skip();
+  }
+}
+
+/// Decodes a whole document: `read_object` plus the trailing-input check.
+template <class T, class Fields>
+void read_document(std::string_view text, T& out, const Fields& fields) {
+  Reader reader(text);
+  read_object(reader, out, fields);
+  reader.finish();
+}
+
+}  // namespace mpesa::json
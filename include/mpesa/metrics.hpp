@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mpesa/connection.hpp"
+#include "mpesa/histogram.hpp"
+
+namespace mpesa {
+
+/// Where a request's time went. Outbound calls record the first six (DNS,
+/// connect and TLS only when a new connection was opened); the callback
+/// receiver records the last two.
+enum class Phase : std::uint8_t {
+  kDns,
+  kConnect,
+  kTls,
+  kTtfb,  ///< request written to first response byte
+  kTotal,  ///< one HTTP exchange, connection setup included
+  kParse,  ///< decoding the Daraja reply
+  kCallbackParse,
+  kCallbackTotal,  ///< callback request parsed to reply queued, handler included
+};
+inline constexpr std::size_t kPhaseCount = 8;
+std::string_view to_string(Phase phase) noexcept;
+
+/// Daraja API or callback route that calls are counted for.
+enum class MetricEndpoint : std::uint8_t {
+  kOAuth,
+  kStkPush,
+  kStkQuery,
+  kC2BRegisterUrl,
+  kC2BSimulate,
+  kB2C,
+  kB2B,
+  kTransactionStatus,
+  kAccountBalance,
+  kReversal,
+  kStkCallback,
+  kC2BValidation,
+  kC2BConfirmation,
+  kResultCallback,
+  kQueueTimeout,
+};
+inline constexpr std::size_t kMetricEndpointCount = 15;
+std::string_view to_string(MetricEndpoint endpoint) noexcept;
+
+enum class CodeKind : std::uint8_t {
+  kHttpStatus,
+  /// `ResponseCode` / `ResultCode` of a reply or callback, or the `errorCode`
+  /// of a rejected call.
+  kResult,
+};
+
+struct EndpointMetrics {
+  std::uint64_t calls = 0;
+  /// Calls that threw: transport errors, non-200 replies, bad payloads and
+  /// failed callback handlers.
+  std::uint64_t failures = 0;
+  /// Summed call durations.
+  std::chrono::nanoseconds time{0};
+};
+
+struct CodeCount {
+  MetricEndpoint endpoint;
+  CodeKind kind;
+  std::string code;
+  std::uint64_t count = 0;
+};
+
+/// Every thread's recordings merged at one point in time.
+struct MetricsSnapshot {
+  std::array<Histogram, kPhaseCount> phases;
+  std::array<EndpointMetrics, kMetricEndpointCount> endpoints;
+  /// Sorted by endpoint, kind and code.
+  std::vector<CodeCount> codes;
+  /// Codes not counted because a thread's code table was full.
+  std::uint64_t codes_dropped = 0;
+
+  const Histogram& phase(Phase p) const noexcept { return phases[static_cast<std::size_t>(p)]; }
+  const EndpointMetrics& endpoint(MetricEndpoint e) const noexcept {
+    return endpoints[static_cast<std::size_t>(e)];
+  }
+  std::uint64_t code_count(MetricEndpoint endpoint, CodeKind kind, std::string_view code) const noexcept;
+};
+
+namespace detail {
+struct MetricsShard;
+}
+
+/// Latency histograms and call counters for the SDK's traffic.
+///
+/// Each recording thread gets its own shard of relaxed atomics that only it
+/// writes (a load and a store, no read-modify-write), so recording is a few
+/// nanoseconds and never contends; `snapshot` and `write_prometheus` read
+/// every shard from any thread. A shard outlives its thread and is handed to
+/// the next thread that starts recording, so memory follows the peak thread
+/// count. Clients record into `Metrics::global()` unless their options name
+/// another instance (or none).
+class Metrics {
+ public:
+  Metrics();
+  Metrics(const Metrics&) = delete;
+  Metrics& operator=(const Metrics&) = delete;
+  ~Metrics();
+
+  static Metrics& global();
+
+  void record(Phase phase, Clock::duration elapsed) noexcept;
+  /// DNS (when a lookup ran), connect and, for TLS, handshake time of a new
+  /// connection.
+  void record_connect(const ConnectTimings& timings, std::chrono::nanoseconds resolve, bool tls) noexcept;
+  void count_call(MetricEndpoint endpoint, Clock::duration elapsed, bool failed) noexcept;
+  /// Codes are cut to 15 characters; anything outside `[0-9A-Za-z._-]` is
+  /// dropped so they are safe as label values.
+  void count_code(MetricEndpoint endpoint, CodeKind kind, std::string_view code) noexcept;
+  void count_code(MetricEndpoint endpoint, CodeKind kind, int code) noexcept;
+
+  MetricsSnapshot snapshot() const;
+  /// Prometheus text exposition format, appended to `out`. Histogram bucket
+  /// counts are accurate to the recording resolution (~6%).
+  void write_prometheus(std::string& out) const;
+  std::string prometheus() const;
+
+ private:
+  detail::MetricsShard& shard() noexcept;
+  detail::MetricsShard& attach();
+
+  const std::uint64_t id_;
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<detail::MetricsShard>> shards_;
+};
+
+/// Times one call and counts it on destruction: as a failure unless
+/// `succeeded()` was called first. Does nothing when `metrics` is null.
+class CallTimer {
+ public:
+  CallTimer(Metrics* metrics, MetricEndpoint endpoint) noexcept
+      : metrics_(metrics), endpoint_(endpoint), started_(metrics ? Clock::now() : Clock::time_point{}) {}
+  CallTimer(const CallTimer&) = delete;
+  CallTimer& operator=(const CallTimer&) = delete;
+  ~CallTimer() {
+    if (metrics_ != nullptr) metrics_->count_call(endpoint_, Clock::now() - started_, !succeeded_);
+  }
+
+  void succeeded() noexcept { succeeded_ = true; }
+
+ private:
+  Metrics* metrics_;
+  MetricEndpoint endpoint_;
+  Clock::time_point started_;
+  bool succeeded_ = false;
+};
+
+}  // namespace mpesa
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mpesa {
+
+/// An amount of Kenyan shillings as a whole number of cents. Parsing and
+/// formatting work on the decimal text directly, so "1.10" is 110 cents
+/// exactly and never 110.00000000000001 by way of `double`. Arithmetic
+/// wraps on overflow, which takes more than 92 trillion shillings.
+class Money {
+ public:
+  /// Longest `format` output: "-92233720368547758.08".
+  static constexpr std::size_t kMaxFormattedSize = 21;
+
+  constexpr Money() = default;
+  static constexpr Money from_cents(std::int64_t cents) noexcept { return Money(cents); }
+  static constexpr Money from_shillings(std::int64_t shillings) noexcept {
+    return Money(wrap(static_cast<std::uint64_t>(shillings) * 100));
+  }
+
+  /// Daraja's amounts as they appear in a callback buffer, quoted or not:
+  /// "10", "10.5", "1.00", "-4510.00". An optional minus sign, then at
+  /// least one digit, then at most two decimals; no exponent, no spaces, no
+  /// "+", no ".5". Nothing for anything else or for more than 16 integer
+  /// digits.
+  static std::optional<Money> parse(std::string_view text) noexcept;
+
+  constexpr std::int64_t cents() const noexcept { return cents_; }
+  /// Whole shillings, rounded toward zero.
+  constexpr std::int64_t shillings() const noexcept { return cents_ / 100; }
+  constexpr bool is_whole() const noexcept { return cents_ % 100 == 0; }
+
+  /// Writes "1234.50" or "-0.05" (always two decimals) and returns the end.
+  /// `out` needs room for `kMaxFormattedSize` bytes.
+  char* format(char* out) const noexcept;
+  std::string to_string() const;
+
+  constexpr Money& operator+=(Money other) noexcept {
+    cents_ = wrap(static_cast<std::uint64_t>(cents_) + static_cast<std::uint64_t>(other.cents_));
+    return *this;
+  }
+  constexpr Money& operator-=(Money other) noexcept {
+    cents_ = wrap(static_cast<std::uint64_t>(cents_) - static_cast<std::uint64_t>(other.cents_));
+    return *this;
+  }
+  friend constexpr Money operator+(Money a, Money b) noexcept { return a += b; }
+  friend constexpr Money operator-(Money a, Money b) noexcept { return a -= b; }
+  constexpr Money operator-() const noexcept { return Money() - *this; }
+  friend constexpr auto operator<=>(Money, Money) noexcept = default;
+
+ private:
+  constexpr explicit Money(std::int64_t cents) noexcept : cents_(cents) {}
+  static constexpr std::int64_t wrap(std::uint64_t v) noexcept { return static_cast<std::int64_t>(v); }
+
+  std::int64_t cents_ = 0;
+};
+
+/// Parses `texts[i]` into `out[i]` and sets `valid[i]` to 1 or 0 (an invalid
+/// text leaves zero). `out` and `valid` must be large enough. Returns the
+/// number parsed.
+std::size_t parse_money(std::span<const std::string_view> texts, std::span<Money> out,
+                        std::span<std::uint8_t> valid) noexcept;
+
+/// Sum of `amounts`, four at a time with AVX2 when the CPU has it.
+Money sum(std::span<const Money> amounts) noexcept;
+/// Adds the index of every position where `a` and `b` differ to
+/// `mismatches`, comparing four at a time with AVX2 when the CPU has it;
+/// positions past the shorter span are not compared. Returns how many it
+/// added.
+std::size_t find_mismatches(std::span<const Money> a, std::span<const Money> b,
+                            std::vector<std::size_t>& mismatches);
+/// One element at a time; the references the SIMD paths must match.
+Money sum_scalar(std::span<const Money> amounts) noexcept;
+std::size_t find_mismatches_scalar(std::span<const Money> a, std::span<const Money> b,
+                                   std::vector<std::size_t>& mismatches);
+
+}  // namespace mpesa
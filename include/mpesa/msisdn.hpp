@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace mpesa {
+
+/// Length of a normalized MSISDN: "2547XXXXXXXX" or "2541XXXXXXXX".
+inline constexpr std::size_t kMsisdnSize = 12;
+
+/// Writes the form Daraja expects for a Kenyan mobile number to `out`
+/// (`kMsisdnSize` bytes, not terminated). Accepts "0712345678",
+/// "712345678", "254712345678" and "+254712345678", and the same with a
+/// leading 1 ("0110...", "2541...") for the newer prefixes. Returns false,
+/// leaving `out` unspecified, for anything else: other lengths, other
+/// country codes, separators or masked digits ("2547*****149").
+bool normalize_msisdn(std::string_view number, char* out) noexcept;
+/// The normalized number, or nothing if `number` is not valid.
+std::optional<std::string> normalize_msisdn(std::string_view number);
+
+/// Normalizes `numbers[i]` into `out[i * kMsisdnSize, (i + 1) * kMsisdnSize)`
+/// and sets `valid[i]` to 1 or 0. `out` and `valid` must be large enough.
+/// Returns the number of valid inputs. Checks two numbers per step with
+/// AVX2 when the CPU has it.
+std::size_t normalize_msisdns(std::span<const std::string_view> numbers, std::span<char> out,
+                              std::span<std::uint8_t> valid) noexcept;
+/// One number at a time; the reference the SIMD path must match.
+std::size_t normalize_msisdns_scalar(std::span<const std::string_view> numbers, std::span<char> out,
+                                     std::span<std::uint8_t> valid) noexcept;
+
+}  // namespace mpesa
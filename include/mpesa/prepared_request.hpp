@@ -0,0 +1,155 @@
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "mpesa/daraja.hpp"
+
+namespace mpesa {
+
+// Daraja `CommandID`s as types. Each names its wire value and the request it
+// belongs to, so a command used with the wrong operation fails to compile.
+namespace command {
+struct BusinessPayment {
+  static constexpr std::string_view kId = "BusinessPayment";
+  using Request = B2CRequest;
+};
+struct SalaryPayment {
+  static constexpr std::string_view kId = "SalaryPayment";
+  using Request = B2CRequest;
+};
+struct PromotionPayment {
+  static constexpr std::string_view kId = "PromotionPayment";
+  using Request = B2CRequest;
+};
+struct BusinessPayBill {
+  static constexpr std::string_view kId = "BusinessPayBill";
+  using Request = B2BRequest;
+};
+struct BusinessBuyGoods {
+  static constexpr std::string_view kId = "BusinessBuyGoods";
+  using Request = B2BRequest;
+};
+struct CustomerPayBillOnline {
+  static constexpr std::string_view kId = "CustomerPayBillOnline";
+  using Request = C2BSimulateRequest;
+};
+struct CustomerBuyGoodsOnline {
+  static constexpr std::string_view kId = "CustomerBuyGoodsOnline";
+  using Request = C2BSimulateRequest;
+};
+}  // namespace command
+
+template <class Command, class Request>
+concept CommandFor = std::same_as<typename Command::Request, Request> && requires {
+  { Command::kId } -> std::convertible_to<std::string_view>;
+};
+
+/// `request.command_id = Command::kId`, checked at compile time.
+template <class Command, class Request>
+  requires CommandFor<Command, Request>
+void set_command(Request& request) {
+  request.command_id.assign(Command::kId);
+}
+
+static_assert(CommandFor<command::SalaryPayment, B2CRequest>);
+static_assert(CommandFor<command::BusinessPayBill, B2BRequest>);
+static_assert(CommandFor<command::CustomerPayBillOnline, C2BSimulateRequest>);
+static_assert(!CommandFor<command::BusinessPayBill, B2CRequest>);
+static_assert(!CommandFor<command::SalaryPayment, B2BRequest>);
+static_assert(!CommandFor<command::CustomerBuyGoodsOnline, B2BRequest>);
+
+/// What every payout from one B2C shortcode shares.
+struct B2CSender {
+  std::string initiator_name;
+  std::string security_credential;
+  std::string party_a;
+  std::string queue_timeout_url;
+  std::string result_url;
+};
+
+namespace detail {
+/// A B2C body minus the per-payout fields, as JSON text.
+struct B2CFragments {
+  std::string head;    ///< "InitiatorName" .. "Amount":
+  std::string middle;  ///< ,"PartyA":...,"PartyB":
+  std::string tail;    ///< ,"QueueTimeOutURL" .. "Occassion":
+  std::string party_a;
+};
+/// Throws `Error(kInvalidArgument)` for a missing field, a non-numeric
+/// PartyA or a callback URL that is not http(s).
+B2CFragments render_b2c_fragments(const B2CSender& sender, std::string_view command_id);
+void write_b2c_body(const B2CFragments& fragments, std::string_view originator_conversation_id, std::int64_t amount,
+                    std::string_view party_b, std::string_view remarks, std::string_view occasion, std::string& out);
+}  // namespace detail
+
+template <class Command>
+  requires CommandFor<Command, B2CRequest>
+class B2CTemplate;
+
+/// One payout through a `B2CTemplate`, which must outlive the call. Sent
+/// like any request: `client.call(payroll.payout(...))`.
+template <class Command>
+struct B2CPayout {
+  const B2CTemplate<Command>* from = nullptr;
+  std::string_view party_a;  ///< the template's, for rate limiting
+  std::int64_t amount = 0;
+  std::string party_b;
+  std::string remarks;
+  std::string occasion;
+  std::string originator_conversation_id;
+};
+
+/// B2C requests with the command fixed by type and the sender's fields
+/// checked and rendered to JSON once, at construction. Building a payout's
+/// body is then a few appends of prepared text around the fields that
+/// change; the initiator, the ~350-byte credential and the URLs are never
+/// escaped again. Output is byte for byte what `write_body(B2CRequest)`
+/// produces.
+///
+///   const mpesa::B2CTemplate<mpesa::command::SalaryPayment> payroll(sender);
+///   co_await client.call(payroll.payout("254708374149", 1250, "October salary"));
+template <class Command>
+  requires CommandFor<Command, B2CRequest>
+class B2CTemplate {
+ public:
+  /// Throws `Error(kInvalidArgument)` for an incomplete sender.
+  explicit B2CTemplate(const B2CSender& sender) : fragments_(detail::render_b2c_fragments(sender, Command::kId)) {}
+  // Payouts point back at it.
+  B2CTemplate(const B2CTemplate&) = delete;
+  B2CTemplate& operator=(const B2CTemplate&) = delete;
+
+  /// Throws `Error(kInvalidArgument)` unless `amount` is positive and
+  /// `party_b` and `remarks` are set.
+  B2CPayout<Command> payout(std::string party_b, std::int64_t amount, std::string remarks,
+                            std::string occasion = {}, std::string originator_conversation_id = {}) const {
+    if (amount <= 0 || party_b.empty() || remarks.empty()) {
+      throw Error(ErrorCode::kInvalidArgument, "B2C payout needs PartyB, remarks and a positive amount");
+    }
+    return {this,
+            fragments_.party_a,
+            amount,
+            std::move(party_b),
+            std::move(remarks),
+            std::move(occasion),
+            std::move(originator_conversation_id)};
+  }
+
+  const detail::B2CFragments& fragments() const noexcept { return fragments_; }
+
+ private:
+  detail::B2CFragments fragments_;
+};
+
+template <class Command>
+struct Operation<B2CPayout<Command>> : Operation<B2CRequest> {};
+
+template <class Command>
+void write_body(const B2CPayout<Command>& p, std::string& out) {
+  detail::write_b2c_body(p.from->fragments(), p.originator_conversation_id, p.amount, p.party_b, p.remarks,
+                         p.occasion, out);
+}
+
+}  // namespace mpesa
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mpesa/connection.hpp"
+#include "mpesa/metrics.hpp"
+
+namespace mpesa {
+
+struct RateLimiterOptions {
+  /// Starting rate of each lane, in calls per second.
+  double initial_rate = 50;
+  double min_rate = 1;
+  /// Ceiling for the additive increase; set it to the app's Daraja quota.
+  double max_rate = 500;
+  /// Calls a lane lets through back to back before pacing starts.
+  unsigned burst = 10;
+  /// Longest a call is held back for its slot. A call that would wait
+  /// longer fails with `Error(kUnavailable)` instead of queueing.
+  std::chrono::milliseconds max_delay{2'000};
+  /// On a throttled reply the rate is multiplied by this (at most once per
+  /// `adjust_period`) and the lane pauses for `throttle_pause`.
+  double decrease = 0.5;
+  std::chrono::milliseconds throttle_pause{250};
+  /// Calls per second added after each `adjust_period` without throttling.
+  double increase = 5;
+  std::chrono::milliseconds adjust_period{1'000};
+  /// Consecutive failures (5xx other than throttling, timeouts, connection
+  /// errors) that open a lane's breaker.
+  unsigned failure_threshold = 5;
+  /// How long an open breaker fails calls before letting one probe through.
+  std::chrono::milliseconds open_time{5'000};
+  /// Lanes tracked individually; lanes beyond this share one.
+  std::size_t max_lanes = 1024;
+};
+
+enum class BreakerState : std::uint8_t {
+  kClosed,
+  kOpen,
+  kHalfOpen,  ///< open time elapsed; one probe call decides
+};
+
+const char* to_string(BreakerState state) noexcept;
+
+struct LaneStats {
+  MetricEndpoint endpoint{};
+  std::string shortcode;
+  double rate = 0;  ///< current calls per second
+  BreakerState breaker = BreakerState::kClosed;
+  std::uint64_t admitted = 0;
+  std::uint64_t delayed = 0;    ///< admitted after waiting for a slot
+  std::uint64_t rejected = 0;   ///< failed fast: breaker open or wait too long
+  std::uint64_t throttled = 0;  ///< throttled replies from Daraja
+  std::uint64_t trips = 0;      ///< times the breaker opened
+};
+
+/// Pacing and circuit breaking for one Daraja operation and shortcode.
+///
+/// The rate limiter is a token bucket kept as one atomic timestamp (GCRA):
+/// `admit` reserves the next slot with a CAS and returns how long to sleep
+/// until it. The rate adapts AIMD-style: a 429 or spike-arrest reply cuts it
+/// by `decrease` and pauses the lane, every quiet `adjust_period` adds
+/// `increase`. The breaker counts consecutive failures; once open, calls
+/// fail immediately until `open_time` has passed, then one probe call is let
+/// through and its outcome closes or reopens the breaker. Everything is
+/// atomics; no call takes a lock.
+class RateLane {
+ public:
+  RateLane(MetricEndpoint endpoint, std::string shortcode, const RateLimiterOptions& options);
+  RateLane(const RateLane&) = delete;
+  RateLane& operator=(const RateLane&) = delete;
+
+  /// Admits one call and returns how long to wait before sending it (zero
+  /// to send now). Throws `Error(kUnavailable)` when the breaker is open or
+  /// the wait would exceed `max_delay`; nothing is reserved then.
+  Clock::duration admit(Clock::time_point now = Clock::now());
+
+  /// Outcome of an admitted call; exactly one per `admit` that returned.
+  void succeeded(Clock::time_point now = Clock::now()) noexcept;
+  void throttled(Clock::time_point now = Clock::now()) noexcept;
+  void failed(Clock::time_point now = Clock::now()) noexcept;
+  /// The call ended without saying anything about Daraja's health (bad
+  /// argument, token fetch failed, ...).
+  void abandoned() noexcept;
+  /// Routes a call's exception to `throttled`, `failed` or `abandoned`.
+  /// Replies other than throttling and 5xx count as `succeeded`: Daraja
+  /// answered.
+  void completed(const std::exception_ptr& error, Clock::time_point now = Clock::now()) noexcept;
+
+  MetricEndpoint endpoint() const noexcept { return endpoint_; }
+  const std::string& shortcode() const noexcept { return shortcode_; }
+  double rate() const noexcept;
+  BreakerState breaker(Clock::time_point now = Clock::now()) const noexcept;
+  LaneStats stats() const;
+
+ private:
+  static std::int64_t ticks(Clock::time_point t) noexcept { return t.time_since_epoch().count(); }
+  void set_rate(double rate) noexcept;
+  /// Daraja answered: reset the failure count and close an open breaker.
+  void answered() noexcept;
+  [[noreturn]] void reject(const char* why);
+
+  const MetricEndpoint endpoint_;
+  const std::string shortcode_;
+  const RateLimiterOptions options_;
+
+  // Pacing, in Clock ticks.
+  alignas(64) std::atomic<std::int64_t> next_free_{0};  ///< theoretical arrival time
+  std::atomic<std::int64_t> interval_;                  ///< ticks per call
+  std::atomic<std::int64_t> last_increase_;
+  std::atomic<std::int64_t> last_decrease_{0};
+  // Breaker.
+  alignas(64) std::atomic<std::int64_t> open_until_{0};  ///< 0 while closed
+  std::atomic<std::uint32_t> failures_{0};
+  std::atomic<bool> probing_{false};
+
+  alignas(64) std::atomic<std::uint64_t> admitted_{0};
+  std::atomic<std::uint64_t> delayed_{0};
+  std::atomic<std::uint64_t> rejected_{0};
+  std::atomic<std::uint64_t> throttled_{0};
+  std::atomic<std::uint64_t> trips_{0};
+};
+
+/// The lanes of one Daraja app, keyed by operation and shortcode, so a
+/// struggling B2C shortcode does not hold back STK Push. Hand one to
+/// `DarajaClient` / `AsyncDarajaClient` and every call is paced and guarded
+/// by its lane.
+///
+/// Lanes live in a fixed open-addressing table of atomic pointers: finding
+/// one is a hash and a short probe, and a new lane is published with a CAS.
+/// Lanes are never removed.
+class RateLimiter {
+ public:
+  explicit RateLimiter(RateLimiterOptions options = {});
+  RateLimiter(const RateLimiter&) = delete;
+  RateLimiter& operator=(const RateLimiter&) = delete;
+  ~RateLimiter();
+
+  /// The lane for `endpoint` and `shortcode`, created on first use.
+  /// Thread-safe; the reference stays valid for the limiter's lifetime.
+  RateLane& lane(MetricEndpoint endpoint, std::string_view shortcode);
+
+  const RateLimiterOptions& options() const noexcept { return options_; }
+  /// Every lane in use, in no particular order.
+  std::vector<LaneStats> stats() const;
+
+ private:
+  RateLimiterOptions options_;
+  std::size_t mask_;
+  std::unique_ptr<std::atomic<RateLane*>[]> slots_;
+  std::atomic<std::size_t> lanes_{0};
+  /// Shared by everything past `max_lanes`.
+  RateLane overflow_;
+};
+
+/// Shortcode a request is made for: the business shortcode of STK and C2B
+/// calls, PartyA of B2C/B2B/status/balance, the receiver of a reversal.
+template <class Request>
+std::string_view shortcode_of(const Request& request) noexcept {
+  if constexpr (requires { request.business_short_code; }) {
+    return request.business_short_code;
+  } else if constexpr (requires { request.short_code; }) {
+    return request.short_code;
+  } else if constexpr (requires { request.party_a; }) {
+    return request.party_a;
+  } else if constexpr (requires { request.receiver_party; }) {
+    return request.receiver_party;
+  } else {
+    return {};
+  }
+}
+
+}  // namespace mpesa
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mpesa {
+
+/// One transaction line of an M-Pesa org portal statement. Views point into
+/// the `StatementFile`; quoted fields come without their quotes.
+struct StatementRow {
+  std::string_view receipt;  ///< "Receipt No.", the TransID / TransactionID
+  std::string_view completion_time;
+  std::string_view details;
+  std::string_view status;  ///< "Transaction Status", e.g. "Completed"
+  std::int64_t paid_in_cents = 0;
+  std::int64_t withdrawn_cents = 0;  ///< as a positive amount
+  std::size_t offset = 0;            ///< of the line in the file
+};
+
+/// An org portal statement CSV, memory-mapped read-only. The preamble
+/// (account holder, period, ...) is skipped up to the column header row,
+/// found by its "Receipt No." column. Rows are never copied: `read_rows`
+/// turns a piece of the mapping into `StatementRow` views, and `split`
+/// cuts the rows into line-aligned pieces so several threads can parse at
+/// once. Rows must not contain line breaks, which portal exports never do.
+class StatementFile {
+ public:
+  /// Throws `Error(kInternal)` if the file cannot be mapped and
+  /// `Error(kParse)` if it has no header row with "Receipt No.", "Paid In"
+  /// and "Withdrawn".
+  explicit StatementFile(const std::string& path);
+  StatementFile(const StatementFile&) = delete;
+  StatementFile& operator=(const StatementFile&) = delete;
+  ~StatementFile();
+
+  /// Everything after the column header row.
+  std::string_view rows_text() const noexcept { return rows_; }
+  /// `rows_text()` in at most `pieces` parts of similar size, each ending
+  /// at a line break.
+  std::vector<std::string_view> split(std::size_t pieces) const;
+  /// Appends the rows in `text`, a piece of `rows_text()`, to `out`.
+  /// Returns how many lines were skipped as malformed: too few fields, or
+  /// an amount that is not a number.
+  std::size_t read_rows(std::string_view text, std::vector<StatementRow>& out) const;
+
+ private:
+  struct Columns {
+    int receipt = -1;
+    int completion_time = -1;
+    int details = -1;
+    int status = -1;
+    int paid_in = -1;
+    int withdrawn = -1;
+    int needed = 0;  ///< fields a row must have
+  };
+
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+  std::string_view rows_;
+  Columns columns_;
+};
+
+/// A transaction the application recorded, usually from a callback: the
+/// TransID of a C2B confirmation or the TransactionID of a B2C result.
+struct LedgerEntry {
+  std::string trans_id;
+  std::int64_t amount_cents = 0;
+};
+
+enum class DiscrepancyKind : std::uint8_t {
+  kMissingFromLedger,     ///< on the statement, never recorded
+  kMissingFromStatement,  ///< recorded, not on the statement
+  kDuplicateInStatement,  ///< receipt seen again on the statement
+  kDuplicateInLedger,     ///< TransID recorded again, e.g. a redelivery handled twice
+  kAmountMismatch,
+};
+inline constexpr std::size_t kDiscrepancyKinds = 5;
+const char* to_string(DiscrepancyKind kind) noexcept;
+
+struct Discrepancy {
+  DiscrepancyKind kind;
+  std::string trans_id;
+  /// The statement row's amount (paid in, or else withdrawn); 0 if none.
+  std::int64_t statement_cents = 0;
+  std::int64_t ledger_cents = 0;
+  /// Where the statement row is, or `npos`.
+  std::size_t statement_offset = npos;
+  /// Index into the ledger, or `npos`.
+  std::size_t ledger_index = npos;
+
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+};
+
+struct ReconcileOptions {
+  /// Threads for parsing and joining (0 = one per core).
+  unsigned threads = 0;
+  /// Only rows whose Transaction Status is "Completed" take part.
+  bool completed_only = true;
+  /// Skip rows whose Details mention "Charge": the portal lists a
+  /// transaction's fee as its own row under the same receipt.
+  bool skip_charges = true;
+};
+
+struct ReconciliationReport {
+  std::size_t statement_rows = 0;  ///< taking part
+  std::size_t skipped_rows = 0;    ///< by status or as charges
+  std::size_t malformed_rows = 0;
+  std::size_t ledger_entries = 0;
+  std::size_t matched = 0;  ///< same ID and amount on both sides
+  std::array<std::size_t, kDiscrepancyKinds> counts{};  ///< by DiscrepancyKind
+  /// Sorted by TransID, then kind, statement offset and ledger index.
+  std::vector<Discrepancy> discrepancies;
+  std::chrono::duration<double> parse_time{};
+  std::chrono::duration<double> join_time{};
+
+  std::size_t count(DiscrepancyKind kind) const noexcept { return counts[static_cast<std::size_t>(kind)]; }
+};
+
+/// Matches statement receipts against `ledger` by TransID with a
+/// partitioned hash join. Each thread parses a run of the statement and
+/// files its rows and a slice of the ledger into partitions by key hash;
+/// then threads take whole partitions, build a table over the ledger side
+/// and probe it with the statement side, so no table is shared and nothing
+/// is locked. The first occurrence of a key on each side, in file and
+/// ledger order, is the one matched; later ones are reported as
+/// duplicates. The report is the same for any thread count.
+ReconciliationReport reconcile(const StatementFile& statement, std::span<const LedgerEntry> ledger,
+                               ReconcileOptions options = {});
+
+}  // namespace mpesa
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mpesa {
+
+struct InitiatorPassword {
+  std::string initiator;
+  std::string password;
+};
+
+/// Produces Daraja's `SecurityCredential` (B2C, B2B, reversal, transaction
+/// status, account balance): the initiator password RSA-encrypted (PKCS#1
+/// v1.5) with the public key of Safaricom's certificate, base64-encoded.
+///
+/// The certificate is parsed once and each initiator's credential is
+/// encrypted once and cached; a later call with the same password is a
+/// shared-lock lookup. A changed password, or a new certificate via
+/// `rotate_certificate`, causes re-encryption. Thread-safe.
+class SecurityCredentials {
+ public:
+  /// `certificate_pem` is the sandbox or production certificate from the
+  /// Daraja portal (a bare RSA public key PEM is accepted too). Throws
+  /// `Error(kInvalidArgument)` if it holds no RSA key.
+  explicit SecurityCredentials(std::string_view certificate_pem);
+  SecurityCredentials(const SecurityCredentials&) = delete;
+  SecurityCredentials& operator=(const SecurityCredentials&) = delete;
+  ~SecurityCredentials();
+
+  /// Credential for `initiator`, encrypting `password` on first use or when
+  /// it differs from the cached one.
+  std::string get(std::string_view initiator, std::string_view password);
+  /// Credential cached for `initiator`. Throws `Error(kInvalidArgument)` if
+  /// the initiator was never added.
+  std::string get(std::string_view initiator);
+
+  /// Adds or updates initiators, encrypting in one batch: one key context
+  /// per thread, spread over the cores for large batches.
+  void set(std::span<const InitiatorPassword> initiators);
+  void set(std::string_view initiator, std::string_view password);
+  void remove(std::string_view initiator);
+
+  /// Switches to a new certificate and re-encrypts every cached initiator
+  /// (as a batch) before readers see it. Throws like the constructor and
+  /// keeps the old certificate on failure.
+  void rotate_certificate(std::string_view certificate_pem);
+
+  /// One-off encryption with the current certificate, not cached. PKCS#1
+  /// padding is randomized, so every call returns a different ciphertext.
+  std::string encrypt(std::string_view password) const;
+
+  std::size_t size() const;
+  /// RSA encryptions performed so far.
+  std::uint64_t encryptions() const noexcept { return encryptions_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Key;
+  struct Entry {
+    std::string password;
+    std::string credential;
+    std::uint64_t key_generation = 0;
+  };
+  struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const noexcept { return std::hash<std::string_view>{}(s); }
+  };
+
+  static std::shared_ptr<const Key> load_key(std::string_view certificate_pem);
+  std::shared_ptr<const Key> current_key() const;
+  /// Encrypts each password into `out`, in parallel for large batches.
+  void encrypt_batch(const Key& key, std::span<const std::string_view> passwords, std::vector<std::string>& out) const;
+
+  mutable std::shared_mutex mutex_;
+  std::shared_ptr<const Key> key_;
+  std::unordered_map<std::string, Entry, StringHash, std::equal_to<>> entries_;
+  /// Serializes `rotate_certificate` against batch updates.
+  std::mutex writer_mutex_;
+  mutable std::atomic<std::uint64_t> encryptions_{0};
+};
+
+}  // namespace mpesa
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mpesa/endpoint.hpp"
+#include "mpesa/http.hpp"
+#include "mpesa/http_client.hpp"
+#include "mpesa/json.hpp"
+#include "mpesa/metrics.hpp"
+#include "mpesa/sim/https_server.hpp"
+
+namespace mpesa::sim {
+
+struct DarajaSimulatorOptions {
+  HttpsServerOptions server;
+
+  /// Credentials the OAuth endpoint accepts; empty accepts any Basic auth.
+  std::string consumer_key;
+  std::string consumer_secret;
+  std::chrono::seconds token_lifetime{3599};
+  /// Answer 401 to API calls whose bearer token was not issued here or has
+  /// expired.
+  bool check_tokens = true;
+  /// When set, STK Push and Query passwords must derive from it.
+  std::string passkey;
+
+  /// Added before every reply: `latency` plus up to `latency_jitter`.
+  std::chrono::microseconds latency{0};
+  std::chrono::microseconds latency_jitter{0};
+  /// Share of API calls answered 500 (errorCode 500.003.1001).
+  double error_rate = 0;
+  /// Share of API calls answered 429 spike arrest (errorCode 500.003.02),
+  /// on top of `max_rate`.
+  double throttle_rate = 0;
+  /// API calls per second beyond which Daraja's spike arrest answers 429
+  /// (0 = unlimited), with bursts of up to `burst` calls (0 = one second's
+  /// worth).
+  double max_rate = 0;
+  double burst = 0;
+
+  /// Delay between accepting a request and posting its outcome: `delay`
+  /// plus up to `jitter`.
+  std::chrono::milliseconds callback_delay{0};
+  std::chrono::milliseconds callback_jitter{0};
+  /// Share of outcomes that fail: STK 1032 (cancelled by user), 2001
+  /// (invalid initiator) for B2C and the other result-URL operations.
+  double failure_rate = 0;
+  /// Share of result-URL operations whose outcome goes to QueueTimeOutURL
+  /// instead.
+  double queue_timeout_rate = 0;
+  /// When set, callbacks go here (keeping the URL's path and query) instead
+  /// of to the host named in the request, so production-shaped URLs can be
+  /// used against a local receiver.
+  std::optional<Endpoint> callback_endpoint;
+  /// Client used to post callbacks; set `pool.tls.ca_pem` for a TLS
+  /// receiver. Records no metrics by default so the simulator's traffic is
+  /// not mixed with the code under test.
+  HttpClientOptions callback_client = [] {
+    HttpClientOptions o;
+    o.metrics = nullptr;
+    return o;
+  }();
+  unsigned callback_workers = 4;
+
+  std::uint64_t seed = 1;
+};
+
+struct DarajaSimulatorStats {
+  /// API calls per operation and callbacks delivered per route, indexed by
+  /// `MetricEndpoint`.
+  std::array<std::uint64_t, kMetricEndpointCount> calls{};
+  std::array<std::uint64_t, kMetricEndpointCount> callbacks{};
+  std::uint64_t unauthorized = 0;
+  std::uint64_t bad_requests = 0;
+  std::uint64_t throttled = 0;
+  std::uint64_t injected_errors = 0;
+  /// Callbacks the receiver refused (non-2xx) or could not be reached for.
+  std::uint64_t callback_failures = 0;
+
+  std::uint64_t calls_to(MetricEndpoint e) const noexcept { return calls[static_cast<std::size_t>(e)]; }
+  std::uint64_t callbacks_to(MetricEndpoint e) const noexcept { return callbacks[static_cast<std::size_t>(e)]; }
+};
+
+/// Local stand-in for the Daraja API for load tests and benchmarks.
+///
+/// Serves OAuth, STK Push and Query, C2B register/simulate, B2C, B2B,
+/// transaction status, account balance and reversal with Daraja's request
+/// checks, reply shapes and error bodies, then posts the asynchronous
+/// outcome (STK callback, C2B validation and confirmation, result or queue
+/// timeout) to the URLs given in the request after a configurable delay.
+/// Latency, injected errors, throttling and failed outcomes follow the
+/// options; randomness is seeded for repeatable runs.
+class DarajaSimulator {
+ public:
+  explicit DarajaSimulator(DarajaSimulatorOptions options = {});
+  DarajaSimulator(const DarajaSimulator&) = delete;
+  DarajaSimulator& operator=(const DarajaSimulator&) = delete;
+  ~DarajaSimulator();
+
+  /// Throws `Error(kConnect)` if binding fails.
+  void start();
+  /// Stops serving and drops callbacks not yet posted.
+  void stop();
+
+  Endpoint endpoint() const { return server_.endpoint(); }
+  const std::string& ca_pem() const noexcept { return server_.ca_pem(); }
+  HttpsServer& server() noexcept { return server_; }
+
+  DarajaSimulatorStats stats() const;
+  std::size_t pending_callbacks() const;
+  /// Waits until every scheduled callback has been posted; false if
+  /// `timeout` passed first.
+  bool drain(std::chrono::milliseconds timeout);
+
+ private:
+  struct Callback {
+    Clock::time_point due;
+    std::uint64_t sequence = 0;
+    MetricEndpoint kind{};
+    std::string url;
+    std::string body;
+    // C2B: the confirmation posted once validation accepts (or fails to
+    // answer and `confirm_on_failure` is set).
+    std::string confirmation_url;
+    bool confirm_on_failure = false;
+  };
+  struct Later {
+    bool operator()(const Callback& a, const Callback& b) const noexcept {
+      return a.due != b.due ? a.due > b.due : a.sequence > b.sequence;
+    }
+  };
+  struct StkOutcome {
+    Clock::time_point due;
+    std::string merchant_request_id;
+    int result_code = 0;
+  };
+  struct C2BUrls {
+    std::string confirmation_url;
+    std::string validation_url;
+    bool complete_on_failure = true;
+  };
+
+  HttpResponse handle(const HttpRequest& request);
+  HttpResponse oauth(const HttpRequest& request);
+  bool authorized(const HttpRequest& request);
+  bool admit();
+  HttpResponse stk_push(const json::Value& body);
+  HttpResponse stk_query(const json::Value& body);
+  HttpResponse c2b_register(const json::Value& body);
+  HttpResponse c2b_simulate(const json::Value& body);
+  HttpResponse result_operation(MetricEndpoint operation, const json::Value& body);
+
+  double uniform();
+  Clock::duration callback_delay();
+  std::uint64_t next_id() noexcept { return ids_.fetch_add(1, std::memory_order_relaxed); }
+  void count(MetricEndpoint endpoint) noexcept;
+  void schedule(Callback callback);
+  void deliver_loop();
+  /// Posts `body`; `reply` receives the response body. False on transport
+  /// errors and non-2xx statuses.
+  bool post(const std::string& url, const std::string& body, std::string* reply);
+
+  DarajaSimulatorOptions options_;
+  HttpsServer server_;
+  HttpClient callback_http_;
+  std::atomic<std::uint64_t> ids_{1};
+
+  mutable std::mutex state_mutex_;
+  std::unordered_map<std::string, Clock::time_point> tokens_;
+  std::unordered_map<std::string, StkOutcome> stk_;
+  std::unordered_map<std::string, C2BUrls> c2b_;
+  double bucket_tokens_ = 0;
+  Clock::time_point bucket_refilled_{};
+
+  std::mutex rng_mutex_;
+  std::mt19937_64 rng_;
+
+  mutable std::mutex stats_mutex_;
+  DarajaSimulatorStats stats_;
+
+  mutable std::mutex queue_mutex_;
+  std::condition_variable queue_cv_;
+  std::condition_variable idle_cv_;
+  std::priority_queue<Callback, std::vector<Callback>, Later> queue_;
+  std::uint64_t scheduled_ = 0;
+  std::size_t in_flight_ = 0;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace mpesa::sim
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+#include "mpesa/endpoint.hpp"
+#include "mpesa/http.hpp"
+#include "mpesa/tls.hpp"
+
+namespace mpesa::sim {
+
+/// PEM-encoded certificate and private key.
+struct TlsIdentity {
+  std::string cert_pem;
+  std::string key_pem;
+};
+
+/// Generates a throwaway P-256 certificate valid for `localhost` and
+/// 127.0.0.1, suitable as both server identity and client trust anchor.
+TlsIdentity generate_self_signed(const std::string& common_name = "localhost");
+
+struct HttpsServerOptions {
+  std::string bind_address = "127.0.0.1";
+  /// 0 picks an ephemeral port; see `HttpsServer::port()`.
+  std::uint16_t port = 0;
+  bool tls = true;
+  /// Close a keep-alive connection after this many requests (0 = never).
+  std::size_t max_requests_per_connection = 0;
+  std::chrono::milliseconds idle_timeout{60'000};
+};
+
+/// Minimal HTTP/1.1 (optionally TLS) server with keep-alive, used as a local
+/// stand-in for the Daraja hosts. One thread per connection: it exists to
+/// exercise the client, not to be fast.
+class HttpsServer {
+ public:
+  using Handler = std::function<HttpResponse(const HttpRequest&)>;
+
+  explicit HttpsServer(Handler handler, HttpsServerOptions options = {});
+  HttpsServer(const HttpsServer&) = delete;
+  HttpsServer& operator=(const HttpsServer&) = delete;
+  ~HttpsServer();
+
+  /// Binds and starts accepting. Throws `Error(kConnect)` if binding fails.
+  void start();
+  void stop();
+
+  std::uint16_t port() const noexcept { return port_; }
+  /// Endpoint a client should use to reach this server.
+  Endpoint endpoint() const { return Endpoint{options_.bind_address, port_, options_.tls}; }
+  /// Certificate to trust when connecting (empty for plain HTTP).
+  const std::string& ca_pem() const noexcept { return identity_.cert_pem; }
+
+  std::uint64_t connections_accepted() const noexcept { return accepted_.load(); }
+  std::uint64_t full_handshakes() const noexcept { return full_handshakes_.load(); }
+  std::uint64_t resumed_handshakes() const noexcept { return resumed_handshakes_.load(); }
+  std::uint64_t requests_served() const noexcept { return requests_.load(); }
+
+ private:
+  void accept_loop();
+  void serve(int fd);
+
+  Handler handler_;
+  HttpsServerOptions options_;
+  TlsIdentity identity_;
+  std::optional<TlsContext> tls_;
+  int listen_fd_ = -1;
+  std::uint16_t port_ = 0;
+  std::atomic<bool> running_{false};
+  std::thread acceptor_;
+
+  std::mutex conns_mutex_;
+  std::condition_variable conns_cv_;
+  std::unordered_set<int> open_fds_;
+  std::size_t active_workers_ = 0;
+
+  std::atomic<std::uint64_t> accepted_{0};
+  std::atomic<std::uint64_t> full_handshakes_{0};
+  std::atomic<std::uint64_t> resumed_handshakes_{0};
+  std::atomic<std::uint64_t> requests_{0};
+};
+
+}  // namespace mpesa::sim
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "mpesa/base64.hpp"
+#include "mpesa/daraja.hpp"
+
+namespace mpesa {
+
+/// An STK password with the timestamp it was derived from. Fixed-size so
+/// producing one never allocates.
+class StkPassword {
+ public:
+  /// Longest shortcode + passkey a generator accepts.
+  static constexpr std::size_t kMaxPrefixSize = 128;
+  static constexpr std::size_t kMaxSize = base64_encoded_size(kMaxPrefixSize + kTimestampSize);
+
+  std::string_view value() const noexcept { return {data_.data(), size_}; }
+  std::string_view timestamp() const noexcept { return {timestamp_.data(), kTimestampSize}; }
+
+ private:
+  friend class StkPasswordGenerator;
+
+  std::array<char, kMaxSize> data_;  // only the first size_ bytes are meaningful
+  std::uint32_t size_ = 0;
+  std::array<char, kTimestampSize> timestamp_;
+};
+
+/// Lipa na M-Pesa password source for one shortcode and passkey.
+///
+/// `base64(shortcode + passkey + timestamp)` only changes in its last few
+/// characters: the whole 3-byte groups of the prefix are encoded once, and
+/// the 0-2 leftover prefix bytes plus the timestamp are re-encoded when the
+/// second changes. The current second is cached in a seqlock cell, so `get`
+/// is lock-free, allocation-free and a copy of ~100 bytes in the common case.
+/// Output is identical to `stk_password(shortcode, passkey, timestamp)`.
+class StkPasswordGenerator {
+ public:
+  /// Throws `Error(kInvalidArgument)` when shortcode + passkey exceed
+  /// `StkPassword::kMaxPrefixSize`.
+  StkPasswordGenerator(std::string_view short_code, std::string_view passkey);
+  StkPasswordGenerator(const StkPasswordGenerator&) = delete;
+  StkPasswordGenerator& operator=(const StkPasswordGenerator&) = delete;
+
+  /// Password and timestamp for the second containing `when`. Thread-safe.
+  void get(StkPassword& out,
+           std::chrono::system_clock::time_point when = std::chrono::system_clock::now()) const noexcept;
+
+  bool matches(std::string_view short_code, std::string_view passkey) const noexcept;
+
+ private:
+  static constexpr std::size_t kMaxTail = base64_encoded_size(2 + kTimestampSize);
+  static constexpr std::size_t kCellWords = (kTimestampSize + kMaxTail + 7) / 8;
+
+  /// Timestamp followed by the encoded tail, as published in the cell.
+  using Cell = std::array<char, kCellWords * 8>;
+
+  void fill(Cell& cell, std::chrono::system_clock::time_point when) const noexcept;
+  void assemble(const Cell& cell, StkPassword& out) const noexcept;
+
+  std::string prefix_;  // shortcode + passkey
+  std::size_t short_code_size_ = 0;
+  std::string head_;    // base64 of the prefix's whole 3-byte groups
+  std::size_t tail_size_ = 0;
+
+  // Seqlock cell for the current second; one writer at a time (`writing_`),
+  // readers that lose the race compute their own copy.
+  mutable std::atomic<std::uint64_t> seq_{0};
+  mutable std::atomic<std::int64_t> second_{INT64_MIN};
+  mutable std::array<std::atomic<std::uint64_t>, kCellWords> words_{};
+  mutable std::atomic<bool> writing_{false};
+};
+
+}  // namespace mpesa
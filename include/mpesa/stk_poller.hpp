@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "mpesa/async_daraja_client.hpp"
+#include "mpesa/callbacks.hpp"
+#include "mpesa/daraja.hpp"
+
+namespace mpesa {
+
+struct StkPollerOptions {
+  /// Wait before the first query; most callbacks arrive well within it.
+  std::chrono::milliseconds first_poll{15'000};
+  /// Each further wait is the previous one times `backoff`, capped at
+  /// `max_interval`.
+  double backoff = 2;
+  std::chrono::milliseconds max_interval{60'000};
+  /// After this long without an outcome the payment is reported expired.
+  std::chrono::milliseconds give_up_after{180'000};
+  /// Queries in flight at once; due polls beyond it wait a tick.
+  unsigned max_in_flight = 32;
+  /// Timer wheel resolution and size. Polls are due to the nearest tick.
+  std::chrono::milliseconds tick{100};
+  std::size_t wheel_slots = 1024;
+};
+
+enum class StkOutcomeSource : std::uint8_t {
+  kCallback,
+  kQuery,
+  kExpired,  ///< neither came within `give_up_after`
+};
+
+const char* to_string(StkOutcomeSource source) noexcept;
+
+struct StkOutcome {
+  std::string checkout_request_id;
+  StkOutcomeSource source = StkOutcomeSource::kCallback;
+  /// 0 = paid, 1032 = cancelled, 1037 = unreachable, ...; -1 when expired.
+  int result_code = -1;
+  std::string result_desc;
+  /// Queries made for this payment.
+  unsigned queries = 0;
+
+  bool succeeded() const noexcept { return source != StkOutcomeSource::kExpired && result_code == 0; }
+};
+
+struct StkPollerStats {
+  std::uint64_t tracked = 0;
+  /// `track` calls for an ID already pending, folded into its entry.
+  std::uint64_t coalesced = 0;
+  std::uint64_t queries = 0;
+  /// Due polls pushed to a later tick by `max_in_flight`.
+  std::uint64_t deferred = 0;
+  std::uint64_t by_callback = 0;
+  std::uint64_t by_query = 0;
+  std::uint64_t expired = 0;
+  std::size_t pending = 0;
+};
+
+/// Falls back to STK Push Query for payments whose callback is late.
+///
+/// Pending CheckoutRequestIDs sit in a hashed timer wheel driven by one
+/// coroutine on the client's loop: each tick it takes the due slot and
+/// starts at most `max_in_flight` queries. A query that finds the payment
+/// still being processed reschedules it with backoff. The callback
+/// (`on_callback`) removes the entry in O(1); a slot entry left behind is
+/// skipped when its tick comes. No thread or timer is created per payment,
+/// and one ID tracked many times is polled once.
+///
+///   StkStatusPoller poller(daraja);
+///   callbacks.on_stk_callback("/mpesa/stk", [&](const StkCallback& cb) { poller.on_callback(cb); });
+///   StkPushResponse r = co_await daraja.stk_push(push);
+///   query.checkout_request_id = r.checkout_request_id;
+///   poller.track(query, [](const StkOutcome& o) { settle(o); });
+///
+/// Handlers run on the loop thread for query and expiry outcomes and on the
+/// caller's thread for `on_callback`, without the poller's lock held; they
+/// must not throw. The poller may be destroyed before the loop: its state
+/// lives until the wheel coroutine and in-flight queries finish.
+class StkStatusPoller {
+ public:
+  using Handler = std::function<void(const StkOutcome&)>;
+
+  /// Starts the wheel on `daraja`'s loop (posted, so any thread may
+  /// construct).
+  explicit StkStatusPoller(AsyncDarajaClient& daraja, StkPollerOptions options = {});
+  StkStatusPoller(const StkStatusPoller&) = delete;
+  StkStatusPoller& operator=(const StkStatusPoller&) = delete;
+  /// Stops polling; pending payments get no outcome.
+  ~StkStatusPoller();
+
+  /// Thread-safe. Watches `query.checkout_request_id` (the request also
+  /// carries the shortcode and passkey to query with) and calls `on_done`
+  /// once with its outcome.
+  void track(StkQueryRequest query, Handler on_done);
+  /// Thread-safe. Resolves the payment from its callback; false if it was
+  /// not pending.
+  bool on_callback(const StkCallback& callback);
+  /// Thread-safe. Stops watching without an outcome.
+  bool cancel(std::string_view checkout_request_id);
+
+  StkPollerStats stats() const;
+
+ private:
+  struct State;
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace mpesa
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "mpesa/async_daraja_client.hpp"
+#include "mpesa/daraja_client.hpp"
+
+namespace mpesa {
+
+/// What calling Daraja for one shortcode takes.
+struct TenantConfig {
+  std::string short_code;
+  /// The shortcode's Daraja app.
+  Credentials credentials;
+  /// Lipa na M-Pesa Online passkey, for STK Push and Query.
+  std::string passkey;
+  /// Initiator and its `SecurityCredential`, for B2C, B2B, transaction
+  /// status, account balance and reversal.
+  std::string initiator_name;
+  std::string security_credential;
+};
+
+/// Finds a shortcode's configuration, e.g. in a secrets store; nothing if
+/// the shortcode is unknown. May block.
+using TenantLoader = std::function<std::optional<TenantConfig>(std::string_view short_code)>;
+
+struct TenantRegistryOptions {
+  /// For each tenant's token cache. Background refresh is off: a refresher
+  /// thread per tenant costs more than letting one caller refresh ahead of
+  /// expiry, which `TokenManager` does when it has no refresher.
+  TokenManagerOptions tokens = [] {
+    TokenManagerOptions o;
+    o.background_refresh = false;
+    return o;
+  }();
+  /// For each tenant's rate limiter. A tenant needs a lane per operation it
+  /// calls, so its table is kept small.
+  RateLimiterOptions rate_limits = [] {
+    RateLimiterOptions o;
+    o.max_lanes = 32;
+    return o;
+  }();
+  /// Most tenants the registry holds.
+  std::size_t max_tenants = 4096;
+};
+
+/// One shortcode's state: its configuration, its own token cache and rate
+/// limiter, and clients over the registry's shared transport.
+class Tenant {
+ public:
+  Tenant(const Tenant&) = delete;
+  Tenant& operator=(const Tenant&) = delete;
+
+  const TenantConfig& config() const noexcept { return config_; }
+  const std::string& short_code() const noexcept { return config_.short_code; }
+  TokenManager& tokens() noexcept { return tokens_; }
+  RateLimiter& limiter() noexcept { return limiter_; }
+  DarajaClient& daraja() noexcept { return daraja_; }
+  /// Throws `Error(kInvalidArgument)` if the registry has no async client.
+  AsyncDarajaClient& async_daraja();
+
+  /// Fills in what `request` leaves empty from the tenant's configuration:
+  /// the shortcode field `shortcode_of` reads, the passkey, the initiator
+  /// and its credential. Only `std::string` fields are filled; a prepared
+  /// request such as `B2CPayout` already carries its sender's.
+  template <class Request>
+  void apply(Request& request) const {
+    const auto fill = [](auto& field, const std::string& value) {
+      if constexpr (std::same_as<std::remove_cvref_t<decltype(field)>, std::string>) {
+        if (field.empty()) field = value;
+      }
+    };
+    if constexpr (requires { request.business_short_code; }) {
+      fill(request.business_short_code, config_.short_code);
+    } else if constexpr (requires { request.short_code; }) {
+      fill(request.short_code, config_.short_code);
+    } else if constexpr (requires { request.party_a; }) {
+      fill(request.party_a, config_.short_code);
+    } else if constexpr (requires { request.receiver_party; }) {
+      fill(request.receiver_party, config_.short_code);
+    }
+    if constexpr (requires { request.passkey; }) fill(request.passkey, config_.passkey);
+    if constexpr (requires { request.initiator_name; }) fill(request.initiator_name, config_.initiator_name);
+    if constexpr (requires { request.initiator; }) fill(request.initiator, config_.initiator_name);
+    if constexpr (requires { request.security_credential; }) {
+      fill(request.security_credential, config_.security_credential);
+    }
+  }
+
+ private:
+  friend class TenantRegistry;
+
+  Tenant(TenantConfig config, HttpClient& http, AsyncHttpClient* async, const Endpoint& endpoint,
+         const TenantRegistryOptions& options);
+
+  TenantConfig config_;
+  TokenManager tokens_;
+  RateLimiter limiter_;
+  DarajaClient daraja_;
+  std::optional<AsyncDarajaClient> async_;
+};
+
+/// Daraja clients for many shortcodes over one transport.
+///
+/// Every tenant shares the registry's `HttpClient` (and so its connection
+/// pool and `Metrics`) and, when given, its `AsyncHttpClient` and event
+/// loop. What must not leak between shortcodes is per tenant: each has its
+/// own token cache, fed by its own consumer key, and its own rate limiter,
+/// so one app's throttling or open breaker leaves the others alone.
+///
+/// Tenants are created on first use from `loader`, so credentials for
+/// shortcodes that are never called are never fetched, and no token is
+/// requested until a tenant's first call. Lookups are lock-free: a hash
+/// and a short probe in a fixed open-addressing table of tenant pointers.
+/// Loading takes a mutex, so a slow loader holds up other first uses but
+/// never a lookup. Tenants stay until the registry is destroyed.
+///
+///   mpesa::TenantRegistry tenants(http, async_http, endpoint, load_from_vault);
+///   mpesa::StkPushRequest push;
+///   push.business_short_code = "600638";  // the passkey comes from the tenant
+///   ...
+///   co_await tenants.call_async(std::move(push));
+class TenantRegistry {
+ public:
+  TenantRegistry(HttpClient& http, Endpoint endpoint, TenantLoader loader, TenantRegistryOptions options = {});
+  TenantRegistry(HttpClient& http, AsyncHttpClient& async, Endpoint endpoint, TenantLoader loader,
+                 TenantRegistryOptions options = {});
+  TenantRegistry(const TenantRegistry&) = delete;
+  TenantRegistry& operator=(const TenantRegistry&) = delete;
+  ~TenantRegistry();
+
+  /// The tenant for `short_code`, loaded on first use. Throws
+  /// `Error(kInvalidArgument)` if the loader does not know the shortcode or
+  /// the registry is full, and whatever the loader throws.
+  Tenant& get(std::string_view short_code);
+  /// The tenant if it is loaded, else null. Lock-free, never loads.
+  Tenant* find(std::string_view short_code) const noexcept;
+  /// Loads a tenant up front. Returns the existing one if the shortcode is
+  /// already there; its configuration is not replaced.
+  Tenant& add(TenantConfig config);
+  std::size_t size() const noexcept { return size_.load(std::memory_order_acquire); }
+  /// Every loaded tenant, in no particular order.
+  std::vector<Tenant*> tenants() const;
+
+  /// Sends `request` as the tenant `shortcode_of(request)` names, after
+  /// `Tenant::apply`, through its blocking client.
+  template <class Request>
+  typename Operation<Request>::Response call(Request request) {
+    Tenant& tenant = get(shortcode_of(request));
+    tenant.apply(request);
+    return tenant.daraja().call(request);
+  }
+
+  /// The same through the tenant's async client. A tenant not loaded yet
+  /// is loaded on the loop's worker thread, so the loader never blocks the
+  /// loop.
+  template <class Request>
+  Task<typename Operation<Request>::Response> call_async(Request request) {
+    Tenant* tenant = find(shortcode_of(request));
+    if (tenant == nullptr) {
+      const std::string short_code(shortcode_of(request));
+      tenant = co_await async_loop().run_blocking([&] { return &get(short_code); });
+    }
+    tenant->apply(request);
+    co_return co_await tenant->async_daraja().call(std::move(request));
+  }
+
+ private:
+  Tenant& insert(TenantConfig config);
+  EventLoop& async_loop();
+
+  HttpClient& http_;
+  AsyncHttpClient* async_;
+  Endpoint endpoint_;
+  TenantLoader loader_;
+  TenantRegistryOptions options_;
+  std::size_t mask_;
+  std::unique_ptr<std::atomic<Tenant*>[]> slots_;
+  std::atomic<std::size_t> size_{0};
+  std::mutex load_mutex_;
+};
+
+}  // namespace mpesa
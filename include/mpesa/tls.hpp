@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+struct ssl_ctx_st;
+struct ssl_session_st;
+struct ssl_st;
+
+namespace mpesa {
+
+struct TlsOptions {
+  bool verify_peer = true;
+  /// PEM bundle on disk. Empty means the system trust store.
+  std::string ca_file;
+  /// In-memory PEM trust anchors, e.g. the certificate of a local stand-in
+  /// server. Used in addition to `ca_file` / the system store.
+  std::string ca_pem;
+  /// Cache session tickets per endpoint so reconnects use an abbreviated
+  /// handshake instead of a full one.
+  bool session_resumption = true;
+};
+
+/// Holds the most recent resumable session for one endpoint. OpenSSL hands
+/// sessions over through a callback that can fire long after the handshake
+/// (TLS 1.3 tickets arrive post-handshake), so connections share ownership.
+class TlsSessionSlot {
+ public:
+  TlsSessionSlot() = default;
+  TlsSessionSlot(const TlsSessionSlot&) = delete;
+  TlsSessionSlot& operator=(const TlsSessionSlot&) = delete;
+  ~TlsSessionSlot();
+
+  /// Takes ownership of `session`.
+  void store(ssl_session_st* session);
+  /// Returns a new reference the caller must free, or nullptr.
+  ssl_session_st* get1() const;
+  void clear();
+
+ private:
+  mutable std::mutex mutex_;
+  ssl_session_st* session_ = nullptr;
+};
+
+/// Shared, immutable SSL_CTX wrapper.
+class TlsContext {
+ public:
+  static TlsContext client(const TlsOptions& options);
+  static TlsContext server(std::string_view cert_pem, std::string_view key_pem);
+
+  ssl_ctx_st* native() const noexcept { return ctx_.get(); }
+  bool session_resumption() const noexcept { return session_resumption_; }
+
+ private:
+  std::shared_ptr<ssl_ctx_st> ctx_;
+  bool session_resumption_ = false;
+};
+
+/// Attaches `fd` to `ssl` like `SSL_set_fd`, but writes never raise SIGPIPE.
+void tls_set_socket(ssl_st* ssl, int fd);
+
+/// Drains the OpenSSL error queue into a printable string.
+std::string tls_error_string();
+
+/// Index of the per-SSL ex-data slot that points at the connection's
+/// `TlsSessionSlot`. Used by the new-session callback.
+int tls_session_slot_index();
+
+}  // namespace mpesa
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "mpesa/connection.hpp"
+#include "mpesa/endpoint.hpp"
+
+namespace mpesa {
+
+class HttpClient;
+
+/// Daraja app credentials used for `/oauth/v1/generate`.
+struct Credentials {
+  std::string consumer_key;
+  std::string consumer_secret;
+};
+
+/// Copy of a cached access token. Fixed-size so reading one never allocates.
+class AccessToken {
+ public:
+  static constexpr std::size_t kMaxSize = 248;
+
+  std::string_view value() const noexcept { return {data_.data(), size_}; }
+  bool empty() const noexcept { return size_ == 0; }
+  Clock::time_point expires_at() const noexcept { return expires_at_; }
+  /// Increments on every refresh; lets callers invalidate exactly the token
+  /// they saw rejected.
+  std::uint64_t generation() const noexcept { return generation_; }
+
+ private:
+  friend class TokenManager;
+
+  std::array<char, kMaxSize> data_;  // only the first size_ bytes are meaningful
+  std::uint32_t size_ = 0;
+  std::uint64_t generation_ = 0;
+  Clock::time_point expires_at_{};
+};
+
+struct TokenManagerOptions {
+  /// Refresh this long before the token expires. Clamped to half the
+  /// token's lifetime for short-lived tokens.
+  std::chrono::seconds refresh_margin{300};
+  /// Run a refresher thread that renews the token ahead of expiry so
+  /// request threads never wait on the token endpoint.
+  bool background_refresh = true;
+  /// Delay before the refresher retries after a failed fetch.
+  std::chrono::milliseconds retry_backoff{1'000};
+};
+
+/// Cached, single-flight OAuth token source.
+///
+/// Reads are a seqlock over a fixed buffer: lock-free, allocation-free and a
+/// few dozen nanoseconds. Only a caller that finds no valid token blocks, and
+/// concurrent callers in that state share one request to the token endpoint
+/// and its outcome. Near expiry, callers keep using the current token while a
+/// single refresh runs (on the refresher thread, or on exactly one caller when
+/// `background_refresh` is off).
+class TokenManager {
+ public:
+  TokenManager(HttpClient& http, Endpoint endpoint, Credentials credentials,
+               TokenManagerOptions options = {});
+  TokenManager(const TokenManager&) = delete;
+  TokenManager& operator=(const TokenManager&) = delete;
+  ~TokenManager();
+
+  /// Returns a valid token, fetching one if needed. Throws `Error` if the
+  /// fetch fails (`kAuth` for rejected credentials).
+  AccessToken get();
+
+  /// Lock-free, never blocks: copies the current token into `out` and
+  /// returns true if it is still valid.
+  bool try_get(AccessToken& out) const noexcept;
+
+  /// Drops `seen` after the API rejected it (HTTP 401). No-op if the cache
+  /// already holds a newer token, so a burst of 401s causes one refresh.
+  void invalidate(const AccessToken& seen);
+
+  /// Number of requests sent to the token endpoint.
+  std::uint64_t fetch_count() const noexcept { return fetches_.load(std::memory_order_relaxed); }
+
+ private:
+  static constexpr std::size_t kWords = AccessToken::kMaxSize / 8;
+
+  void read(AccessToken& out, Clock::time_point* refresh_at) const noexcept;
+  void publish(std::string_view token, Clock::time_point expires_at,
+               Clock::time_point refresh_at);
+  /// Single-flight refresh: joins a fetch already in flight or leads a new
+  /// one, and rethrows the fetch's error. Skips the fetch if a token newer
+  /// than `seen_generation` arrived meanwhile.
+  void refresh(std::uint64_t seen_generation);
+  void fetch_and_publish();
+  void refresher_loop();
+
+  HttpClient& http_;
+  Endpoint endpoint_;
+  std::string authorization_;
+  TokenManagerOptions options_;
+
+  // Seqlock-protected token cell. The only writers are the refresh leader
+  // (`in_flight_`) and `invalidate`, which runs under `mutex_` while no
+  // refresh is in flight.
+  std::atomic<std::uint64_t> seq_{0};
+  std::array<std::atomic<std::uint64_t>, kWords> words_{};
+  std::atomic<std::uint32_t> size_{0};
+  std::atomic<std::uint64_t> generation_{0};
+  std::atomic<std::int64_t> expires_ns_{0};
+  std::atomic<std::int64_t> refresh_ns_{0};
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool in_flight_ = false;
+  std::uint64_t completed_ = 0;
+  std::exception_ptr last_error_;
+  std::atomic<bool> opportunistic_{false};
+
+  bool stopping_ = false;
+  std::thread refresher_;
+
+  std::atomic<std::uint64_t> fetches_{0};
+};
+
+}  // namespace mpesa
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mpesa/callbacks.hpp"
+
+namespace mpesa {
+
+/// Strings numbered densely from 0 in order of first appearance. Values
+/// live back to back in one buffer; an open-addressing table of ids finds
+/// them again.
+class StringDictionary {
+ public:
+  static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+
+  /// Id of `value`, added if new.
+  std::uint32_t intern(std::string_view value);
+  /// Id of `value`, or `npos`.
+  std::uint32_t find(std::string_view value) const noexcept;
+  std::string_view value(std::uint32_t id) const noexcept {
+    const std::size_t begin = id == 0 ? 0 : ends_[id - 1];
+    return std::string_view(text_).substr(begin, ends_[id] - begin);
+  }
+  std::size_t size() const noexcept { return ends_.size(); }
+  std::size_t memory_bytes() const noexcept;
+  void clear() noexcept;
+
+ private:
+  struct Slot {
+    std::uint32_t hash = 0;
+    std::uint32_t id = npos;
+  };
+  void rehash(std::size_t slots);
+
+  std::string text_;
+  std::vector<std::uint32_t> ends_;
+  std::vector<Slot> slots_;
+};
+
+/// Which callback a transaction came from.
+enum class TransactionSource : std::uint8_t { kC2B, kStk, kResult };
+
+/// One transaction, as appended or read back. Times are Daraja's: East
+/// Africa Time as seconds since 1970-01-01 00:00 on that clock, so
+/// `time / 3600` is a local hour.
+struct TransactionRecord {
+  TransactionSource source = TransactionSource::kC2B;
+  std::int64_t time = 0;
+  std::int64_t amount_cents = 0;
+  int result_code = 0;
+  std::string_view short_code;
+  std::string_view msisdn;
+  std::string_view receipt;
+};
+
+/// "20261016063845" (C2B, STK) or "16.10.2026 06:38:45" (B2C results) in
+/// store time; -1 if it is neither.
+std::int64_t parse_daraja_time(std::string_view text) noexcept;
+
+struct TransactionFilter {
+  /// `[from, to)` in store time.
+  std::int64_t from = std::numeric_limits<std::int64_t>::min();
+  std::int64_t to = std::numeric_limits<std::int64_t>::max();
+  /// Empty for every shortcode.
+  std::string_view short_code;
+  std::optional<TransactionSource> source{};
+  /// Only `result_code == 0`.
+  bool succeeded_only = true;
+};
+
+struct TransactionTotals {
+  std::uint64_t count = 0;
+  std::int64_t amount_cents = 0;
+};
+
+struct HourlyTotal {
+  std::string_view short_code;
+  std::int64_t hour = 0;  ///< store time / 3600
+  std::uint64_t count = 0;
+  std::int64_t amount_cents = 0;
+};
+
+/// Callback transactions kept column by column for dashboard queries: one
+/// contiguous array each for time, amount, result code and source, and
+/// shortcodes and MSISDNs dictionary-encoded to 32-bit ids. Receipts,
+/// unique per row, sit back to back in one buffer. A row costs about 40
+/// bytes plus its receipt, and a scan reads only the columns it filters
+/// or sums. The min and max time of every `kBlockRows` rows are kept, so
+/// a time-bounded query skips blocks outside its range; callbacks arrive
+/// roughly in time order, which keeps those ranges tight.
+///
+/// Appends copy what they keep out of the callback. Not thread-safe: one
+/// writer, and no reads during a write.
+class TransactionStore {
+ public:
+  static constexpr std::size_t kBlockRows = 4096;
+
+  /// Throws `Error(kParse)` if `TransAmount` or `TransTime` is malformed.
+  void append(const C2BNotification& n);
+  /// STK callbacks do not name the shortcode, so the caller does. A failed
+  /// payment carries no metadata and is stored with amount 0 and the
+  /// current time. Throws `Error(kParse)` on malformed metadata.
+  void append(const StkCallback& cb, std::string_view short_code);
+  /// B2C results: amount from `TransactionAmount`, time from
+  /// `TransactionCompletedDateTime`, MSISDN from the start of
+  /// `ReceiverPartyPublicName`, receipt `TransactionID`. As for STK, a
+  /// failure is stored with amount 0 and the current time.
+  void append(const ResultCallback& r, std::string_view short_code);
+  void append(const TransactionRecord& record);
+
+  std::size_t size() const noexcept { return times_.size(); }
+  TransactionRecord row(std::size_t i) const noexcept;
+  void reserve(std::size_t rows);
+  void clear() noexcept;
+  std::size_t memory_bytes() const noexcept;
+
+  /// Count and sum of the matching rows. Uses AVX2 when the CPU has it.
+  TransactionTotals total(const TransactionFilter& filter) const noexcept;
+  /// Row-at-a-time `total`; the reference the SIMD path must match.
+  TransactionTotals total_scalar(const TransactionFilter& filter) const noexcept;
+  /// Count and sum of the matching rows per shortcode and hour, e.g. what
+  /// each paybill received hour by hour. Sorted by shortcode, then hour;
+  /// empty groups are left out.
+  std::vector<HourlyTotal> hourly_totals(const TransactionFilter& filter) const;
+
+  const StringDictionary& short_codes() const noexcept { return short_codes_; }
+  const StringDictionary& msisdns() const noexcept { return msisdns_; }
+
+ private:
+  struct Zone {
+    std::int64_t min_time;
+    std::int64_t max_time;
+  };
+
+  std::vector<std::int64_t> times_;
+  std::vector<std::int64_t> amounts_;
+  std::vector<std::uint32_t> short_code_ids_;
+  std::vector<std::uint32_t> msisdn_ids_;
+  std::vector<std::int32_t> result_codes_;
+  std::vector<std::uint8_t> sources_;
+  std::string receipts_;
+  std::vector<std::uint64_t> receipt_ends_;
+  std::vector<Zone> zones_;
+  StringDictionary short_codes_;
+  StringDictionary msisdns_;
+};
+
+}  // namespace mpesa
@@ -0,0 +1,302 @@
+#include "mpesa/async_http_client.hpp"
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+namespace {
+
+bool idempotent(std::string_view method) {
+  return method == "GET" || method == "HEAD" || method == "PUT" || method == "DELETE" ||
+         method == "OPTIONS";
+}
+
+/// Owns a connection whose fd may be registered with the loop, and
+/// unregisters it on every exit path, exceptions included.
+class LoopConnection {
+ public:
+  LoopConnection(EventLoop& loop, std::unique_ptr<Connection> connection)
+      : loop_(loop), connection_(std::move(connection)) {}
+  LoopConnection(const LoopConnection&) = delete;
+  LoopConnection& operator=(const LoopConnection&) = delete;
+  ~LoopConnection() {
+    if (connection_) loop_.forget_fd(connection_->fd());
+  }
+
+  Connection* operator->() const noexcept { return connection_.get(); }
+  Connection& operator*() const noexcept { return *connection_; }
+  std::unique_ptr<Connection> take() noexcept { return std::move(connection_); }
+
+ private:
+  EventLoop& loop_;
+  std::unique_ptr<Connection> connection_;
+};
+
+}  // namespace
+
+AsyncHttpClient::AsyncHttpClient(EventLoop& loop, HttpClientOptions options)
+    : loop_(loop),
+      options_(std::move(options)),
+      tls_(TlsContext::client(options_.pool.tls)),
+      read_buffer_(16 * 1024) {}
+
+AsyncHttpClient::~AsyncHttpClient() {
+  for (auto& [endpoint, h] : hosts_) {
+    for (auto& conn : h->idle) close(std::move(conn));
+  }
+}
+
+AsyncHttpClient::Host& AsyncHttpClient::host(const Endpoint& endpoint) {
+  auto& slot = hosts_[endpoint];
+  if (!slot) slot = std::make_unique<Host>();
+  return *slot;
+}
+
+EventLoop::IoAwaiter AsyncHttpClient::ready(Connection& connection, IoStatus status,
+                                            Clock::time_point deadline) {
+  return loop_.wait_io(connection.fd(),
+                       status == IoStatus::kWantRead ? EventLoop::Io::kRead : EventLoop::Io::kWrite,
+                       deadline);
+}
+
+void AsyncHttpClient::close(std::unique_ptr<Connection> connection) {
+  if (connection) loop_.forget_fd(connection->fd());
+}
+
+void AsyncHttpClient::release(Host& host, std::unique_ptr<Connection> connection) {
+  connection->touch();
+  if (!host.waiters.empty()) {
+    Waiter* next = host.waiters.front();
+    host.waiters.pop_front();
+    loop_.cancel(next->timer);
+    next->connection = std::move(connection);
+    loop_.schedule(next->handle);
+  } else if (host.idle.size() < options_.pool.max_idle_per_endpoint) {
+    host.idle.push_back(std::move(connection));
+  } else {
+    discard(host, std::move(connection));
+  }
+}
+
+void AsyncHttpClient::discard(Host& host, std::unique_ptr<Connection> connection) {
+  close(std::move(connection));
+  --host.open;
+  if (!host.waiters.empty()) {
+    // Hand the freed slot to the oldest waiter; it opens a new connection.
+    Waiter* next = host.waiters.front();
+    host.waiters.pop_front();
+    loop_.cancel(next->timer);
+    loop_.schedule(next->handle);
+  }
+}
+
+Task<void> AsyncHttpClient::wait_for_slot(Host& host, Waiter& waiter, Clock::time_point deadline) {
+  struct Suspend {
+    Waiter& waiter;
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) noexcept { waiter.handle = h; }
+    void await_resume() const noexcept {}
+  };
+  const auto it = host.waiters.insert(host.waiters.end(), &waiter);
+  if (deadline != Clock::time_point::max()) {
+    waiter.timer = loop_.call_at(deadline, [&host, &waiter, it] {
+      host.waiters.erase(it);
+      waiter.timed_out = true;
+      waiter.handle.resume();
+    });
+  }
+  co_await Suspend{waiter};
+}
+
+Task<std::unique_ptr<Connection>> AsyncHttpClient::connect(const Endpoint& endpoint, Host& host,
+                                                           Clock::time_point deadline,
+                                                           std::chrono::nanoseconds& resolve_time) {
+  if (host.addresses.empty() || Clock::now() - host.resolved_at >= options_.pool.dns_ttl) {
+    const auto started = Clock::now();
+    // Named rather than a temporary: GCC 12 destroys lambda captures of a
+    // temporary awaiter twice.
+    auto lookup = loop_.run_blocking([target = endpoint] { return resolve(target); });
+    host.addresses = co_await lookup;
+    host.resolved_at = Clock::now();
+    resolve_time = host.resolved_at - started;
+    ++stats_.dns_lookups;
+  }
+  const auto connect_deadline = std::min(deadline, Clock::now() + options_.pool.connect_timeout);
+  const std::vector<SocketAddress> addresses = host.addresses;
+  std::string last_error = "no addresses";
+  bool timed_out = false;
+
+  for (const auto& address : addresses) {
+    const auto started = Clock::now();
+    IoStatus status = IoStatus::kDone;
+    std::unique_ptr<Connection> raw;
+    try {
+      raw = Connection::start(endpoint, address, status);
+    } catch (const Error& e) {
+      last_error = e.what();
+      continue;
+    }
+    LoopConnection conn(loop_, std::move(raw));
+    if (status != IoStatus::kDone) {
+      if (!co_await ready(*conn, status, connect_deadline)) {
+        timed_out = true;
+        last_error = "connect timed out";
+        continue;
+      }
+      try {
+        conn->finish_connect();
+      } catch (const Error& e) {
+        last_error = e.what();
+        continue;
+      }
+    }
+    const auto connected = Clock::now();
+    conn->timings().connect = connected - started;
+
+    if (endpoint.tls) {
+      conn->start_tls(*tls_, host.session);
+      for (IoStatus step; (step = conn->handshake_step()) != IoStatus::kDone;) {
+        if (!co_await ready(*conn, step, connect_deadline)) {
+          throw Error(ErrorCode::kTimeout, endpoint.authority() + ": TLS handshake timed out");
+        }
+      }
+      conn->timings().tls = Clock::now() - connected;
+      ++(conn->timings().tls_resumed ? stats_.resumed_handshakes : stats_.full_handshakes);
+    }
+    ++stats_.connections_opened;
+    co_return conn.take();
+  }
+  if (!timed_out) host.addresses.clear();  // the host may have moved
+  throw Error(timed_out ? ErrorCode::kTimeout : ErrorCode::kConnect,
+              endpoint.authority() + ": " + last_error);
+}
+
+Task<ConnectionPool::Lease> AsyncHttpClient::acquire(const Endpoint& endpoint, Host& host,
+                                                     Clock::time_point deadline) {
+  for (;;) {
+    while (options_.pool.keep_alive && !host.idle.empty()) {
+      std::unique_ptr<Connection> conn = std::move(host.idle.back());
+      host.idle.pop_back();
+      if (Clock::now() - conn->last_used() > options_.pool.idle_timeout || !conn->idle_healthy()) {
+        ++stats_.discarded_stale;
+        discard(host, std::move(conn));
+        continue;
+      }
+      ++stats_.reused;
+      co_return ConnectionPool::Lease{std::move(conn), true, {}};
+    }
+
+    const std::size_t limit = options_.pool.max_connections_per_endpoint;
+    if (limit == 0 || host.open < limit) {
+      ++host.open;
+      ConnectionPool::Lease lease;
+      std::exception_ptr error;
+      try {
+        lease.connection = co_await connect(endpoint, host, deadline, lease.resolve);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      if (error) {
+        discard(host, nullptr);
+        std::rethrow_exception(error);
+      }
+      co_return lease;
+    }
+
+    Waiter waiter;
+    co_await wait_for_slot(host, waiter, deadline);
+    if (waiter.timed_out) {
+      throw Error(ErrorCode::kTimeout, endpoint.authority() + ": no free connection before deadline");
+    }
+    if (waiter.connection) {
+      ++stats_.reused;
+      co_return ConnectionPool::Lease{std::move(waiter.connection), true, {}};
+    }
+  }
+}
+
+Task<HttpResponse> AsyncHttpClient::attempt(const Endpoint& endpoint, Host& host, const HttpRequest& request,
+                                            std::pmr::memory_resource* arena, Clock::time_point deadline,
+                                            bool& retryable) {
+  retryable = false;
+  ConnectionPool::Lease lease = co_await acquire(endpoint, host, deadline);
+  LoopConnection conn(loop_, std::move(lease.connection));
+  Metrics* const metrics = options_.metrics;
+  if (metrics != nullptr && !lease.reused) metrics->record_connect(conn->timings(), lease.resolve, endpoint.tls);
+
+  std::pmr::string wire(arena);
+  const bool keep_alive = options_.pool.keep_alive;
+  serialize_request(request, endpoint.authority(), keep_alive, wire, options_.user_agent);
+
+  HttpParser parser(HttpParser::Kind::kResponse, arena);
+  if (request.method == "HEAD") parser.expect_no_body();
+  std::exception_ptr error;
+  try {
+    std::string_view rest = wire;
+    for (IoStatus status; (status = conn->write_step(rest)) != IoStatus::kDone;) {
+      if (!co_await ready(*conn, status, deadline)) {
+        throw Error(ErrorCode::kTimeout, endpoint.authority() + ": write timed out");
+      }
+    }
+    const auto written = metrics != nullptr ? Clock::now() : Clock::time_point{};
+    while (!parser.done()) {
+      std::size_t n = 0;
+      const IoStatus status = conn->read_step(read_buffer_.data(), read_buffer_.size(), n);
+      if (status != IoStatus::kDone) {
+        if (!co_await ready(*conn, status, deadline)) {
+          throw Error(ErrorCode::kTimeout, endpoint.authority() + ": response timed out");
+        }
+        continue;
+      }
+      if (n == 0) {
+        parser.finish();
+        if (!parser.done()) throw Error(ErrorCode::kConnectionClosed, "empty response");
+        break;
+      }
+      if (metrics != nullptr && !parser.started()) metrics->record(Phase::kTtfb, Clock::now() - written);
+      // The shared read buffer is consumed before the next suspension point.
+      parser.feed(read_buffer_.data(), n);
+    }
+  } catch (Error& e) {
+    retryable = lease.reused && !parser.started() && idempotent(request.method) &&
+                e.code() == ErrorCode::kConnectionClosed;
+    e.set_sent(true);
+    error = std::current_exception();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  if (error) {
+    discard(host, conn.take());
+    std::rethrow_exception(error);
+  }
+
+  conn->count_request();
+  if (keep_alive && parser.keep_alive()) {
+    release(host, conn.take());
+  } else {
+    discard(host, conn.take());
+  }
+  co_return std::move(parser.response());
+}
+
+Task<HttpResponse> AsyncHttpClient::send(Endpoint endpoint, HttpRequest request) {
+  co_return co_await exchange(endpoint, request, std::pmr::get_default_resource());
+}
+
+Task<HttpResponse> AsyncHttpClient::exchange(const Endpoint& endpoint, const HttpRequest& request,
+                                             std::pmr::memory_resource* arena) {
+  const auto started = Clock::now();
+  const auto deadline = started + options_.request_timeout;
+  Host& h = host(endpoint);
+  bool retryable = false;
+  std::optional<HttpResponse> response;
+  try {
+    response = co_await attempt(endpoint, h, request, arena, deadline, retryable);
+  } catch (const Error&) {
+    if (!retryable) throw;
+  }
+  if (!response) response = co_await attempt(endpoint, h, request, arena, deadline, retryable);
+  if (options_.metrics != nullptr) options_.metrics->record(Phase::kTotal, Clock::now() - started);
+  co_return std::move(*response);
+}
+
+}  // namespace mpesa
@@ -0,0 +1,88 @@
+#include "mpesa/base64.hpp"
+
+#include "cpu.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MPESA_BASE64_AVX2 1
+#endif
+
+namespace mpesa {
+namespace {
+
+constexpr char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#ifdef MPESA_BASE64_AVX2
+
+// 24 input bytes -> 32 output characters per step (Muła and Lemire, "Faster
+// Base64 Encoding and Decoding Using AVX2 Instructions", 2018). Each 128-bit
+// lane takes 12 bytes, spreads every 3-byte group over four bytes, isolates
+// the 6-bit indices with multiplies and maps them to ASCII by adding a
+// per-range offset. Returns the input bytes consumed; the caller finishes
+// the tail, which keeps the 16-byte loads inside the input.
+__attribute__((target("avx2"))) std::size_t encode_avx2(const unsigned char* in, std::size_t n, char* out) noexcept {
+  const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,  //
+                                          10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+  const __m256i offsets = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,  //
+                                           65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+  std::size_t done = 0;
+  for (; n - done >= 28; done += 24) {
+    const __m256i raw = _mm256_set_m128i(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done + 12)),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done)));
+    const __m256i spread = _mm256_shuffle_epi8(raw, shuffle);
+    const __m256i hi = _mm256_mulhi_epu16(_mm256_and_si256(spread, _mm256_set1_epi32(0x0fc0fc00)),
+                                          _mm256_set1_epi32(0x04000040));
+    const __m256i lo = _mm256_mullo_epi16(_mm256_and_si256(spread, _mm256_set1_epi32(0x003f03f0)),
+                                          _mm256_set1_epi32(0x01000010));
+    const __m256i indices = _mm256_or_si256(hi, lo);
+    // Range selector: 0 for A-Z, 1 for a-z, 2..11 for digits, 12 for '+', 13 for '/'.
+    __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    range = _mm256_sub_epi8(range, _mm256_cmpgt_epi8(indices, _mm256_set1_epi8(25)));
+    const __m256i ascii = _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + done / 3 * 4), ascii);
+  }
+  return done;
+}
+
+#endif
+
+}  // namespace
+
+std::size_t base64_encode_scalar(std::string_view in, char* out) noexcept {
+  const auto* p = reinterpret_cast<const unsigned char*>(in.data());
+  std::size_t n = in.size();
+  char* o = out;
+  for (; n >= 3; n -= 3, p += 3) {
+    const unsigned v = (unsigned{p[0]} << 16) | (unsigned{p[1]} << 8) | p[2];
+    *o++ = kAlphabet[v >> 18];
+    *o++ = kAlphabet[(v >> 12) & 63];
+    *o++ = kAlphabet[(v >> 6) & 63];
+    *o++ = kAlphabet[v & 63];
+  }
+  if (n > 0) {
+    const unsigned v = (unsigned{p[0]} << 16) | (n == 2 ? unsigned{p[1]} << 8 : 0u);
+    *o++ = kAlphabet[v >> 18];
+    *o++ = kAlphabet[(v >> 12) & 63];
+    *o++ = n == 2 ? kAlphabet[(v >> 6) & 63] : '=';
+    *o++ = '=';
+  }
+  return static_cast<std::size_t>(o - out);
+}
+
+std::size_t base64_encode(std::string_view in, char* out) noexcept {
+#ifdef MPESA_BASE64_AVX2
+  if (in.size() >= 28 && detail::cpu_has_avx2()) {
+    const std::size_t done = encode_avx2(reinterpret_cast<const unsigned char*>(in.data()), in.size(), out);
+    return done / 3 * 4 + base64_encode_scalar(in.substr(done), out + done / 3 * 4);
+  }
+#endif
+  return base64_encode_scalar(in, out);
+}
+
+std::string base64_encode(std::string_view in) {
+  std::string out(base64_encoded_size(in.size()), '\0');
+  base64_encode(in, out.data());
+  return out;
+}
+
+}  // namespace mpesa
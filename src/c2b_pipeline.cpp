@@ -0,0 +1,307 @@
+#include "mpesa/c2b_pipeline.hpp"
+
+#include <algorithm>
+
+#include "mpesa/error.hpp"
+#include "mpesa/json.hpp"
+
+namespace mpesa {
+namespace {
+
+// Fields of C2BNotification, for moving decoded text out of the reader.
+constexpr std::string_view C2BNotification::*kFields[] = {
+    &C2BNotification::transaction_type,    &C2BNotification::trans_id,
+    &C2BNotification::trans_time,          &C2BNotification::trans_amount,
+    &C2BNotification::business_short_code, &C2BNotification::bill_ref_number,
+    &C2BNotification::invoice_number,      &C2BNotification::org_account_balance,
+    &C2BNotification::third_party_trans_id, &C2BNotification::msisdn,
+    &C2BNotification::first_name,          &C2BNotification::middle_name,
+    &C2BNotification::last_name,
+};
+
+}  // namespace
+
+const char* to_string(C2BStage stage) noexcept {
+  switch (stage) {
+    case C2BStage::kParse: return "parse";
+    case C2BStage::kValidate: return "validate";
+    case C2BStage::kDedupe: return "dedupe";
+    case C2BStage::kEnrich: return "enrich";
+    case C2BStage::kSink: return "sink";
+  }
+  return "unknown";
+}
+
+C2BPipeline::C2BPipeline(C2BPipelineOptions options, Steps steps)
+    : options_(std::move(options)),
+      steps_(std::move(steps)),
+      own_index_(options_.dedupe == nullptr ? std::make_unique<IdempotencyIndex>() : nullptr),
+      index_(options_.dedupe != nullptr ? options_.dedupe : own_index_.get()),
+      pool_(std::make_unique<C2BTransaction[]>(std::max<std::size_t>(options_.capacity, 1))),
+      // Every ring holds the whole pool, so only `free_` can run dry.
+      free_(options_.capacity),
+      ingress_(options_.capacity),
+      to_validate_(options_.capacity),
+      to_dedupe_(options_.capacity),
+      to_enrich_(options_.capacity),
+      to_sink_(options_.capacity) {
+  if (!steps_.sink) throw Error(ErrorCode::kInvalidArgument, "C2BPipeline needs a sink");
+  for (std::size_t i = 0; i < std::max<std::size_t>(options_.capacity, 1); ++i) free_.try_push(&pool_[i]);
+  stages_[0].thread = std::thread([this] { run_parse(); });
+  stages_[1].thread = std::thread([this] { run_validate(); });
+  stages_[2].thread = std::thread([this] { run_dedupe(); });
+  stages_[3].thread = std::thread([this] { run_enrich(); });
+  stages_[4].thread = std::thread([this] { run_sink(); });
+}
+
+C2BPipeline::~C2BPipeline() { stop(); }
+
+bool C2BPipeline::offer(std::string_view body) {
+  offering_.fetch_add(1);
+  if (!accepting_.load()) {
+    offering_.fetch_sub(1);
+    return false;
+  }
+  offered_.fetch_add(1, std::memory_order_relaxed);
+  Item item = nullptr;
+  if (!free_.try_pop(item)) {
+    const Clock::time_point deadline = Clock::now() + options_.offer_timeout;
+    Backoff backoff;
+    while (!free_.try_pop(item)) {
+      if (Clock::now() >= deadline || !accepting_.load(std::memory_order_relaxed)) {
+        refused_.fetch_add(1, std::memory_order_relaxed);
+        offering_.fetch_sub(1);
+        return false;
+      }
+      backoff.pause();
+    }
+  }
+  item->body.assign(body);
+  item->received = item->stage_entered = Clock::now();
+  ingress_.try_push(item);
+  offering_.fetch_sub(1);
+  return true;
+}
+
+void C2BPipeline::stop() {
+  std::call_once(stopped_, [this] {
+    {
+      std::lock_guard lock(stop_mutex_);
+      accepting_.store(false);
+    }
+    stop_cv_.notify_all();
+    // Each stage exits once its upstream has and its queue is empty.
+    for (Stage& stage : stages_) stage.thread.join();
+  });
+}
+
+template <class Queue, class Done, class Process, class Forward>
+void C2BPipeline::drive(Stage& stage, Queue& in, Done upstream_done, Process process, Forward forward) {
+  std::vector<Item> batch;
+  batch.reserve(std::max<std::size_t>(options_.max_batch, 1));
+  Backoff backoff;
+  for (;;) {
+    // Checked before popping: whatever upstream pushed before it finished
+    // is visible to the pops below.
+    const bool last = upstream_done();
+    Item item = nullptr;
+    while (batch.size() < batch.capacity() && in.try_pop(item)) batch.push_back(item);
+    if (batch.empty()) {
+      if (last) return;
+      backoff.pause();
+      continue;
+    }
+    backoff.reset();
+    const std::size_t taken = batch.size();
+    process(batch);
+    stage.processed.fetch_add(taken, std::memory_order_relaxed);
+    const Clock::time_point now = Clock::now();
+    {
+      std::lock_guard lock(stage.mutex);
+      for (const Item t : batch) stage.latency.record(now - t->stage_entered);
+    }
+    for (const Item t : batch) {
+      t->stage_entered = now;
+      forward(t);
+    }
+    batch.clear();
+  }
+}
+
+void C2BPipeline::pass(SpscQueue<Item>& out, Item item) {
+  // Never full, as the ring holds the whole pool; waits only by accident.
+  Backoff backoff;
+  while (!out.try_push(item)) backoff.pause();
+}
+
+void C2BPipeline::drop(Stage& stage, Item item, C2BDropReason reason) {
+  stage.dropped.fetch_add(1, std::memory_order_relaxed);
+  if (steps_.dropped) steps_.dropped(*item, reason);
+  recycle(item);
+}
+
+void C2BPipeline::recycle(Item item) {
+  item->notification = {};
+  item->amount_cents = 0;
+  item->account.clear();
+  item->tag = 0;
+  item->unescaped.clear();
+  free_.try_push(item);
+}
+
+void C2BPipeline::run_parse() {
+  Stage& stage = stages_[0];
+  const auto upstream_done = [this] { return !accepting_.load() && offering_.load() == 0; };
+  const auto process = [&](std::vector<Item>& batch) {
+    std::erase_if(batch, [&](Item t) {
+      try {
+        json::Reader reader(t->body);
+        read_callback(reader, t->notification);
+      } catch (const Error&) {
+        drop(stage, t, C2BDropReason::kMalformed);
+        return true;
+      }
+      // Strings with escapes were decoded into the reader's scratch, which
+      // dies here; copy them next to the body. Decoded text is never longer
+      // than the body, so one reservation keeps the views stable.
+      const char* const begin = t->body.data();
+      const char* const end = begin + t->body.size();
+      for (const auto field : kFields) {
+        std::string_view& view = t->notification.*field;
+        if (view.empty() || (view.data() >= begin && view.data() < end)) continue;
+        if (t->unescaped.capacity() < t->body.size()) t->unescaped.reserve(t->body.size());
+        const std::size_t from = t->unescaped.size();
+        t->unescaped.append(view);
+        view = std::string_view(t->unescaped).substr(from);
+      }
+      return false;
+    });
+  };
+  drive(stage, ingress_, upstream_done, process, [this](Item t) { pass(to_validate_, t); });
+  done_[0].store(true);
+}
+
+bool C2BPipeline::valid(const C2BTransaction& t) const {
+  const C2BNotification& n = t.notification;
+  if (n.trans_id.empty() || t.amount_cents <= 0) return false;
+  if (!options_.short_codes.empty() &&
+      std::find(options_.short_codes.begin(), options_.short_codes.end(), n.business_short_code) ==
+          options_.short_codes.end()) {
+    return false;
+  }
+  return !steps_.validate || steps_.validate(t);
+}
+
+void C2BPipeline::run_validate() {
+  Stage& stage = stages_[1];
+  const auto process = [&](std::vector<Item>& batch) {
+    std::erase_if(batch, [&](Item t) {
+      t->amount_cents = parse_amount_cents(t->notification.trans_amount);
+      bool ok = false;
+      try {
+        ok = valid(*t);
+      } catch (...) {
+      }
+      if (!ok) drop(stage, t, C2BDropReason::kInvalid);
+      return !ok;
+    });
+  };
+  drive(stage, to_validate_, [this] { return done_[0].load(); }, process,
+        [this](Item t) { pass(to_dedupe_, t); });
+  done_[1].store(true);
+}
+
+void C2BPipeline::run_dedupe() {
+  Stage& stage = stages_[2];
+  const auto process = [&](std::vector<Item>& batch) {
+    const Clock::time_point now = Clock::now();
+    std::erase_if(batch, [&](Item t) {
+      if (index_->first_seen(IdKind::kTransId, t->notification.trans_id, now)) return false;
+      drop(stage, t, C2BDropReason::kDuplicate);
+      return true;
+    });
+  };
+  drive(stage, to_dedupe_, [this] { return done_[1].load(); }, process,
+        [this](Item t) { pass(to_enrich_, t); });
+  done_[2].store(true);
+}
+
+void C2BPipeline::run_enrich() {
+  Stage& stage = stages_[3];
+  const auto process = [&](std::vector<Item>& batch) {
+    if (!steps_.enrich) return;
+    std::erase_if(batch, [&](Item t) {
+      try {
+        steps_.enrich(*t);
+        return false;
+      } catch (...) {
+        index_->forget(IdKind::kTransId, t->notification.trans_id);
+        drop(stage, t, C2BDropReason::kEnrichFailed);
+        return true;
+      }
+    });
+  };
+  drive(stage, to_enrich_, [this] { return done_[2].load(); }, process, [this](Item t) { pass(to_sink_, t); });
+  done_[3].store(true);
+}
+
+void C2BPipeline::run_sink() {
+  Stage& stage = stages_[4];
+  const auto process = [&](std::vector<Item>& batch) {
+    const std::span<C2BTransaction* const> items(batch.data(), batch.size());
+    for (auto backoff = options_.sink_retry_backoff;;) {
+      // Once stopping, a failing batch gets this one last try.
+      const bool last = !accepting_.load();
+      try {
+        steps_.sink(items);
+        break;
+      } catch (...) {
+      }
+      if (last) {
+        for (const Item t : batch) {
+          index_->forget(IdKind::kTransId, t->notification.trans_id);
+          drop(stage, t, C2BDropReason::kSinkFailed);
+        }
+        batch.clear();
+        return;
+      }
+      sink_retries_.fetch_add(1, std::memory_order_relaxed);
+      std::unique_lock lock(stop_mutex_);
+      stop_cv_.wait_for(lock, backoff, [this] { return !accepting_.load(); });
+      backoff = std::min(backoff * 2, options_.sink_retry_max_backoff);
+    }
+    sunk_.fetch_add(batch.size(), std::memory_order_relaxed);
+    const Clock::time_point now = Clock::now();
+    std::lock_guard lock(end_to_end_mutex_);
+    for (const Item t : batch) end_to_end_.record(now - t->received);
+  };
+  drive(stage, to_sink_, [this] { return done_[3].load(); }, process, [this](Item t) { recycle(t); });
+  done_[4].store(true);
+}
+
+C2BPipelineStats C2BPipeline::stats() const {
+  C2BPipelineStats s;
+  const std::size_t depths[kC2BStageCount] = {ingress_.size(), to_validate_.size(), to_dedupe_.size(),
+                                              to_enrich_.size(), to_sink_.size()};
+  for (std::size_t i = 0; i < kC2BStageCount; ++i) {
+    const Stage& stage = stages_[i];
+    C2BStageStats& out = s.stages[i];
+    out.processed = stage.processed.load(std::memory_order_relaxed);
+    out.dropped = stage.dropped.load(std::memory_order_relaxed);
+    out.depth = depths[i];
+    std::lock_guard lock(stage.mutex);
+    out.latency = stage.latency;
+  }
+  s.offered = offered_.load(std::memory_order_relaxed);
+  s.refused = refused_.load(std::memory_order_relaxed);
+  s.sunk = sunk_.load(std::memory_order_relaxed);
+  s.sink_retries = sink_retries_.load(std::memory_order_relaxed);
+  const std::size_t pooled = std::max<std::size_t>(options_.capacity, 1);
+  const std::size_t free = free_.size();
+  s.in_flight = pooled > free ? pooled - free : 0;
+  std::lock_guard lock(end_to_end_mutex_);
+  s.end_to_end = end_to_end_;
+  return s;
+}
+
+}  // namespace mpesa
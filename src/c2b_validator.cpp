@@ -0,0 +1,109 @@
+#include "mpesa/c2b_validator.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+namespace {
+
+char fold_char(char c) noexcept { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+
+// FNV-1a; keys are short account numbers and phone numbers.
+std::uint32_t hash_key(std::string_view key, bool fold) noexcept {
+  std::uint32_t h = 2166136261u;
+  for (char c : key) {
+    if (fold) c = fold_char(c);
+    h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  return h;
+}
+
+bool equal(std::string_view stored, std::string_view key, bool fold) noexcept {
+  if (stored.size() != key.size()) return false;
+  if (!fold) return stored == key;
+  for (std::size_t i = 0; i < key.size(); ++i) {
+    if (stored[i] != fold_char(key[i])) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+void C2BValidator::Table::build(const std::vector<std::string>& keys, bool fold, std::string& text) {
+  fold_ = fold;
+  slots_.assign(keys.empty() ? 0 : std::bit_ceil(keys.size() * 2), Slot{});
+  for (const std::string& key : keys) {
+    if (key.empty()) throw Error(ErrorCode::kInvalidArgument, "C2B validation rules may not hold empty strings");
+    const std::uint32_t hash = hash_key(key, fold);
+    if (find(key, hash, text)) continue;
+    const std::size_t mask = slots_.size() - 1;
+    std::size_t i = hash & mask;
+    while (slots_[i].length != 0) i = (i + 1) & mask;
+    slots_[i] = {hash, static_cast<std::uint32_t>(text.size()), static_cast<std::uint32_t>(key.size())};
+    for (const char c : key) text.push_back(fold ? fold_char(c) : c);
+    lengths_.push_back(static_cast<std::uint32_t>(key.size()));
+    ++count_;
+  }
+  std::sort(lengths_.begin(), lengths_.end());
+  lengths_.erase(std::unique(lengths_.begin(), lengths_.end()), lengths_.end());
+}
+
+bool C2BValidator::Table::find(std::string_view key, std::uint32_t hash, const std::string& text) const noexcept {
+  if (count_ == 0) return false;
+  const std::size_t mask = slots_.size() - 1;
+  // At most half full, so the probe always reaches an empty slot.
+  for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+    const Slot& slot = slots_[i];
+    if (slot.length == 0) return false;
+    if (slot.hash == hash && equal(std::string_view(text).substr(slot.offset, slot.length), key, fold_)) return true;
+  }
+}
+
+bool C2BValidator::Table::contains(std::string_view key, const std::string& text) const noexcept {
+  return find(key, hash_key(key, fold_), text);
+}
+
+bool C2BValidator::Table::contains_prefix_of(std::string_view key, const std::string& text) const noexcept {
+  for (const std::uint32_t length : lengths_) {
+    if (length > key.size()) break;
+    const std::string_view prefix = key.substr(0, length);
+    if (find(prefix, hash_key(prefix, fold_), text)) return true;
+  }
+  return false;
+}
+
+C2BValidator::C2BValidator() = default;
+
+C2BValidator::C2BValidator(const C2BValidationRules& rules)
+    : min_cents_(rules.min_amount_cents), max_cents_(rules.max_amount_cents) {
+  if (min_cents_ < 0 || (max_cents_ != 0 && max_cents_ < min_cents_)) {
+    throw Error(ErrorCode::kInvalidArgument, "C2B validation amount bounds are inverted");
+  }
+  short_codes_.build(rules.short_codes, false, text_);
+  blocked_msisdns_.build(rules.blocked_msisdns, false, text_);
+  blocked_msisdn_prefixes_.build(rules.blocked_msisdn_prefixes, false, text_);
+  accounts_.build(rules.accounts, rules.fold_account_case, text_);
+  account_prefixes_.build(rules.account_prefixes, rules.fold_account_case, text_);
+}
+
+C2BValidation C2BValidator::decide(const C2BNotification& n) const noexcept {
+  if (!short_codes_.empty() && !short_codes_.contains(n.business_short_code, text_)) {
+    return C2BValidation::kRejectShortCode;
+  }
+  const std::int64_t cents = parse_amount_cents(n.trans_amount);
+  if (cents < 0 || cents < min_cents_ || (max_cents_ != 0 && cents > max_cents_)) {
+    return C2BValidation::kRejectAmount;
+  }
+  if (blocked_msisdns_.contains(n.msisdn, text_) || blocked_msisdn_prefixes_.contains_prefix_of(n.msisdn, text_)) {
+    return C2BValidation::kRejectMsisdn;
+  }
+  if ((!accounts_.empty() || !account_prefixes_.empty()) && !accounts_.contains(n.bill_ref_number, text_) &&
+      !account_prefixes_.contains_prefix_of(n.bill_ref_number, text_)) {
+    return C2BValidation::kRejectAccount;
+  }
+  return C2BValidation::kAccept;
+}
+
+}  // namespace mpesa
@@ -0,0 +1,577 @@
+#include "mpesa/callback_server.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <unordered_map>
+
+#include "mpesa/arena.hpp"
+#include "mpesa/error.hpp"
+#include "mpesa/http.hpp"
+#include "mpesa/json.hpp"
+
+namespace mpesa {
+namespace {
+
+using SteadyClock = std::chrono::steady_clock;
+
+constexpr std::string_view kAccepted = R"({"ResultCode":0,"ResultDesc":"Accepted"})";
+constexpr std::size_t kReadBufferSize = 64 * 1024;
+constexpr int kMaxEvents = 256;
+// Room for any acknowledgement, so replying never allocates.
+constexpr std::size_t kReplyReserve = 512;
+
+// epoll tags for the two fds shared by all workers; connections use their
+// `Peer*`.
+char listen_tag;
+char stop_tag;
+
+void append_reply(std::string& out, int status, std::string_view body, bool keep_alive) {
+  switch (status) {
+    case 200: out.append("HTTP/1.1 200 OK\r\n"); break;
+    case 400: out.append("HTTP/1.1 400 Bad Request\r\n"); break;
+    case 404: out.append("HTTP/1.1 404 Not Found\r\n"); break;
+    case 405: out.append("HTTP/1.1 405 Method Not Allowed\r\n"); break;
+    case 503: out.append("HTTP/1.1 503 Service Unavailable\r\n"); break;
+    default: out.append("HTTP/1.1 500 Internal Server Error\r\n"); break;
+  }
+  out.append("Content-Type: application/json\r\nContent-Length: ");
+  char digits[20];
+  const auto end = std::to_chars(digits, digits + sizeof(digits), body.size()).ptr;
+  out.append(digits, end);
+  out.append(keep_alive ? "\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+  out.append(body);
+}
+
+// Validation replies for every decision, with and without keep-alive,
+// rendered once: answering from rules is a single append.
+const std::string& validation_reply(C2BValidation decision, bool keep_alive) {
+  constexpr std::size_t kDecisions = static_cast<std::size_t>(C2BValidation::kRejectOther) + 1;
+  static const auto replies = [] {
+    std::array<std::array<std::string, 2>, kDecisions> r;
+    for (std::size_t i = 0; i < kDecisions; ++i) {
+      for (const bool alive : {false, true}) {
+        append_reply(r[i][alive], 200, validation_response_body(static_cast<C2BValidation>(i)), alive);
+      }
+    }
+    return r;
+  }();
+  return replies[static_cast<std::size_t>(decision)][keep_alive];
+}
+
+void pin_to_cpu(std::thread& thread, unsigned index) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+  const int count = CPU_COUNT(&allowed);
+  if (count == 0) return;
+  int target = static_cast<int>(index % static_cast<unsigned>(count));
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (!CPU_ISSET(cpu, &allowed)) continue;
+    if (target-- == 0) {
+      cpu_set_t one;
+      CPU_ZERO(&one);
+      CPU_SET(cpu, &one);
+      pthread_setaffinity_np(thread.native_handle(), sizeof(one), &one);
+      return;
+    }
+  }
+}
+
+}  // namespace
+
+struct CallbackServer::Peer {
+  int fd = -1;
+  // Holds the request being parsed and its JSON scratch; released after
+  // each reply.
+  Arena<> arena;
+  HttpParser parser{HttpParser::Kind::kRequest, &arena};
+  std::string out;
+  std::size_t sent = 0;
+  bool close_after = false;
+  bool want_write = false;
+  SteadyClock::time_point last_active;
+};
+
+// Counters are per worker and padded apart so workers never share a line.
+struct alignas(64) CallbackServer::Worker {
+  unsigned index = 0;
+  int epoll_fd = -1;
+  std::thread thread;
+  std::unordered_map<int, std::unique_ptr<Peer>> peers;
+  std::vector<char> buffer = std::vector<char>(kReadBufferSize);
+  SteadyClock::time_point now;
+  SteadyClock::time_point next_sweep;
+
+  std::atomic<std::uint64_t> accepted{0};
+  std::atomic<std::uint64_t> requests{0};
+  std::atomic<std::uint64_t> stk{0};
+  std::atomic<std::uint64_t> validations{0};
+  std::atomic<std::uint64_t> confirmations{0};
+  std::atomic<std::uint64_t> results{0};
+  std::atomic<std::uint64_t> timeouts{0};
+  std::atomic<std::uint64_t> rejected{0};
+  std::atomic<std::uint64_t> handler_errors{0};
+  std::atomic<std::uint64_t> duplicates{0};
+  std::atomic<std::uint64_t> busy{0};
+
+  ~Worker() {
+    if (epoll_fd >= 0) ::close(epoll_fd);
+  }
+};
+
+CallbackServer::CallbackServer(CallbackServerOptions options) : options_(std::move(options)) {}
+
+CallbackServer::~CallbackServer() { stop(); }
+
+void CallbackServer::add_route(Route route) {
+  if (running_.load()) throw Error(ErrorCode::kInvalidArgument, "routes must be added before start()");
+  if (find_route(route.path) != nullptr) {
+    throw Error(ErrorCode::kInvalidArgument, "duplicate callback route " + route.path);
+  }
+  routes_.push_back(std::move(route));
+}
+
+void CallbackServer::on_stk_callback(std::string path, StkHandler handler) {
+  add_route({std::move(path), Kind::kStk, std::move(handler), {}, {}, {}, {}, {}});
+}
+void CallbackServer::on_c2b_validation(std::string path, ValidationHandler handler) {
+  add_route({std::move(path), Kind::kValidation, {}, std::move(handler), {}, {}, {}, {}});
+}
+void CallbackServer::on_c2b_validation(std::string path, C2BValidator validator) {
+  validation_reply(C2BValidation::kAccept, true);  // render the replies now, not on the first request
+  add_route({std::move(path), Kind::kValidationRules, {}, {}, {}, {}, {}, std::move(validator)});
+}
+void CallbackServer::on_c2b_confirmation(std::string path, ConfirmationHandler handler) {
+  add_route({std::move(path), Kind::kConfirmation, {}, {}, std::move(handler), {}, {}, {}});
+}
+void CallbackServer::on_c2b_confirmation_body(std::string path, BodyHandler handler) {
+  add_route({std::move(path), Kind::kConfirmationBody, {}, {}, {}, {}, std::move(handler), {}});
+}
+void CallbackServer::on_result(std::string path, ResultHandler handler) {
+  add_route({std::move(path), Kind::kResult, {}, {}, {}, std::move(handler), {}, {}});
+}
+void CallbackServer::on_queue_timeout(std::string path, ResultHandler handler) {
+  add_route({std::move(path), Kind::kTimeout, {}, {}, {}, std::move(handler), {}, {}});
+}
+
+const CallbackServer::Route* CallbackServer::find_route(std::string_view path) const noexcept {
+  // A handful of routes: a linear scan beats hashing the path.
+  for (const auto& route : routes_) {
+    if (route.path == path) return &route;
+  }
+  return nullptr;
+}
+
+void CallbackServer::start() {
+  if (running_.exchange(true)) return;
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(options_.port);
+  if (inet_pton(AF_INET, options_.bind_address.c_str(), &addr.sin_addr) != 1) {
+    running_ = false;
+    throw Error(ErrorCode::kInvalidArgument, "bind address must be IPv4: " + options_.bind_address);
+  }
+  listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  const int one = 1;
+  ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::listen(listen_fd_, options_.backlog) != 0) {
+    const std::string reason = std::strerror(errno);
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+    running_ = false;
+    throw Error(ErrorCode::kConnect, "binding " + options_.bind_address + ": " + reason);
+  }
+  socklen_t len = sizeof(addr);
+  ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+  port_ = ntohs(addr.sin_port);
+  // Never read: once written it stays readable and wakes every worker.
+  stop_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  workers_.clear();  // from a previous start(); stats() reads them after stop()
+  unsigned count = options_.workers != 0 ? options_.workers : std::thread::hardware_concurrency();
+  count = std::max(count, 1u);
+  for (unsigned i = 0; i < count; ++i) {
+    auto worker = std::make_unique<Worker>();
+    worker->index = i;
+    worker->epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = &listen_tag;
+    ::epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, listen_fd_, &ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &stop_tag;
+    ::epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, stop_fd_, &ev);
+    workers_.push_back(std::move(worker));
+  }
+  for (auto& worker : workers_) {
+    Worker& w = *worker;
+    w.thread = std::thread([this, &w] { run_worker(w); });
+    if (options_.pin_workers) pin_to_cpu(w.thread, w.index);
+  }
+}
+
+void CallbackServer::stop() {
+  if (!running_.exchange(false)) return;
+  const std::uint64_t one = 1;
+  [[maybe_unused]] const auto n = ::write(stop_fd_, &one, sizeof(one));
+  for (auto& worker : workers_) {
+    if (worker->thread.joinable()) worker->thread.join();
+  }
+  ::close(listen_fd_);
+  ::close(stop_fd_);
+  listen_fd_ = stop_fd_ = -1;
+}
+
+CallbackServerStats CallbackServer::stats() const noexcept {
+  CallbackServerStats s;
+  for (const auto& w : workers_) {
+    s.connections_accepted += w->accepted.load(std::memory_order_relaxed);
+    s.requests += w->requests.load(std::memory_order_relaxed);
+    s.stk_callbacks += w->stk.load(std::memory_order_relaxed);
+    s.c2b_validations += w->validations.load(std::memory_order_relaxed);
+    s.c2b_confirmations += w->confirmations.load(std::memory_order_relaxed);
+    s.results += w->results.load(std::memory_order_relaxed);
+    s.timeouts += w->timeouts.load(std::memory_order_relaxed);
+    s.rejected += w->rejected.load(std::memory_order_relaxed);
+    s.handler_errors += w->handler_errors.load(std::memory_order_relaxed);
+    s.duplicates += w->duplicates.load(std::memory_order_relaxed);
+    s.busy += w->busy.load(std::memory_order_relaxed);
+  }
+  return s;
+}
+
+void CallbackServer::run_worker(Worker& worker) {
+  epoll_event events[kMaxEvents];
+  const auto sweep_every = std::min<SteadyClock::duration>(options_.idle_timeout, std::chrono::seconds(1));
+  worker.next_sweep = SteadyClock::now() + sweep_every;
+  bool stopping = false;
+  while (!stopping) {
+    const int n = ::epoll_wait(worker.epoll_fd, events, kMaxEvents, 1000);
+    worker.now = SteadyClock::now();
+    for (int i = 0; i < n; ++i) {
+      void* tag = events[i].data.ptr;
+      if (tag == &listen_tag) {
+        accept_ready(worker);
+      } else if (tag == &stop_tag) {
+        stopping = true;
+      } else {
+        Peer& peer = *static_cast<Peer*>(tag);
+        const std::uint32_t ev = events[i].events;
+        if ((ev & EPOLLIN) != 0) {
+          if (!read_ready(worker, peer)) continue;
+        } else if ((ev & (EPOLLERR | EPOLLHUP)) != 0) {
+          close(worker, peer);
+          continue;
+        }
+        if ((ev & EPOLLOUT) != 0) flush(worker, peer);
+      }
+    }
+    if (worker.now >= worker.next_sweep) {
+      sweep_idle(worker);
+      worker.next_sweep = worker.now + sweep_every;
+    }
+  }
+  for (auto& [fd, peer] : worker.peers) ::close(fd);
+  worker.peers.clear();
+}
+
+void CallbackServer::accept_ready(Worker& worker) {
+  for (;;) {
+    const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      return;  // EAGAIN: another worker took the rest; EMFILE: retry on next wakeup
+    }
+    const int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    auto peer = std::make_unique<Peer>();
+    peer->fd = fd;
+    peer->out.reserve(kReplyReserve);
+    peer->last_active = worker.now;
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = peer.get();
+    if (::epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      ::close(fd);
+      continue;
+    }
+    worker.peers.emplace(fd, std::move(peer));
+    worker.accepted.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+bool CallbackServer::read_ready(Worker& worker, Peer& peer) {
+  peer.last_active = worker.now;
+  for (;;) {
+    const ssize_t n = ::recv(peer.fd, worker.buffer.data(), worker.buffer.size(), 0);
+    if (n == 0) {
+      close(worker, peer);
+      return false;
+    }
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      close(worker, peer);
+      return false;
+    }
+    const char* data = worker.buffer.data();
+    auto left = static_cast<std::size_t>(n);
+    try {
+      while (left > 0 && !peer.close_after) {
+        const std::size_t used = peer.parser.feed(data, left);
+        data += used;
+        left -= used;
+        if (!peer.parser.done()) break;
+        handle(worker, peer);
+        peer.parser.reset();
+        peer.arena.release();
+      }
+    } catch (const Error&) {
+      worker.rejected.fetch_add(1, std::memory_order_relaxed);
+      append_reply(peer.out, 400, R"({"ResultCode":1,"ResultDesc":"Malformed request"})", false);
+      peer.close_after = true;
+    }
+    if (peer.close_after || static_cast<std::size_t>(n) < worker.buffer.size()) break;
+  }
+  return flush(worker, peer);
+}
+
+MetricEndpoint CallbackServer::metric_endpoint(Kind kind) noexcept {
+  switch (kind) {
+    case Kind::kStk: return MetricEndpoint::kStkCallback;
+    case Kind::kValidation:
+    case Kind::kValidationRules: return MetricEndpoint::kC2BValidation;
+    case Kind::kConfirmation:
+    case Kind::kConfirmationBody: return MetricEndpoint::kC2BConfirmation;
+    case Kind::kResult: return MetricEndpoint::kResultCallback;
+    case Kind::kTimeout: break;
+  }
+  return MetricEndpoint::kQueueTimeout;
+}
+
+void CallbackServer::handle(Worker& worker, Peer& peer) {
+  worker.requests.fetch_add(1, std::memory_order_relaxed);
+  const HttpRequest& request = peer.parser.request();
+  const bool keep_alive = peer.parser.keep_alive();
+  if (!keep_alive) peer.close_after = true;
+
+  std::string_view path = request.target;
+  path = path.substr(0, path.find('?'));
+  const Route* route = find_route(path);
+  if (route == nullptr) {
+    worker.rejected.fetch_add(1, std::memory_order_relaxed);
+    append_reply(peer.out, 404, R"({"ResultCode":1,"ResultDesc":"Unknown callback path"})", keep_alive);
+    return;
+  }
+  if (request.method != "POST") {
+    worker.rejected.fetch_add(1, std::memory_order_relaxed);
+    append_reply(peer.out, 405, R"({"ResultCode":1,"ResultDesc":"POST only"})", keep_alive);
+    return;
+  }
+
+  Metrics* const metrics = options_.metrics;
+  const MetricEndpoint endpoint = metric_endpoint(route->kind);
+  const auto started = metrics != nullptr ? SteadyClock::now() : SteadyClock::time_point{};
+  const auto finish = [&](bool failed) {
+    if (metrics == nullptr) return;
+    const auto elapsed = SteadyClock::now() - started;
+    metrics->record(Phase::kCallbackTotal, elapsed);
+    metrics->count_call(endpoint, elapsed, failed);
+  };
+  bool delivered = false;  // past decoding; a throw now is the handler's
+  const auto decoded = [&] {
+    delivered = true;
+    if (metrics != nullptr) metrics->record(Phase::kCallbackParse, SteadyClock::now() - started);
+  };
+  const auto count_result = [&](auto code) {
+    if (metrics != nullptr) metrics->count_code(endpoint, CodeKind::kResult, code);
+  };
+
+  // Outlives the try block: the claimed ID may point into its scratch.
+  json::Reader reader(request.body, &peer.arena);
+  IdKind id_kind{};
+  std::string_view id;
+  bool in_progress = false;  // a redelivery of a callback still being handled
+  // Claims the ID for this delivery; true if the handler must not run.
+  const auto duplicate = [&](IdKind kind, std::string_view value) {
+    IdempotencyIndex* const index = options_.idempotency;
+    if (index == nullptr) return false;
+    switch (index->claim(kind, value, worker.now)) {
+      case IdClaim::kClaimed:
+        id_kind = kind;
+        id = value;
+        return false;
+      case IdClaim::kPending:
+        in_progress = true;
+        return true;
+      case IdClaim::kDone:
+        break;
+    }
+    worker.duplicates.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  };
+
+  std::string_view body = kAccepted;
+  try {
+    switch (route->kind) {
+      case Kind::kStk: {
+        StkCallback event;
+        read_callback(reader, event);
+        decoded();
+        if (duplicate(IdKind::kCheckoutRequestId, event.checkout_request_id)) break;
+        count_result(event.result_code);
+        worker.stk.fetch_add(1, std::memory_order_relaxed);
+        route->stk(event);
+        break;
+      }
+      case Kind::kValidation: {
+        C2BNotification event;
+        read_callback(reader, event);
+        decoded();
+        worker.validations.fetch_add(1, std::memory_order_relaxed);
+        const C2BValidation decision = route->validation(event);
+        count_result(validation_result_code(decision));
+        body = validation_response_body(decision);
+        break;
+      }
+      case Kind::kValidationRules: {
+        C2BNotification event;
+        read_callback(reader, event);
+        decoded();
+        worker.validations.fetch_add(1, std::memory_order_relaxed);
+        const C2BValidation decision = route->rules.decide(event);
+        count_result(validation_result_code(decision));
+        peer.out.append(validation_reply(decision, keep_alive));
+        finish(false);
+        return;
+      }
+      case Kind::kConfirmation: {
+        C2BNotification event;
+        read_callback(reader, event);
+        decoded();
+        if (duplicate(IdKind::kTransId, event.trans_id)) break;
+        worker.confirmations.fetch_add(1, std::memory_order_relaxed);
+        route->confirmation(event);
+        break;
+      }
+      case Kind::kConfirmationBody: {
+        decoded();
+        if (!route->body(request.body)) {
+          worker.busy.fetch_add(1, std::memory_order_relaxed);
+          append_reply(peer.out, 503, R"({"ResultCode":1,"ResultDesc":"Busy, retry later"})", keep_alive);
+          finish(true);
+          return;
+        }
+        worker.confirmations.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+      case Kind::kResult:
+      case Kind::kTimeout: {
+        ResultCallback event;
+        read_callback(reader, event);
+        decoded();
+        if (duplicate(route->kind == Kind::kResult ? IdKind::kConversationId : IdKind::kTimeoutConversationId,
+                      event.conversation_id)) {
+          break;
+        }
+        count_result(event.result_code);
+        (route->kind == Kind::kResult ? worker.results : worker.timeouts)
+            .fetch_add(1, std::memory_order_relaxed);
+        route->result(event);
+        break;
+      }
+    }
+  } catch (...) {
+    if (delivered) {
+      if (!id.empty()) options_.idempotency->forget(id_kind, id);
+      worker.handler_errors.fetch_add(1, std::memory_order_relaxed);
+      append_reply(peer.out, 500, R"({"ResultCode":1,"ResultDesc":"Handler failed"})", keep_alive);
+    } else {
+      worker.rejected.fetch_add(1, std::memory_order_relaxed);
+      append_reply(peer.out, 400, R"({"ResultCode":1,"ResultDesc":"Malformed payload"})", keep_alive);
+    }
+    finish(true);
+    return;
+  }
+  if (in_progress) {
+    // Acknowledging it would lose the callback if the first handler throws.
+    worker.busy.fetch_add(1, std::memory_order_relaxed);
+    append_reply(peer.out, 503, R"({"ResultCode":1,"ResultDesc":"In progress, retry later"})", keep_alive);
+    finish(true);
+    return;
+  }
+  if (!id.empty()) options_.idempotency->commit(id_kind, id);
+  append_reply(peer.out, 200, body, keep_alive);
+  finish(false);
+}
+
+bool CallbackServer::flush(Worker& worker, Peer& peer) {
+  while (peer.sent < peer.out.size()) {
+    const ssize_t n = ::send(peer.fd, peer.out.data() + peer.sent, peer.out.size() - peer.sent, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        close(worker, peer);
+        return false;
+      }
+      if (!peer.want_write) {
+        // Stop reading until the client drains what it already asked for.
+        epoll_event ev{};
+        ev.events = EPOLLOUT;
+        ev.data.ptr = &peer;
+        ::epoll_ctl(worker.epoll_fd, EPOLL_CTL_MOD, peer.fd, &ev);
+        peer.want_write = true;
+      }
+      return true;
+    }
+    peer.sent += static_cast<std::size_t>(n);
+  }
+  peer.out.clear();
+  peer.sent = 0;
+  if (peer.close_after) {
+    close(worker, peer);
+    return false;
+  }
+  if (peer.want_write) {
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = &peer;
+    ::epoll_ctl(worker.epoll_fd, EPOLL_CTL_MOD, peer.fd, &ev);
+    peer.want_write = false;
+  }
+  return true;
+}
+
+void CallbackServer::close(Worker& worker, Peer& peer) {
+  const int fd = peer.fd;
+  ::close(fd);  // also removes it from the epoll set
+  worker.peers.erase(fd);
+}
+
+void CallbackServer::sweep_idle(Worker& worker) {
+  for (auto it = worker.peers.begin(); it != worker.peers.end();) {
+    Peer& peer = *it->second;
+    if (!peer.want_write && worker.now - peer.last_active > options_.idle_timeout) {
+      ::close(peer.fd);
+      it = worker.peers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace mpesa
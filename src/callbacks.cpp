@@ -0,0 +1,165 @@
+#include "mpesa/callbacks.hpp"
+
+#include <limits>
+#include <optional>
+#include <string>
+#include <tuple>
+
+#include "mpesa/error.hpp"
+#include "mpesa/json_schema.hpp"
+#include "mpesa/money.hpp"
+
+namespace mpesa {
+namespace {
+
+using json::custom;
+using json::field;
+using json::nested;
+
+constexpr int kMissing = std::numeric_limits<int>::min();
+
+struct NamedValue {
+  std::string_view name;
+  std::string_view value;
+};
+
+// CallbackMetadata.Item[]: {"Name": ..., "Value": ...}; "Balance" comes
+// without a value.
+void read_stk_items(json::Reader& reader, StkCallback& out) {
+  static constexpr auto kItem = std::tuple{field("Name", &NamedValue::name), field("Value", &NamedValue::value)};
+  reader.begin_array();
+  while (reader.next_element()) {
+    NamedValue item;
+    json::read_object(reader, item, kItem);
+    if (item.name == "Amount") out.amount = item.value;
+    else if (item.name == "MpesaReceiptNumber") out.mpesa_receipt_number = item.value;
+    else if (item.name == "TransactionDate") out.transaction_date = item.value;
+    else if (item.name == "PhoneNumber") out.phone_number = item.value;
+  }
+}
+
+constexpr auto kStkCallback = std::tuple{nested(
+    "Body",
+    std::tuple{nested(
+        "stkCallback",
+        std::tuple{field("MerchantRequestID", &StkCallback::merchant_request_id),
+                   field("CheckoutRequestID", &StkCallback::checkout_request_id),
+                   field("ResultCode", &StkCallback::result_code),
+                   field("ResultDesc", &StkCallback::result_desc),
+                   nested("CallbackMetadata", std::tuple{custom("Item", &read_stk_items)})})})};
+
+constexpr auto kC2BNotification = std::tuple{
+    field("TransactionType", &C2BNotification::transaction_type),
+    field("TransID", &C2BNotification::trans_id),
+    field("TransTime", &C2BNotification::trans_time),
+    field("TransAmount", &C2BNotification::trans_amount),
+    field("BusinessShortCode", &C2BNotification::business_short_code),
+    field("BillRefNumber", &C2BNotification::bill_ref_number),
+    field("InvoiceNumber", &C2BNotification::invoice_number),
+    field("OrgAccountBalance", &C2BNotification::org_account_balance),
+    field("ThirdPartyTransID", &C2BNotification::third_party_trans_id),
+    field("MSISDN", &C2BNotification::msisdn),
+    field("FirstName", &C2BNotification::first_name),
+    field("MiddleName", &C2BNotification::middle_name),
+    field("LastName", &C2BNotification::last_name)};
+
+// ResultParameters.ResultParameter: an array of {"Key", "Value"}, or a bare
+// object when there is only one.
+void read_result_parameters(json::Reader& reader, ResultCallback& out) {
+  static constexpr auto kParameter =
+      std::tuple{field("Key", &ResultParameter::key), field("Value", &ResultParameter::value)};
+  auto add = [&] {
+    ResultParameter p;
+    json::read_object(reader, p, kParameter);
+    if (out.parameter_count < ResultCallback::kMaxParameters) out.parameter_storage[out.parameter_count++] = p;
+  };
+  if (reader.peek() != json::Value::Type::kArray) {
+    add();
+    return;
+  }
+  reader.begin_array();
+  while (reader.next_element()) add();
+}
+
+constexpr auto kResultCallback = std::tuple{nested(
+    "Result",
+    std::tuple{field("ResultType", &ResultCallback::result_type),
+               field("ResultCode", &ResultCallback::result_code),
+               field("ResultDesc", &ResultCallback::result_desc),
+               field("OriginatorConversationID", &ResultCallback::originator_conversation_id),
+               field("ConversationID", &ResultCallback::conversation_id),
+               field("TransactionID", &ResultCallback::transaction_id),
+               nested("ResultParameters", std::tuple{custom("ResultParameter", &read_result_parameters)})})};
+
+void require(bool present, const char* what) {
+  if (!present) throw Error(ErrorCode::kParse, std::string("callback without ") + what);
+}
+
+}  // namespace
+
+std::string_view validation_response_body(C2BValidation decision) noexcept {
+  switch (decision) {
+    case C2BValidation::kAccept: return R"({"ResultCode":"0","ResultDesc":"Accepted"})";
+    case C2BValidation::kRejectMsisdn: return R"({"ResultCode":"C2B00011","ResultDesc":"Rejected"})";
+    case C2BValidation::kRejectAccount: return R"({"ResultCode":"C2B00012","ResultDesc":"Rejected"})";
+    case C2BValidation::kRejectAmount: return R"({"ResultCode":"C2B00013","ResultDesc":"Rejected"})";
+    case C2BValidation::kRejectKyc: return R"({"ResultCode":"C2B00014","ResultDesc":"Rejected"})";
+    case C2BValidation::kRejectShortCode: return R"({"ResultCode":"C2B00015","ResultDesc":"Rejected"})";
+    case C2BValidation::kRejectOther: break;
+  }
+  return R"({"ResultCode":"C2B00016","ResultDesc":"Rejected"})";
+}
+
+std::string_view validation_result_code(C2BValidation decision) noexcept {
+  switch (decision) {
+    case C2BValidation::kAccept: return "0";
+    case C2BValidation::kRejectMsisdn: return "C2B00011";
+    case C2BValidation::kRejectAccount: return "C2B00012";
+    case C2BValidation::kRejectAmount: return "C2B00013";
+    case C2BValidation::kRejectKyc: return "C2B00014";
+    case C2BValidation::kRejectShortCode: return "C2B00015";
+    case C2BValidation::kRejectOther: break;
+  }
+  return "C2B00016";
+}
+
+std::int64_t parse_amount_cents(std::string_view amount) noexcept {
+  if (!amount.empty() && amount[0] == '-') return -1;
+  const std::optional<Money> money = Money::parse(amount);
+  return money ? money->cents() : -1;
+}
+
+std::string_view ResultCallback::parameter(std::string_view key) const noexcept {
+  for (const auto& p : parameters()) {
+    if (p.key == key) return p.value;
+  }
+  return {};
+}
+
+void read_callback(json::Reader& reader, StkCallback& out) {
+  out = StkCallback{};
+  out.result_code = kMissing;
+  json::read_object(reader, out, kStkCallback);
+  reader.finish();
+  require(out.result_code != kMissing, "ResultCode");
+  require(!out.checkout_request_id.empty(), "CheckoutRequestID");
+}
+
+void read_callback(json::Reader& reader, C2BNotification& out) {
+  out = C2BNotification{};
+  json::read_object(reader, out, kC2BNotification);
+  reader.finish();
+  require(!out.trans_id.empty(), "TransID");
+}
+
+void read_callback(json::Reader& reader, ResultCallback& out) {
+  out.result_type = 0;
+  out.result_code = kMissing;
+  out.result_desc = out.originator_conversation_id = out.conversation_id = out.transaction_id = {};
+  out.parameter_count = 0;
+  json::read_object(reader, out, kResultCallback);
+  reader.finish();
+  require(out.result_code != kMissing, "ResultCode");
+}
+
+}  // namespace mpesa
@@ -0,0 +1,262 @@
+#include "mpesa/connection.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+namespace {
+
+int remaining_ms(Clock::time_point deadline) {
+  const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+  return left.count() <= 0 ? 0 : static_cast<int>(left.count());
+}
+
+bool is_ip_literal(const std::string& host) {
+  unsigned char buf[sizeof(in6_addr)];
+  return inet_pton(AF_INET, host.c_str(), buf) == 1 || inet_pton(AF_INET6, host.c_str(), buf) == 1;
+}
+
+std::string errno_string(const char* what) { return std::string(what) + ": " + std::strerror(errno); }
+
+}  // namespace
+
+std::vector<SocketAddress> resolve(const Endpoint& endpoint) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_ADDRCONFIG;
+  addrinfo* result = nullptr;
+  const std::string port = std::to_string(endpoint.port);
+  const int rc = getaddrinfo(endpoint.host.c_str(), port.c_str(), &hints, &result);
+  if (rc != 0) throw Error(ErrorCode::kResolve, endpoint.host + ": " + gai_strerror(rc));
+
+  std::vector<SocketAddress> out;
+  for (addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+    SocketAddress addr;
+    std::memcpy(&addr.storage, ai->ai_addr, ai->ai_addrlen);
+    addr.length = ai->ai_addrlen;
+    out.push_back(addr);
+  }
+  freeaddrinfo(result);
+  if (out.empty()) throw Error(ErrorCode::kResolve, endpoint.host + ": no addresses");
+  return out;
+}
+
+std::unique_ptr<Connection> Connection::start(const Endpoint& endpoint, const SocketAddress& address,
+                                              IoStatus& status) {
+  const int fd = ::socket(address.storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) throw Error(ErrorCode::kConnect, errno_string("socket"));
+  std::unique_ptr<Connection> conn(new Connection(endpoint, fd));
+  const int one = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&address.storage), address.length) == 0) {
+    status = IoStatus::kDone;
+  } else if (errno == EINPROGRESS) {
+    status = IoStatus::kWantWrite;
+  } else {
+    throw Error(ErrorCode::kConnect, endpoint.authority() + ": " + errno_string("connect"));
+  }
+  return conn;
+}
+
+void Connection::finish_connect() {
+  int so_error = 0;
+  socklen_t len = sizeof(so_error);
+  if (::getsockopt(fd_, SOL_SOCKET, SO_ERROR, &so_error, &len) != 0) so_error = errno;
+  if (so_error != 0) {
+    errno = so_error;
+    throw Error(ErrorCode::kConnect, endpoint_.authority() + ": " + errno_string("connect"));
+  }
+}
+
+std::unique_ptr<Connection> Connection::open(const Endpoint& endpoint,
+                                             const std::vector<SocketAddress>& addresses,
+                                             const TlsContext* tls,
+                                             std::shared_ptr<TlsSessionSlot> session,
+                                             Clock::time_point deadline) {
+  const auto started = Clock::now();
+  std::string last_error = "no addresses";
+  bool timed_out = false;
+  for (const auto& addr : addresses) {
+    std::unique_ptr<Connection> conn;
+    try {
+      IoStatus status;
+      conn = start(endpoint, addr, status);
+      if (status != IoStatus::kDone) {
+        conn->wait(status, deadline);
+        conn->finish_connect();
+      }
+    } catch (const Error& e) {
+      timed_out = e.code() == ErrorCode::kTimeout;
+      last_error = e.what();
+      continue;
+    }
+    const auto connected = Clock::now();
+    conn->timings_.connect = connected - started;
+    if (tls != nullptr) {
+      conn->start_tls(*tls, std::move(session));
+      for (IoStatus status; (status = conn->handshake_step()) != IoStatus::kDone;) {
+        conn->wait(status, deadline);
+      }
+      conn->timings_.tls = Clock::now() - connected;
+    }
+    return conn;
+  }
+  throw Error(timed_out ? ErrorCode::kTimeout : ErrorCode::kConnect,
+              endpoint.authority() + ": " + last_error);
+}
+
+Connection::~Connection() {
+  if (ssl_ != nullptr) {
+    SSL_shutdown(ssl_);  // best effort close_notify; never waits
+    SSL_free(ssl_);
+  }
+  if (fd_ >= 0) ::close(fd_);
+}
+
+void Connection::start_tls(const TlsContext& tls, std::shared_ptr<TlsSessionSlot> session) {
+  ssl_ = SSL_new(tls.native());
+  if (ssl_ == nullptr) throw Error(ErrorCode::kTls, tls_error_string());
+  tls_set_socket(ssl_, fd_);
+
+  if (is_ip_literal(endpoint_.host)) {
+    X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl_), endpoint_.host.c_str());
+  } else {
+    SSL_set_tlsext_host_name(ssl_, endpoint_.host.c_str());
+    SSL_set1_host(ssl_, endpoint_.host.c_str());
+  }
+
+  if (tls.session_resumption() && session) {
+    session_ = std::move(session);
+    SSL_set_ex_data(ssl_, tls_session_slot_index(), session_.get());
+    if (SSL_SESSION* cached = session_->get1()) {
+      SSL_set_session(ssl_, cached);
+      SSL_SESSION_free(cached);
+    }
+  }
+}
+
+IoStatus Connection::handshake_step() {
+  ERR_clear_error();
+  const int rc = SSL_connect(ssl_);
+  if (rc == 1) {
+    timings_.tls_resumed = SSL_session_reused(ssl_) == 1;
+    return IoStatus::kDone;
+  }
+  const int err = SSL_get_error(ssl_, rc);
+  if (err == SSL_ERROR_WANT_READ) return IoStatus::kWantRead;
+  if (err == SSL_ERROR_WANT_WRITE) return IoStatus::kWantWrite;
+  std::string message = tls_error_string();
+  const long verify = SSL_get_verify_result(ssl_);
+  if (verify != X509_V_OK) message += std::string(" (") + X509_verify_cert_error_string(verify) + ")";
+  throw Error(ErrorCode::kTls, endpoint_.authority() + ": handshake failed: " + message);
+}
+
+void Connection::wait(IoStatus status, Clock::time_point deadline) const {
+  pollfd pfd{fd_, static_cast<short>(status == IoStatus::kWantRead ? POLLIN : POLLOUT), 0};
+  for (;;) {
+    const int rc = ::poll(&pfd, 1, remaining_ms(deadline));
+    if (rc > 0) return;
+    if (rc == 0) throw Error(ErrorCode::kTimeout, endpoint_.authority() + ": I/O timed out");
+    if (errno != EINTR) throw Error(ErrorCode::kConnectionClosed, errno_string("poll"));
+  }
+}
+
+IoStatus Connection::write_step(std::string_view& data) {
+  while (!data.empty()) {
+    if (ssl_ != nullptr) {
+      ERR_clear_error();
+      const int rc = SSL_write(ssl_, data.data(), static_cast<int>(data.size()));
+      if (rc > 0) {
+        data.remove_prefix(static_cast<std::size_t>(rc));
+        continue;
+      }
+      const int err = SSL_get_error(ssl_, rc);
+      if (err == SSL_ERROR_WANT_WRITE) return IoStatus::kWantWrite;
+      if (err == SSL_ERROR_WANT_READ) return IoStatus::kWantRead;
+      throw Error(ErrorCode::kConnectionClosed, endpoint_.authority() + ": write failed");
+    }
+    const ssize_t rc = ::send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+    if (rc >= 0) {
+      data.remove_prefix(static_cast<std::size_t>(rc));
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return IoStatus::kWantWrite;
+    } else if (errno != EINTR) {
+      throw Error(ErrorCode::kConnectionClosed, errno_string("send"));
+    }
+  }
+  return IoStatus::kDone;
+}
+
+IoStatus Connection::read_step(char* buffer, std::size_t capacity, std::size_t& n) {
+  n = 0;
+  for (;;) {
+    if (ssl_ != nullptr) {
+      ERR_clear_error();
+      const int rc = SSL_read(ssl_, buffer, static_cast<int>(capacity));
+      if (rc > 0) {
+        n = static_cast<std::size_t>(rc);
+        return IoStatus::kDone;
+      }
+      const int err = SSL_get_error(ssl_, rc);
+      if (err == SSL_ERROR_WANT_READ) return IoStatus::kWantRead;
+      if (err == SSL_ERROR_WANT_WRITE) return IoStatus::kWantWrite;
+      if (err == SSL_ERROR_ZERO_RETURN || (err == SSL_ERROR_SYSCALL && errno == 0)) {
+        return IoStatus::kDone;
+      }
+      throw Error(ErrorCode::kConnectionClosed, endpoint_.authority() + ": read failed");
+    }
+    const ssize_t rc = ::recv(fd_, buffer, capacity, 0);
+    if (rc >= 0) {
+      n = static_cast<std::size_t>(rc);
+      return IoStatus::kDone;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return IoStatus::kWantRead;
+    if (errno != EINTR) throw Error(ErrorCode::kConnectionClosed, errno_string("recv"));
+  }
+}
+
+void Connection::write_all(std::string_view data, Clock::time_point deadline) {
+  for (IoStatus status; (status = write_step(data)) != IoStatus::kDone;) wait(status, deadline);
+}
+
+std::size_t Connection::read_some(char* buffer, std::size_t capacity, Clock::time_point deadline) {
+  std::size_t n = 0;
+  for (IoStatus status; (status = read_step(buffer, capacity, n)) != IoStatus::kDone;) {
+    wait(status, deadline);
+  }
+  return n;
+}
+
+bool Connection::idle_healthy() {
+  pollfd pfd{fd_, POLLIN, 0};
+  if (::poll(&pfd, 1, 0) == 0) return true;
+  if ((pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) return false;
+  if (ssl_ == nullptr) {
+    char byte;
+    const ssize_t rc = ::recv(fd_, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+  // Readable TLS sockets are usually just carrying post-handshake session
+  // tickets. Let OpenSSL consume them; any application data or EOF means the
+  // connection cannot be reused.
+  ERR_clear_error();
+  char byte;
+  const int rc = SSL_read(ssl_, &byte, 1);
+  return rc <= 0 && SSL_get_error(ssl_, rc) == SSL_ERROR_WANT_READ;
+}
+
+}  // namespace mpesa
@@ -0,0 +1,106 @@
+#include "mpesa/connection_pool.hpp"
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+
+ConnectionPool::ConnectionPool(PoolOptions options)
+    : options_(std::move(options)), tls_(TlsContext::client(options_.tls)) {}
+
+ConnectionPool::~ConnectionPool() = default;
+
+ConnectionPool::HostPool& ConnectionPool::host(const Endpoint& endpoint) {
+  std::lock_guard lock(hosts_mutex_);
+  auto& slot = hosts_[endpoint];
+  if (!slot) slot = std::make_unique<HostPool>();
+  return *slot;
+}
+
+ConnectionPool::Lease ConnectionPool::acquire(const Endpoint& endpoint, Clock::time_point deadline) {
+  HostPool& hp = host(endpoint);
+  const auto now = Clock::now();
+  std::vector<SocketAddress> addresses;
+  {
+    std::unique_lock lock(hp.mutex);
+    while (options_.keep_alive && !hp.idle.empty()) {
+      std::unique_ptr<Connection> conn = std::move(hp.idle.back());
+      hp.idle.pop_back();
+      if (now - conn->last_used() > options_.idle_timeout) {
+        stale_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      lock.unlock();
+      // The health probe may consume session tickets, so it runs outside the
+      // host lock.
+      if (conn->idle_healthy()) {
+        reused_.fetch_add(1, std::memory_order_relaxed);
+        return Lease{std::move(conn), true, {}};
+      }
+      stale_.fetch_add(1, std::memory_order_relaxed);
+      conn.reset();
+      lock.lock();
+    }
+    if (!hp.addresses.empty() && now - hp.resolved_at < options_.dns_ttl) addresses = hp.addresses;
+  }
+
+  Lease lease;
+  if (addresses.empty()) {
+    const auto started = Clock::now();
+    addresses = resolve(endpoint);
+    lease.resolve = Clock::now() - started;
+    dns_lookups_.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard lock(hp.mutex);
+    hp.addresses = addresses;
+    hp.resolved_at = Clock::now();
+  }
+
+  const auto connect_deadline = std::min(deadline, Clock::now() + options_.connect_timeout);
+  try {
+    lease.connection = Connection::open(endpoint, addresses, endpoint.tls ? &*tls_ : nullptr,
+                                        hp.session, connect_deadline);
+  } catch (const Error& e) {
+    if (e.code() == ErrorCode::kConnect) {
+      // The host may have moved; resolve again next time.
+      std::lock_guard lock(hp.mutex);
+      hp.addresses.clear();
+    }
+    throw;
+  }
+  opened_.fetch_add(1, std::memory_order_relaxed);
+  if (endpoint.tls) {
+    (lease.connection->timings().tls_resumed ? resumed_handshakes_ : full_handshakes_)
+        .fetch_add(1, std::memory_order_relaxed);
+  }
+  return lease;
+}
+
+void ConnectionPool::release(std::unique_ptr<Connection> connection) {
+  if (!connection || !options_.keep_alive) return;
+  connection->touch();
+  HostPool& hp = host(connection->endpoint());
+  std::lock_guard lock(hp.mutex);
+  if (hp.idle.size() < options_.max_idle_per_endpoint) hp.idle.push_back(std::move(connection));
+}
+
+void ConnectionPool::clear() {
+  std::lock_guard lock(hosts_mutex_);
+  for (auto& [endpoint, hp] : hosts_) {
+    std::lock_guard host_lock(hp->mutex);
+    hp->idle.clear();
+    hp->addresses.clear();
+    hp->session->clear();
+  }
+}
+
+PoolStats ConnectionPool::stats() const noexcept {
+  PoolStats s;
+  s.connections_opened = opened_.load(std::memory_order_relaxed);
+  s.full_handshakes = full_handshakes_.load(std::memory_order_relaxed);
+  s.resumed_handshakes = resumed_handshakes_.load(std::memory_order_relaxed);
+  s.reused = reused_.load(std::memory_order_relaxed);
+  s.discarded_stale = stale_.load(std::memory_order_relaxed);
+  s.dns_lookups = dns_lookups_.load(std::memory_order_relaxed);
+  return s;
+}
+
+}  // namespace mpesa
@@ -0,0 +1,17 @@
+#pragma once
+
+// CPU feature checks shared by the SIMD kernels. Private to the library.
+
+#if defined(__x86_64__) || defined(__i386__)
+
+namespace mpesa::detail {
+
+/// Whether this CPU runs AVX2 code; probed once per process.
+inline bool cpu_has_avx2() noexcept {
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+}
+
+}  // namespace mpesa::detail
+
+#endif
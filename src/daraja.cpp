@@ -0,0 +1,346 @@
+#include "mpesa/daraja.hpp"
+
+#include <charconv>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+
+#include "mpesa/base64.hpp"
+#include "mpesa/error.hpp"
+#include "mpesa/json.hpp"
+#include "mpesa/json_schema.hpp"
+#include "mpesa/stk_password.hpp"
+
+namespace mpesa {
+namespace {
+
+constexpr std::chrono::hours kEastAfricaOffset{3};
+
+/// Appends `"Name":value` members to a JSON object under construction.
+class BodyWriter {
+ public:
+  explicit BodyWriter(std::string& out) : out_(out) { out_.push_back('{'); }
+  ~BodyWriter() { out_.push_back('}'); }
+
+  BodyWriter& field(std::string_view name, std::string_view value) {
+    key(name);
+    json::append_quoted(out_, value);
+    return *this;
+  }
+  BodyWriter& field(std::string_view name, std::int64_t value) {
+    key(name);
+    char digits[24];
+    const auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    out_.append(digits, end);
+    return *this;
+  }
+  BodyWriter& optional(std::string_view name, std::string_view value) {
+    return value.empty() ? *this : field(name, value);
+  }
+
+ private:
+  void key(std::string_view name) {
+    if (out_.back() != '{') out_.push_back(',');
+    json::append_quoted(out_, name);
+    out_.push_back(':');
+  }
+
+  std::string& out_;
+};
+
+using json::field;
+
+struct ErrorBody {
+  std::string request_id;
+  std::string error_code;
+  std::string error_message;
+};
+
+constexpr auto kErrorBody = std::tuple{field("requestId", &ErrorBody::request_id),
+                                       field("errorCode", &ErrorBody::error_code),
+                                       field("errorMessage", &ErrorBody::error_message)};
+
+constexpr auto kStkPushResponse = std::tuple{
+    field("MerchantRequestID", &StkPushResponse::merchant_request_id),
+    field("CheckoutRequestID", &StkPushResponse::checkout_request_id),
+    field("ResponseCode", &StkPushResponse::response_code),
+    field("ResponseDescription", &StkPushResponse::response_description),
+    field("CustomerMessage", &StkPushResponse::customer_message)};
+
+constexpr auto kStkQueryResponse = std::tuple{
+    field("ResponseCode", &StkQueryResponse::response_code),
+    field("ResponseDescription", &StkQueryResponse::response_description),
+    field("MerchantRequestID", &StkQueryResponse::merchant_request_id),
+    field("CheckoutRequestID", &StkQueryResponse::checkout_request_id),
+    field("ResultCode", &StkQueryResponse::result_code),
+    field("ResultDesc", &StkQueryResponse::result_desc)};
+
+constexpr auto kAcceptedResponse = std::tuple{
+    field("OriginatorConversationID", &AcceptedResponse::originator_conversation_id),
+    field("OriginatorCoversationID", &AcceptedResponse::originator_conversation_id),  // sic, C2B register
+    field("ConversationID", &AcceptedResponse::conversation_id),
+    field("ResponseCode", &AcceptedResponse::response_code),
+    field("ResponseDescription", &AcceptedResponse::response_description)};
+
+/// Decodes a 200 reply with `fields`; anything else becomes an `ApiError`.
+template <class Response, class Fields>
+void decode_ok(const HttpResponse& response, Response& out, const Fields& fields) {
+  if (response.status == 200) {
+    json::read_document(response.body, out, fields);
+    return;
+  }
+  ErrorBody error;
+  try {
+    json::read_document(response.body, error, kErrorBody);
+  } catch (const Error&) {
+    // Gateways in front of Daraja sometimes answer with HTML or plain text.
+  }
+  if (error.error_message.empty()) error.error_message = std::string_view(response.body).substr(0, 256);
+  throw ApiError(response.status, std::move(error.error_code), error.error_message, std::move(error.request_id));
+}
+
+/// This thread's password generator for `short_code`, rebuilt if its
+/// passkey changed. Kept per shortcode: a service calling for many of them
+/// (see `TenantRegistry`) takes them in turn on one thread, and a single
+/// cached generator would be rebuilt on almost every call.
+const StkPasswordGenerator& stk_generator(const std::string& short_code, const std::string& passkey) {
+  constexpr std::size_t kMaxGenerators = 4096;
+  thread_local std::unordered_map<std::string, std::unique_ptr<StkPasswordGenerator>> generators;
+  auto it = generators.find(short_code);
+  if (it != generators.end() && it->second->matches(short_code, passkey)) return *it->second;
+  if (it == generators.end()) {
+    if (generators.size() == kMaxGenerators) generators.clear();
+    it = generators.emplace(short_code, nullptr).first;
+  }
+  it->second = std::make_unique<StkPasswordGenerator>(short_code, passkey);
+  return *it->second;
+}
+
+/// Password and timestamp for an STK request. When the timestamp is left to
+/// us they come from this thread's generator for the shortcode; otherwise
+/// (or for oversized credentials) they are computed directly.
+class StkAuth {
+ public:
+  StkAuth(const std::string& short_code, const std::string& passkey, const std::string& timestamp) {
+    if (timestamp.empty() && short_code.size() + passkey.size() <= StkPassword::kMaxPrefixSize) {
+      stk_generator(short_code, passkey).get(cached_);
+      timestamp_ = cached_.timestamp();
+      password_ = cached_.value();
+      return;
+    }
+    if (timestamp.empty()) {
+      write_daraja_timestamp(std::chrono::system_clock::now(), now_);
+      timestamp_ = {now_, kTimestampSize};
+    } else {
+      timestamp_ = timestamp;
+    }
+    thread_local std::string password;
+    password.clear();
+    append_stk_password(password, short_code, passkey, timestamp_);
+    password_ = password;
+  }
+
+  StkAuth(const StkAuth&) = delete;
+  StkAuth& operator=(const StkAuth&) = delete;
+
+  std::string_view timestamp() const noexcept { return timestamp_; }
+  std::string_view password() const noexcept { return password_; }
+
+ private:
+  StkPassword cached_;
+  char now_[kTimestampSize];
+  std::string_view timestamp_;
+  std::string_view password_;
+};
+
+}  // namespace
+
+void write_daraja_timestamp(std::chrono::system_clock::time_point when, char* out) noexcept {
+  using namespace std::chrono;
+  const auto local = floor<seconds>(when) + kEastAfricaOffset;
+  const auto day = floor<days>(local);
+  const year_month_day date{day};
+  const hh_mm_ss time{local - day};
+  const auto put = [&out](unsigned value, int width) {
+    for (int i = width - 1; i >= 0; --i, value /= 10) out[i] = static_cast<char>('0' + value % 10);
+    out += width;
+  };
+  put(static_cast<unsigned>(static_cast<int>(date.year())), 4);
+  put(static_cast<unsigned>(date.month()), 2);
+  put(static_cast<unsigned>(date.day()), 2);
+  put(static_cast<unsigned>(time.hours().count()), 2);
+  put(static_cast<unsigned>(time.minutes().count()), 2);
+  put(static_cast<unsigned>(time.seconds().count()), 2);
+}
+
+std::string daraja_timestamp(std::chrono::system_clock::time_point when) {
+  std::string out(kTimestampSize, '\0');
+  write_daraja_timestamp(when, out.data());
+  return out;
+}
+
+void append_stk_password(std::string& out, std::string_view short_code, std::string_view passkey,
+                         std::string_view timestamp) {
+  thread_local std::string raw;
+  raw.clear();
+  raw.append(short_code).append(passkey).append(timestamp);
+  const std::size_t at = out.size();
+  out.resize(at + base64_encoded_size(raw.size()));
+  base64_encode(raw, out.data() + at);
+}
+
+std::string stk_password(std::string_view short_code, std::string_view passkey,
+                         std::string_view timestamp) {
+  std::string out;
+  append_stk_password(out, short_code, passkey, timestamp);
+  return out;
+}
+
+void write_body(const StkPushRequest& r, std::string& out) {
+  const StkAuth auth(r.business_short_code, r.passkey, r.timestamp);
+  BodyWriter(out)
+      .field("BusinessShortCode", r.business_short_code)
+      .field("Password", auth.password())
+      .field("Timestamp", auth.timestamp())
+      .field("TransactionType", r.transaction_type)
+      .field("Amount", r.amount)
+      .field("PartyA", r.party_a)
+      .field("PartyB", r.party_b.empty() ? r.business_short_code : r.party_b)
+      .field("PhoneNumber", r.phone_number.empty() ? r.party_a : r.phone_number)
+      .field("CallBackURL", r.callback_url)
+      .field("AccountReference", r.account_reference)
+      .field("TransactionDesc", r.transaction_desc);
+}
+
+void write_body(const StkQueryRequest& r, std::string& out) {
+  const StkAuth auth(r.business_short_code, r.passkey, r.timestamp);
+  BodyWriter(out)
+      .field("BusinessShortCode", r.business_short_code)
+      .field("Password", auth.password())
+      .field("Timestamp", auth.timestamp())
+      .field("CheckoutRequestID", r.checkout_request_id);
+}
+
+void write_body(const C2BRegisterUrlRequest& r, std::string& out) {
+  BodyWriter(out)
+      .field("ShortCode", r.short_code)
+      .field("ResponseType", r.response_type)
+      .field("ConfirmationURL", r.confirmation_url)
+      .field("ValidationURL", r.validation_url);
+}
+
+void write_body(const C2BSimulateRequest& r, std::string& out) {
+  BodyWriter(out)
+      .field("ShortCode", r.short_code)
+      .field("CommandID", r.command_id)
+      .field("Amount", r.amount)
+      .field("Msisdn", r.msisdn)
+      .field("BillRefNumber", r.bill_ref_number);
+}
+
+void write_body(const B2CRequest& r, std::string& out) {
+  BodyWriter(out)
+      .optional("OriginatorConversationID", r.originator_conversation_id)
+      .field("InitiatorName", r.initiator_name)
+      .field("SecurityCredential", r.security_credential)
+      .field("CommandID", r.command_id)
+      .field("Amount", r.amount)
+      .field("PartyA", r.party_a)
+      .field("PartyB", r.party_b)
+      .field("Remarks", r.remarks)
+      .field("QueueTimeOutURL", r.queue_timeout_url)
+      .field("ResultURL", r.result_url)
+      .field("Occassion", r.occasion);  // sic: Daraja's spelling
+}
+
+void write_body(const B2BRequest& r, std::string& out) {
+  BodyWriter(out)
+      .field("Initiator", r.initiator)
+      .field("SecurityCredential", r.security_credential)
+      .field("CommandID", r.command_id)
+      .field("SenderIdentifierType", r.sender_identifier_type)
+      .field("RecieverIdentifierType", r.receiver_identifier_type)  // sic
+      .field("Amount", r.amount)
+      .field("PartyA", r.party_a)
+      .field("PartyB", r.party_b)
+      .field("AccountReference", r.account_reference)
+      .optional("Requester", r.requester)
+      .field("Remarks", r.remarks)
+      .field("QueueTimeOutURL", r.queue_timeout_url)
+      .field("ResultURL", r.result_url);
+}
+
+void write_body(const TransactionStatusRequest& r, std::string& out) {
+  BodyWriter(out)
+      .field("Initiator", r.initiator)
+      .field("SecurityCredential", r.security_credential)
+      .field("CommandID", r.command_id)
+      .field("TransactionID", r.transaction_id)
+      .optional("OriginalConversationID", r.original_conversation_id)
+      .field("PartyA", r.party_a)
+      .field("IdentifierType", r.identifier_type)
+      .field("ResultURL", r.result_url)
+      .field("QueueTimeOutURL", r.queue_timeout_url)
+      .field("Remarks", r.remarks)
+      .field("Occasion", r.occasion);
+}
+
+void write_body(const AccountBalanceRequest& r, std::string& out) {
+  BodyWriter(out)
+      .field("Initiator", r.initiator)
+      .field("SecurityCredential", r.security_credential)
+      .field("CommandID", r.command_id)
+      .field("PartyA", r.party_a)
+      .field("IdentifierType", r.identifier_type)
+      .field("Remarks", r.remarks)
+      .field("QueueTimeOutURL", r.queue_timeout_url)
+      .field("ResultURL", r.result_url);
+}
+
+void write_body(const ReversalRequest& r, std::string& out) {
+  BodyWriter(out)
+      .field("Initiator", r.initiator)
+      .field("SecurityCredential", r.security_credential)
+      .field("CommandID", r.command_id)
+      .field("TransactionID", r.transaction_id)
+      .field("Amount", r.amount)
+      .field("ReceiverParty", r.receiver_party)
+      .field("RecieverIdentifierType", r.receiver_identifier_type)  // sic
+      .field("ResultURL", r.result_url)
+      .field("QueueTimeOutURL", r.queue_timeout_url)
+      .field("Remarks", r.remarks)
+      .field("Occasion", r.occasion);
+}
+
+HttpRequest make_api_request(std::string_view path, std::string_view access_token, std::string_view body) {
+  HttpRequest request;
+  reset_api_request(request, path, access_token);
+  request.body.assign(body);
+  return request;
+}
+
+void reset_api_request(HttpRequest& out, std::string_view path, std::string_view access_token) {
+  out.method.assign("POST");
+  out.target.assign(path);
+  out.headers.resize(2);
+  out.headers[0].name.assign("Authorization");
+  out.headers[0].value.assign("Bearer ").append(access_token);
+  out.headers[1].name.assign("Content-Type");
+  out.headers[1].value.assign("application/json");
+  out.body.clear();
+}
+
+void read_response(const HttpResponse& response, StkPushResponse& out) {
+  decode_ok(response, out, kStkPushResponse);
+}
+
+void read_response(const HttpResponse& response, StkQueryResponse& out) {
+  decode_ok(response, out, kStkQueryResponse);
+}
+
+void read_response(const HttpResponse& response, AcceptedResponse& out) {
+  decode_ok(response, out, kAcceptedResponse);
+}
+
+}  // namespace mpesa
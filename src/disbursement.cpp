@@ -0,0 +1,432 @@
+#include "mpesa/disbursement.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <utility>
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+namespace {
+
+// Daraja's gateway answers over-quota callers with these instead of a 429.
+constexpr std::string_view kSpikeArrest = "500.003.02";
+constexpr std::string_view kQuotaViolation = "500.003.03";
+
+constexpr std::size_t slot(DisbursementStatus status) noexcept { return static_cast<std::size_t>(status); }
+
+bool finished(DisbursementStatus status) noexcept {
+  return status == DisbursementStatus::kSucceeded || status == DisbursementStatus::kFailed;
+}
+
+/// Splits one CSV line into `out`, honouring double quotes.
+bool split_csv(std::string_view line, std::vector<std::string>& out) {
+  out.clear();
+  std::size_t i = 0;
+  while (true) {
+    std::string& field = out.emplace_back();
+    if (i < line.size() && line[i] == '"') {
+      for (++i;; ++i) {
+        if (i == line.size()) return false;  // unterminated quote
+        if (line[i] == '"') {
+          if (i + 1 < line.size() && line[i + 1] == '"') {
+            field.push_back('"');
+            ++i;
+          } else {
+            ++i;
+            break;
+          }
+        } else {
+          field.push_back(line[i]);
+        }
+      }
+      if (i < line.size() && line[i] != ',') return false;
+    } else {
+      const std::size_t end = std::min(line.find(',', i), line.size());
+      field.assign(line.substr(i, end - i));
+      i = end;
+    }
+    if (i == line.size()) return true;
+    ++i;  // ','
+  }
+}
+
+}  // namespace
+
+const char* to_string(DisbursementStatus status) noexcept {
+  switch (status) {
+    case DisbursementStatus::kPending: return "pending";
+    case DisbursementStatus::kAccepted: return "accepted";
+    case DisbursementStatus::kSucceeded: return "succeeded";
+    case DisbursementStatus::kFailed: return "failed";
+    case DisbursementStatus::kRejected: return "rejected";
+    case DisbursementStatus::kUnconfirmed: return "unconfirmed";
+  }
+  return "unknown";
+}
+
+double DisbursementReport::accept_rate() const noexcept {
+  const double seconds = submit_time.count();
+  return seconds > 0 ? static_cast<double>(accept_latency.count()) / seconds : 0;
+}
+
+double DisbursementReport::completion_rate() const noexcept {
+  const double seconds = completion_time.count();
+  return seconds > 0 ? static_cast<double>(completion_latency.count()) / seconds : 0;
+}
+
+CsvDisbursementSource::CsvDisbursementSource(std::istream& in, B2CRequest defaults)
+    : in_(in), defaults_(std::move(defaults)) {}
+
+void CsvDisbursementSource::read_header() {
+  while (std::getline(in_, line_)) {
+    ++line_number_;
+    if (!line_.empty() && line_.back() == '\r') line_.pop_back();
+    if (!line_.empty()) break;
+  }
+  if (line_.empty() || !split_csv(line_, fields_)) throw Error(ErrorCode::kParse, "CSV without a header line");
+  bool has_party_b = false;
+  bool has_amount = false;
+  for (const std::string& name : fields_) {
+    if (name == "PartyB") {
+      columns_.push_back(Column::kPartyB);
+      has_party_b = true;
+    } else if (name == "Amount") {
+      columns_.push_back(Column::kAmount);
+      has_amount = true;
+    } else if (name == "Remarks") {
+      columns_.push_back(Column::kRemarks);
+    } else if (name == "Occasion") {
+      columns_.push_back(Column::kOccasion);
+    } else if (name == "CommandID") {
+      columns_.push_back(Column::kCommandId);
+    } else if (name == "OriginatorConversationID") {
+      columns_.push_back(Column::kOriginatorId);
+    } else {
+      throw Error(ErrorCode::kParse, "CSV line " + std::to_string(line_number_) + ": unknown column '" + name + "'");
+    }
+  }
+  if (!has_party_b || !has_amount) throw Error(ErrorCode::kParse, "CSV header needs PartyB and Amount columns");
+}
+
+bool CsvDisbursementSource::operator()(B2CRequest& out) {
+  if (columns_.empty()) read_header();
+  do {
+    if (!std::getline(in_, line_)) return false;
+    ++line_number_;
+    if (!line_.empty() && line_.back() == '\r') line_.pop_back();
+  } while (line_.empty());
+
+  const auto fail = [&](const std::string& what) {
+    throw Error(ErrorCode::kParse, "CSV line " + std::to_string(line_number_) + ": " + what);
+  };
+  if (!split_csv(line_, fields_)) fail("unbalanced quotes");
+  if (fields_.size() != columns_.size()) {
+    fail("expected " + std::to_string(columns_.size()) + " fields, got " + std::to_string(fields_.size()));
+  }
+  out = defaults_;
+  for (std::size_t i = 0; i < columns_.size(); ++i) {
+    std::string& field = fields_[i];
+    switch (columns_[i]) {
+      case Column::kPartyB: out.party_b = std::move(field); break;
+      case Column::kAmount: {
+        const auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), out.amount);
+        if (ec != std::errc() || end != field.data() + field.size() || out.amount <= 0) {
+          fail("bad Amount '" + field + "'");
+        }
+        break;
+      }
+      case Column::kRemarks: out.remarks = std::move(field); break;
+      case Column::kOccasion: out.occasion = std::move(field); break;
+      case Column::kCommandId: out.command_id = std::move(field); break;
+      case Column::kOriginatorId: out.originator_conversation_id = std::move(field); break;
+    }
+  }
+  return true;
+}
+
+DisbursementEngine::DisbursementEngine(AsyncDarajaClient& daraja, DisbursementOptions options)
+    : daraja_(daraja), options_(std::move(options)) {
+  if (options_.id_prefix.empty()) {
+    char buf[32];
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    std::snprintf(buf, sizeof(buf), "bulk-%llx",
+                  static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::microseconds>(now).count()));
+    options_.id_prefix = buf;
+  }
+  options_.concurrency = std::max(1u, options_.concurrency);
+  options_.max_attempts = std::max(1u, options_.max_attempts);
+}
+
+Task<DisbursementReport> DisbursementEngine::run(DisbursementSource source) {
+  if (running_ != 0) throw Error(ErrorCode::kInvalidArgument, "a disbursement run is already in progress");
+  {
+    std::lock_guard lock(mutex_);
+    submitting_ = true;
+    started_ = Clock::now();
+  }
+  source_done_ = false;
+  source_error_ = nullptr;
+  running_ = options_.concurrency;
+  for (unsigned i = 0; i < options_.concurrency; ++i) daraja_.loop().spawn(worker(source));
+  co_await JoinAwaiter{*this};
+  {
+    std::lock_guard lock(mutex_);
+    submitting_ = false;
+  }
+  results_cv_.notify_all();
+  if (source_error_) std::rethrow_exception(source_error_);
+  co_return report();
+}
+
+Task<DisbursementReport> DisbursementEngine::run(std::vector<B2CRequest> batch) {
+  std::size_t next = 0;
+  // Named rather than awaited as a temporary; see AsyncHttpClient::connect.
+  auto all = run(DisbursementSource([&batch, &next](B2CRequest& out) {
+    if (next == batch.size()) return false;
+    out = std::move(batch[next++]);
+    return true;
+  }));
+  co_return co_await std::move(all);
+}
+
+Task<void> DisbursementEngine::worker(DisbursementSource& source) {
+  while (!source_done_) {
+    B2CRequest request;
+    bool more = false;
+    try {
+      more = source(request);
+    } catch (...) {
+      source_error_ = std::current_exception();
+    }
+    if (!more) {
+      source_done_ = true;
+      break;
+    }
+    co_await submit(add(std::move(request)));
+  }
+  if (--running_ == 0 && join_) daraja_.loop().schedule(std::exchange(join_, {}));
+}
+
+std::size_t DisbursementEngine::add(B2CRequest request) {
+  std::lock_guard lock(mutex_);
+  const std::size_t index = items_.size();
+  if (request.originator_conversation_id.empty()) {
+    // Skip IDs a caller already used; one that appears later is rejected.
+    std::string id = options_.id_prefix + "-" + std::to_string(index);
+    for (unsigned n = 1; index_.contains(id); ++n) {
+      id = options_.id_prefix + "-" + std::to_string(index) + "-" + std::to_string(n);
+    }
+    request.originator_conversation_id = std::move(id);
+  }
+  const bool unique = index_.emplace(request.originator_conversation_id, index).second;
+  Disbursement& item = items_.emplace_back();
+  item.request = std::move(request);
+  ++by_status_[slot(DisbursementStatus::kPending)];
+  if (!unique) {
+    // Results are matched by this ID, so a second transfer under it could
+    // never be told apart from the first: refuse it before it is sent.
+    item.error = "duplicate OriginatorConversationID";
+    set_status(item, DisbursementStatus::kRejected);
+  }
+  return index;
+}
+
+Task<void> DisbursementEngine::submit(std::size_t index) {
+  B2CRequest request;
+  {
+    std::lock_guard lock(mutex_);
+    if (items_[index].status != DisbursementStatus::kPending) co_return;
+    request = items_[index].request;
+  }
+  if (request.amount <= 0) {
+    reject(index, "Amount must be positive");
+    co_return;
+  }
+  EventLoop& loop = daraja_.loop();
+  if (RequestJournal* journal = options_.journal) {
+    const RequestJournal::Ticket ticket =
+        journal->submitted(MetricEndpoint::kB2C, request.originator_conversation_id, render_body(request));
+    if (!journal->durable(ticket)) {
+      // Named rather than a temporary; see AsyncHttpClient::connect.
+      auto durable = loop.run_blocking([journal, ticket] { journal->wait_durable(ticket); });
+      co_await durable;
+    }
+  }
+  for (unsigned attempt = 1;; ++attempt) {
+    co_await loop.sleep_until(reserve_slot());
+    {
+      std::lock_guard lock(mutex_);
+      Disbursement& item = items_[index];
+      if (item.attempts++ == 0) item.submitted_at = Clock::now();
+      ++attempts_;
+    }
+    AcceptedResponse response;
+    std::exception_ptr error;
+    try {
+      response = co_await daraja_.b2c(request);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    if (!error) {
+      if (RequestJournal* journal = options_.journal) {
+        if (response.accepted()) {
+          journal->accepted(request.originator_conversation_id, response.conversation_id);
+        } else {
+          journal->finished(request.originator_conversation_id, -1);
+        }
+      }
+      accept(index, response);
+      co_return;
+    }
+    Failure failure = classify(error);
+    if (failure.throttled) {
+      // Everyone waits, not just this worker: the quota is per app.
+      next_slot_ = std::max(next_slot_, Clock::now() + options_.retry_backoff);
+    }
+    const bool retry = failure.retry && attempt < options_.max_attempts;
+    {
+      std::lock_guard lock(mutex_);
+      if (failure.throttled) ++throttled_;
+      if (retry) ++retries_;
+    }
+    if (!retry && !failure.settled) {
+      // The transfer may have gone through; it stays in flight in the
+      // journal for a status query.
+      unconfirmed(index, std::move(failure.message));
+      co_return;
+    }
+    if (!retry) {
+      if (options_.journal != nullptr) options_.journal->finished(request.originator_conversation_id, -1);
+      reject(index, std::move(failure.message));
+      co_return;
+    }
+    co_await loop.sleep_for(options_.retry_backoff * (1 << std::min(attempt - 1, 10u)));
+  }
+}
+
+Clock::time_point DisbursementEngine::reserve_slot() {
+  const Clock::time_point at = std::max(Clock::now(), next_slot_);
+  if (options_.max_rate > 0) {
+    next_slot_ = at + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options_.max_rate));
+  }
+  return at;
+}
+
+void DisbursementEngine::accept(std::size_t index, const AcceptedResponse& response) {
+  if (!response.accepted()) {
+    reject(index, "ResponseCode " + response.response_code + ": " + response.response_description);
+    return;
+  }
+  const Clock::time_point now = Clock::now();
+  std::lock_guard lock(mutex_);
+  Disbursement& item = items_[index];
+  item.accepted_at = now;
+  if (item.conversation_id.empty()) item.conversation_id = response.conversation_id;
+  if (!response.conversation_id.empty()) index_.emplace(response.conversation_id, index);
+  if (!response.originator_conversation_id.empty()) index_.emplace(response.originator_conversation_id, index);
+  accept_latency_.record(now - item.submitted_at);
+  submitted_ = now;
+  // The result callback can beat the API reply.
+  if (item.status == DisbursementStatus::kPending) set_status(item, DisbursementStatus::kAccepted);
+}
+
+void DisbursementEngine::reject(std::size_t index, std::string reason) {
+  std::lock_guard lock(mutex_);
+  Disbursement& item = items_[index];
+  item.error = std::move(reason);
+  submitted_ = Clock::now();
+  if (item.status == DisbursementStatus::kPending) set_status(item, DisbursementStatus::kRejected);
+}
+
+void DisbursementEngine::unconfirmed(std::size_t index, std::string reason) {
+  std::lock_guard lock(mutex_);
+  Disbursement& item = items_[index];
+  item.error = std::move(reason);
+  submitted_ = Clock::now();
+  if (item.status == DisbursementStatus::kPending) set_status(item, DisbursementStatus::kUnconfirmed);
+}
+
+void DisbursementEngine::set_status(Disbursement& item, DisbursementStatus status) {
+  --by_status_[slot(item.status)];
+  ++by_status_[slot(status)];
+  item.status = status;
+}
+
+DisbursementEngine::Failure DisbursementEngine::classify(std::exception_ptr error) {
+  try {
+    std::rethrow_exception(std::move(error));
+  } catch (const ApiError& e) {
+    // Throttling is decided at the gateway, before the request reaches the
+    // payment system. Any other 5xx may come after it has.
+    const bool throttled =
+        e.http_status() == 429 || e.error_code() == kSpikeArrest || e.error_code() == kQuotaViolation;
+    return {throttled, throttled, throttled || e.http_status() < 500, e.what()};
+  } catch (const Error& e) {
+    if (e.sent()) return {false, false, false, e.what()};
+    // Not sent: refused locally, or failed resolving, connecting, in the
+    // TLS handshake or waiting for a connection. A parse error is a reply
+    // that could not be read, so the outcome is unknown.
+    const bool before_send =
+        e.transient() || e.code() == ErrorCode::kInvalidArgument || e.code() == ErrorCode::kAuth;
+    return {e.transient(), false, before_send, e.what()};
+  } catch (const std::exception& e) {
+    return {false, false, false, e.what()};
+  }
+}
+
+bool DisbursementEngine::on_result(const ResultCallback& result) {
+  const Clock::time_point now = Clock::now();
+  {
+    std::lock_guard lock(mutex_);
+    auto it = index_.find(result.originator_conversation_id);
+    if (it == index_.end()) it = index_.find(result.conversation_id);
+    if (it == index_.end()) return false;
+    Disbursement& item = items_[it->second];
+    if (finished(item.status)) return true;  // redelivery
+    item.result_code = result.result_code;
+    item.result_desc.assign(result.result_desc);
+    item.transaction_id.assign(result.transaction_id);
+    item.completed_at = now;
+    if (item.conversation_id.empty()) item.conversation_id.assign(result.conversation_id);
+    completion_latency_.record(now - item.submitted_at);
+    last_result_ = now;
+    set_status(item, result.succeeded() ? DisbursementStatus::kSucceeded : DisbursementStatus::kFailed);
+    if (options_.journal != nullptr) {
+      options_.journal->finished(item.request.originator_conversation_id, result.result_code);
+    }
+  }
+  results_cv_.notify_all();
+  return true;
+}
+
+bool DisbursementEngine::wait_for_results(std::chrono::milliseconds timeout) {
+  std::unique_lock lock(mutex_);
+  return results_cv_.wait_for(lock, timeout, [&] {
+    return !submitting_ && by_status_[slot(DisbursementStatus::kPending)] == 0 &&
+           by_status_[slot(DisbursementStatus::kAccepted)] == 0;
+  });
+}
+
+DisbursementReport DisbursementEngine::report() const {
+  std::lock_guard lock(mutex_);
+  DisbursementReport r;
+  r.total = items_.size();
+  r.by_status = by_status_;
+  r.attempts = attempts_;
+  r.retries = retries_;
+  r.throttled = throttled_;
+  if (submitted_ > started_) r.submit_time = submitted_ - started_;
+  if (last_result_ > started_) r.completion_time = last_result_ - started_;
+  r.accept_latency = accept_latency_;
+  r.completion_latency = completion_latency_;
+  return r;
+}
+
+void DisbursementEngine::visit(const std::function<void(const Disbursement&)>& fn) const {
+  std::lock_guard lock(mutex_);
+  for (const Disbursement& item : items_) fn(item);
+}
+
+}  // namespace mpesa
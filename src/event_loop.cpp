@@ -0,0 +1,257 @@
+#include "mpesa/event_loop.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+
+struct EventLoop::Detached {
+  struct promise_type {
+    Detached get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+EventLoop::Detached EventLoop::run_detached(EventLoop* loop, Task<void> task) {
+  try {
+    co_await std::move(task);
+  } catch (...) {
+    loop->report(std::current_exception());
+  }
+  loop->task_finished();
+}
+
+EventLoop::EventLoop() {
+  epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epoll_fd_ < 0 || wake_fd_ < 0) {
+    throw Error(ErrorCode::kInternal, std::string("creating event loop: ") + std::strerror(errno));
+  }
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = wake_fd_;
+  ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+}
+
+EventLoop::~EventLoop() {
+  {
+    std::lock_guard lock(blocking_mutex_);
+    blocking_stop_ = true;
+  }
+  blocking_cv_.notify_all();
+  if (blocking_thread_.joinable()) blocking_thread_.join();
+  ::close(wake_fd_);
+  ::close(epoll_fd_);
+}
+
+void EventLoop::stop() {
+  stop_requested_.store(true, std::memory_order_release);
+  const std::uint64_t one = 1;
+  [[maybe_unused]] const auto n = ::write(wake_fd_, &one, sizeof(one));
+}
+
+void EventLoop::post(std::function<void()> fn) {
+  {
+    std::lock_guard lock(posted_mutex_);
+    posted_.push_back(std::move(fn));
+  }
+  const std::uint64_t one = 1;
+  [[maybe_unused]] const auto n = ::write(wake_fd_, &one, sizeof(one));
+}
+
+EventLoop::TimerId EventLoop::call_at(Clock::time_point when, std::function<void()> fn) {
+  const TimerId id = next_timer_++;
+  timers_.emplace(id, std::move(fn));
+  timer_heap_.push_back({when, id});
+  std::push_heap(timer_heap_.begin(), timer_heap_.end(), std::greater<>{});
+  return id;
+}
+
+void EventLoop::cancel(TimerId id) noexcept { timers_.erase(id); }
+
+void EventLoop::spawn(Task<void> task) {
+  ++active_tasks_;
+  run_detached(this, std::move(task));
+}
+
+void EventLoop::report(std::exception_ptr error) noexcept {
+  if (!pending_error_) pending_error_ = error;
+}
+
+void EventLoop::add_io_waiter(IoAwaiter* waiter) {
+  FdState& state = fds_[waiter->fd];
+  (waiter->io == Io::kRead ? state.reader : state.writer) = waiter;
+  if (waiter->deadline != Clock::time_point::max()) {
+    waiter->timer = call_at(waiter->deadline, [this, waiter] {
+      auto it = fds_.find(waiter->fd);
+      if (it != fds_.end()) {
+        IoAwaiter*& slot = waiter->io == Io::kRead ? it->second.reader : it->second.writer;
+        if (slot == waiter) slot = nullptr;
+      }
+      waiter->ready = false;
+      waiter->handle.resume();
+    });
+  }
+  set_interest(waiter->fd, state,
+               state.registered | (waiter->io == Io::kRead ? EPOLLIN : EPOLLOUT));
+}
+
+// Interest is dropped lazily: a woken waiter usually waits for the same
+// event again, so bits stay registered until an event fires with nobody
+// waiting for it. That saves two epoll_ctl calls per request.
+void EventLoop::set_interest(int fd, FdState& state, std::uint32_t wanted) {
+  if (state.added && wanted == state.registered) return;
+  epoll_event ev{};
+  ev.events = wanted;
+  ev.data.fd = fd;
+  if (!state.added) {
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      throw Error(ErrorCode::kInternal, std::string("epoll_ctl: ") + std::strerror(errno));
+    }
+    state.added = true;
+  } else if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) != 0 && errno == ENOENT) {
+    // The fd was closed and reused without forget_fd(); register it afresh.
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+  }
+  state.registered = wanted;
+}
+
+void EventLoop::forget_fd(int fd) noexcept {
+  auto it = fds_.find(fd);
+  if (it == fds_.end()) return;
+  if (it->second.added) ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  fds_.erase(it);
+}
+
+void EventLoop::dispatch_io(int fd, std::uint32_t events, std::vector<std::coroutine_handle<>>& ready) {
+  auto it = fds_.find(fd);
+  if (it == fds_.end()) return;
+  FdState& state = it->second;
+  const bool error = (events & (EPOLLERR | EPOLLHUP)) != 0;
+  std::uint32_t unwanted = 0;
+  auto wake = [&](IoAwaiter*& slot, std::uint32_t bit) {
+    if (!error && (events & bit) == 0) return;
+    if (slot == nullptr) {
+      unwanted |= bit;
+      return;
+    }
+    IoAwaiter* waiter = std::exchange(slot, nullptr);
+    if (waiter->timer != 0) cancel(waiter->timer);
+    waiter->ready = true;
+    ready.push_back(waiter->handle);
+  };
+  const std::size_t woken = ready.size();
+  wake(state.reader, EPOLLIN);
+  wake(state.writer, EPOLLOUT);
+  if (error && ready.size() == woken) {
+    // Errors are reported regardless of interest; stop watching the fd until
+    // someone waits on it again, or an idle broken socket would spin the loop.
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    state.added = false;
+    state.registered = 0;
+  } else if (unwanted != 0) {
+    set_interest(fd, state, state.registered & ~unwanted);
+  }
+}
+
+void EventLoop::run_due_timers() {
+  const auto now = Clock::now();
+  while (!timer_heap_.empty() && timer_heap_.front().when <= now) {
+    std::pop_heap(timer_heap_.begin(), timer_heap_.end(), std::greater<>{});
+    const TimerId id = timer_heap_.back().id;
+    timer_heap_.pop_back();
+    auto it = timers_.find(id);
+    if (it == timers_.end()) continue;  // cancelled
+    std::function<void()> fn = std::move(it->second);
+    timers_.erase(it);
+    fn();
+  }
+}
+
+void EventLoop::drain_posted() {
+  std::uint64_t count;
+  while (::read(wake_fd_, &count, sizeof(count)) > 0) {
+  }
+  std::vector<std::function<void()>> batch;
+  {
+    std::lock_guard lock(posted_mutex_);
+    batch.swap(posted_);
+  }
+  for (auto& fn : batch) fn();
+}
+
+void EventLoop::run() {
+  std::vector<epoll_event> events(256);
+  std::vector<std::coroutine_handle<>> ready;
+  while (!stop_requested_.load(std::memory_order_acquire)) {
+    int timeout = scheduled_.empty() ? -1 : 0;
+    // Drop cancelled timers from the top so they don't cause early wakeups.
+    while (!timer_heap_.empty() && !timers_.count(timer_heap_.front().id)) {
+      std::pop_heap(timer_heap_.begin(), timer_heap_.end(), std::greater<>{});
+      timer_heap_.pop_back();
+    }
+    if (timeout != 0 && !timer_heap_.empty()) {
+      const auto wait = timer_heap_.front().when - Clock::now();
+      timeout = wait <= Clock::duration::zero()
+                    ? 0
+                    : static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(wait).count());
+    }
+    const int n = ::epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), timeout);
+    if (n < 0 && errno != EINTR) {
+      throw Error(ErrorCode::kInternal, std::string("epoll_wait: ") + std::strerror(errno));
+    }
+    ready.clear();
+    bool woken = false;
+    for (int i = 0; i < n; ++i) {
+      if (events[i].data.fd == wake_fd_) {
+        woken = true;
+      } else {
+        dispatch_io(events[i].data.fd, events[i].events, ready);
+      }
+    }
+    for (auto h : ready) h.resume();
+    if (!scheduled_.empty()) {
+      ready.clear();
+      ready.swap(scheduled_);
+      for (auto h : ready) h.resume();
+    }
+    if (woken) drain_posted();
+    run_due_timers();
+    if (pending_error_) std::rethrow_exception(std::exchange(pending_error_, nullptr));
+  }
+  stop_requested_.store(false, std::memory_order_relaxed);
+}
+
+void EventLoop::submit_blocking(std::function<void()> job) {
+  {
+    std::lock_guard lock(blocking_mutex_);
+    blocking_jobs_.push_back(std::move(job));
+    if (!blocking_thread_.joinable()) {
+      blocking_thread_ = std::thread([this] {
+        std::unique_lock lock(blocking_mutex_);
+        for (;;) {
+          blocking_cv_.wait(lock, [this] { return blocking_stop_ || !blocking_jobs_.empty(); });
+          if (blocking_jobs_.empty()) return;
+          std::function<void()> next = std::move(blocking_jobs_.front());
+          blocking_jobs_.pop_front();
+          lock.unlock();
+          next();
+          lock.lock();
+        }
+      });
+    }
+  }
+  blocking_cv_.notify_one();
+}
+
+}  // namespace mpesa
@@ -0,0 +1,56 @@
+#include "mpesa/histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mpesa {
+
+void Histogram::merge(const Histogram& other) noexcept {
+  for (std::size_t i = 0; i < kBuckets; ++i) counts_[i] += other.counts_[i];
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+void Histogram::merge(std::span<const std::uint64_t, kBuckets> counts, std::uint64_t sum, std::uint64_t min,
+                      std::uint64_t max) noexcept {
+  std::uint64_t total = 0;
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    counts_[i] += counts[i];
+    total += counts[i];
+  }
+  if (total == 0) return;
+  count_ += total;
+  sum_ += sum;
+  min_ = std::min(min_, min);
+  max_ = std::max(max_, max);
+}
+
+std::uint64_t Histogram::bucket_upper(std::size_t bucket) noexcept {
+  if (bucket < kSubBuckets) return bucket;
+  const std::size_t shift = bucket / kSubBuckets - 1;
+  const std::uint64_t lower = (kSubBuckets + bucket % kSubBuckets) << shift;
+  return lower + ((std::uint64_t{1} << shift) - 1);
+}
+
+std::uint64_t Histogram::percentile(double q) const noexcept {
+  if (count_ == 0) return 0;
+  const auto rank = static_cast<std::uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(count_)));
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    seen += counts_[i];
+    if (seen >= std::max<std::uint64_t>(rank, 1)) return std::min(bucket_upper(i), max_);
+  }
+  return max_;
+}
+
+std::uint64_t Histogram::count_at_most(std::uint64_t value) const noexcept {
+  const std::size_t last = bucket_of(value);
+  std::uint64_t n = 0;
+  for (std::size_t i = 0; i < last; ++i) n += counts_[i];
+  if (bucket_upper(last) <= value) n += counts_[last];
+  return n;
+}
+
+}  // namespace mpesa
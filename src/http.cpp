@@ -0,0 +1,312 @@
+#include "mpesa/http.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <memory>
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+namespace {
+
+char lower(char c) noexcept { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+
+std::string_view trim(std::string_view s) noexcept {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+  return s;
+}
+
+bool contains_token(std::string_view list, std::string_view token) noexcept {
+  while (!list.empty()) {
+    const auto comma = list.find(',');
+    if (iequals(trim(list.substr(0, comma)), token)) return true;
+    if (comma == std::string_view::npos) break;
+    list.remove_prefix(comma + 1);
+  }
+  return false;
+}
+
+const char* default_reason(int status) noexcept {
+  switch (status) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 204: return "No Content";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 429: return "Too Many Requests";
+    case 500: return "Internal Server Error";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    case 504: return "Gateway Timeout";
+    default: return "Unknown";
+  }
+}
+
+[[noreturn]] void protocol_error(const char* what) { throw Error(ErrorCode::kProtocol, what); }
+
+// Rebuilds `object` empty on `resource`. Move-assigning a fresh one instead
+// would leave a string its old buffer whenever the new value fits inline,
+// and that buffer may be in an arena about to be released.
+template <class T>
+void renew(T& object, std::pmr::memory_resource* resource) {
+  std::destroy_at(&object);
+  std::construct_at(&object, resource);
+}
+
+template <class String>
+void write_request(const HttpRequest& request, std::string_view host, bool keep_alive, String& out,
+                   std::string_view user_agent) {
+  out.append(request.method).append(" ").append(request.target).append(" HTTP/1.1\r\nHost: ");
+  out.append(host).append("\r\n");
+  if (!user_agent.empty() && find_header(request.headers, "User-Agent") == nullptr) {
+    out.append("User-Agent: ").append(user_agent).append("\r\n");
+  }
+  for (const auto& h : request.headers) out.append(h.name).append(": ").append(h.value).append("\r\n");
+  if (!request.body.empty() || request.method == "POST" || request.method == "PUT") {
+    out.append("Content-Length: ").append(std::to_string(request.body.size())).append("\r\n");
+  }
+  if (!keep_alive) out.append("Connection: close\r\n");
+  out.append("\r\n").append(request.body);
+}
+
+}  // namespace
+
+bool iequals(std::string_view a, std::string_view b) noexcept {
+  if (a.size() != b.size()) return false;
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    if (lower(a[i]) != lower(b[i])) return false;
+  }
+  return true;
+}
+
+const std::pmr::string* find_header(const Headers& headers, std::string_view name) noexcept {
+  for (const auto& h : headers) {
+    if (iequals(h.name, name)) return &h.value;
+  }
+  return nullptr;
+}
+
+void serialize_request(const HttpRequest& request, std::string_view host, bool keep_alive,
+                       std::string& out, std::string_view user_agent) {
+  write_request(request, host, keep_alive, out, user_agent);
+}
+
+void serialize_request(const HttpRequest& request, std::string_view host, bool keep_alive,
+                       std::pmr::string& out, std::string_view user_agent) {
+  write_request(request, host, keep_alive, out, user_agent);
+}
+
+void serialize_response(const HttpResponse& response, std::string& out) {
+  out.append("HTTP/1.1 ").append(std::to_string(response.status)).append(" ");
+  out.append(response.reason.empty() ? default_reason(response.status) : response.reason.c_str());
+  out.append("\r\n");
+  for (const auto& h : response.headers) out.append(h.name).append(": ").append(h.value).append("\r\n");
+  out.append("Content-Length: ").append(std::to_string(response.body.size())).append("\r\n");
+  if (!response.keep_alive) out.append("Connection: close\r\n");
+  out.append("\r\n").append(response.body);
+}
+
+void HttpParser::reset() {
+  state_ = State::kHeaders;
+  started_ = false;
+  no_body_ = false;
+  keep_alive_ = true;
+  remaining_ = 0;
+  // Heap storage is kept for the next head; an arena's may be released next.
+  if (resource_ == std::pmr::get_default_resource()) {
+    pending_.clear();
+  } else {
+    renew(pending_, resource_);
+  }
+  renew(request_, resource_);
+  renew(response_, resource_);
+}
+
+void HttpParser::finish() {
+  if (state_ == State::kUntilClose) {
+    state_ = State::kDone;
+    return;
+  }
+  if (state_ != State::kDone && started_) {
+    throw Error(ErrorCode::kConnectionClosed, "peer closed connection mid-message");
+  }
+}
+
+std::size_t HttpParser::feed(const char* data, std::size_t size) {
+  std::size_t used = 0;
+  if (size > 0) started_ = true;
+  while (used < size && state_ != State::kDone) {
+    const char* p = data + used;
+    const std::size_t avail = size - used;
+    switch (state_) {
+      case State::kHeaders: {
+        // Tolerate stray CRLFs between keep-alive messages.
+        if (pending_.empty() && (*p == '\r' || *p == '\n')) {
+          ++used;
+          break;
+        }
+        const std::size_t before = pending_.size();
+        pending_.append(p, avail);
+        const auto end = pending_.find("\r\n\r\n", before >= 3 ? before - 3 : 0);
+        if (end == std::string::npos) {
+          if (pending_.size() > kMaxHeaderBytes) protocol_error("header block too large");
+          used += avail;
+          break;
+        }
+        used += end + 4 - before;
+        parse_head(std::string_view(pending_).substr(0, end));
+        pending_.clear();
+        break;
+      }
+      case State::kBody: {
+        const std::size_t take = std::min(remaining_, avail);
+        body().append(p, take);
+        remaining_ -= take;
+        used += take;
+        if (remaining_ == 0) state_ = State::kDone;
+        break;
+      }
+      case State::kChunkSize:
+      case State::kTrailers: {
+        const void* nl = std::memchr(p, '\n', avail);
+        const std::size_t take = nl ? static_cast<const char*>(nl) - p + 1 : avail;
+        pending_.append(p, take);
+        used += take;
+        if (pending_.size() > kMaxHeaderBytes) protocol_error("chunk line too large");
+        if (!nl) break;
+        std::string_view line(pending_);
+        line.remove_suffix(1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (state_ == State::kTrailers) {
+          if (line.empty()) state_ = State::kDone;
+          pending_.clear();
+          break;
+        }
+        line = trim(line.substr(0, line.find(';')));
+        std::size_t chunk = 0;
+        const auto [ptr, ec] = std::from_chars(line.data(), line.data() + line.size(), chunk, 16);
+        if (ec != std::errc{} || ptr != line.data() + line.size() || line.empty()) {
+          protocol_error("bad chunk size");
+        }
+        pending_.clear();
+        if (chunk == 0) {
+          state_ = State::kTrailers;
+        } else {
+          if (chunk > kMaxBodyBytes - body().size()) protocol_error("body too large");
+          remaining_ = chunk;
+          state_ = State::kChunkData;
+        }
+        break;
+      }
+      case State::kChunkData: {
+        const std::size_t take = std::min(remaining_, avail);
+        body().append(p, take);
+        remaining_ -= take;
+        used += take;
+        if (remaining_ == 0) state_ = State::kChunkDataEnd;
+        break;
+      }
+      case State::kChunkDataEnd: {
+        // CRLF after chunk data; accept a bare LF as well.
+        if (*p == '\r') {
+          ++used;
+        } else if (*p == '\n') {
+          ++used;
+          state_ = State::kChunkSize;
+        } else {
+          protocol_error("missing CRLF after chunk");
+        }
+        break;
+      }
+      case State::kUntilClose: {
+        if (avail > kMaxBodyBytes - body().size()) protocol_error("body too large");
+        body().append(p, avail);
+        used += avail;
+        break;
+      }
+      case State::kDone:
+        break;
+    }
+  }
+  return used;
+}
+
+void HttpParser::parse_head(std::string_view head) {
+  auto next_line = [&head]() {
+    const auto nl = head.find("\r\n");
+    std::string_view line = head.substr(0, nl);
+    head.remove_prefix(nl == std::string_view::npos ? head.size() : nl + 2);
+    return line;
+  };
+
+  const std::string_view start = next_line();
+  std::string_view version;
+  if (kind_ == Kind::kRequest) {
+    const auto sp1 = start.find(' ');
+    const auto sp2 = start.rfind(' ');
+    if (sp1 == std::string_view::npos || sp2 == sp1) protocol_error("bad request line");
+    request_.method.assign(start.substr(0, sp1));
+    request_.target.assign(start.substr(sp1 + 1, sp2 - sp1 - 1));
+    version = start.substr(sp2 + 1);
+  } else {
+    const auto sp1 = start.find(' ');
+    if (sp1 == std::string_view::npos || start.size() < sp1 + 4) protocol_error("bad status line");
+    version = start.substr(0, sp1);
+    const auto code = start.substr(sp1 + 1, 3);
+    int status = 0;
+    const auto [ptr, ec] = std::from_chars(code.data(), code.data() + code.size(), status);
+    if (ec != std::errc{} || ptr != code.data() + code.size()) protocol_error("bad status code");
+    response_.status = status;
+    if (start.size() > sp1 + 5) response_.reason.assign(start.substr(sp1 + 5));
+  }
+  if (version.substr(0, 5) != "HTTP/") protocol_error("bad HTTP version");
+  keep_alive_ = version != "HTTP/1.0";
+
+  auto& hs = headers();
+  while (!head.empty()) {
+    const std::string_view line = next_line();
+    if (line.empty()) continue;
+    const auto colon = line.find(':');
+    if (colon == std::string_view::npos || colon == 0) protocol_error("bad header line");
+    hs.emplace_back(line.substr(0, colon), trim(line.substr(colon + 1)));
+  }
+
+  if (const auto* conn = find_header(hs, "Connection")) {
+    if (contains_token(*conn, "close")) keep_alive_ = false;
+    if (contains_token(*conn, "keep-alive")) keep_alive_ = true;
+  }
+
+  const bool bodiless = kind_ == Kind::kResponse &&
+                        (no_body_ || response_.status / 100 == 1 || response_.status == 204 ||
+                         response_.status == 304);
+  const auto* te = find_header(hs, "Transfer-Encoding");
+  const auto* cl = find_header(hs, "Content-Length");
+  if (bodiless) {
+    state_ = State::kDone;
+  } else if (te && contains_token(*te, "chunked")) {
+    state_ = State::kChunkSize;
+  } else if (cl) {
+    std::size_t length = 0;
+    const auto [ptr, ec] = std::from_chars(cl->data(), cl->data() + cl->size(), length);
+    if (ec != std::errc{} || ptr != cl->data() + cl->size()) protocol_error("bad Content-Length");
+    if (length > kMaxBodyBytes) protocol_error("body too large");
+    body().reserve(length);
+    remaining_ = length;
+    state_ = length == 0 ? State::kDone : State::kBody;
+  } else if (kind_ == Kind::kRequest) {
+    state_ = State::kDone;
+  } else {
+    keep_alive_ = false;
+    state_ = State::kUntilClose;
+  }
+  if (kind_ == Kind::kResponse) response_.keep_alive = keep_alive_;
+}
+
+}  // namespace mpesa
@@ -0,0 +1,77 @@
+#include "mpesa/http_client.hpp"
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+namespace {
+
+bool idempotent(std::string_view method) {
+  return method == "GET" || method == "HEAD" || method == "PUT" || method == "DELETE" ||
+         method == "OPTIONS";
+}
+
+}  // namespace
+
+HttpClient::HttpClient(HttpClientOptions options)
+    : options_(std::move(options)), pool_(options_.pool) {}
+
+HttpResponse HttpClient::send(const Endpoint& endpoint, const HttpRequest& request,
+                              std::pmr::memory_resource* arena) {
+  const auto started = Clock::now();
+  const auto deadline = started + options_.request_timeout;
+  bool retryable = false;
+  try {
+    HttpResponse response = attempt(endpoint, request, arena, deadline, retryable);
+    if (options_.metrics != nullptr) options_.metrics->record(Phase::kTotal, Clock::now() - started);
+    return response;
+  } catch (const Error&) {
+    if (!retryable) throw;
+  }
+  HttpResponse response = attempt(endpoint, request, arena, deadline, retryable);
+  if (options_.metrics != nullptr) options_.metrics->record(Phase::kTotal, Clock::now() - started);
+  return response;
+}
+
+HttpResponse HttpClient::attempt(const Endpoint& endpoint, const HttpRequest& request,
+                                 std::pmr::memory_resource* arena, Clock::time_point deadline, bool& retryable) {
+  retryable = false;
+  ConnectionPool::Lease lease = pool_.acquire(endpoint, deadline);
+  Connection& conn = *lease.connection;
+  Metrics* const metrics = options_.metrics;
+  if (metrics != nullptr && !lease.reused) metrics->record_connect(conn.timings(), lease.resolve, endpoint.tls);
+
+  thread_local std::string wire;
+  wire.clear();
+  const bool keep_alive = pool_.options().keep_alive;
+  serialize_request(request, endpoint.authority(), keep_alive, wire, options_.user_agent);
+
+  HttpParser parser(HttpParser::Kind::kResponse, arena);
+  if (request.method == "HEAD") parser.expect_no_body();
+  try {
+    conn.write_all(wire, deadline);
+    const auto written = metrics != nullptr ? Clock::now() : Clock::time_point{};
+    char buffer[16 * 1024];
+    while (!parser.done()) {
+      const std::size_t n = conn.read_some(buffer, sizeof(buffer), deadline);
+      if (n == 0) {
+        parser.finish();
+        if (!parser.done()) throw Error(ErrorCode::kConnectionClosed, "empty response");
+        break;
+      }
+      if (metrics != nullptr && !parser.started()) metrics->record(Phase::kTtfb, Clock::now() - written);
+      parser.feed(buffer, n);
+    }
+  } catch (Error& e) {
+    retryable = lease.reused && !parser.started() && idempotent(request.method) &&
+                e.code() == ErrorCode::kConnectionClosed;
+    e.set_sent(true);
+    throw;
+  }
+
+  conn.count_request();
+  HttpResponse response = std::move(parser.response());
+  if (keep_alive && parser.keep_alive()) pool_.release(std::move(lease.connection));
+  return response;
+}
+
+}  // namespace mpesa
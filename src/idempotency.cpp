@@ -0,0 +1,177 @@
+#include "mpesa/idempotency.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace mpesa {
+namespace {
+
+constexpr int kExpiryBits = 28;
+constexpr std::uint64_t kExpiryMask = (std::uint64_t{1} << kExpiryBits) - 1;
+// Set while the handler for a claimed key is still running.
+constexpr std::uint64_t kPendingBit = std::uint64_t{1} << kExpiryBits;
+constexpr int kFingerprintShift = kExpiryBits + 1;
+constexpr std::uint64_t kFingerprintMask = (std::uint64_t{1} << (64 - kFingerprintShift)) - 1;
+// Slots examined from a key's home slot; a key lives within this window.
+constexpr std::size_t kProbeWindow = 32;
+
+std::uint64_t hash_key(IdKind kind, std::string_view id) noexcept {
+  // FNV-1a, then a splitmix64 finalizer so shard, slot and fingerprint bits
+  // are all well mixed.
+  std::uint64_t h = 0xcbf29ce484222325ULL;
+  h = (h ^ static_cast<std::uint8_t>(kind)) * 0x100000001b3ULL;
+  for (const char c : id) h = (h ^ static_cast<std::uint8_t>(c)) * 0x100000001b3ULL;
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+std::uint64_t fingerprint_of(std::uint64_t hash) noexcept {
+  const std::uint64_t fp = (hash >> kFingerprintShift) & kFingerprintMask;
+  return fp == 0 ? 1 : fp;  // a zero word marks an empty slot
+}
+
+std::uint64_t expiry_of(std::uint64_t word) noexcept { return word & kExpiryMask; }
+std::uint64_t fingerprint_in(std::uint64_t word) noexcept { return word >> kFingerprintShift; }
+
+}  // namespace
+
+// Counters are per shard and padded apart like the tables they count.
+struct alignas(64) IdempotencyIndex::Shard {
+  std::unique_ptr<std::atomic<std::uint64_t>[]> slots;
+  std::atomic<std::uint64_t> admitted{0};
+  std::atomic<std::uint64_t> duplicates{0};
+  std::atomic<std::uint64_t> overflows{0};
+};
+
+IdempotencyIndex::IdempotencyIndex(IdempotencyOptions options)
+    : epoch_(Clock::now()),
+      ttl_(static_cast<std::uint32_t>(std::clamp<std::int64_t>(options.ttl.count(), 1, kExpiryMask / 2))),
+      shard_count_(std::bit_ceil(std::max(1u, options.shards))) {
+  const std::size_t total = std::bit_ceil(std::max<std::size_t>(options.capacity, 1) * 2);
+  shard_slots_ = std::max<std::size_t>(kProbeWindow * 2, total / shard_count_);
+  shards_ = std::make_unique<Shard[]>(shard_count_);
+  for (std::size_t i = 0; i < shard_count_; ++i) {
+    shards_[i].slots = std::make_unique<std::atomic<std::uint64_t>[]>(shard_slots_);
+  }
+}
+
+IdempotencyIndex::~IdempotencyIndex() = default;
+
+std::uint32_t IdempotencyIndex::seconds(Clock::time_point now) const noexcept {
+  // 1-based so that no live entry has expiry 0. Wraps after ~8 years.
+  const auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - epoch_).count();
+  return static_cast<std::uint32_t>((std::max<std::int64_t>(elapsed, 0) + 1) & kExpiryMask);
+}
+
+std::atomic<std::uint64_t>* IdempotencyIndex::find(std::uint64_t hash, std::uint64_t fingerprint,
+                                                   std::uint32_t now) const noexcept {
+  Shard& shard = shards_[hash & (shard_count_ - 1)];
+  const std::size_t mask = shard_slots_ - 1;
+  const std::size_t home = static_cast<std::size_t>(hash >> 8) & mask;
+  for (std::size_t i = 0; i < kProbeWindow; ++i) {
+    std::atomic<std::uint64_t>& slot = shard.slots[(home + i) & mask];
+    const std::uint64_t word = slot.load(std::memory_order_acquire);
+    if (word == 0) return nullptr;
+    if (expiry_of(word) > now && fingerprint_in(word) == fingerprint) return &slot;
+  }
+  return nullptr;
+}
+
+bool IdempotencyIndex::first_seen(IdKind kind, std::string_view id, Clock::time_point now) noexcept {
+  return insert(kind, id, now, false) == IdClaim::kClaimed;
+}
+
+IdClaim IdempotencyIndex::claim(IdKind kind, std::string_view id, Clock::time_point now) noexcept {
+  return insert(kind, id, now, true);
+}
+
+IdClaim IdempotencyIndex::insert(IdKind kind, std::string_view id, Clock::time_point now, bool pending) noexcept {
+  if (id.empty()) return IdClaim::kClaimed;
+  const std::uint64_t hash = hash_key(kind, id);
+  const std::uint64_t fingerprint = fingerprint_of(hash);
+  const std::uint32_t now_s = seconds(now);
+  const std::uint64_t claimed = (fingerprint << kFingerprintShift) | (pending ? kPendingBit : 0) |
+                                std::min<std::uint64_t>(now_s + ttl_, kExpiryMask);
+  Shard& shard = shards_[hash & (shard_count_ - 1)];
+  const std::size_t mask = shard_slots_ - 1;
+  const std::size_t home = static_cast<std::size_t>(hash >> 8) & mask;
+  for (;;) {
+    // Slots never return to zero, so a key is always found before the first
+    // empty slot of its window. Scan for a live copy, remembering the first
+    // slot that could take it; a lost CAS means the window changed, so scan
+    // again (and find a concurrent insert of the same key).
+    std::atomic<std::uint64_t>* free = nullptr;
+    std::uint64_t free_word = 0;
+    for (std::size_t i = 0; i < kProbeWindow; ++i) {
+      std::atomic<std::uint64_t>& slot = shard.slots[(home + i) & mask];
+      const std::uint64_t word = slot.load(std::memory_order_acquire);
+      if (word == 0 || expiry_of(word) <= now_s) {
+        if (free == nullptr) {
+          free = &slot;
+          free_word = word;
+        }
+        if (word == 0) break;
+        continue;
+      }
+      if (fingerprint_in(word) == fingerprint) {
+        shard.duplicates.fetch_add(1, std::memory_order_relaxed);
+        return (word & kPendingBit) != 0 ? IdClaim::kPending : IdClaim::kDone;
+      }
+    }
+    if (free == nullptr) {
+      shard.overflows.fetch_add(1, std::memory_order_relaxed);
+      return IdClaim::kClaimed;
+    }
+    if (free->compare_exchange_strong(free_word, claimed, std::memory_order_acq_rel)) {
+      shard.admitted.fetch_add(1, std::memory_order_relaxed);
+      return IdClaim::kClaimed;
+    }
+  }
+}
+
+bool IdempotencyIndex::contains(IdKind kind, std::string_view id, Clock::time_point now) const noexcept {
+  if (id.empty()) return false;
+  const std::uint64_t hash = hash_key(kind, id);
+  return find(hash, fingerprint_of(hash), seconds(now)) != nullptr;
+}
+
+void IdempotencyIndex::commit(IdKind kind, std::string_view id) noexcept {
+  if (id.empty()) return;
+  const std::uint64_t hash = hash_key(kind, id);
+  const std::uint64_t fingerprint = fingerprint_of(hash);
+  std::atomic<std::uint64_t>* slot = find(hash, fingerprint, seconds(Clock::now()));
+  if (slot == nullptr) return;
+  std::uint64_t word = slot->load(std::memory_order_relaxed);
+  while (fingerprint_in(word) == fingerprint && (word & kPendingBit) != 0 &&
+         !slot->compare_exchange_weak(word, word & ~kPendingBit, std::memory_order_acq_rel)) {
+  }
+}
+
+void IdempotencyIndex::forget(IdKind kind, std::string_view id) noexcept {
+  if (id.empty()) return;
+  const std::uint64_t hash = hash_key(kind, id);
+  const std::uint64_t fingerprint = fingerprint_of(hash);
+  std::atomic<std::uint64_t>* slot = find(hash, fingerprint, seconds(Clock::now()));
+  if (slot == nullptr) return;
+  // Expire in place: the slot stays non-zero so probe chains stay intact.
+  std::uint64_t word = slot->load(std::memory_order_relaxed);
+  while (fingerprint_in(word) == fingerprint && expiry_of(word) != 0 &&
+         !slot->compare_exchange_weak(word, fingerprint << kFingerprintShift, std::memory_order_acq_rel)) {
+  }
+}
+
+IdempotencyStats IdempotencyIndex::stats() const noexcept {
+  IdempotencyStats s;
+  for (std::size_t i = 0; i < shard_count_; ++i) {
+    s.admitted += shards_[i].admitted.load(std::memory_order_relaxed);
+    s.duplicates += shards_[i].duplicates.load(std::memory_order_relaxed);
+    s.overflows += shards_[i].overflows.load(std::memory_order_relaxed);
+  }
+  return s;
+}
+
+}  // namespace mpesa
@@ -0,0 +1,388 @@
+#include "mpesa/journal.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+namespace {
+
+// File layout: a 16-byte header, then 8-byte aligned records:
+//   u32 size (whole record, padded)  u32 crc32 (of everything after it)
+//   u8 type  u8 operation  u16 id_size  i32 code  u32 data_size
+//   id bytes, data bytes, zero padding
+// The size word is stored last, so a zero size marks the end of the log.
+constexpr char kMagic[8] = {'M', 'P', 'J', 'R', 'N', 'L', '\0', '\1'};
+constexpr std::size_t kFileHeader = 16;
+constexpr std::size_t kRecordHeader = 20;
+
+enum RecordType : std::uint8_t { kSubmitted = 1, kAccepted = 2, kFinished = 3 };
+
+constexpr std::array<std::uint32_t, 256> kCrcTable = [] {
+  std::array<std::uint32_t, 256> table{};
+  for (std::uint32_t i = 0; i < 256; ++i) {
+    std::uint32_t c = i;
+    for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    table[i] = c;
+  }
+  return table;
+}();
+
+std::uint32_t crc32(const char* data, std::size_t size) noexcept {
+  std::uint32_t c = 0xFFFFFFFFu;
+  for (std::size_t i = 0; i < size; ++i) c = kCrcTable[(c ^ static_cast<std::uint8_t>(data[i])) & 0xFF] ^ (c >> 8);
+  return c ^ 0xFFFFFFFFu;
+}
+
+constexpr std::size_t record_size(std::size_t id, std::size_t data) noexcept {
+  return (kRecordHeader + id + data + 7) & ~std::size_t{7};
+}
+
+template <class T>
+T load(const char* p) noexcept {
+  T v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+template <class T>
+void store(char* p, T v) noexcept {
+  std::memcpy(p, &v, sizeof(v));
+}
+
+/// Writes everything but the size word; returns the record's size.
+std::size_t encode_body(char* out, std::uint8_t type, MetricEndpoint operation, std::string_view id, int code,
+                        std::string_view data) noexcept {
+  const std::size_t size = record_size(id.size(), data.size());
+  out[8] = static_cast<char>(type);
+  out[9] = static_cast<char>(operation);
+  store<std::uint16_t>(out + 10, static_cast<std::uint16_t>(id.size()));
+  store<std::int32_t>(out + 12, code);
+  store<std::uint32_t>(out + 16, static_cast<std::uint32_t>(data.size()));
+  std::memcpy(out + kRecordHeader, id.data(), id.size());
+  std::memcpy(out + kRecordHeader + id.size(), data.data(), data.size());
+  const std::size_t used = kRecordHeader + id.size() + data.size();
+  std::memset(out + used, 0, size - used);
+  store<std::uint32_t>(out + 4, crc32(out + 8, used - 8));
+  return size;
+}
+
+std::size_t encode(char* out, std::uint8_t type, MetricEndpoint operation, std::string_view id, int code,
+                   std::string_view data) noexcept {
+  const std::size_t size = encode_body(out, type, operation, id, code, data);
+  store<std::uint32_t>(out, static_cast<std::uint32_t>(size));
+  return size;
+}
+
+/// Replays the records in `[kFileHeader, size)` and returns the entries left
+/// in flight, oldest first; `end` receives the end of the last valid record.
+std::vector<JournalEntry> replay(const char* base, std::size_t size, std::size_t& end) {
+  std::vector<JournalEntry> entries;
+  std::vector<bool> live;
+  std::unordered_map<std::string, std::size_t> index;
+  std::size_t pos = kFileHeader;
+  while (pos + kRecordHeader <= size) {
+    const char* rec = base + pos;
+    const std::uint32_t rec_size = load<std::uint32_t>(rec);
+    if (rec_size < kRecordHeader || rec_size % 8 != 0 || pos + rec_size > size) break;
+    const std::size_t id_size = load<std::uint16_t>(rec + 10);
+    const std::size_t data_size = load<std::uint32_t>(rec + 16);
+    if (record_size(id_size, data_size) != rec_size) break;
+    if (load<std::uint32_t>(rec + 4) != crc32(rec + 8, kRecordHeader - 8 + id_size + data_size)) break;
+    pos += rec_size;
+
+    std::string id(rec + kRecordHeader, id_size);
+    const std::string_view data(rec + kRecordHeader + id_size, data_size);
+    const auto it = index.find(id);
+    switch (static_cast<std::uint8_t>(rec[8])) {
+      case kSubmitted:
+        if (it != index.end() && live[it->second]) {
+          entries[it->second].body.assign(data);  // resubmitted under the same ID
+          break;
+        }
+        index[id] = entries.size();
+        entries.push_back({static_cast<MetricEndpoint>(rec[9]), std::move(id), {}, std::string(data)});
+        live.push_back(true);
+        break;
+      case kAccepted:
+        if (it != index.end()) entries[it->second].conversation_id.assign(data);
+        break;
+      case kFinished:
+        if (it != index.end()) live[it->second] = false;
+        break;
+      default:
+        break;
+    }
+  }
+  end = pos;
+  std::vector<JournalEntry> out;
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    if (live[i]) out.push_back(std::move(entries[i]));
+  }
+  return out;
+}
+
+[[noreturn]] void fail(const std::string& path, const char* what) {
+  throw Error(ErrorCode::kInternal, "journal " + path + ": " + what + ": " + std::strerror(errno));
+}
+
+std::size_t entries_size(const std::vector<JournalEntry>& entries) noexcept {
+  std::size_t total = kFileHeader;
+  for (const JournalEntry& e : entries) {
+    total += record_size(e.originator_conversation_id.size(), e.body.size());
+    if (e.accepted()) total += record_size(e.originator_conversation_id.size(), e.conversation_id.size());
+  }
+  return total;
+}
+
+void sync_directory(const std::string& path) {
+  const std::size_t slash = path.rfind('/');
+  const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+  const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return;
+  ::fsync(fd);
+  ::close(fd);
+}
+
+/// Writes `entries` to a fresh file of `capacity` bytes, swaps it in for
+/// `path` and returns its descriptor; `end` receives the end of the data.
+int write_fresh(const std::string& path, const std::vector<JournalEntry>& entries, std::size_t capacity,
+                std::size_t& end) {
+  const std::string tmp = path + ".tmp";
+  const int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) fail(tmp, "open");
+  if (::ftruncate(fd, static_cast<off_t>(capacity)) != 0) {
+    ::close(fd);
+    fail(tmp, "ftruncate");
+  }
+  void* mapped = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    ::close(fd);
+    fail(tmp, "mmap");
+  }
+  char* base = static_cast<char*>(mapped);
+  std::memcpy(base, kMagic, sizeof(kMagic));
+  std::size_t pos = kFileHeader;
+  for (const JournalEntry& e : entries) {
+    pos += encode(base + pos, kSubmitted, e.operation, e.originator_conversation_id, 0, e.body);
+    if (e.accepted()) {
+      pos += encode(base + pos, kAccepted, e.operation, e.originator_conversation_id, 0, e.conversation_id);
+    }
+  }
+  const bool synced = ::msync(base, pos, MS_SYNC) == 0;
+  ::munmap(base, capacity);
+  if (!synced || ::fsync(fd) != 0 || ::rename(tmp.c_str(), path.c_str()) != 0) {
+    ::close(fd);
+    fail(path, "writing");
+  }
+  sync_directory(path);
+  end = pos;
+  return fd;
+}
+
+}  // namespace
+
+RequestJournal::RequestJournal(std::string path, JournalOptions options)
+    : path_(std::move(path)), options_(options) {
+  recovered_ = read(path_);
+  std::size_t capacity = std::max<std::size_t>(options_.capacity, 64 * 1024);
+  while (entries_size(recovered_) > capacity / 2) capacity *= 2;
+  std::size_t end = 0;
+  const int fd = write_fresh(path_, recovered_, capacity, end);
+  map(fd, capacity);
+  tail_.store(end);
+  scanned_ = flushed_ = end;
+  durable_.store(end);
+  committer_ = std::thread([this] { commit_loop(); });
+}
+
+RequestJournal::~RequestJournal() {
+  {
+    std::lock_guard lock(commit_mutex_);
+    stopping_ = true;
+  }
+  commit_cv_.notify_all();
+  if (committer_.joinable()) committer_.join();
+  {
+    std::shared_lock lock(remap_);
+    commit();
+  }
+  unmap();
+}
+
+void RequestJournal::map(int fd, std::size_t capacity) {
+  void* mapped = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    ::close(fd);
+    fail(path_, "mmap");
+  }
+  fd_ = fd;
+  base_ = static_cast<char*>(mapped);
+  capacity_ = capacity;
+}
+
+void RequestJournal::unmap() noexcept {
+  if (base_ != nullptr) ::munmap(base_, capacity_);
+  if (fd_ >= 0) ::close(fd_);
+  base_ = nullptr;
+  fd_ = -1;
+}
+
+RequestJournal::Ticket RequestJournal::submitted(MetricEndpoint operation, std::string_view originator_conversation_id,
+                                                 std::string_view body) {
+  return append(kSubmitted, operation, originator_conversation_id, 0, body);
+}
+
+RequestJournal::Ticket RequestJournal::accepted(std::string_view originator_conversation_id,
+                                                std::string_view conversation_id) {
+  return append(kAccepted, MetricEndpoint{}, originator_conversation_id, 0, conversation_id);
+}
+
+RequestJournal::Ticket RequestJournal::finished(std::string_view originator_conversation_id, int result_code) {
+  return append(kFinished, MetricEndpoint{}, originator_conversation_id, result_code, {});
+}
+
+RequestJournal::Ticket RequestJournal::append(std::uint8_t type, MetricEndpoint operation, std::string_view id,
+                                              int code, std::string_view data) {
+  if (id.empty() || id.size() > 0xFFFF) throw Error(ErrorCode::kInvalidArgument, "journal key must be 1-65535 bytes");
+  const std::size_t size = record_size(id.size(), data.size());
+  for (;;) {
+    {
+      std::shared_lock lock(remap_);
+      if (size > capacity_ / 4) throw Error(ErrorCode::kInvalidArgument, "journal record too large");
+      const std::size_t pos = tail_.fetch_add(size, std::memory_order_relaxed);
+      if (pos + size <= capacity_) {
+        char* rec = base_ + pos;
+        encode_body(rec, type, operation, id, code, data);
+        std::atomic_ref<std::uint32_t>(*reinterpret_cast<std::uint32_t*>(rec))
+            .store(static_cast<std::uint32_t>(size), std::memory_order_release);
+        appends_.fetch_add(1, std::memory_order_relaxed);
+        bytes_.fetch_add(size, std::memory_order_relaxed);
+        return origin_ + pos + size;
+      }
+    }
+    compact(size);
+  }
+}
+
+void RequestJournal::compact(std::size_t min_free) {
+  std::unique_lock lock(remap_);
+  if (tail_.load(std::memory_order_relaxed) + min_free <= capacity_) return;  // another thread got here first
+  // No appender is mid-record now, so everything reserved below capacity is
+  // published.
+  std::size_t end = 0;
+  const std::vector<JournalEntry> live = replay(base_, capacity_, end);
+  const Ticket reached = origin_ + end;
+  std::size_t capacity = capacity_;
+  while (entries_size(live) + min_free > capacity / 2) capacity *= 2;
+  std::size_t live_end = 0;
+  const int fd = write_fresh(path_, live, capacity, live_end);
+  unmap();
+  map(fd, capacity);
+  tail_.store(live_end, std::memory_order_relaxed);
+  scanned_ = flushed_ = live_end;
+  origin_ = reached - live_end;
+  compactions_.fetch_add(1, std::memory_order_relaxed);
+  durable_.store(reached, std::memory_order_release);
+  {
+    std::lock_guard commit_lock(commit_mutex_);
+  }
+  durable_cv_.notify_all();
+}
+
+void RequestJournal::commit() {
+  std::size_t end = scanned_;
+  while (end + kRecordHeader <= capacity_) {
+    const std::uint32_t size =
+        std::atomic_ref<std::uint32_t>(*reinterpret_cast<std::uint32_t*>(base_ + end)).load(std::memory_order_acquire);
+    if (size == 0) break;
+    end += size;
+  }
+  scanned_ = end;
+  if (end > flushed_) {
+    if (options_.sync) {
+      static const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+      const std::size_t from = flushed_ & ~(page - 1);
+      ::msync(base_ + from, end - from, MS_SYNC);
+    }
+    flushed_ = end;
+    commits_.fetch_add(1, std::memory_order_relaxed);
+  }
+  durable_.store(origin_ + end, std::memory_order_release);
+  {
+    std::lock_guard lock(commit_mutex_);
+  }
+  durable_cv_.notify_all();
+}
+
+void RequestJournal::commit_loop() {
+  std::unique_lock lock(commit_mutex_);
+  while (!stopping_) {
+    commit_cv_.wait_for(lock, options_.commit_interval, [this] { return waiting_ || stopping_; });
+    waiting_ = false;
+    lock.unlock();
+    {
+      std::shared_lock remap(remap_);
+      commit();
+    }
+    lock.lock();
+  }
+}
+
+void RequestJournal::wait_durable(Ticket ticket) {
+  if (durable(ticket)) return;
+  std::unique_lock lock(commit_mutex_);
+  waiting_ = true;
+  commit_cv_.notify_one();
+  durable_cv_.wait(lock, [&] { return durable(ticket); });
+}
+
+JournalStats RequestJournal::stats() const noexcept {
+  return {appends_.load(std::memory_order_relaxed), commits_.load(std::memory_order_relaxed),
+          bytes_.load(std::memory_order_relaxed), compactions_.load(std::memory_order_relaxed)};
+}
+
+std::vector<JournalEntry> RequestJournal::read(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    if (errno == ENOENT) return {};
+    fail(path, "open");
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    fail(path, "stat");
+  }
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  if (size < kFileHeader) {
+    ::close(fd);
+    return {};
+  }
+  void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) fail(path, "mmap");
+  const char* base = static_cast<const char*>(mapped);
+  if (std::memcmp(base, kMagic, sizeof(kMagic)) != 0) {
+    ::munmap(mapped, size);
+    throw Error(ErrorCode::kParse, "journal " + path + ": not a request journal");
+  }
+  std::size_t end = 0;
+  std::vector<JournalEntry> entries = replay(base, size, end);
+  ::munmap(mapped, size);
+  return entries;
+}
+
+TransactionStatusRequest status_query_for(const JournalEntry& entry, TransactionStatusRequest query) {
+  query.original_conversation_id = entry.originator_conversation_id;
+  return query;
+}
+
+}  // namespace mpesa
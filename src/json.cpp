@@ -0,0 +1,459 @@
+#include "mpesa/json.hpp"
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+
+#include "mpesa/error.hpp"
+#include "mpesa/money.hpp"
+
+namespace mpesa::json {
+namespace {
+
+[[noreturn]] void fail(const char* what, std::size_t offset) {
+  throw Error(ErrorCode::kParse, std::string(what) + " at offset " + std::to_string(offset));
+}
+
+[[noreturn]] void type_error(const char* expected) {
+  throw Error(ErrorCode::kParse, std::string("JSON value is not ") + expected);
+}
+
+template <class String>
+void append_utf8(String& out, std::uint32_t cp) {
+  if (cp < 0x80) {
+    out.push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+
+// Returns the offset just past the number starting at `pos`.
+std::size_t scan_number(std::string_view text, std::size_t pos) {
+  const std::size_t start = pos;
+  auto digits = [&] {
+    const std::size_t from = pos;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') ++pos;
+    if (pos == from) fail("invalid number", start);
+  };
+  if (pos < text.size() && text[pos] == '-') ++pos;
+  digits();
+  if (pos < text.size() && text[pos] == '.') {
+    ++pos;
+    digits();
+  }
+  if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+    ++pos;
+    if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) ++pos;
+    digits();
+  }
+  return pos;
+}
+
+std::uint32_t hex4(std::string_view text, std::size_t& pos) {
+  if (pos + 4 > text.size()) fail("truncated \\u escape", pos);
+  std::uint32_t cp = 0;
+  const auto [ptr, ec] = std::from_chars(text.data() + pos, text.data() + pos + 4, cp, 16);
+  if (ec != std::errc{} || ptr != text.data() + pos + 4) fail("invalid \\u escape", pos);
+  pos += 4;
+  return cp;
+}
+
+// Appends the decoded string whose contents start at `pos` (just past the
+// opening quote) to `out`; returns the offset past the closing quote.
+template <class String>
+std::size_t decode_string(std::string_view text, std::size_t pos, String& out) {
+  for (;;) {
+    const std::size_t run = pos;
+    while (pos < text.size() && text[pos] != '"' && text[pos] != '\\') {
+      if (static_cast<unsigned char>(text[pos]) < 0x20) fail("control character in string", pos);
+      ++pos;
+    }
+    out.append(text.substr(run, pos - run));
+    if (pos >= text.size()) fail("unterminated string", run);
+    if (text[pos++] == '"') return pos;
+    if (pos >= text.size()) fail("unterminated escape", pos);
+    switch (text[pos++]) {
+      case '"': out.push_back('"'); break;
+      case '\\': out.push_back('\\'); break;
+      case '/': out.push_back('/'); break;
+      case 'b': out.push_back('\b'); break;
+      case 'f': out.push_back('\f'); break;
+      case 'n': out.push_back('\n'); break;
+      case 'r': out.push_back('\r'); break;
+      case 't': out.push_back('\t'); break;
+      case 'u': {
+        std::uint32_t cp = hex4(text, pos);
+        if (cp >= 0xD800 && cp < 0xDC00 && text.substr(pos, 2) == "\\u") {
+          pos += 2;
+          const std::uint32_t low = hex4(text, pos);
+          if (low < 0xDC00 || low > 0xDFFF) fail("invalid surrogate pair", pos);
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+        append_utf8(out, cp);
+        break;
+      }
+      default:
+        fail("invalid escape", pos - 1);
+    }
+  }
+}
+
+}  // namespace
+
+class Parser {
+ public:
+  explicit Parser(std::string_view text) : text_(text) {}
+
+  Value document() {
+    Value v = value(0);
+    skip_ws();
+    if (pos_ != text_.size()) fail("trailing characters", pos_);
+    return v;
+  }
+
+ private:
+  static constexpr int kMaxDepth = 64;
+
+  void skip_ws() {
+    while (pos_ < text_.size() &&
+           (text_[pos_] == ' ' || text_[pos_] == '\n' || text_[pos_] == '\r' || text_[pos_] == '\t')) {
+      ++pos_;
+    }
+  }
+
+  char peek() {
+    skip_ws();
+    if (pos_ >= text_.size()) fail("unexpected end of input", pos_);
+    return text_[pos_];
+  }
+
+  void expect(char c) {
+    if (peek() != c) fail("unexpected character", pos_);
+    ++pos_;
+  }
+
+  bool literal(std::string_view word) {
+    if (text_.substr(pos_, word.size()) != word) fail("invalid literal", pos_);
+    pos_ += word.size();
+    return true;
+  }
+
+  Value value(int depth) {
+    if (depth > kMaxDepth) fail("nesting too deep", pos_);
+    Value v;
+    switch (peek()) {
+      case '{': {
+        ++pos_;
+        v.type_ = Value::Type::kObject;
+        if (peek() == '}') {
+          ++pos_;
+          return v;
+        }
+        for (;;) {
+          if (peek() != '"') fail("expected member name", pos_);
+          Value::Member m;
+          string(m.key);
+          expect(':');
+          m.value = value(depth + 1);
+          v.object_.push_back(std::move(m));
+          const char c = peek();
+          ++pos_;
+          if (c == '}') break;
+          if (c != ',') fail("expected ',' or '}'", pos_ - 1);
+        }
+        return v;
+      }
+      case '[': {
+        ++pos_;
+        v.type_ = Value::Type::kArray;
+        if (peek() == ']') {
+          ++pos_;
+          return v;
+        }
+        for (;;) {
+          v.array_.push_back(value(depth + 1));
+          const char c = peek();
+          ++pos_;
+          if (c == ']') break;
+          if (c != ',') fail("expected ',' or ']'", pos_ - 1);
+        }
+        return v;
+      }
+      case '"':
+        v.type_ = Value::Type::kString;
+        string(v.text_);
+        return v;
+      case 't':
+        v.type_ = Value::Type::kBool;
+        v.bool_ = literal("true");
+        return v;
+      case 'f':
+        v.type_ = Value::Type::kBool;
+        literal("false");
+        return v;
+      case 'n':
+        literal("null");
+        return v;
+      default:
+        v.type_ = Value::Type::kNumber;
+        number(v.text_);
+        return v;
+    }
+  }
+
+  void number(std::string& out) {
+    const std::size_t start = pos_;
+    pos_ = scan_number(text_, pos_);
+    out.assign(text_.substr(start, pos_ - start));
+  }
+
+  void string(std::string& out) { pos_ = decode_string(text_, pos_ + 1, out); }
+
+  std::string_view text_;
+  std::size_t pos_ = 0;
+};
+
+Value parse(std::string_view text) { return Parser(text).document(); }
+
+bool Value::as_bool() const {
+  if (type_ != Type::kBool) type_error("a bool");
+  return bool_;
+}
+
+const std::string& Value::as_string() const {
+  if (type_ != Type::kString) type_error("a string");
+  return text_;
+}
+
+const std::string& Value::scalar_text() const {
+  if (type_ != Type::kString && type_ != Type::kNumber) type_error("a string or number");
+  return text_;
+}
+
+std::int64_t Value::as_int64() const {
+  const std::string& t = scalar_text();
+  std::int64_t out = 0;
+  const auto [ptr, ec] = std::from_chars(t.data(), t.data() + t.size(), out);
+  if (ec != std::errc{} || ptr != t.data() + t.size()) type_error("an integer");
+  return out;
+}
+
+double Value::as_double() const {
+  const std::string& t = scalar_text();
+  char* end = nullptr;
+  const double out = std::strtod(t.c_str(), &end);
+  if (end != t.c_str() + t.size() || t.empty()) type_error("a number");
+  return out;
+}
+
+Money Value::as_money() const {
+  const std::optional<Money> out = Money::parse(scalar_text());
+  if (!out) type_error("an amount");
+  return *out;
+}
+
+const std::vector<Value>& Value::as_array() const {
+  if (type_ != Type::kArray) type_error("an array");
+  return array_;
+}
+
+const std::vector<Value::Member>& Value::as_object() const {
+  if (type_ != Type::kObject) type_error("an object");
+  return object_;
+}
+
+const Value* Value::find(std::string_view key) const noexcept {
+  if (type_ != Type::kObject) return nullptr;
+  for (const auto& m : object_) {
+    if (m.key == key) return &m.value;
+  }
+  return nullptr;
+}
+
+const Value& Value::at(std::string_view key) const {
+  const Value* v = find(key);
+  if (v == nullptr) throw Error(ErrorCode::kParse, "missing JSON member \"" + std::string(key) + "\"");
+  return *v;
+}
+
+void append_quoted(std::string& out, std::string_view text) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  out.push_back('"');
+  std::size_t run = 0;  // start of the pending unescaped run
+  for (std::size_t i = 0; i < text.size(); ++i) {
+    const char c = text[i];
+    if (c != '"' && c != '\\' && static_cast<unsigned char>(c) >= 0x20) continue;
+    out.append(text.data() + run, i - run);
+    run = i + 1;
+    switch (c) {
+      case '"': out.append("\\\""); break;
+      case '\\': out.append("\\\\"); break;
+      case '\n': out.append("\\n"); break;
+      case '\r': out.append("\\r"); break;
+      case '\t': out.append("\\t"); break;
+      default:
+        out.append("\\u00");
+        out.push_back(kHex[(c >> 4) & 0xF]);
+        out.push_back(kHex[c & 0xF]);
+    }
+  }
+  out.append(text.data() + run, text.size() - run);
+  out.push_back('"');
+}
+
+void Reader::fail(const char* what) const { json::fail(what, static_cast<std::size_t>(p_ - begin_)); }
+
+char Reader::next_char() {
+  while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) ++p_;
+  if (p_ == end_) fail("unexpected end of input");
+  return *p_;
+}
+
+Value::Type Reader::peek() {
+  switch (next_char()) {
+    case '{': return Value::Type::kObject;
+    case '[': return Value::Type::kArray;
+    case '"': return Value::Type::kString;
+    case 't':
+    case 'f': return Value::Type::kBool;
+    case 'n': return Value::Type::kNull;
+    default: return Value::Type::kNumber;
+  }
+}
+
+void Reader::begin_object() {
+  if (next_char() != '{') fail("expected an object");
+  ++p_;
+  fresh_ = true;
+}
+
+bool Reader::next_member(std::string_view& key) {
+  char c = next_char();
+  if (c == '}') {
+    ++p_;
+    fresh_ = false;
+    return false;
+  }
+  if (!fresh_) {
+    if (c != ',') fail("expected ',' or '}'");
+    ++p_;
+    c = next_char();
+  }
+  fresh_ = false;
+  if (c != '"') fail("expected member name");
+  key = string();
+  if (next_char() != ':') fail("expected ':'");
+  ++p_;
+  return true;
+}
+
+void Reader::begin_array() {
+  if (next_char() != '[') fail("expected an array");
+  ++p_;
+  fresh_ = true;
+}
+
+bool Reader::next_element() {
+  const char c = next_char();
+  if (c == ']') {
+    ++p_;
+    fresh_ = false;
+    return false;
+  }
+  if (!fresh_) {
+    if (c != ',') fail("expected ',' or ']'");
+    ++p_;
+  }
+  fresh_ = false;
+  return true;
+}
+
+std::string_view Reader::string() {
+  const char* start = ++p_;
+  const auto* quote = static_cast<const char*>(std::memchr(start, '"', static_cast<std::size_t>(end_ - start)));
+  if (quote == nullptr) fail("unterminated string");
+  if (std::memchr(start, '\\', static_cast<std::size_t>(quote - start)) == nullptr) {
+    p_ = quote + 1;
+    return {start, static_cast<std::size_t>(quote - start)};
+  }
+  // Decoded text is never longer than its source, so one reservation for
+  // the whole input keeps earlier views into the scratch buffer valid.
+  if (scratch_.empty()) scratch_.reserve(static_cast<std::size_t>(end_ - begin_));
+  const std::size_t from = scratch_.size();
+  const std::string_view text(begin_, static_cast<std::size_t>(end_ - begin_));
+  p_ = begin_ + decode_string(text, static_cast<std::size_t>(start - begin_), scratch_);
+  return {scratch_.data() + from, scratch_.size() - from};
+}
+
+std::string_view Reader::scalar() {
+  const char c = next_char();
+  fresh_ = false;
+  auto literal = [this](std::string_view word) {
+    if (static_cast<std::size_t>(end_ - p_) < word.size() || std::memcmp(p_, word.data(), word.size()) != 0) {
+      fail("invalid literal");
+    }
+    const std::string_view text(p_, word.size());
+    p_ += word.size();
+    return text;
+  };
+  switch (c) {
+    case '"': return string();
+    case '{':
+    case '[': fail("expected a scalar");
+    case 't': return literal("true");
+    case 'f': return literal("false");
+    case 'n': literal("null"); return {};
+    default: {
+      const std::string_view text(begin_, static_cast<std::size_t>(end_ - begin_));
+      const char* start = p_;
+      p_ = begin_ + scan_number(text, static_cast<std::size_t>(p_ - begin_));
+      return {start, static_cast<std::size_t>(p_ - start)};
+    }
+  }
+}
+
+void Reader::skip() {
+  const char c = next_char();
+  if (c != '{' && c != '[') {
+    scalar();
+    return;
+  }
+  int depth = 0;
+  while (p_ < end_) {
+    const char ch = *p_++;
+    if (ch == '"') {
+      for (;;) {
+        const auto* quote = static_cast<const char*>(std::memchr(p_, '"', static_cast<std::size_t>(end_ - p_)));
+        if (quote == nullptr) fail("unterminated string");
+        const char* b = quote;
+        while (b > p_ && b[-1] == '\\') --b;
+        p_ = quote + 1;
+        if ((quote - b) % 2 == 0) break;  // not escaped
+      }
+    } else if (ch == '{' || ch == '[') {
+      ++depth;
+    } else if ((ch == '}' || ch == ']') && --depth == 0) {
+      fresh_ = false;
+      return;
+    }
+  }
+  fail("unterminated value");
+}
+
+void Reader::finish() {
+  while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) ++p_;
+  if (p_ != end_) fail("trailing characters");
+}
+
+}  // namespace mpesa::json
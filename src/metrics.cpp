@@ -0,0 +1,375 @@
+#include "mpesa/metrics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+namespace mpesa {
+namespace detail {
+
+// Written only by the thread that claimed it; read by snapshots. Code slots
+// are filled once and published through `used`.
+struct alignas(64) MetricsShard {
+  static constexpr std::size_t kCodeSlots = 128;
+  static constexpr std::size_t kMaxCode = 15;
+
+  struct PhaseCounts {
+    std::array<std::atomic<std::uint64_t>, Histogram::kBuckets> buckets{};
+    std::atomic<std::uint64_t> sum{0};
+    std::atomic<std::uint64_t> min{UINT64_MAX};
+    std::atomic<std::uint64_t> max{0};
+  };
+  struct EndpointCounts {
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> failures{0};
+    std::atomic<std::uint64_t> nanos{0};
+  };
+  struct CodeSlot {
+    std::atomic<bool> used{false};
+    MetricEndpoint endpoint{};
+    CodeKind kind{};
+    std::uint8_t size = 0;
+    char code[kMaxCode];
+    std::atomic<std::uint64_t> count{0};
+  };
+
+  std::atomic<bool> claimed{true};
+  std::array<PhaseCounts, kPhaseCount> phases;
+  std::array<EndpointCounts, kMetricEndpointCount> endpoints;
+  std::array<CodeSlot, kCodeSlots> codes;
+  std::atomic<std::uint64_t> codes_dropped{0};
+};
+
+}  // namespace detail
+
+namespace {
+
+using Shard = detail::MetricsShard;
+
+std::atomic<std::uint64_t> next_metrics_id{1};
+
+/// Shards this thread has claimed, released for reuse when it exits.
+struct ThreadShards {
+  struct Claim {
+    std::uint64_t owner;
+    std::shared_ptr<Shard> shard;
+  };
+  std::vector<Claim> claims;
+
+  ~ThreadShards() {
+    for (const Claim& c : claims) c.shard->claimed.store(false, std::memory_order_release);
+  }
+};
+
+thread_local ThreadShards thread_shards;
+// Last instance this thread recorded into; trivially destructible, so the
+// fast path needs no TLS initialization guard.
+thread_local std::uint64_t last_owner = 0;
+thread_local Shard* last_shard = nullptr;
+
+/// Single-writer increment: no locked instruction needed.
+inline void bump(std::atomic<std::uint64_t>& counter, std::uint64_t by) noexcept {
+  counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+std::uint64_t nanos(Clock::duration elapsed) noexcept {
+  const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  return ns < 0 ? 0 : static_cast<std::uint64_t>(ns);
+}
+
+bool label_safe(char c) noexcept {
+  return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '.' || c == '_' ||
+         c == '-';
+}
+
+struct BucketBound {
+  std::string_view le;  // seconds, as exported
+  std::uint64_t nanos;
+};
+
+constexpr std::array<BucketBound, 16> kBucketBounds = {{
+    {"0.0005", 500'000},
+    {"0.001", 1'000'000},
+    {"0.0025", 2'500'000},
+    {"0.005", 5'000'000},
+    {"0.01", 10'000'000},
+    {"0.025", 25'000'000},
+    {"0.05", 50'000'000},
+    {"0.1", 100'000'000},
+    {"0.25", 250'000'000},
+    {"0.5", 500'000'000},
+    {"1", 1'000'000'000},
+    {"2.5", 2'500'000'000},
+    {"5", 5'000'000'000},
+    {"10", 10'000'000'000},
+    {"30", 30'000'000'000},
+    {"60", 60'000'000'000},
+}};
+
+void append_number(std::string& out, std::uint64_t value) {
+  char digits[20];
+  out.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+}
+
+void append_number(std::string& out, double value) {
+  char digits[32];
+  out.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+}
+
+double seconds(std::uint64_t ns) { return static_cast<double>(ns) / 1e9; }
+
+void append_help(std::string& out, std::string_view name, std::string_view type, std::string_view help) {
+  out.append("# HELP ").append(name).append(" ").append(help).append("\n# TYPE ").append(name).append(" ");
+  out.append(type).append("\n");
+}
+
+}  // namespace
+
+std::string_view to_string(Phase phase) noexcept {
+  switch (phase) {
+    case Phase::kDns: return "dns";
+    case Phase::kConnect: return "connect";
+    case Phase::kTls: return "tls";
+    case Phase::kTtfb: return "ttfb";
+    case Phase::kTotal: return "total";
+    case Phase::kParse: return "parse";
+    case Phase::kCallbackParse: return "callback_parse";
+    case Phase::kCallbackTotal: return "callback_total";
+  }
+  return "unknown";
+}
+
+std::string_view to_string(MetricEndpoint endpoint) noexcept {
+  switch (endpoint) {
+    case MetricEndpoint::kOAuth: return "oauth";
+    case MetricEndpoint::kStkPush: return "stk_push";
+    case MetricEndpoint::kStkQuery: return "stk_query";
+    case MetricEndpoint::kC2BRegisterUrl: return "c2b_register_url";
+    case MetricEndpoint::kC2BSimulate: return "c2b_simulate";
+    case MetricEndpoint::kB2C: return "b2c";
+    case MetricEndpoint::kB2B: return "b2b";
+    case MetricEndpoint::kTransactionStatus: return "transaction_status";
+    case MetricEndpoint::kAccountBalance: return "account_balance";
+    case MetricEndpoint::kReversal: return "reversal";
+    case MetricEndpoint::kStkCallback: return "stk_callback";
+    case MetricEndpoint::kC2BValidation: return "c2b_validation";
+    case MetricEndpoint::kC2BConfirmation: return "c2b_confirmation";
+    case MetricEndpoint::kResultCallback: return "result";
+    case MetricEndpoint::kQueueTimeout: return "queue_timeout";
+  }
+  return "unknown";
+}
+
+std::uint64_t MetricsSnapshot::code_count(MetricEndpoint endpoint, CodeKind kind,
+                                          std::string_view code) const noexcept {
+  for (const CodeCount& c : codes) {
+    if (c.endpoint == endpoint && c.kind == kind && c.code == code) return c.count;
+  }
+  return 0;
+}
+
+Metrics::Metrics() : id_(next_metrics_id.fetch_add(1, std::memory_order_relaxed)) {}
+
+Metrics::~Metrics() = default;
+
+Metrics& Metrics::global() {
+  static Metrics metrics;
+  return metrics;
+}
+
+detail::MetricsShard& Metrics::shard() noexcept {
+  if (last_owner == id_) return *last_shard;
+  for (const auto& c : thread_shards.claims) {
+    if (c.owner == id_) {
+      last_owner = id_;
+      last_shard = c.shard.get();
+      return *last_shard;
+    }
+  }
+  return attach();
+}
+
+detail::MetricsShard& Metrics::attach() {
+  std::shared_ptr<Shard> shard;
+  {
+    std::lock_guard lock(mutex_);
+    for (const auto& candidate : shards_) {
+      bool expected = false;
+      if (candidate->claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+        shard = candidate;
+        break;
+      }
+    }
+    if (!shard) shard = shards_.emplace_back(std::make_shared<Shard>());
+  }
+  thread_shards.claims.push_back({id_, shard});
+  last_owner = id_;
+  last_shard = shard.get();
+  return *shard;
+}
+
+void Metrics::record(Phase phase, Clock::duration elapsed) noexcept {
+  const std::uint64_t value = nanos(elapsed);
+  Shard::PhaseCounts& p = shard().phases[static_cast<std::size_t>(phase)];
+  bump(p.buckets[Histogram::bucket_of(value)], 1);
+  bump(p.sum, value);
+  if (value < p.min.load(std::memory_order_relaxed)) p.min.store(value, std::memory_order_relaxed);
+  if (value > p.max.load(std::memory_order_relaxed)) p.max.store(value, std::memory_order_relaxed);
+}
+
+void Metrics::record_connect(const ConnectTimings& timings, std::chrono::nanoseconds resolve, bool tls) noexcept {
+  if (resolve.count() > 0) record(Phase::kDns, resolve);
+  record(Phase::kConnect, timings.connect);
+  if (tls) record(Phase::kTls, timings.tls);
+}
+
+void Metrics::count_call(MetricEndpoint endpoint, Clock::duration elapsed, bool failed) noexcept {
+  Shard::EndpointCounts& e = shard().endpoints[static_cast<std::size_t>(endpoint)];
+  bump(e.calls, 1);
+  if (failed) bump(e.failures, 1);
+  bump(e.nanos, nanos(elapsed));
+}
+
+void Metrics::count_code(MetricEndpoint endpoint, CodeKind kind, std::string_view code) noexcept {
+  char clean[Shard::kMaxCode];
+  std::size_t size = 0;
+  for (const char c : code) {
+    if (size == sizeof(clean)) break;
+    if (label_safe(c)) clean[size++] = c;
+  }
+  // FNV-1a over the whole key.
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  const auto mix = [&hash](std::uint8_t byte) { hash = (hash ^ byte) * 0x100000001b3ULL; };
+  mix(static_cast<std::uint8_t>(endpoint));
+  mix(static_cast<std::uint8_t>(kind));
+  for (std::size_t i = 0; i < size; ++i) mix(static_cast<std::uint8_t>(clean[i]));
+
+  Shard& s = shard();
+  for (std::size_t probe = 0; probe < Shard::kCodeSlots; ++probe) {
+    Shard::CodeSlot& slot = s.codes[(hash + probe) % Shard::kCodeSlots];
+    if (!slot.used.load(std::memory_order_relaxed)) {
+      slot.endpoint = endpoint;
+      slot.kind = kind;
+      slot.size = static_cast<std::uint8_t>(size);
+      std::memcpy(slot.code, clean, size);
+      slot.count.store(1, std::memory_order_relaxed);
+      slot.used.store(true, std::memory_order_release);
+      return;
+    }
+    if (slot.endpoint == endpoint && slot.kind == kind && slot.size == size &&
+        std::memcmp(slot.code, clean, size) == 0) {
+      bump(slot.count, 1);
+      return;
+    }
+  }
+  bump(s.codes_dropped, 1);
+}
+
+void Metrics::count_code(MetricEndpoint endpoint, CodeKind kind, int code) noexcept {
+  char digits[12];
+  const auto end = std::to_chars(digits, digits + sizeof(digits), code).ptr;
+  count_code(endpoint, kind, std::string_view(digits, static_cast<std::size_t>(end - digits)));
+}
+
+MetricsSnapshot Metrics::snapshot() const {
+  MetricsSnapshot out;
+  std::map<std::tuple<MetricEndpoint, CodeKind, std::string>, std::uint64_t> codes;
+  std::array<std::uint64_t, Histogram::kBuckets> buckets;
+  std::lock_guard lock(mutex_);
+  for (const auto& s : shards_) {
+    for (std::size_t p = 0; p < kPhaseCount; ++p) {
+      const Shard::PhaseCounts& counts = s->phases[p];
+      for (std::size_t i = 0; i < Histogram::kBuckets; ++i) {
+        buckets[i] = counts.buckets[i].load(std::memory_order_relaxed);
+      }
+      out.phases[p].merge(buckets, counts.sum.load(std::memory_order_relaxed),
+                          counts.min.load(std::memory_order_relaxed), counts.max.load(std::memory_order_relaxed));
+    }
+    for (std::size_t e = 0; e < kMetricEndpointCount; ++e) {
+      const Shard::EndpointCounts& counts = s->endpoints[e];
+      out.endpoints[e].calls += counts.calls.load(std::memory_order_relaxed);
+      out.endpoints[e].failures += counts.failures.load(std::memory_order_relaxed);
+      out.endpoints[e].time += std::chrono::nanoseconds(counts.nanos.load(std::memory_order_relaxed));
+    }
+    for (const Shard::CodeSlot& slot : s->codes) {
+      if (!slot.used.load(std::memory_order_acquire)) continue;
+      codes[{slot.endpoint, slot.kind, std::string(slot.code, slot.size)}] +=
+          slot.count.load(std::memory_order_relaxed);
+    }
+    out.codes_dropped += s->codes_dropped.load(std::memory_order_relaxed);
+  }
+  out.codes.reserve(codes.size());
+  for (auto& [key, count] : codes) {
+    out.codes.push_back({std::get<0>(key), std::get<1>(key), std::get<2>(key), count});
+  }
+  return out;
+}
+
+void Metrics::write_prometheus(std::string& out) const {
+  const MetricsSnapshot s = snapshot();
+
+  append_help(out, "mpesa_phase_seconds", "histogram", "Time spent per phase of Daraja calls and callbacks.");
+  for (std::size_t p = 0; p < kPhaseCount; ++p) {
+    const Histogram& h = s.phases[p];
+    const std::string_view phase = to_string(static_cast<Phase>(p));
+    for (const BucketBound& bound : kBucketBounds) {
+      out.append("mpesa_phase_seconds_bucket{phase=\"").append(phase).append("\",le=\"");
+      out.append(bound.le).append("\"} ");
+      append_number(out, h.count_at_most(bound.nanos));
+      out.append("\n");
+    }
+    out.append("mpesa_phase_seconds_bucket{phase=\"").append(phase).append("\",le=\"+Inf\"} ");
+    append_number(out, h.count());
+    out.append("\nmpesa_phase_seconds_sum{phase=\"").append(phase).append("\"} ");
+    append_number(out, seconds(h.sum()));
+    out.append("\nmpesa_phase_seconds_count{phase=\"").append(phase).append("\"} ");
+    append_number(out, h.count());
+    out.append("\n");
+  }
+
+  const auto per_endpoint = [&](std::string_view name, std::string_view help, auto value) {
+    append_help(out, name, "counter", help);
+    for (std::size_t e = 0; e < kMetricEndpointCount; ++e) {
+      if (s.endpoints[e].calls == 0) continue;
+      out.append(name).append("{endpoint=\"").append(to_string(static_cast<MetricEndpoint>(e))).append("\"} ");
+      append_number(out, value(s.endpoints[e]));
+      out.append("\n");
+    }
+  };
+  per_endpoint("mpesa_calls_total", "Daraja calls made and callbacks received.",
+               [](const EndpointMetrics& m) { return m.calls; });
+  per_endpoint("mpesa_call_failures_total", "Calls that failed and callbacks that were rejected.",
+               [](const EndpointMetrics& m) { return m.failures; });
+  per_endpoint("mpesa_call_seconds_total", "Time spent in calls and callbacks.",
+               [](const EndpointMetrics& m) { return seconds(static_cast<std::uint64_t>(m.time.count())); });
+
+  const auto per_code = [&](std::string_view name, std::string_view label, std::string_view help, CodeKind kind) {
+    append_help(out, name, "counter", help);
+    for (const CodeCount& c : s.codes) {
+      if (c.kind != kind) continue;
+      out.append(name).append("{endpoint=\"").append(to_string(c.endpoint)).append("\",");
+      out.append(label).append("=\"").append(c.code).append("\"} ");
+      append_number(out, c.count);
+      out.append("\n");
+    }
+  };
+  per_code("mpesa_http_responses_total", "status", "HTTP statuses received from Daraja.", CodeKind::kHttpStatus);
+  per_code("mpesa_result_codes_total", "code", "Daraja ResponseCode, ResultCode and errorCode values.",
+           CodeKind::kResult);
+
+  append_help(out, "mpesa_result_codes_dropped_total", "counter", "Codes not counted because a table was full.");
+  out.append("mpesa_result_codes_dropped_total ");
+  append_number(out, s.codes_dropped);
+  out.append("\n");
+}
+
+std::string Metrics::prometheus() const {
+  std::string out;
+  write_prometheus(out);
+  return out;
+}
+
+}  // namespace mpesa
@@ -0,0 +1,154 @@
+#include "mpesa/money.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+#include "cpu.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MPESA_MONEY_AVX2 1
+#endif
+
+namespace mpesa {
+namespace {
+
+constexpr std::size_t kMaxWholeDigits = 16;
+
+// Digits are accumulated unconditionally and a non-digit only sets `bad`,
+// so the loop has no branch on the characters themselves.
+std::uint64_t accumulate(std::string_view digits, std::uint64_t value, unsigned& bad) noexcept {
+  for (const char c : digits) {
+    const unsigned d = static_cast<unsigned>(static_cast<unsigned char>(c)) - '0';
+    bad |= static_cast<unsigned>(d > 9);
+    value = value * 10 + d;
+  }
+  return value;
+}
+
+const std::int64_t* raw(std::span<const Money> amounts) noexcept {
+  static_assert(sizeof(Money) == sizeof(std::int64_t));
+  return reinterpret_cast<const std::int64_t*>(amounts.data());
+}
+
+#ifdef MPESA_MONEY_AVX2
+
+// Two accumulators of four lanes each, so consecutive adds do not wait on
+// one another.
+__attribute__((target("avx2"))) std::int64_t sum_avx2(const std::int64_t* p, std::size_t n) noexcept {
+  __m256i a = _mm256_setzero_si256();
+  __m256i b = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    a = _mm256_add_epi64(a, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)));
+    b = _mm256_add_epi64(b, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 4)));
+  }
+  alignas(32) std::uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(a, b));
+  std::uint64_t total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  for (; i < n; ++i) total += static_cast<std::uint64_t>(p[i]);
+  return static_cast<std::int64_t>(total);
+}
+
+// Four comparisons per step; only a step with a difference looks at its
+// lanes one by one.
+__attribute__((target("avx2"))) std::size_t mismatches_avx2(const std::int64_t* a, const std::int64_t* b,
+                                                            std::size_t n, std::vector<std::size_t>& out) {
+  const std::size_t before = out.size();
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    auto differ = static_cast<unsigned>(~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(x, y)))) & 0xfu;
+    for (; differ != 0; differ &= differ - 1) out.push_back(i + static_cast<std::size_t>(__builtin_ctz(differ)));
+  }
+  for (; i < n; ++i) {
+    if (a[i] != b[i]) out.push_back(i);
+  }
+  return out.size() - before;
+}
+
+#endif
+
+}  // namespace
+
+std::optional<Money> Money::parse(std::string_view text) noexcept {
+  const bool negative = !text.empty() && text[0] == '-';
+  text.remove_prefix(negative ? 1 : 0);
+  const std::size_t dot = text.find('.');
+  const std::string_view whole = text.substr(0, dot);
+  const std::string_view fraction = dot == std::string_view::npos ? std::string_view() : text.substr(dot + 1);
+  if (whole.empty() || whole.size() > kMaxWholeDigits || fraction.size() > 2 ||
+      (dot != std::string_view::npos && fraction.empty())) {
+    return std::nullopt;
+  }
+  static constexpr std::uint64_t kScale[] = {100, 10, 1};
+  unsigned bad = 0;
+  const std::uint64_t value = accumulate(fraction, accumulate(whole, 0, bad), bad) * kScale[fraction.size()];
+  if (bad != 0) return std::nullopt;
+  const auto cents = static_cast<std::int64_t>(value);
+  return Money(negative ? -cents : cents);
+}
+
+char* Money::format(char* out) const noexcept {
+  const std::uint64_t magnitude =
+      cents_ < 0 ? std::uint64_t{0} - static_cast<std::uint64_t>(cents_) : static_cast<std::uint64_t>(cents_);
+  *out = '-';
+  out += cents_ < 0 ? 1 : 0;
+  out = std::to_chars(out, out + kMaxFormattedSize, magnitude / 100).ptr;
+  const auto fraction = static_cast<unsigned>(magnitude % 100);
+  out[0] = '.';
+  out[1] = static_cast<char>('0' + fraction / 10);
+  out[2] = static_cast<char>('0' + fraction % 10);
+  return out + 3;
+}
+
+std::string Money::to_string() const {
+  char buf[kMaxFormattedSize];
+  return std::string(buf, format(buf));
+}
+
+std::size_t parse_money(std::span<const std::string_view> texts, std::span<Money> out,
+                        std::span<std::uint8_t> valid) noexcept {
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < texts.size(); ++i) {
+    const std::optional<Money> m = Money::parse(texts[i]);
+    out[i] = m.value_or(Money());
+    valid[i] = m ? 1 : 0;
+    count += valid[i];
+  }
+  return count;
+}
+
+Money sum_scalar(std::span<const Money> amounts) noexcept {
+  Money total;
+  for (const Money m : amounts) total += m;
+  return total;
+}
+
+Money sum(std::span<const Money> amounts) noexcept {
+#ifdef MPESA_MONEY_AVX2
+  if (detail::cpu_has_avx2()) return Money::from_cents(sum_avx2(raw(amounts), amounts.size()));
+#endif
+  return sum_scalar(amounts);
+}
+
+std::size_t find_mismatches_scalar(std::span<const Money> a, std::span<const Money> b,
+                                   std::vector<std::size_t>& mismatches) {
+  const std::size_t before = mismatches.size();
+  const std::size_t n = std::min(a.size(), b.size());
+  for (std::size_t i = 0; i < n; ++i) {
+    if (a[i] != b[i]) mismatches.push_back(i);
+  }
+  return mismatches.size() - before;
+}
+
+std::size_t find_mismatches(std::span<const Money> a, std::span<const Money> b,
+                            std::vector<std::size_t>& mismatches) {
+#ifdef MPESA_MONEY_AVX2
+  if (detail::cpu_has_avx2()) return mismatches_avx2(raw(a), raw(b), std::min(a.size(), b.size()), mismatches);
+#endif
+  return find_mismatches_scalar(a, b, mismatches);
+}
+
+}  // namespace mpesa
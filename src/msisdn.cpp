@@ -0,0 +1,174 @@
+#include "mpesa/msisdn.hpp"
+
+#include <array>
+#include <cstring>
+
+#include "cpu.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MPESA_MSISDN_AVX2 1
+#endif
+
+namespace mpesa {
+namespace {
+
+// Every accepted form ends in the nine-digit subscriber number, "7..." or
+// "1...", after a prefix fixed by the length: 9 none, 10 "0", 12 "254",
+// 13 "+254".
+constexpr std::size_t kSubscriberDigits = 9;
+
+constexpr std::string_view prefix_for(std::size_t length) noexcept {
+  switch (length) {
+    case 9: return "";
+    case 10: return "0";
+    case 12: return "254";
+    case 13: return "+254";
+    default: return {};
+  }
+}
+
+constexpr bool valid_length(std::size_t length) noexcept { return length >= 9 && length <= 13 && length != 11; }
+
+// The output is "254", the subscriber's lead digit, then its last eight.
+void write_normalized(const char* number, std::size_t length, char* out) noexcept {
+  std::memcpy(out, "254", 3);
+  std::memcpy(out + 3, number + length - kSubscriberDigits, kSubscriberDigits);
+}
+
+#ifdef MPESA_MSISDN_AVX2
+
+// A number of 9 to 13 bytes is read as two 8-byte loads that stay inside
+// it: its first eight bytes in the low half of a 128-bit lane and its last
+// eight in the high half. For each length, `role` says what each lane
+// byte must be: part of the prefix (equal to `expect`), the subscriber's
+// lead digit ('7' or '1'), one of the last eight digits, or ignored
+// (beyond the number, or already covered by the high half).
+enum Role : char { kIgnore = 0, kPrefix = 1, kLead = 2, kDigit = 3 };
+
+struct Pattern {
+  std::array<char, 16> role{};
+  std::array<char, 16> expect{};
+};
+
+// Lengths are checked before the kernel runs; others keep an empty pattern.
+constexpr Pattern make_pattern(std::size_t length) {
+  Pattern p;
+  if (!valid_length(length)) return p;
+  const std::string_view prefix = prefix_for(length);
+  for (std::size_t i = 0; i < prefix.size(); ++i) {
+    p.role[i] = kPrefix;
+    p.expect[i] = prefix[i];
+  }
+  p.role[prefix.size()] = kLead;
+  for (std::size_t i = 8; i < 16; ++i) p.role[i] = kDigit;
+  return p;
+}
+
+constexpr std::array<Pattern, 14> kPatterns = [] {
+  std::array<Pattern, 14> out{};
+  for (std::size_t length = 0; length < out.size(); ++length) out[length] = make_pattern(length);
+  return out;
+}();
+
+__m128i load_number(std::string_view n) noexcept {
+  std::uint64_t head;
+  std::uint64_t tail;
+  std::memcpy(&head, n.data(), sizeof(head));
+  std::memcpy(&tail, n.data() + n.size() - sizeof(tail), sizeof(tail));
+  return _mm_set_epi64x(static_cast<long long>(tail), static_cast<long long>(head));
+}
+
+__m128i load_pattern(const std::array<char, 16>& bytes) noexcept {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes.data()));
+}
+
+// Two numbers of valid length per call; bit 0 and bit 1 of the result say
+// whether each one is well formed.
+__attribute__((target("avx2"))) unsigned check_pair(std::string_view a, std::string_view b) noexcept {
+  const Pattern& pa = kPatterns[a.size()];
+  const Pattern& pb = kPatterns[b.size()];
+  const __m256i text = _mm256_set_m128i(load_number(b), load_number(a));
+  const __m256i role = _mm256_set_m128i(load_pattern(pb.role), load_pattern(pa.role));
+  const __m256i expect = _mm256_set_m128i(load_pattern(pb.expect), load_pattern(pa.expect));
+
+  const __m256i value = _mm256_sub_epi8(text, _mm256_set1_epi8('0'));
+  const __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(value, _mm256_set1_epi8(9)), value);
+  const __m256i is_lead =
+      _mm256_or_si256(_mm256_cmpeq_epi8(text, _mm256_set1_epi8('7')), _mm256_cmpeq_epi8(text, _mm256_set1_epi8('1')));
+  const __m256i is_expected = _mm256_cmpeq_epi8(text, expect);
+
+  const __m256i bad_prefix = _mm256_andnot_si256(is_expected, _mm256_cmpeq_epi8(role, _mm256_set1_epi8(kPrefix)));
+  const __m256i bad_lead = _mm256_andnot_si256(is_lead, _mm256_cmpeq_epi8(role, _mm256_set1_epi8(kLead)));
+  const __m256i bad_digit = _mm256_andnot_si256(is_digit, _mm256_cmpeq_epi8(role, _mm256_set1_epi8(kDigit)));
+  const auto bad = static_cast<unsigned>(
+      _mm256_movemask_epi8(_mm256_or_si256(bad_prefix, _mm256_or_si256(bad_lead, bad_digit))));
+  return static_cast<unsigned>((bad & 0xffffu) == 0) | static_cast<unsigned>((bad >> 16) == 0) << 1;
+}
+
+#endif
+
+}  // namespace
+
+bool normalize_msisdn(std::string_view number, char* out) noexcept {
+  if (!valid_length(number.size())) return false;
+  const std::string_view prefix = prefix_for(number.size());
+  if (number.substr(0, prefix.size()) != prefix) return false;
+  const std::string_view subscriber = number.substr(prefix.size());
+  if (subscriber[0] != '7' && subscriber[0] != '1') return false;
+  for (const char c : subscriber) {
+    if (c < '0' || c > '9') return false;
+  }
+  write_normalized(number.data(), number.size(), out);
+  return true;
+}
+
+std::optional<std::string> normalize_msisdn(std::string_view number) {
+  std::string out(kMsisdnSize, '\0');
+  if (!normalize_msisdn(number, out.data())) return std::nullopt;
+  return out;
+}
+
+std::size_t normalize_msisdns_scalar(std::span<const std::string_view> numbers, std::span<char> out,
+                                     std::span<std::uint8_t> valid) noexcept {
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < numbers.size(); ++i) {
+    valid[i] = normalize_msisdn(numbers[i], out.data() + i * kMsisdnSize) ? 1 : 0;
+    count += valid[i];
+  }
+  return count;
+}
+
+std::size_t normalize_msisdns(std::span<const std::string_view> numbers, std::span<char> out,
+                              std::span<std::uint8_t> valid) noexcept {
+#ifdef MPESA_MSISDN_AVX2
+  if (detail::cpu_has_avx2()) {
+    const auto finish = [&](std::size_t i, bool ok) -> std::size_t {
+      valid[i] = ok ? 1 : 0;
+      if (ok) write_normalized(numbers[i].data(), numbers[i].size(), out.data() + i * kMsisdnSize);
+      return valid[i];
+    };
+    // Numbers of an impossible length are rejected here, so the kernel
+    // only sees lengths its two loads fit; the rest go in pairs.
+    constexpr std::size_t kNone = static_cast<std::size_t>(-1);
+    std::size_t held = kNone;
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < numbers.size(); ++i) {
+      if (!valid_length(numbers[i].size())) {
+        valid[i] = 0;
+      } else if (held == kNone) {
+        held = i;
+      } else {
+        const unsigned ok = check_pair(numbers[held], numbers[i]);
+        count += finish(held, (ok & 1u) != 0) + finish(i, (ok & 2u) != 0);
+        held = kNone;
+      }
+    }
+    if (held != kNone) count += finish(held, normalize_msisdn(numbers[held], out.data() + held * kMsisdnSize));
+    return count;
+  }
+#endif
+  return normalize_msisdns_scalar(numbers, out, valid);
+}
+
+}  // namespace mpesa
@@ -0,0 +1,69 @@
+#include "mpesa/prepared_request.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+#include "mpesa/error.hpp"
+#include "mpesa/json.hpp"
+
+namespace mpesa::detail {
+namespace {
+
+void member(std::string& out, std::string_view name, std::string_view value) {
+  json::append_quoted(out, name);
+  out.push_back(':');
+  json::append_quoted(out, value);
+  out.push_back(',');
+}
+
+void require(bool ok, const char* what) {
+  if (!ok) throw Error(ErrorCode::kInvalidArgument, std::string("B2C sender: ") + what);
+}
+
+bool is_url(std::string_view url) { return url.starts_with("https://") || url.starts_with("http://"); }
+
+}  // namespace
+
+B2CFragments render_b2c_fragments(const B2CSender& sender, std::string_view command_id) {
+  require(!sender.initiator_name.empty(), "InitiatorName is required");
+  require(!sender.security_credential.empty(), "SecurityCredential is required");
+  require(!sender.party_a.empty() && std::all_of(sender.party_a.begin(), sender.party_a.end(),
+                                                 [](char c) { return c >= '0' && c <= '9'; }),
+          "PartyA must be a shortcode");
+  require(is_url(sender.queue_timeout_url), "QueueTimeOutURL must be an http(s) URL");
+  require(is_url(sender.result_url), "ResultURL must be an http(s) URL");
+
+  // Member order matches write_body(const B2CRequest&).
+  B2CFragments f;
+  member(f.head, "InitiatorName", sender.initiator_name);
+  member(f.head, "SecurityCredential", sender.security_credential);
+  member(f.head, "CommandID", command_id);
+  f.head.append(R"("Amount":)");
+  f.middle.push_back(',');
+  member(f.middle, "PartyA", sender.party_a);
+  f.middle.append(R"("PartyB":)");
+  f.tail.push_back(',');
+  member(f.tail, "QueueTimeOutURL", sender.queue_timeout_url);
+  member(f.tail, "ResultURL", sender.result_url);
+  f.tail.append(R"("Occassion":)");  // sic: Daraja's spelling
+  f.party_a = sender.party_a;
+  return f;
+}
+
+void write_b2c_body(const B2CFragments& f, std::string_view originator_conversation_id, std::int64_t amount,
+                    std::string_view party_b, std::string_view remarks, std::string_view occasion, std::string& out) {
+  out.push_back('{');
+  if (!originator_conversation_id.empty()) member(out, "OriginatorConversationID", originator_conversation_id);
+  out.append(f.head);
+  char digits[24];
+  out.append(digits, std::to_chars(digits, digits + sizeof(digits), amount).ptr);
+  out.append(f.middle);
+  json::append_quoted(out, party_b);
+  out.append(R"(,"Remarks":)");
+  json::append_quoted(out, remarks);
+  out.append(f.tail);
+  json::append_quoted(out, occasion);
+  out.push_back('}');
+}
+
+}  // namespace mpesa::detail
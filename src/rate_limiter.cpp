@@ -0,0 +1,232 @@
+#include "mpesa/rate_limiter.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+namespace {
+
+// Daraja's gateway answers over-quota callers with these, as 429 or 500.
+constexpr std::string_view kSpikeArrest = "500.003.02";
+constexpr std::string_view kQuotaViolation = "500.003.03";
+
+std::int64_t ticks_of(std::chrono::milliseconds d) noexcept {
+  return std::chrono::duration_cast<Clock::duration>(d).count();
+}
+
+std::int64_t interval_for(double rate) noexcept {
+  const auto interval = std::chrono::duration<double>(1.0 / std::max(rate, 1e-3));
+  return std::max<std::int64_t>(1, std::chrono::duration_cast<Clock::duration>(interval).count());
+}
+
+std::uint64_t hash_lane(MetricEndpoint endpoint, std::string_view shortcode) noexcept {
+  std::uint64_t h = 0xcbf29ce484222325ULL;
+  h = (h ^ static_cast<std::uint8_t>(endpoint)) * 0x100000001b3ULL;
+  for (const char c : shortcode) h = (h ^ static_cast<std::uint8_t>(c)) * 0x100000001b3ULL;
+  return h ^ (h >> 29);
+}
+
+}  // namespace
+
+const char* to_string(BreakerState state) noexcept {
+  switch (state) {
+    case BreakerState::kClosed: return "closed";
+    case BreakerState::kOpen: return "open";
+    case BreakerState::kHalfOpen: return "half-open";
+  }
+  return "unknown";
+}
+
+RateLane::RateLane(MetricEndpoint endpoint, std::string shortcode, const RateLimiterOptions& options)
+    : endpoint_(endpoint),
+      shortcode_(std::move(shortcode)),
+      options_(options),
+      interval_(interval_for(std::clamp(options.initial_rate, options.min_rate, options.max_rate))),
+      last_increase_(ticks(Clock::now())) {}
+
+void RateLane::reject(const char* why) {
+  rejected_.fetch_add(1, std::memory_order_relaxed);
+  throw Error(ErrorCode::kUnavailable,
+              std::string(why) + " for " + std::string(to_string(endpoint_)) + " " + shortcode_);
+}
+
+Clock::duration RateLane::admit(Clock::time_point now) {
+  const std::int64_t t = ticks(now);
+  bool probe = false;
+  const std::int64_t open_until = open_until_.load(std::memory_order_acquire);
+  if (open_until != 0) {
+    if (t < open_until || probing_.exchange(true, std::memory_order_acq_rel)) reject("circuit open");
+    probe = true;
+  }
+  const std::int64_t interval = interval_.load(std::memory_order_relaxed);
+  const std::int64_t tolerance = interval * (std::max(options_.burst, 1u) - 1);
+  const std::int64_t max_delay = ticks_of(options_.max_delay);
+  std::int64_t next = next_free_.load(std::memory_order_relaxed);
+  for (;;) {
+    const std::int64_t start = std::max(next, t);
+    const std::int64_t wait = std::max<std::int64_t>(0, start - tolerance - t);
+    if (wait > max_delay) {
+      if (probe) probing_.store(false, std::memory_order_release);
+      reject("rate limited");
+    }
+    if (next_free_.compare_exchange_weak(next, start + interval, std::memory_order_relaxed)) {
+      admitted_.fetch_add(1, std::memory_order_relaxed);
+      if (wait > 0) delayed_.fetch_add(1, std::memory_order_relaxed);
+      return Clock::duration(wait);
+    }
+  }
+}
+
+void RateLane::answered() noexcept {
+  // Loads first so the steady state writes nothing shared.
+  if (failures_.load(std::memory_order_relaxed) != 0) failures_.store(0, std::memory_order_relaxed);
+  if (open_until_.load(std::memory_order_relaxed) != 0) {
+    open_until_.store(0, std::memory_order_release);
+    probing_.store(false, std::memory_order_release);
+  }
+}
+
+void RateLane::succeeded(Clock::time_point now) noexcept {
+  answered();
+  const std::int64_t t = ticks(now);
+  std::int64_t last = last_increase_.load(std::memory_order_relaxed);
+  if (t - last >= ticks_of(options_.adjust_period) &&
+      last_increase_.compare_exchange_strong(last, t, std::memory_order_relaxed)) {
+    set_rate(std::min(rate() + options_.increase, options_.max_rate));
+  }
+}
+
+void RateLane::throttled(Clock::time_point now) noexcept {
+  answered();
+  throttled_.fetch_add(1, std::memory_order_relaxed);
+  const std::int64_t t = ticks(now);
+  last_increase_.store(t, std::memory_order_relaxed);
+  // A burst of calls in flight all come back throttled; cut the rate once
+  // for the lot.
+  std::int64_t last = last_decrease_.load(std::memory_order_relaxed);
+  if (t - last >= ticks_of(options_.adjust_period) &&
+      last_decrease_.compare_exchange_strong(last, t, std::memory_order_relaxed)) {
+    set_rate(std::max(rate() * options_.decrease, options_.min_rate));
+  }
+  const std::int64_t resume = t + ticks_of(options_.throttle_pause);
+  std::int64_t next = next_free_.load(std::memory_order_relaxed);
+  while (next < resume && !next_free_.compare_exchange_weak(next, resume, std::memory_order_relaxed)) {
+  }
+}
+
+void RateLane::failed(Clock::time_point now) noexcept {
+  const std::int64_t t = ticks(now);
+  const std::int64_t open_until = open_until_.load(std::memory_order_acquire);
+  if (open_until != 0) {
+    // Only the half-open probe reopens; other failures are calls that were
+    // already in flight when the breaker opened.
+    if (t >= open_until && probing_.load(std::memory_order_acquire)) {
+      open_until_.store(t + ticks_of(options_.open_time), std::memory_order_release);
+      probing_.store(false, std::memory_order_release);
+      trips_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return;
+  }
+  if (failures_.fetch_add(1, std::memory_order_relaxed) + 1 == std::max(options_.failure_threshold, 1u)) {
+    open_until_.store(t + ticks_of(options_.open_time), std::memory_order_release);
+    trips_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void RateLane::abandoned() noexcept {
+  if (open_until_.load(std::memory_order_relaxed) != 0) probing_.store(false, std::memory_order_release);
+}
+
+void RateLane::completed(const std::exception_ptr& error, Clock::time_point now) noexcept {
+  if (!error) {
+    succeeded(now);
+    return;
+  }
+  try {
+    std::rethrow_exception(error);
+  } catch (const ApiError& e) {
+    if (e.http_status() == 429 || e.error_code() == kSpikeArrest || e.error_code() == kQuotaViolation) {
+      throttled(now);
+    } else if (e.http_status() >= 500) {
+      failed(now);
+    } else {
+      succeeded(now);
+    }
+  } catch (const Error& e) {
+    if ((e.transient() && e.code() != ErrorCode::kUnavailable) || e.code() == ErrorCode::kProtocol) {
+      failed(now);
+    } else {
+      abandoned();
+    }
+  } catch (...) {
+    abandoned();
+  }
+}
+
+void RateLane::set_rate(double rate) noexcept { interval_.store(interval_for(rate), std::memory_order_relaxed); }
+
+double RateLane::rate() const noexcept {
+  return 1.0 / std::chrono::duration<double>(Clock::duration(interval_.load(std::memory_order_relaxed))).count();
+}
+
+BreakerState RateLane::breaker(Clock::time_point now) const noexcept {
+  const std::int64_t open_until = open_until_.load(std::memory_order_acquire);
+  if (open_until == 0) return BreakerState::kClosed;
+  return ticks(now) < open_until ? BreakerState::kOpen : BreakerState::kHalfOpen;
+}
+
+LaneStats RateLane::stats() const {
+  LaneStats s;
+  s.endpoint = endpoint_;
+  s.shortcode = shortcode_;
+  s.rate = rate();
+  s.breaker = breaker();
+  s.admitted = admitted_.load(std::memory_order_relaxed);
+  s.delayed = delayed_.load(std::memory_order_relaxed);
+  s.rejected = rejected_.load(std::memory_order_relaxed);
+  s.throttled = throttled_.load(std::memory_order_relaxed);
+  s.trips = trips_.load(std::memory_order_relaxed);
+  return s;
+}
+
+RateLimiter::RateLimiter(RateLimiterOptions options)
+    : options_(options),
+      mask_(std::bit_ceil(std::max<std::size_t>(options.max_lanes, 8) * 2) - 1),
+      slots_(std::make_unique<std::atomic<RateLane*>[]>(mask_ + 1)),
+      overflow_(MetricEndpoint{}, "*", options_) {}
+
+RateLimiter::~RateLimiter() {
+  for (std::size_t i = 0; i <= mask_; ++i) delete slots_[i].load(std::memory_order_relaxed);
+}
+
+RateLane& RateLimiter::lane(MetricEndpoint endpoint, std::string_view shortcode) {
+  std::size_t i = static_cast<std::size_t>(hash_lane(endpoint, shortcode)) & mask_;
+  // The table is twice `max_lanes`, so a probe always ends at a match or an
+  // empty slot.
+  for (;; i = (i + 1) & mask_) {
+    RateLane* lane = slots_[i].load(std::memory_order_acquire);
+    if (lane == nullptr) {
+      if (lanes_.fetch_add(1, std::memory_order_relaxed) >= options_.max_lanes) {
+        lanes_.fetch_sub(1, std::memory_order_relaxed);
+        return overflow_;
+      }
+      auto fresh = std::make_unique<RateLane>(endpoint, std::string(shortcode), options_);
+      if (slots_[i].compare_exchange_strong(lane, fresh.get(), std::memory_order_acq_rel)) return *fresh.release();
+      lanes_.fetch_sub(1, std::memory_order_relaxed);  // lost the slot; `lane` is the winner
+    }
+    if (lane->endpoint() == endpoint && lane->shortcode() == shortcode) return *lane;
+  }
+}
+
+std::vector<LaneStats> RateLimiter::stats() const {
+  std::vector<LaneStats> out;
+  for (std::size_t i = 0; i <= mask_; ++i) {
+    if (const RateLane* lane = slots_[i].load(std::memory_order_acquire)) out.push_back(lane->stats());
+  }
+  if (overflow_.stats().admitted != 0) out.push_back(overflow_.stats());
+  return out;
+}
+
+}  // namespace mpesa
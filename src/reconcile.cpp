@@ -0,0 +1,370 @@
+#include "mpesa/reconcile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <tuple>
+
+#include "mpesa/callbacks.hpp"
+#include "mpesa/connection.hpp"
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+namespace {
+
+[[noreturn]] void fail(const std::string& path, const char* what) {
+  throw Error(ErrorCode::kInternal, "statement " + path + ": " + what + ": " + std::strerror(errno));
+}
+
+/// Splits `line` at commas outside double quotes. Quoted fields come back
+/// without their quotes; doubled quotes inside them are left as they are.
+void split_fields(std::string_view line, std::vector<std::string_view>& out) {
+  out.clear();
+  std::size_t i = 0;
+  for (;;) {
+    if (i < line.size() && line[i] == '"') {
+      std::size_t end = i + 1;
+      for (; end < line.size(); ++end) {
+        if (line[end] != '"') continue;
+        if (end + 1 < line.size() && line[end + 1] == '"') {
+          ++end;
+          continue;
+        }
+        break;
+      }
+      out.push_back(line.substr(i + 1, std::min(end, line.size()) - i - 1));
+      i = std::min(line.find(',', end), line.size());
+    } else {
+      const std::size_t end = std::min(line.find(',', i), line.size());
+      out.push_back(line.substr(i, end - i));
+      i = end;
+    }
+    if (i >= line.size()) return;
+    ++i;  // ','
+  }
+}
+
+std::string_view trim(std::string_view s) noexcept {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+  return s;
+}
+
+/// "1,234.50", "-500.00" or "" as positive cents; -1 if not an amount.
+std::int64_t statement_cents(std::string_view field) noexcept {
+  field = trim(field);
+  if (field.empty()) return 0;
+  if (field.front() == '-') field.remove_prefix(1);
+  char digits[32];
+  std::size_t n = 0;
+  for (const char c : field) {
+    if (c == ',') continue;
+    if (n == sizeof(digits)) return -1;
+    digits[n++] = c;
+  }
+  return parse_amount_cents(std::string_view(digits, n));
+}
+
+std::uint64_t hash_key(std::string_view key) noexcept {
+  std::uint64_t h = 14695981039346656037ull;
+  for (const char c : key) h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  return h ^ (h >> 29);
+}
+
+/// A key on either side of the join. `where` is the statement offset or
+/// the ledger index.
+struct Ref {
+  std::uint64_t hash;
+  std::string_view key;
+  std::int64_t cents;
+  std::size_t where;
+};
+
+using Partitions = std::vector<std::vector<Ref>>;
+
+struct JoinOutput {
+  std::vector<Discrepancy> discrepancies;
+  std::size_t matched = 0;
+};
+
+void report(JoinOutput& out, DiscrepancyKind kind, std::string_view key, const Ref* row, const Ref* entry) {
+  Discrepancy& d = out.discrepancies.emplace_back();
+  d.kind = kind;
+  d.trans_id.assign(key);
+  if (row != nullptr) {
+    d.statement_cents = row->cents;
+    d.statement_offset = row->where;
+  }
+  if (entry != nullptr) {
+    d.ledger_cents = entry->cents;
+    d.ledger_index = entry->where;
+  }
+}
+
+// One partition: a table over its ledger refs, probed by its statement
+// refs. Each thread parsed a contiguous run of the statement and of the
+// ledger, so visiting per-thread partitions in thread order is file order
+// and ledger order, and "first occurrence" does not depend on the thread
+// count.
+void join_partition(const std::vector<Partitions>& statement, const std::vector<Partitions>& ledger,
+                    std::size_t partition, JoinOutput& out) {
+  struct Entry {
+    const Ref* ref;
+    bool matched;
+  };
+  std::vector<Entry> entries;
+  std::size_t ledger_refs = 0;
+  for (const Partitions& p : ledger) ledger_refs += p[partition].size();
+  entries.reserve(ledger_refs);
+  std::vector<std::uint32_t> table(std::bit_ceil(std::max<std::size_t>(ledger_refs * 2, 2)), 0);  // entry + 1
+  const std::size_t mask = table.size() - 1;
+  const auto find = [&](const Ref& ref) -> std::uint32_t* {
+    for (std::size_t i = ref.hash & mask;; i = (i + 1) & mask) {
+      if (table[i] == 0 || entries[table[i] - 1].ref->key == ref.key) return &table[i];
+    }
+  };
+
+  for (const Partitions& p : ledger) {
+    for (const Ref& ref : p[partition]) {
+      std::uint32_t* slot = find(ref);
+      if (*slot != 0) {
+        report(out, DiscrepancyKind::kDuplicateInLedger, ref.key, nullptr, &ref);
+        continue;
+      }
+      entries.push_back({&ref, false});
+      *slot = static_cast<std::uint32_t>(entries.size());
+    }
+  }
+  for (const Partitions& p : statement) {
+    for (const Ref& row : p[partition]) {
+      const std::uint32_t slot = *find(row);
+      if (slot == 0) {
+        report(out, DiscrepancyKind::kMissingFromLedger, row.key, &row, nullptr);
+        continue;
+      }
+      Entry& entry = entries[slot - 1];
+      if (entry.matched) {
+        report(out, DiscrepancyKind::kDuplicateInStatement, row.key, &row, entry.ref);
+        continue;
+      }
+      entry.matched = true;
+      if (row.cents != entry.ref->cents) {
+        report(out, DiscrepancyKind::kAmountMismatch, row.key, &row, entry.ref);
+      } else {
+        ++out.matched;
+      }
+    }
+  }
+  for (const Entry& entry : entries) {
+    if (!entry.matched) report(out, DiscrepancyKind::kMissingFromStatement, entry.ref->key, nullptr, entry.ref);
+  }
+}
+
+template <class Fn>
+void run_threads(unsigned threads, Fn fn) {
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (unsigned t = 1; t < threads; ++t) pool.emplace_back(fn, t);
+  fn(0u);
+  for (std::thread& thread : pool) thread.join();
+}
+
+}  // namespace
+
+const char* to_string(DiscrepancyKind kind) noexcept {
+  switch (kind) {
+    case DiscrepancyKind::kMissingFromLedger: return "missing_from_ledger";
+    case DiscrepancyKind::kMissingFromStatement: return "missing_from_statement";
+    case DiscrepancyKind::kDuplicateInStatement: return "duplicate_in_statement";
+    case DiscrepancyKind::kDuplicateInLedger: return "duplicate_in_ledger";
+    case DiscrepancyKind::kAmountMismatch: return "amount_mismatch";
+  }
+  return "unknown";
+}
+
+StatementFile::StatementFile(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) fail(path, "open");
+  struct stat st {};
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    fail(path, "stat");
+  }
+  size_ = static_cast<std::size_t>(st.st_size);
+  if (size_ != 0) {
+    void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      ::close(fd);
+      fail(path, "mmap");
+    }
+    ::madvise(mapped, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(mapped);
+  }
+  ::close(fd);
+
+  const std::string_view text(data_, size_);
+  std::vector<std::string_view> fields;
+  for (std::size_t pos = 0; pos < text.size();) {
+    const std::size_t eol = std::min(text.find('\n', pos), text.size());
+    split_fields(text.substr(pos, eol - pos), fields);
+    pos = std::min(eol + 1, text.size());
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      const std::string_view name = trim(fields[i]);
+      const int column = static_cast<int>(i);
+      if (name == "Receipt No.") columns_.receipt = column;
+      else if (name == "Completion Time") columns_.completion_time = column;
+      else if (name == "Details") columns_.details = column;
+      else if (name == "Transaction Status") columns_.status = column;
+      else if (name == "Paid In") columns_.paid_in = column;
+      else if (name == "Withdrawn") columns_.withdrawn = column;
+    }
+    if (columns_.receipt < 0) {
+      columns_ = Columns{};
+      continue;
+    }
+    if (columns_.paid_in < 0 || columns_.withdrawn < 0) break;
+    columns_.needed = 1 + std::max({columns_.receipt, columns_.completion_time, columns_.details, columns_.status,
+                                    columns_.paid_in, columns_.withdrawn});
+    rows_ = text.substr(pos);
+    return;
+  }
+  if (data_ != nullptr) ::munmap(const_cast<char*>(data_), size_);
+  throw Error(ErrorCode::kParse,
+              "statement " + path + ": no header row with \"Receipt No.\", \"Paid In\" and \"Withdrawn\"");
+}
+
+StatementFile::~StatementFile() {
+  if (data_ != nullptr) ::munmap(const_cast<char*>(data_), size_);
+}
+
+std::vector<std::string_view> StatementFile::split(std::size_t pieces) const {
+  std::vector<std::string_view> out;
+  pieces = std::max<std::size_t>(pieces, 1);
+  const std::size_t step = rows_.size() / pieces + 1;
+  for (std::size_t begin = 0; begin < rows_.size();) {
+    std::size_t end = std::min(begin + step, rows_.size());
+    if (end < rows_.size()) end = std::min(rows_.find('\n', end), rows_.size() - 1) + 1;
+    out.push_back(rows_.substr(begin, end - begin));
+    begin = end;
+  }
+  return out;
+}
+
+std::size_t StatementFile::read_rows(std::string_view text, std::vector<StatementRow>& out) const {
+  thread_local std::vector<std::string_view> fields;
+  std::size_t malformed = 0;
+  const auto field = [&](int column) { return column < 0 ? std::string_view{} : trim(fields[column]); };
+  for (std::size_t pos = 0; pos < text.size();) {
+    const std::size_t eol = std::min(text.find('\n', pos), text.size());
+    const std::string_view line = trim(text.substr(pos, eol - pos));
+    const std::size_t offset = static_cast<std::size_t>(text.data() + pos - data_);
+    pos = eol + 1;
+    if (line.empty()) continue;
+    split_fields(line, fields);
+    if (fields.size() < static_cast<std::size_t>(columns_.needed) || field(columns_.receipt).empty()) {
+      ++malformed;
+      continue;
+    }
+    const std::int64_t paid_in = statement_cents(fields[columns_.paid_in]);
+    const std::int64_t withdrawn = statement_cents(fields[columns_.withdrawn]);
+    if (paid_in < 0 || withdrawn < 0) {
+      ++malformed;
+      continue;
+    }
+    out.push_back({field(columns_.receipt), field(columns_.completion_time), field(columns_.details),
+                   field(columns_.status), paid_in, withdrawn, offset});
+  }
+  return malformed;
+}
+
+ReconciliationReport reconcile(const StatementFile& statement, std::span<const LedgerEntry> ledger,
+                               ReconcileOptions options) {
+  const unsigned threads =
+      std::max(1u, options.threads != 0 ? options.threads : std::thread::hardware_concurrency());
+  const std::size_t partitions = std::bit_ceil(std::size_t{threads} * 8);
+  const int shift = 64 - std::countr_zero(partitions);
+  const auto partition_of = [shift](std::uint64_t hash) { return static_cast<std::size_t>(hash >> shift); };
+
+  ReconciliationReport report;
+  report.ledger_entries = ledger.size();
+  const auto started = Clock::now();
+
+  // Phase 1: each thread parses a contiguous run of statement pieces and
+  // one slice of the ledger into its own partitions. Runs rather than every
+  // `threads`-th piece keep thread order equal to file order.
+  const std::vector<std::string_view> pieces = statement.split(std::size_t{threads} * 16);
+  std::vector<Partitions> statement_parts(threads, Partitions(partitions));
+  std::vector<Partitions> ledger_parts(threads, Partitions(partitions));
+  std::vector<std::array<std::size_t, 3>> row_counts(threads);  // taking part, skipped, malformed
+  run_threads(threads, [&](unsigned t) {
+    Partitions& parts = statement_parts[t];
+    std::vector<StatementRow> rows;
+    const std::size_t first = pieces.size() * t / threads;
+    const std::size_t last = pieces.size() * (t + 1) / threads;
+    for (std::size_t i = first; i < last; ++i) {
+      rows.clear();
+      row_counts[t][2] += statement.read_rows(pieces[i], rows);
+      for (const StatementRow& row : rows) {
+        if ((options.completed_only && row.status != "Completed") ||
+            (options.skip_charges && row.details.find("Charge") != std::string_view::npos)) {
+          ++row_counts[t][1];
+          continue;
+        }
+        ++row_counts[t][0];
+        const std::uint64_t hash = hash_key(row.receipt);
+        parts[partition_of(hash)].push_back(
+            {hash, row.receipt, row.paid_in_cents != 0 ? row.paid_in_cents : row.withdrawn_cents, row.offset});
+      }
+    }
+    const std::size_t begin = ledger.size() * t / threads;
+    const std::size_t end = ledger.size() * (t + 1) / threads;
+    for (std::size_t i = begin; i < end; ++i) {
+      const std::uint64_t hash = hash_key(ledger[i].trans_id);
+      ledger_parts[t][partition_of(hash)].push_back({hash, ledger[i].trans_id, ledger[i].amount_cents, i});
+    }
+  });
+  for (const auto& c : row_counts) {
+    report.statement_rows += c[0];
+    report.skipped_rows += c[1];
+    report.malformed_rows += c[2];
+  }
+  const auto parsed = Clock::now();
+
+  // Phase 2: threads take whole partitions.
+  std::vector<JoinOutput> outputs(threads);
+  std::atomic<std::size_t> next{0};
+  run_threads(threads, [&](unsigned t) {
+    for (std::size_t p; (p = next.fetch_add(1, std::memory_order_relaxed)) < partitions;) {
+      join_partition(statement_parts, ledger_parts, p, outputs[t]);
+    }
+  });
+  std::size_t total = 0;
+  for (const JoinOutput& o : outputs) total += o.discrepancies.size();
+  report.discrepancies.reserve(total);
+  for (JoinOutput& o : outputs) {
+    report.matched += o.matched;
+    for (Discrepancy& d : o.discrepancies) {
+      ++report.counts[static_cast<std::size_t>(d.kind)];
+      report.discrepancies.push_back(std::move(d));
+    }
+  }
+  // Threads finish partitions in any order; sort fully so the report does
+  // not depend on it.
+  std::sort(report.discrepancies.begin(), report.discrepancies.end(), [](const Discrepancy& a, const Discrepancy& b) {
+    return std::tie(a.trans_id, a.kind, a.statement_offset, a.ledger_index) <
+           std::tie(b.trans_id, b.kind, b.statement_offset, b.ledger_index);
+  });
+  report.parse_time = parsed - started;
+  report.join_time = Clock::now() - parsed;
+  return report;
+}
+
+}  // namespace mpesa
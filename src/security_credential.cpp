@@ -0,0 +1,245 @@
+#include "mpesa/security_credential.hpp"
+
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+#include "mpesa/base64.hpp"
+#include "mpesa/error.hpp"
+#include "mpesa/tls.hpp"
+
+namespace mpesa {
+
+struct SecurityCredentials::Key {
+  std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> pkey{nullptr, &EVP_PKEY_free};
+  /// Distinguishes credentials encrypted under an older certificate.
+  std::uint64_t generation = 0;
+};
+
+namespace {
+
+using ContextPtr = std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)>;
+
+// Batches below this size are encrypted on the calling thread.
+constexpr std::size_t kParallelBatch = 64;
+
+std::atomic<std::uint64_t> g_key_generation{0};
+
+[[noreturn]] void fail(const std::string& what) {
+  throw Error(ErrorCode::kInvalidArgument, what + ": " + tls_error_string());
+}
+
+EVP_PKEY* read_public_key(std::string_view pem) {
+  std::unique_ptr<BIO, decltype(&BIO_free)> bio(BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size())), &BIO_free);
+  if (!bio) fail("reading certificate");
+  if (X509* cert = PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr)) {
+    EVP_PKEY* key = X509_get_pubkey(cert);
+    X509_free(cert);
+    return key;
+  }
+  ERR_clear_error();
+  BIO_reset(bio.get());
+  return PEM_read_bio_PUBKEY(bio.get(), nullptr, nullptr, nullptr);
+}
+
+ContextPtr make_context(EVP_PKEY* key) {
+  ContextPtr ctx(EVP_PKEY_CTX_new(key, nullptr), &EVP_PKEY_CTX_free);
+  if (!ctx || EVP_PKEY_encrypt_init(ctx.get()) != 1 ||
+      EVP_PKEY_CTX_set_rsa_padding(ctx.get(), RSA_PKCS1_PADDING) != 1) {
+    fail("preparing RSA encryption");
+  }
+  return ctx;
+}
+
+std::string encrypt_with(EVP_PKEY_CTX* ctx, std::string_view password) {
+  const auto* in = reinterpret_cast<const unsigned char*>(password.data());
+  std::size_t size = 0;
+  if (EVP_PKEY_encrypt(ctx, nullptr, &size, in, password.size()) != 1) fail("sizing credential");
+  std::string cipher(size, '\0');
+  if (EVP_PKEY_encrypt(ctx, reinterpret_cast<unsigned char*>(cipher.data()), &size, in, password.size()) != 1) {
+    fail("encrypting credential (password too long for the key?)");
+  }
+  cipher.resize(size);
+  return base64_encode(cipher);
+}
+
+bool same_password(const std::string& cached, std::string_view password) noexcept {
+  return cached.size() == password.size() && CRYPTO_memcmp(cached.data(), password.data(), cached.size()) == 0;
+}
+
+}  // namespace
+
+std::shared_ptr<const SecurityCredentials::Key> SecurityCredentials::load_key(std::string_view certificate_pem) {
+  auto key = std::make_shared<Key>();
+  key->pkey.reset(read_public_key(certificate_pem));
+  if (!key->pkey) fail("no certificate or public key in PEM");
+  if (EVP_PKEY_base_id(key->pkey.get()) != EVP_PKEY_RSA) {
+    throw Error(ErrorCode::kInvalidArgument, "SecurityCredential certificate must hold an RSA key");
+  }
+  key->generation = g_key_generation.fetch_add(1, std::memory_order_relaxed) + 1;
+  return key;
+}
+
+SecurityCredentials::SecurityCredentials(std::string_view certificate_pem) : key_(load_key(certificate_pem)) {}
+
+SecurityCredentials::~SecurityCredentials() {
+  for (auto& [initiator, entry] : entries_) OPENSSL_cleanse(entry.password.data(), entry.password.size());
+}
+
+std::shared_ptr<const SecurityCredentials::Key> SecurityCredentials::current_key() const {
+  std::shared_lock lock(mutex_);
+  return key_;
+}
+
+std::string SecurityCredentials::get(std::string_view initiator, std::string_view password) {
+  for (;;) {
+    std::shared_ptr<const Key> key;
+    {
+      std::shared_lock lock(mutex_);
+      const auto it = entries_.find(initiator);
+      if (it != entries_.end() && it->second.key_generation == key_->generation &&
+          same_password(it->second.password, password)) {
+        return it->second.credential;
+      }
+      key = key_;
+    }
+    std::string credential = encrypt_with(make_context(key->pkey.get()).get(), password);
+    encryptions_.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock lock(mutex_);
+    if (key_ != key) continue;  // certificate rotated meanwhile
+    Entry& entry = entries_[std::string(initiator)];
+    entry.password.assign(password);
+    entry.credential = credential;
+    entry.key_generation = key->generation;
+    return credential;
+  }
+}
+
+std::string SecurityCredentials::get(std::string_view initiator) {
+  std::string password;
+  {
+    std::shared_lock lock(mutex_);
+    const auto it = entries_.find(initiator);
+    if (it == entries_.end()) {
+      throw Error(ErrorCode::kInvalidArgument, "no password for initiator '" + std::string(initiator) + "'");
+    }
+    if (it->second.key_generation == key_->generation) return it->second.credential;
+    password = it->second.password;
+  }
+  std::string credential = get(initiator, password);
+  OPENSSL_cleanse(password.data(), password.size());
+  return credential;
+}
+
+void SecurityCredentials::set(std::span<const InitiatorPassword> initiators) {
+  std::lock_guard writer(writer_mutex_);
+  const std::shared_ptr<const Key> key = current_key();
+  std::vector<std::string_view> passwords;
+  passwords.reserve(initiators.size());
+  for (const auto& i : initiators) passwords.push_back(i.password);
+  std::vector<std::string> credentials;
+  encrypt_batch(*key, passwords, credentials);
+  std::unique_lock lock(mutex_);
+  for (std::size_t i = 0; i < initiators.size(); ++i) {
+    Entry& entry = entries_[initiators[i].initiator];
+    entry.password = initiators[i].password;
+    entry.credential = std::move(credentials[i]);
+    entry.key_generation = key->generation;
+  }
+}
+
+void SecurityCredentials::set(std::string_view initiator, std::string_view password) {
+  const InitiatorPassword one{std::string(initiator), std::string(password)};
+  set(std::span(&one, 1));
+}
+
+void SecurityCredentials::remove(std::string_view initiator) {
+  std::unique_lock lock(mutex_);
+  const auto it = entries_.find(initiator);
+  if (it == entries_.end()) return;
+  OPENSSL_cleanse(it->second.password.data(), it->second.password.size());
+  entries_.erase(it);
+}
+
+void SecurityCredentials::rotate_certificate(std::string_view certificate_pem) {
+  const std::shared_ptr<const Key> fresh = load_key(certificate_pem);
+  std::lock_guard writer(writer_mutex_);
+  std::vector<std::string> initiators;
+  std::vector<std::string> passwords;
+  {
+    std::shared_lock lock(mutex_);
+    for (const auto& [initiator, entry] : entries_) {
+      initiators.push_back(initiator);
+      passwords.push_back(entry.password);
+    }
+  }
+  std::vector<std::string> credentials;
+  encrypt_batch(*fresh, std::vector<std::string_view>(passwords.begin(), passwords.end()), credentials);
+
+  std::unique_lock lock(mutex_);
+  key_ = fresh;
+  for (std::size_t i = 0; i < initiators.size(); ++i) {
+    // An entry whose password changed meanwhile stays on the old generation
+    // and is re-encrypted on its next `get`.
+    const auto it = entries_.find(initiators[i]);
+    if (it == entries_.end() || it->second.password != passwords[i]) continue;
+    it->second.credential = std::move(credentials[i]);
+    it->second.key_generation = key_->generation;
+  }
+  lock.unlock();
+  for (std::string& p : passwords) OPENSSL_cleanse(p.data(), p.size());
+}
+
+std::string SecurityCredentials::encrypt(std::string_view password) const {
+  const std::shared_ptr<const Key> key = current_key();
+  std::string credential = encrypt_with(make_context(key->pkey.get()).get(), password);
+  encryptions_.fetch_add(1, std::memory_order_relaxed);
+  return credential;
+}
+
+std::size_t SecurityCredentials::size() const {
+  std::shared_lock lock(mutex_);
+  return entries_.size();
+}
+
+void SecurityCredentials::encrypt_batch(const Key& key, std::span<const std::string_view> passwords,
+                                        std::vector<std::string>& out) const {
+  out.assign(passwords.size(), {});
+  const auto run = [&](std::size_t first, std::size_t stride) {
+    const ContextPtr ctx = make_context(key.pkey.get());
+    for (std::size_t i = first; i < passwords.size(); i += stride) out[i] = encrypt_with(ctx.get(), passwords[i]);
+  };
+  const std::size_t threads =
+      passwords.size() < kParallelBatch
+          ? 1
+          : std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, passwords.size() / (kParallelBatch / 2));
+  if (threads <= 1) {
+    run(0, 1);
+  } else {
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        try {
+          run(t, threads);
+        } catch (...) {
+          errors[t] = std::current_exception();
+        }
+      });
+    }
+    for (auto& w : workers) w.join();
+    for (const auto& e : errors) {
+      if (e) std::rethrow_exception(e);
+    }
+  }
+  encryptions_.fetch_add(passwords.size(), std::memory_order_relaxed);
+}
+
+}  // namespace mpesa
@@ -0,0 +1,701 @@
+#include "mpesa/sim/daraja_simulator.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <span>
+#include <string_view>
+
+#include "mpesa/base64.hpp"
+#include "mpesa/daraja.hpp"
+#include "mpesa/error.hpp"
+
+namespace mpesa::sim {
+namespace {
+
+struct Route {
+  std::string_view path;
+  MetricEndpoint operation;
+};
+
+constexpr Route kRoutes[] = {
+    {"/mpesa/stkpush/v1/processrequest", MetricEndpoint::kStkPush},
+    {"/mpesa/stkpushquery/v1/query", MetricEndpoint::kStkQuery},
+    {"/mpesa/c2b/v1/registerurl", MetricEndpoint::kC2BRegisterUrl},
+    {"/mpesa/c2b/v2/registerurl", MetricEndpoint::kC2BRegisterUrl},
+    {"/mpesa/c2b/v1/simulate", MetricEndpoint::kC2BSimulate},
+    {"/mpesa/c2b/v2/simulate", MetricEndpoint::kC2BSimulate},
+    {"/mpesa/b2c/v1/paymentrequest", MetricEndpoint::kB2C},
+    {"/mpesa/b2c/v3/paymentrequest", MetricEndpoint::kB2C},
+    {"/mpesa/b2b/v1/paymentrequest", MetricEndpoint::kB2B},
+    {"/mpesa/transactionstatus/v1/query", MetricEndpoint::kTransactionStatus},
+    {"/mpesa/accountbalance/v1/query", MetricEndpoint::kAccountBalance},
+    {"/mpesa/reversal/v1/request", MetricEndpoint::kReversal},
+};
+
+/// Members each result-URL operation must carry, as Daraja checks them.
+constexpr std::string_view kB2CFields[] = {"InitiatorName", "SecurityCredential", "CommandID", "Amount",
+                                           "PartyA", "PartyB", "QueueTimeOutURL", "ResultURL"};
+constexpr std::string_view kB2BFields[] = {"Initiator", "SecurityCredential", "CommandID",
+                                           "SenderIdentifierType", "RecieverIdentifierType", "Amount",
+                                           "PartyA", "PartyB", "QueueTimeOutURL", "ResultURL"};
+constexpr std::string_view kStatusFields[] = {"Initiator", "SecurityCredential", "CommandID", "TransactionID",
+                                              "PartyA", "IdentifierType", "QueueTimeOutURL", "ResultURL"};
+constexpr std::string_view kBalanceFields[] = {"Initiator", "SecurityCredential", "CommandID", "PartyA",
+                                               "IdentifierType", "QueueTimeOutURL", "ResultURL"};
+constexpr std::string_view kReversalFields[] = {"Initiator", "SecurityCredential", "CommandID",
+                                                "TransactionID", "Amount", "ReceiverParty",
+                                                "RecieverIdentifierType", "QueueTimeOutURL", "ResultURL"};
+
+constexpr std::string_view kAccepted = "Accept the service request successfully.";
+constexpr std::string_view kProcessed = "The service request is processed successfully.";
+
+HttpResponse reply(int status, std::string_view body) {
+  HttpResponse response;
+  response.status = status;
+  response.reason = status == 200 ? "OK" : "";
+  response.headers = {{"Content-Type", "application/json"}};
+  response.body.assign(body);
+  return response;
+}
+
+/// Daraja's error body: `{"requestId","errorCode","errorMessage"}`.
+HttpResponse error_reply(int status, std::string_view request_id, std::string_view code,
+                         std::string_view message) {
+  std::string body = "{\"requestId\":";
+  json::append_quoted(body, request_id);
+  body += ",\"errorCode\":";
+  json::append_quoted(body, code);
+  body += ",\"errorMessage\":";
+  json::append_quoted(body, message);
+  body += '}';
+  return reply(status, body);
+}
+
+HttpResponse invalid(std::string_view request_id, std::string_view member) {
+  return error_reply(400, request_id, "400.002.02", "Bad Request - Invalid " + std::string(member));
+}
+
+/// Text of a non-empty string or number member; nullptr otherwise.
+const std::string* text(const json::Value& body, std::string_view key) noexcept {
+  const json::Value* v = body.find(key);
+  if (v == nullptr || !(v->is_string() || v->is_number())) return nullptr;
+  const std::string& s = v->scalar_text();
+  return s.empty() ? nullptr : &s;
+}
+
+std::string_view text_or_empty(const json::Value& body, std::string_view key) noexcept {
+  const std::string* s = text(body, key);
+  return s == nullptr ? std::string_view{} : std::string_view(*s);
+}
+
+/// Whole shillings, as a number or a numeric string; 0 when not positive.
+std::int64_t amount(const json::Value& body) noexcept {
+  const std::string* s = text(body, "Amount");
+  if (s == nullptr) return 0;
+  double value = 0;
+  const auto [end, ec] = std::from_chars(s->data(), s->data() + s->size(), value);
+  if (ec != std::errc{} || end != s->data() + s->size() || value < 1) return 0;
+  return static_cast<std::int64_t>(value);
+}
+
+/// Ten characters of upper-case base 36, the shape of an M-Pesa receipt.
+std::string receipt(std::uint64_t n) {
+  std::string out(10, '0');
+  out[0] = 'S';
+  out[1] = 'I';
+  out[2] = 'M';
+  for (std::size_t i = out.size(); i-- > 3 && n != 0; n /= 36) {
+    out[i] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[n % 36];
+  }
+  return out;
+}
+
+std::string conversation_id(std::uint64_t n) {
+  char buf[48];
+  std::snprintf(buf, sizeof(buf), "AG_%.8s_%020llx", daraja_timestamp(std::chrono::system_clock::now()).c_str(),
+                static_cast<unsigned long long>(n));
+  return buf;
+}
+
+std::string request_id(std::uint64_t n) { return std::to_string(n % 100'000) + "-" + std::to_string(n) + "-1"; }
+
+struct Target {
+  Endpoint endpoint;
+  std::string path;
+};
+
+/// Splits an `http(s)://host[:port]/path` URL; false when malformed.
+bool parse_url(std::string_view url, Target& out) {
+  if (url.starts_with("https://")) {
+    out.endpoint.tls = true;
+    out.endpoint.port = 443;
+    url.remove_prefix(8);
+  } else if (url.starts_with("http://")) {
+    out.endpoint.tls = false;
+    out.endpoint.port = 80;
+    url.remove_prefix(7);
+  } else {
+    return false;
+  }
+  const std::size_t slash = url.find('/');
+  std::string_view authority = url.substr(0, slash);
+  out.path = slash == std::string_view::npos ? "/" : std::string(url.substr(slash));
+  if (const std::size_t colon = authority.rfind(':'); colon != std::string_view::npos) {
+    const std::string_view port = authority.substr(colon + 1);
+    const auto [end, ec] = std::from_chars(port.data(), port.data() + port.size(), out.endpoint.port);
+    if (ec != std::errc{} || end != port.data() + port.size()) return false;
+    authority = authority.substr(0, colon);
+  }
+  out.endpoint.host = std::string(authority);
+  return !out.endpoint.host.empty();
+}
+
+void append_member(std::string& out, std::string_view key, std::string_view value) {
+  if (out.back() != '{') out += ',';
+  json::append_quoted(out, key);
+  out += ':';
+  json::append_quoted(out, value);
+}
+
+void append_raw(std::string& out, std::string_view key, std::string_view raw) {
+  if (out.back() != '{') out += ',';
+  json::append_quoted(out, key);
+  out += ':';
+  out += raw;
+}
+
+}  // namespace
+
+DarajaSimulator::DarajaSimulator(DarajaSimulatorOptions options)
+    : options_(std::move(options)),
+      server_([this](const HttpRequest& request) { return handle(request); }, options_.server),
+      callback_http_(options_.callback_client),
+      rng_(options_.seed) {}
+
+DarajaSimulator::~DarajaSimulator() { stop(); }
+
+void DarajaSimulator::start() {
+  {
+    std::lock_guard lock(state_mutex_);
+    bucket_tokens_ = options_.burst > 0 ? options_.burst : options_.max_rate;
+    bucket_refilled_ = Clock::now();
+  }
+  {
+    std::lock_guard lock(queue_mutex_);
+    if (!workers_.empty()) return;
+    stopping_ = false;
+  }
+  server_.start();
+  for (unsigned i = 0; i < std::max(1u, options_.callback_workers); ++i) {
+    workers_.emplace_back([this] { deliver_loop(); });
+  }
+}
+
+void DarajaSimulator::stop() {
+  server_.stop();
+  {
+    std::lock_guard lock(queue_mutex_);
+    stopping_ = true;
+    queue_ = {};
+  }
+  queue_cv_.notify_all();
+  for (auto& worker : workers_) worker.join();
+  workers_.clear();
+  idle_cv_.notify_all();
+}
+
+DarajaSimulatorStats DarajaSimulator::stats() const {
+  std::lock_guard lock(stats_mutex_);
+  return stats_;
+}
+
+std::size_t DarajaSimulator::pending_callbacks() const {
+  std::lock_guard lock(queue_mutex_);
+  return queue_.size() + in_flight_;
+}
+
+bool DarajaSimulator::drain(std::chrono::milliseconds timeout) {
+  std::unique_lock lock(queue_mutex_);
+  return idle_cv_.wait_for(lock, timeout, [this] { return stopping_ || (queue_.empty() && in_flight_ == 0); });
+}
+
+HttpResponse DarajaSimulator::handle(const HttpRequest& request) {
+  if (options_.latency.count() > 0 || options_.latency_jitter.count() > 0) {
+    std::this_thread::sleep_for(options_.latency + std::chrono::microseconds(static_cast<std::int64_t>(
+                                                       uniform() * static_cast<double>(options_.latency_jitter.count()))));
+  }
+  const std::string_view target = request.target;
+  const std::string_view path = target.substr(0, target.find('?'));
+  if (path == "/oauth/v1/generate") {
+    count(MetricEndpoint::kOAuth);
+    return oauth(request);
+  }
+
+  const Route* route = nullptr;
+  for (const Route& r : kRoutes) {
+    if (r.path == path) route = &r;
+  }
+  const std::string id = request_id(next_id());
+  if (route == nullptr || request.method != "POST") {
+    return error_reply(404, id, "404.001.01", "Resource not found");
+  }
+  count(route->operation);
+
+  if (!authorized(request)) {
+    std::lock_guard lock(stats_mutex_);
+    ++stats_.unauthorized;
+    return error_reply(401, id, "404.001.03", "Invalid Access Token");
+  }
+  if (!admit() || (options_.throttle_rate > 0 && uniform() < options_.throttle_rate)) {
+    std::lock_guard lock(stats_mutex_);
+    ++stats_.throttled;
+    return error_reply(429, id, "500.003.02", "Spike arrest violation");
+  }
+  if (options_.error_rate > 0 && uniform() < options_.error_rate) {
+    std::lock_guard lock(stats_mutex_);
+    ++stats_.injected_errors;
+    return error_reply(500, id, "500.003.1001", "Internal Server Error");
+  }
+
+  json::Value body;
+  try {
+    body = json::parse(request.body);
+  } catch (const Error&) {
+  }
+  HttpResponse response;
+  if (!body.is_object()) {
+    response = error_reply(400, id, "400.002.02", "Bad Request - Invalid JSON");
+  } else {
+    switch (route->operation) {
+      case MetricEndpoint::kStkPush: response = stk_push(body); break;
+      case MetricEndpoint::kStkQuery: response = stk_query(body); break;
+      case MetricEndpoint::kC2BRegisterUrl: response = c2b_register(body); break;
+      case MetricEndpoint::kC2BSimulate: response = c2b_simulate(body); break;
+      default: response = result_operation(route->operation, body); break;
+    }
+  }
+  if (response.status == 400) {
+    std::lock_guard lock(stats_mutex_);
+    ++stats_.bad_requests;
+  }
+  return response;
+}
+
+HttpResponse DarajaSimulator::oauth(const HttpRequest& request) {
+  const std::string id = request_id(next_id());
+  if (request.target.find("grant_type=client_credentials") == std::string::npos) {
+    return error_reply(400, id, "400.008.02", "Invalid grant type passed");
+  }
+  const std::pmr::string* authorization = find_header(request.headers, "Authorization");
+  const bool basic = authorization != nullptr && authorization->starts_with("Basic ");
+  const bool accepted =
+      basic && ((options_.consumer_key.empty() && options_.consumer_secret.empty()) ||
+                std::string_view(*authorization) ==
+                    "Basic " + base64_encode(options_.consumer_key + ":" + options_.consumer_secret));
+  if (!accepted) {
+    std::lock_guard lock(stats_mutex_);
+    ++stats_.unauthorized;
+    return error_reply(400, id, "400.008.01", "Invalid Authentication passed");
+  }
+
+  std::string token = "sim" + base64_encode(std::to_string(next_id()) + ":" + std::to_string(uniform()));
+  std::erase(token, '=');
+  {
+    std::lock_guard lock(state_mutex_);
+    tokens_[token] = Clock::now() + options_.token_lifetime;
+  }
+  std::string body = "{";
+  append_member(body, "access_token", token);
+  append_member(body, "expires_in", std::to_string(options_.token_lifetime.count()));
+  body += '}';
+  return reply(200, body);
+}
+
+bool DarajaSimulator::authorized(const HttpRequest& request) {
+  if (!options_.check_tokens) return true;
+  const std::pmr::string* authorization = find_header(request.headers, "Authorization");
+  if (authorization == nullptr || !authorization->starts_with("Bearer ")) return false;
+  std::lock_guard lock(state_mutex_);
+  const auto it = tokens_.find(std::string(std::string_view(*authorization).substr(7)));
+  if (it == tokens_.end()) return false;
+  if (it->second > Clock::now()) return true;
+  tokens_.erase(it);
+  return false;
+}
+
+bool DarajaSimulator::admit() {
+  if (options_.max_rate <= 0) return true;
+  const double capacity = options_.burst > 0 ? options_.burst : options_.max_rate;
+  std::lock_guard lock(state_mutex_);
+  const Clock::time_point now = Clock::now();
+  bucket_tokens_ = std::min(capacity, bucket_tokens_ + std::chrono::duration<double>(now - bucket_refilled_).count() *
+                                                           options_.max_rate);
+  bucket_refilled_ = now;
+  if (bucket_tokens_ < 1) return false;
+  bucket_tokens_ -= 1;
+  return true;
+}
+
+HttpResponse DarajaSimulator::stk_push(const json::Value& body) {
+  const std::uint64_t n = next_id();
+  const std::string id = request_id(n);
+  for (const std::string_view member : {"BusinessShortCode", "Password", "Timestamp", "TransactionType", "PartyA",
+                                        "PartyB", "PhoneNumber", "CallBackURL", "AccountReference"}) {
+    if (text(body, member) == nullptr) return invalid(id, member);
+  }
+  const std::int64_t value = amount(body);
+  if (value == 0) return invalid(id, "Amount");
+  const std::string& short_code = *text(body, "BusinessShortCode");
+  const std::string& timestamp = *text(body, "Timestamp");
+  if (timestamp.size() != kTimestampSize) return invalid(id, "Timestamp");
+  if (!options_.passkey.empty() &&
+      *text(body, "Password") != stk_password(short_code, options_.passkey, timestamp)) {
+    return error_reply(500, id, "500.001.1001", "Merchant does not exist");
+  }
+  Target callback_target;
+  if (!parse_url(*text(body, "CallBackURL"), callback_target)) return invalid(id, "CallBackURL");
+
+  const std::string checkout_id = "ws_CO_" + daraja_timestamp(std::chrono::system_clock::now()) + std::to_string(n);
+  const bool failed = options_.failure_rate > 0 && uniform() < options_.failure_rate;
+  const Clock::duration delay = callback_delay();
+  {
+    std::lock_guard lock(state_mutex_);
+    stk_[checkout_id] = StkOutcome{Clock::now() + delay, id, failed ? 1032 : 0};
+  }
+
+  Callback callback;
+  callback.due = Clock::now() + delay;
+  callback.kind = MetricEndpoint::kStkCallback;
+  callback.url = *text(body, "CallBackURL");
+  std::string& out = callback.body;
+  out = "{\"Body\":{\"stkCallback\":{";
+  append_member(out, "MerchantRequestID", id);
+  append_member(out, "CheckoutRequestID", checkout_id);
+  if (failed) {
+    append_raw(out, "ResultCode", "1032");
+    append_member(out, "ResultDesc", "Request cancelled by user");
+  } else {
+    append_raw(out, "ResultCode", "0");
+    append_member(out, "ResultDesc", kProcessed);
+    out += ",\"CallbackMetadata\":{\"Item\":[{\"Name\":\"Amount\",\"Value\":" + std::to_string(value) +
+           ".00},{\"Name\":\"MpesaReceiptNumber\",\"Value\":";
+    json::append_quoted(out, receipt(n));
+    out += "},{\"Name\":\"Balance\"},{\"Name\":\"TransactionDate\",\"Value\":" +
+           daraja_timestamp(std::chrono::system_clock::now()) + "},{\"Name\":\"PhoneNumber\",\"Value\":" +
+           std::string(text_or_empty(body, "PhoneNumber")) + "}]}";
+  }
+  out += "}}}";
+  schedule(std::move(callback));
+
+  std::string reply_body = "{";
+  append_member(reply_body, "MerchantRequestID", id);
+  append_member(reply_body, "CheckoutRequestID", checkout_id);
+  append_member(reply_body, "ResponseCode", "0");
+  append_member(reply_body, "ResponseDescription", "Success. Request accepted for processing");
+  append_member(reply_body, "CustomerMessage", "Success. Request accepted for processing");
+  reply_body += '}';
+  return reply(200, reply_body);
+}
+
+HttpResponse DarajaSimulator::stk_query(const json::Value& body) {
+  const std::string id = request_id(next_id());
+  for (const std::string_view member : {"BusinessShortCode", "Password", "Timestamp", "CheckoutRequestID"}) {
+    if (text(body, member) == nullptr) return invalid(id, member);
+  }
+  if (!options_.passkey.empty() &&
+      *text(body, "Password") !=
+          stk_password(*text(body, "BusinessShortCode"), options_.passkey, *text(body, "Timestamp"))) {
+    return error_reply(500, id, "500.001.1001", "Merchant does not exist");
+  }
+  const std::string& checkout_id = *text(body, "CheckoutRequestID");
+  StkOutcome outcome;
+  {
+    std::lock_guard lock(state_mutex_);
+    const auto it = stk_.find(checkout_id);
+    if (it == stk_.end()) return invalid(id, "CheckoutRequestID");
+    outcome = it->second;
+  }
+  if (outcome.due > Clock::now()) return error_reply(500, id, "500.001.1001", "The transaction is being processed");
+
+  std::string reply_body = "{";
+  append_member(reply_body, "ResponseCode", "0");
+  append_member(reply_body, "ResponseDescription", "The service request has been accepted successsfully");
+  append_member(reply_body, "MerchantRequestID", outcome.merchant_request_id);
+  append_member(reply_body, "CheckoutRequestID", checkout_id);
+  append_member(reply_body, "ResultCode", std::to_string(outcome.result_code));
+  append_member(reply_body, "ResultDesc",
+                outcome.result_code == 0 ? kProcessed : std::string_view("Request cancelled by user"));
+  reply_body += '}';
+  return reply(200, reply_body);
+}
+
+HttpResponse DarajaSimulator::c2b_register(const json::Value& body) {
+  const std::string id = request_id(next_id());
+  for (const std::string_view member : {"ShortCode", "ResponseType", "ConfirmationURL"}) {
+    if (text(body, member) == nullptr) return invalid(id, member);
+  }
+  const std::string& response_type = *text(body, "ResponseType");
+  if (response_type != "Completed" && response_type != "Cancelled") return invalid(id, "ResponseType");
+  Target target;
+  if (!parse_url(*text(body, "ConfirmationURL"), target)) return invalid(id, "ConfirmationURL");
+  const std::string_view validation_url = text_or_empty(body, "ValidationURL");
+  if (!validation_url.empty() && !parse_url(validation_url, target)) return invalid(id, "ValidationURL");
+  {
+    std::lock_guard lock(state_mutex_);
+    c2b_[*text(body, "ShortCode")] =
+        C2BUrls{*text(body, "ConfirmationURL"), std::string(validation_url), response_type == "Completed"};
+  }
+  std::string reply_body = "{";
+  append_member(reply_body, "OriginatorCoversationID", id);  // sic, as Daraja spells it here
+  append_member(reply_body, "ConversationID", "");
+  append_member(reply_body, "ResponseCode", "0");
+  append_member(reply_body, "ResponseDescription", "Success");
+  reply_body += '}';
+  return reply(200, reply_body);
+}
+
+HttpResponse DarajaSimulator::c2b_simulate(const json::Value& body) {
+  const std::uint64_t n = next_id();
+  const std::string id = request_id(n);
+  for (const std::string_view member : {"ShortCode", "CommandID", "Msisdn"}) {
+    if (text(body, member) == nullptr) return invalid(id, member);
+  }
+  const std::int64_t value = amount(body);
+  if (value == 0) return invalid(id, "Amount");
+  const std::string& command = *text(body, "CommandID");
+  if (command != "CustomerPayBillOnline" && command != "CustomerBuyGoodsOnline") return invalid(id, "CommandID");
+  const std::string& short_code = *text(body, "ShortCode");
+  C2BUrls urls;
+  {
+    std::lock_guard lock(state_mutex_);
+    const auto it = c2b_.find(short_code);
+    if (it == c2b_.end()) return error_reply(400, id, "400.002.02", "Bad Request - No URLs registered for ShortCode");
+    urls = it->second;
+  }
+
+  std::string notification = "{";
+  append_member(notification, "TransactionType", command == "CustomerPayBillOnline" ? "Pay Bill" : "Buy Goods");
+  append_member(notification, "TransID", receipt(n));
+  append_member(notification, "TransTime", daraja_timestamp(std::chrono::system_clock::now()));
+  append_member(notification, "TransAmount", std::to_string(value) + ".00");
+  append_member(notification, "BusinessShortCode", short_code);
+  append_member(notification, "BillRefNumber", text_or_empty(body, "BillRefNumber"));
+  append_member(notification, "InvoiceNumber", "");
+  append_member(notification, "OrgAccountBalance", "");
+  append_member(notification, "ThirdPartyTransID", "");
+  append_member(notification, "MSISDN", *text(body, "Msisdn"));
+  append_member(notification, "FirstName", "John");
+  append_member(notification, "MiddleName", "");
+  append_member(notification, "LastName", "Doe");
+  notification += '}';
+
+  Callback callback;
+  callback.due = Clock::now() + callback_delay();
+  callback.body = std::move(notification);
+  if (urls.validation_url.empty()) {
+    callback.kind = MetricEndpoint::kC2BConfirmation;
+    callback.url = urls.confirmation_url;
+  } else {
+    callback.kind = MetricEndpoint::kC2BValidation;
+    callback.url = urls.validation_url;
+    callback.confirmation_url = urls.confirmation_url;
+    callback.confirm_on_failure = urls.complete_on_failure;
+  }
+  schedule(std::move(callback));
+
+  std::string reply_body = "{";
+  append_member(reply_body, "OriginatorCoversationID", id);  // sic
+  append_member(reply_body, "ConversationID", conversation_id(n));
+  append_member(reply_body, "ResponseCode", "0");
+  append_member(reply_body, "ResponseDescription", kAccepted);
+  reply_body += '}';
+  return reply(200, reply_body);
+}
+
+HttpResponse DarajaSimulator::result_operation(MetricEndpoint operation, const json::Value& body) {
+  const std::uint64_t n = next_id();
+  const std::string id = request_id(n);
+  std::span<const std::string_view> required;
+  switch (operation) {
+    case MetricEndpoint::kB2C: required = kB2CFields; break;
+    case MetricEndpoint::kB2B: required = kB2BFields; break;
+    case MetricEndpoint::kTransactionStatus: required = kStatusFields; break;
+    case MetricEndpoint::kAccountBalance: required = kBalanceFields; break;
+    default: required = kReversalFields; break;
+  }
+  for (const std::string_view member : required) {
+    if (text(body, member) == nullptr) return invalid(id, member);
+  }
+  const bool has_amount = operation == MetricEndpoint::kB2C || operation == MetricEndpoint::kB2B ||
+                          operation == MetricEndpoint::kReversal;
+  const std::int64_t value = has_amount ? amount(body) : 0;
+  if (has_amount && value == 0) return invalid(id, "Amount");
+  Target target;
+  if (!parse_url(*text(body, "ResultURL"), target)) return invalid(id, "ResultURL");
+  if (!parse_url(*text(body, "QueueTimeOutURL"), target)) return invalid(id, "QueueTimeOutURL");
+
+  const std::string_view given = text_or_empty(body, "OriginatorConversationID");
+  const std::string originator = given.empty() ? id : std::string(given);
+  const std::string conversation = conversation_id(n);
+  const bool timed_out = options_.queue_timeout_rate > 0 && uniform() < options_.queue_timeout_rate;
+  const bool failed = !timed_out && options_.failure_rate > 0 && uniform() < options_.failure_rate;
+
+  Callback callback;
+  callback.due = Clock::now() + callback_delay();
+  callback.kind = timed_out ? MetricEndpoint::kQueueTimeout : MetricEndpoint::kResultCallback;
+  callback.url = *text(body, timed_out ? "QueueTimeOutURL" : "ResultURL");
+  std::string& out = callback.body;
+  out = "{\"Result\":{";
+  append_raw(out, "ResultType", timed_out ? "1" : "0");
+  if (timed_out) {
+    append_raw(out, "ResultCode", "1");
+    append_member(out, "ResultDesc", "The request timed out in the queue.");
+  } else if (failed) {
+    append_raw(out, "ResultCode", "2001");
+    append_member(out, "ResultDesc", "The initiator information is invalid.");
+  } else {
+    append_raw(out, "ResultCode", "0");
+    append_member(out, "ResultDesc", kProcessed);
+  }
+  append_member(out, "OriginatorConversationID", originator);
+  append_member(out, "ConversationID", conversation);
+  const std::string transaction = timed_out || failed ? receipt(0) : receipt(n);
+  append_member(out, "TransactionID", transaction);
+  if (!timed_out && !failed) {
+    out += ",\"ResultParameters\":{\"ResultParameter\":[";
+    switch (operation) {
+      case MetricEndpoint::kB2C:
+        out += "{\"Key\":\"TransactionAmount\",\"Value\":" + std::to_string(value) +
+               "},{\"Key\":\"TransactionReceipt\",\"Value\":\"" + transaction +
+               "\"},{\"Key\":\"B2CRecipientIsRegisteredCustomer\",\"Value\":\"Y\"},"
+               "{\"Key\":\"ReceiverPartyPublicName\",\"Value\":";
+        json::append_quoted(out, std::string(text_or_empty(body, "PartyB")) + " - John Doe");
+        out += "}";
+        break;
+      case MetricEndpoint::kAccountBalance:
+        out += "{\"Key\":\"AccountBalance\",\"Value\":\"Working Account|KES|700000.00|700000.00|0.00|0.00"
+               "&Utility Account|KES|228037.00|228037.00|0.00|0.00\"},{\"Key\":\"BOCompletedTime\",\"Value\":" +
+               daraja_timestamp(std::chrono::system_clock::now()) + "}";
+        break;
+      default:
+        out += "{\"Key\":\"Amount\",\"Value\":" + std::to_string(value) +
+               "},{\"Key\":\"TransCompletedTime\",\"Value\":" + daraja_timestamp(std::chrono::system_clock::now()) +
+               "}";
+        break;
+    }
+    out += "]}";
+  }
+  out += ",\"ReferenceData\":{\"ReferenceItem\":{\"Key\":\"QueueTimeoutURL\",\"Value\":";
+  json::append_quoted(out, *text(body, "QueueTimeOutURL"));
+  out += "}}}}";
+  schedule(std::move(callback));
+
+  std::string reply_body = "{";
+  append_member(reply_body, "ConversationID", conversation);
+  append_member(reply_body, "OriginatorConversationID", originator);
+  append_member(reply_body, "ResponseCode", "0");
+  append_member(reply_body, "ResponseDescription", kAccepted);
+  reply_body += '}';
+  return reply(200, reply_body);
+}
+
+double DarajaSimulator::uniform() {
+  std::lock_guard lock(rng_mutex_);
+  return std::uniform_real_distribution<double>(0, 1)(rng_);
+}
+
+Clock::duration DarajaSimulator::callback_delay() {
+  const double jitter = options_.callback_jitter.count() > 0
+                            ? uniform() * static_cast<double>(options_.callback_jitter.count())
+                            : 0;
+  return options_.callback_delay + std::chrono::duration_cast<Clock::duration>(
+                                       std::chrono::duration<double, std::milli>(jitter));
+}
+
+void DarajaSimulator::count(MetricEndpoint endpoint) noexcept {
+  std::lock_guard lock(stats_mutex_);
+  ++stats_.calls[static_cast<std::size_t>(endpoint)];
+}
+
+void DarajaSimulator::schedule(Callback callback) {
+  {
+    std::lock_guard lock(queue_mutex_);
+    if (stopping_) return;
+    callback.sequence = scheduled_++;
+    queue_.push(std::move(callback));
+  }
+  queue_cv_.notify_one();
+}
+
+void DarajaSimulator::deliver_loop() {
+  std::unique_lock lock(queue_mutex_);
+  while (!stopping_) {
+    if (queue_.empty()) {
+      queue_cv_.wait(lock);
+      continue;
+    }
+    if (queue_.top().due > Clock::now()) {
+      queue_cv_.wait_until(lock, queue_.top().due);
+      continue;
+    }
+    Callback callback = queue_.top();
+    queue_.pop();
+    ++in_flight_;
+    lock.unlock();
+
+    std::string reply;
+    const bool delivered = post(callback.url, callback.body, &reply);
+    bool confirm = false;
+    if (callback.kind == MetricEndpoint::kC2BValidation) {
+      // The receiver's ResultCode decides; "0" accepts, anything else
+      // ("C2B00011"...) rejects the payment.
+      if (delivered) {
+        try {
+          const json::Value decision = json::parse(reply);
+          const json::Value* code = decision.find("ResultCode");
+          confirm = code != nullptr && code->scalar_text() == "0";
+        } catch (const Error&) {
+        }
+      } else {
+        confirm = callback.confirm_on_failure;
+      }
+    }
+    {
+      std::lock_guard stats_lock(stats_mutex_);
+      if (delivered) ++stats_.callbacks[static_cast<std::size_t>(callback.kind)];
+      else ++stats_.callback_failures;
+    }
+    if (confirm) {
+      Callback confirmation;
+      confirmation.due = Clock::now();
+      confirmation.kind = MetricEndpoint::kC2BConfirmation;
+      confirmation.url = std::move(callback.confirmation_url);
+      confirmation.body = std::move(callback.body);
+      schedule(std::move(confirmation));
+    }
+
+    lock.lock();
+    --in_flight_;
+    if (queue_.empty() && in_flight_ == 0) idle_cv_.notify_all();
+  }
+}
+
+bool DarajaSimulator::post(const std::string& url, const std::string& body, std::string* reply) {
+  Target target;
+  if (!parse_url(url, target)) return false;
+  HttpRequest request;
+  request.method = "POST";
+  request.target = std::move(target.path);
+  request.headers = {{"Content-Type", "application/json"}};
+  request.body = body;
+  try {
+    HttpResponse response = callback_http_.send(options_.callback_endpoint.value_or(target.endpoint), request);
+    if (reply != nullptr) reply->assign(response.body);
+    return response.status >= 200 && response.status < 300;
+  } catch (const Error&) {
+    return false;
+  }
+}
+
+}  // namespace mpesa::sim
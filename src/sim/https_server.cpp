@@ -0,0 +1,227 @@
+#include "mpesa/sim/https_server.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "mpesa/error.hpp"
+
+namespace mpesa::sim {
+namespace {
+
+std::string bio_to_string(BIO* bio) {
+  char* data = nullptr;
+  const long size = BIO_get_mem_data(bio, &data);
+  return std::string(data, static_cast<std::size_t>(size));
+}
+
+void add_extension(X509* cert, int nid, const char* value) {
+  X509V3_CTX ctx;
+  X509V3_set_ctx_nodb(&ctx);
+  X509V3_set_ctx(&ctx, cert, cert, nullptr, nullptr, 0);
+  X509_EXTENSION* ext = X509V3_EXT_conf_nid(nullptr, &ctx, nid, value);
+  if (ext == nullptr) throw Error(ErrorCode::kTls, "building certificate extension");
+  X509_add_ext(cert, ext, -1);
+  X509_EXTENSION_free(ext);
+}
+
+}  // namespace
+
+TlsIdentity generate_self_signed(const std::string& common_name) {
+  EVP_PKEY* raw_key = nullptr;
+  std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> kctx(
+      EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), &EVP_PKEY_CTX_free);
+  if (!kctx || EVP_PKEY_keygen_init(kctx.get()) != 1 ||
+      EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx.get(), NID_X9_62_prime256v1) != 1 ||
+      EVP_PKEY_keygen(kctx.get(), &raw_key) != 1) {
+    throw Error(ErrorCode::kTls, "generating key: " + tls_error_string());
+  }
+  std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(raw_key, &EVP_PKEY_free);
+
+  std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), &X509_free);
+  X509_set_version(cert.get(), 2);
+  unsigned char serial[8];
+  RAND_bytes(serial, sizeof(serial));
+  serial[0] &= 0x7f;
+  BIGNUM* bn = BN_bin2bn(serial, sizeof(serial), nullptr);
+  BN_to_ASN1_INTEGER(bn, X509_get_serialNumber(cert.get()));
+  BN_free(bn);
+  X509_gmtime_adj(X509_getm_notBefore(cert.get()), -3600);
+  X509_gmtime_adj(X509_getm_notAfter(cert.get()), 30L * 24 * 3600);
+  X509_set_pubkey(cert.get(), key.get());
+  X509_NAME* name = X509_get_subject_name(cert.get());
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char*>(common_name.c_str()), -1, -1, 0);
+  X509_set_issuer_name(cert.get(), name);
+  const std::string san = "DNS:" + common_name + ",DNS:localhost,IP:127.0.0.1,IP:::1";
+  add_extension(cert.get(), NID_subject_alt_name, san.c_str());
+  if (X509_sign(cert.get(), key.get(), EVP_sha256()) == 0) {
+    throw Error(ErrorCode::kTls, "signing certificate: " + tls_error_string());
+  }
+
+  TlsIdentity identity;
+  std::unique_ptr<BIO, decltype(&BIO_free)> cert_bio(BIO_new(BIO_s_mem()), &BIO_free);
+  PEM_write_bio_X509(cert_bio.get(), cert.get());
+  identity.cert_pem = bio_to_string(cert_bio.get());
+  std::unique_ptr<BIO, decltype(&BIO_free)> key_bio(BIO_new(BIO_s_mem()), &BIO_free);
+  PEM_write_bio_PrivateKey(key_bio.get(), key.get(), nullptr, nullptr, 0, nullptr, nullptr);
+  identity.key_pem = bio_to_string(key_bio.get());
+  return identity;
+}
+
+HttpsServer::HttpsServer(Handler handler, HttpsServerOptions options)
+    : handler_(std::move(handler)), options_(std::move(options)) {
+  if (options_.tls) {
+    identity_ = generate_self_signed();
+    tls_ = TlsContext::server(identity_.cert_pem, identity_.key_pem);
+  }
+}
+
+HttpsServer::~HttpsServer() { stop(); }
+
+void HttpsServer::start() {
+  if (running_.exchange(true)) return;
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(options_.port);
+  if (inet_pton(AF_INET, options_.bind_address.c_str(), &addr.sin_addr) != 1) {
+    running_ = false;
+    throw Error(ErrorCode::kInvalidArgument, "bind address must be IPv4: " + options_.bind_address);
+  }
+  listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  const int one = 1;
+  ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::listen(listen_fd_, 1024) != 0) {
+    const std::string reason = std::strerror(errno);
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+    running_ = false;
+    throw Error(ErrorCode::kConnect, "binding " + options_.bind_address + ": " + reason);
+  }
+  socklen_t len = sizeof(addr);
+  ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+  port_ = ntohs(addr.sin_port);
+  acceptor_ = std::thread([this] { accept_loop(); });
+}
+
+void HttpsServer::stop() {
+  if (!running_.exchange(false)) return;
+  ::shutdown(listen_fd_, SHUT_RDWR);
+  if (acceptor_.joinable()) acceptor_.join();
+  ::close(listen_fd_);
+  listen_fd_ = -1;
+  std::unique_lock lock(conns_mutex_);
+  for (const int fd : open_fds_) ::shutdown(fd, SHUT_RDWR);
+  conns_cv_.wait(lock, [this] { return active_workers_ == 0; });
+}
+
+void HttpsServer::accept_loop() {
+  while (running_.load()) {
+    const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      return;  // listener shut down
+    }
+    accepted_.fetch_add(1, std::memory_order_relaxed);
+    const int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    timeval tv{};
+    tv.tv_sec = static_cast<long>(options_.idle_timeout.count() / 1000);
+    tv.tv_usec = static_cast<long>(options_.idle_timeout.count() % 1000) * 1000;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    {
+      std::lock_guard lock(conns_mutex_);
+      open_fds_.insert(fd);
+      ++active_workers_;
+    }
+    std::thread([this, fd] {
+      try {
+        serve(fd);
+      } catch (...) {
+        // A broken client connection must not take the server down.
+      }
+      std::lock_guard lock(conns_mutex_);
+      open_fds_.erase(fd);
+      ::close(fd);
+      --active_workers_;
+      conns_cv_.notify_all();
+    }).detach();
+  }
+}
+
+void HttpsServer::serve(int fd) {
+  std::unique_ptr<SSL, decltype(&SSL_free)> ssl(nullptr, &SSL_free);
+  if (tls_) {
+    ssl.reset(SSL_new(tls_->native()));
+    tls_set_socket(ssl.get(), fd);
+    if (SSL_accept(ssl.get()) != 1) return;
+    (SSL_session_reused(ssl.get()) ? resumed_handshakes_ : full_handshakes_)
+        .fetch_add(1, std::memory_order_relaxed);
+  }
+  auto read_some = [&](char* buf, std::size_t cap) -> long {
+    if (ssl) return SSL_read(ssl.get(), buf, static_cast<int>(cap));
+    return ::recv(fd, buf, cap, 0);
+  };
+  auto write_all = [&](std::string_view data) -> bool {
+    while (!data.empty()) {
+      const long n = ssl ? SSL_write(ssl.get(), data.data(), static_cast<int>(data.size()))
+                         : ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+      if (n <= 0) return false;
+      data.remove_prefix(static_cast<std::size_t>(n));
+    }
+    return true;
+  };
+
+  HttpParser parser(HttpParser::Kind::kRequest);
+  std::string wire;
+  char buffer[16 * 1024];
+  std::size_t buffered = 0;
+  std::size_t served = 0;
+  while (running_.load(std::memory_order_relaxed)) {
+    if (buffered == 0) {
+      const long n = read_some(buffer, sizeof(buffer));
+      if (n <= 0) return;
+      buffered = static_cast<std::size_t>(n);
+    }
+    const std::size_t used = parser.feed(buffer, buffered);
+    std::memmove(buffer, buffer + used, buffered - used);
+    buffered -= used;
+    if (!parser.done()) continue;
+
+    HttpResponse response;
+    try {
+      response = handler_(parser.request());
+    } catch (const std::exception& e) {
+      response = HttpResponse();
+      response.status = 500;
+      response.headers = {{"Content-Type", "text/plain"}};
+      response.body = e.what();
+    }
+    ++served;
+    requests_.fetch_add(1, std::memory_order_relaxed);
+    const bool limit = options_.max_requests_per_connection != 0 &&
+                       served >= options_.max_requests_per_connection;
+    response.keep_alive = response.keep_alive && parser.keep_alive() && !limit;
+    wire.clear();
+    serialize_response(response, wire);
+    if (!write_all(wire) || !response.keep_alive) break;
+    parser.reset();
+  }
+  if (ssl) SSL_shutdown(ssl.get());
+}
+
+}  // namespace mpesa::sim
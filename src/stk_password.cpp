@@ -0,0 +1,82 @@
+#include "mpesa/stk_password.hpp"
+
+#include <cstring>
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+
+StkPasswordGenerator::StkPasswordGenerator(std::string_view short_code, std::string_view passkey) {
+  if (short_code.size() + passkey.size() > StkPassword::kMaxPrefixSize) {
+    throw Error(ErrorCode::kInvalidArgument, "shortcode and passkey longer than " +
+                                                 std::to_string(StkPassword::kMaxPrefixSize) + " bytes");
+  }
+  prefix_.reserve(short_code.size() + passkey.size());
+  prefix_.append(short_code).append(passkey);
+  short_code_size_ = short_code.size();
+  const std::size_t whole = prefix_.size() / 3 * 3;
+  head_ = base64_encode(std::string_view(prefix_).substr(0, whole));
+  tail_size_ = base64_encoded_size(prefix_.size() - whole + kTimestampSize);
+}
+
+bool StkPasswordGenerator::matches(std::string_view short_code, std::string_view passkey) const noexcept {
+  return short_code.size() == short_code_size_ && prefix_.size() == short_code.size() + passkey.size() &&
+         prefix_.compare(0, short_code_size_, short_code) == 0 &&
+         prefix_.compare(short_code_size_, std::string::npos, passkey) == 0;
+}
+
+void StkPasswordGenerator::fill(Cell& cell, std::chrono::system_clock::time_point when) const noexcept {
+  write_daraja_timestamp(when, cell.data());
+  const std::size_t carry = prefix_.size() % 3;
+  char raw[2 + kTimestampSize];
+  std::memcpy(raw, prefix_.data() + prefix_.size() - carry, carry);
+  std::memcpy(raw + carry, cell.data(), kTimestampSize);
+  base64_encode(std::string_view(raw, carry + kTimestampSize), cell.data() + kTimestampSize);
+}
+
+void StkPasswordGenerator::assemble(const Cell& cell, StkPassword& out) const noexcept {
+  std::memcpy(out.data_.data(), head_.data(), head_.size());
+  std::memcpy(out.data_.data() + head_.size(), cell.data() + kTimestampSize, tail_size_);
+  out.size_ = static_cast<std::uint32_t>(head_.size() + tail_size_);
+  std::memcpy(out.timestamp_.data(), cell.data(), kTimestampSize);
+}
+
+void StkPasswordGenerator::get(StkPassword& out, std::chrono::system_clock::time_point when) const noexcept {
+  const std::int64_t second = std::chrono::floor<std::chrono::seconds>(when.time_since_epoch()).count();
+  Cell cell{};
+  for (;;) {
+    const std::uint64_t begin = seq_.load(std::memory_order_acquire);
+    if ((begin & 1) != 0) break;  // writer active: derive our own copy
+    if (second_.load(std::memory_order_relaxed) != second) break;
+    for (std::size_t i = 0; i < kCellWords; ++i) {
+      const std::uint64_t w = words_[i].load(std::memory_order_relaxed);
+      std::memcpy(cell.data() + i * 8, &w, sizeof(w));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq_.load(std::memory_order_relaxed) == begin) {
+      assemble(cell, out);
+      return;
+    }
+  }
+
+  // New second, a stale `when` or a publish in progress: derive it, and
+  // publish it if it is the newest and no other thread is publishing.
+  fill(cell, when);
+  assemble(cell, out);
+  if (second <= second_.load(std::memory_order_relaxed) || writing_.exchange(true, std::memory_order_acquire)) {
+    return;
+  }
+  const std::uint64_t seq = seq_.load(std::memory_order_relaxed);
+  seq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (std::size_t i = 0; i < kCellWords; ++i) {
+    std::uint64_t w;
+    std::memcpy(&w, cell.data() + i * 8, sizeof(w));
+    words_[i].store(w, std::memory_order_relaxed);
+  }
+  second_.store(second, std::memory_order_relaxed);
+  seq_.store(seq + 2, std::memory_order_release);
+  writing_.store(false, std::memory_order_release);
+}
+
+}  // namespace mpesa
@@ -0,0 +1,249 @@
+#include "mpesa/stk_poller.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mpesa {
+namespace {
+
+int parse_code(std::string_view s) noexcept {
+  int code = -1;
+  std::from_chars(s.data(), s.data() + s.size(), code);
+  return code;
+}
+
+}  // namespace
+
+const char* to_string(StkOutcomeSource source) noexcept {
+  switch (source) {
+    case StkOutcomeSource::kCallback: return "callback";
+    case StkOutcomeSource::kQuery: return "query";
+    case StkOutcomeSource::kExpired: return "expired";
+  }
+  return "unknown";
+}
+
+struct StkStatusPoller::State {
+  struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const noexcept { return std::hash<std::string_view>{}(s); }
+  };
+  struct Entry {
+    StkQueryRequest query;
+    std::vector<Handler> handlers;
+    Clock::time_point deadline;
+    Clock::duration interval;
+    /// Tells this entry's wheel item from one of an earlier entry with the
+    /// same ID.
+    std::uint64_t generation = 0;
+    unsigned queries = 0;
+  };
+  struct WheelItem {
+    std::string id;
+    std::uint64_t generation;
+    std::uint64_t due_tick;
+  };
+  struct DueQuery {
+    std::string id;
+    std::uint64_t generation;
+    StkQueryRequest query;
+  };
+  struct Done {
+    std::vector<Handler> handlers;
+    StkOutcome outcome;
+  };
+
+  State(AsyncDarajaClient& daraja, StkPollerOptions options)
+      : daraja(daraja),
+        options(options),
+        tick(std::max<Clock::duration>(options.tick, std::chrono::milliseconds(1))),
+        epoch(Clock::now()),
+        wheel(std::max<std::size_t>(options.wheel_slots, 16)) {}
+
+  std::uint64_t tick_of(Clock::time_point t) const noexcept {
+    return t <= epoch ? 0 : static_cast<std::uint64_t>((t - epoch + tick - Clock::duration(1)) / tick);
+  }
+
+  /// Caller holds `mutex`.
+  void schedule(std::string id, std::uint64_t generation, Clock::time_point due) {
+    const std::uint64_t due_tick = std::max(tick_of(due), current_tick + 1);
+    wheel[due_tick % wheel.size()].push_back({std::move(id), generation, due_tick});
+  }
+
+  /// Caller holds `mutex`; `it` is erased.
+  template <class It>
+  Done finish(It it, StkOutcomeSource source, int result_code, std::string result_desc) {
+    Done done{std::move(it->second.handlers),
+              {it->first, source, result_code, std::move(result_desc), it->second.queries}};
+    pending.erase(it);
+    return done;
+  }
+
+  static void deliver(Done& done) {
+    for (const Handler& h : done.handlers) {
+      if (h) h(done.outcome);
+    }
+  }
+
+  Task<void> run(std::shared_ptr<State> self);
+  Task<void> poll(std::shared_ptr<State> self, DueQuery due);
+
+  AsyncDarajaClient& daraja;
+  const StkPollerOptions options;
+  const Clock::duration tick;
+  const Clock::time_point epoch;
+  std::atomic<bool> stopping{false};
+
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, Entry, StringHash, std::equal_to<>> pending;
+  std::vector<std::vector<WheelItem>> wheel;
+  std::uint64_t current_tick = 0;  ///< last tick processed
+  std::uint64_t next_generation = 0;
+  unsigned in_flight = 0;
+  StkPollerStats stats;
+};
+
+Task<void> StkStatusPoller::State::run(std::shared_ptr<State> self) {
+  EventLoop& loop = daraja.loop();
+  std::vector<DueQuery> due;
+  std::vector<Done> expired;
+  while (!stopping.load(std::memory_order_acquire)) {
+    co_await loop.sleep_for(tick);
+    if (stopping.load(std::memory_order_acquire)) break;
+    const Clock::time_point now = Clock::now();
+    {
+      std::lock_guard lock(mutex);
+      const std::uint64_t target = tick_of(now);
+      // After a stall, one pass over the wheel covers every slot.
+      const std::uint64_t last = std::min(target, current_tick + wheel.size());
+      for (std::uint64_t t = current_tick + 1; t <= last; ++t) {
+        std::vector<WheelItem>& slot = wheel[t % wheel.size()];
+        std::size_t kept = 0;
+        std::vector<WheelItem> later;
+        for (WheelItem& item : slot) {
+          if (item.due_tick > target) {
+            slot[kept++] = std::move(item);
+            continue;
+          }
+          const auto it = pending.find(item.id);
+          if (it == pending.end() || it->second.generation != item.generation) continue;  // resolved or cancelled
+          if (now >= it->second.deadline) {
+            ++stats.expired;
+            expired.push_back(finish(it, StkOutcomeSource::kExpired, -1, "no outcome before give-up"));
+          } else if (in_flight >= std::max(options.max_in_flight, 1u)) {
+            ++stats.deferred;
+            item.due_tick = target + 1;
+            later.push_back(std::move(item));
+          } else {
+            ++in_flight;
+            ++stats.queries;
+            ++it->second.queries;
+            due.push_back({item.id, item.generation, it->second.query});
+          }
+        }
+        slot.resize(kept);
+        for (WheelItem& item : later) wheel[item.due_tick % wheel.size()].push_back(std::move(item));
+      }
+      current_tick = std::max(current_tick, target);
+    }
+    for (Done& done : expired) deliver(done);
+    expired.clear();
+    for (DueQuery& query : due) loop.spawn(poll(self, std::move(query)));
+    due.clear();
+  }
+}
+
+// The unnamed state pointer keeps the poller's state alive while the query is
+// in flight.
+Task<void> StkStatusPoller::State::poll(std::shared_ptr<State>, DueQuery due) {
+  std::optional<StkQueryResponse> response;
+  try {
+    response = co_await daraja.stk_query(std::move(due.query));
+  } catch (const std::exception&) {
+    // "The transaction is being processed" (500.001.1001), throttling or a
+    // transport failure: all mean ask again later.
+  }
+  std::optional<Done> done;
+  {
+    std::lock_guard lock(mutex);
+    --in_flight;
+    const auto it = pending.find(due.id);
+    // The callback won, or it did and the ID was tracked again since.
+    if (it == pending.end() || it->second.generation != due.generation) co_return;
+    Entry& entry = it->second;
+    if (response && !response->result_code.empty()) {
+      ++stats.by_query;
+      done = finish(it, StkOutcomeSource::kQuery, parse_code(response->result_code), std::move(response->result_desc));
+    } else {
+      const Clock::time_point now = Clock::now();
+      entry.interval = std::min<Clock::duration>(
+          std::chrono::duration_cast<Clock::duration>(entry.interval * options.backoff), options.max_interval);
+      schedule(due.id, entry.generation, std::min(now + entry.interval, entry.deadline));
+    }
+  }
+  if (done) deliver(*done);
+}
+
+StkStatusPoller::StkStatusPoller(AsyncDarajaClient& daraja, StkPollerOptions options)
+    : state_(std::make_shared<State>(daraja, options)) {
+  daraja.loop().post([state = state_] { state->daraja.loop().spawn(state->run(state)); });
+}
+
+StkStatusPoller::~StkStatusPoller() { state_->stopping.store(true, std::memory_order_release); }
+
+void StkStatusPoller::track(StkQueryRequest query, Handler on_done) {
+  State& s = *state_;
+  const Clock::time_point now = Clock::now();
+  std::lock_guard lock(s.mutex);
+  const auto [it, inserted] = s.pending.try_emplace(query.checkout_request_id);
+  State::Entry& entry = it->second;
+  entry.handlers.push_back(std::move(on_done));
+  if (!inserted) {
+    ++s.stats.coalesced;
+    return;
+  }
+  ++s.stats.tracked;
+  entry.query = std::move(query);
+  entry.deadline = now + s.options.give_up_after;
+  entry.interval = s.options.first_poll;
+  entry.generation = ++s.next_generation;
+  s.schedule(it->first, entry.generation, std::min(now + entry.interval, entry.deadline));
+}
+
+bool StkStatusPoller::on_callback(const StkCallback& callback) {
+  State& s = *state_;
+  std::optional<State::Done> done;
+  {
+    std::lock_guard lock(s.mutex);
+    const auto it = s.pending.find(callback.checkout_request_id);
+    if (it == s.pending.end()) return false;
+    ++s.stats.by_callback;
+    done = s.finish(it, StkOutcomeSource::kCallback, callback.result_code, std::string(callback.result_desc));
+  }
+  State::deliver(*done);
+  return true;
+}
+
+bool StkStatusPoller::cancel(std::string_view checkout_request_id) {
+  State& s = *state_;
+  std::lock_guard lock(s.mutex);
+  const auto it = s.pending.find(checkout_request_id);
+  if (it == s.pending.end()) return false;
+  s.pending.erase(it);
+  return true;
+}
+
+StkPollerStats StkStatusPoller::stats() const {
+  std::lock_guard lock(state_->mutex);
+  StkPollerStats out = state_->stats;
+  out.pending = state_->pending.size();
+  return out;
+}
+
+}  // namespace mpesa
@@ -0,0 +1,108 @@
+#include "mpesa/tenant_registry.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+namespace {
+
+std::uint64_t hash_short_code(std::string_view short_code) noexcept {
+  std::uint64_t h = 0xcbf29ce484222325ULL;
+  for (const char c : short_code) h = (h ^ static_cast<std::uint8_t>(c)) * 0x100000001b3ULL;
+  return h ^ (h >> 29);
+}
+
+}  // namespace
+
+Tenant::Tenant(TenantConfig config, HttpClient& http, AsyncHttpClient* async, const Endpoint& endpoint,
+               const TenantRegistryOptions& options)
+    : config_(std::move(config)),
+      tokens_(http, endpoint, config_.credentials, options.tokens),
+      limiter_(options.rate_limits),
+      daraja_(http, tokens_, endpoint, &limiter_) {
+  if (async != nullptr) async_.emplace(*async, tokens_, endpoint, &limiter_);
+}
+
+AsyncDarajaClient& Tenant::async_daraja() {
+  if (!async_) throw Error(ErrorCode::kInvalidArgument, "tenant registry has no async client");
+  return *async_;
+}
+
+TenantRegistry::TenantRegistry(HttpClient& http, Endpoint endpoint, TenantLoader loader,
+                               TenantRegistryOptions options)
+    : http_(http),
+      async_(nullptr),
+      endpoint_(std::move(endpoint)),
+      loader_(std::move(loader)),
+      options_(options),
+      mask_(std::bit_ceil(std::max<std::size_t>(options.max_tenants, 8) * 2) - 1),
+      slots_(std::make_unique<std::atomic<Tenant*>[]>(mask_ + 1)) {}
+
+TenantRegistry::TenantRegistry(HttpClient& http, AsyncHttpClient& async, Endpoint endpoint, TenantLoader loader,
+                               TenantRegistryOptions options)
+    : TenantRegistry(http, std::move(endpoint), std::move(loader), options) {
+  async_ = &async;
+}
+
+TenantRegistry::~TenantRegistry() {
+  for (std::size_t i = 0; i <= mask_; ++i) delete slots_[i].load(std::memory_order_relaxed);
+}
+
+Tenant* TenantRegistry::find(std::string_view short_code) const noexcept {
+  // The table is twice `max_tenants`, so a probe always ends at a match or
+  // an empty slot.
+  for (std::size_t i = static_cast<std::size_t>(hash_short_code(short_code)) & mask_;; i = (i + 1) & mask_) {
+    Tenant* tenant = slots_[i].load(std::memory_order_acquire);
+    if (tenant == nullptr || tenant->short_code() == short_code) return tenant;
+  }
+}
+
+Tenant& TenantRegistry::get(std::string_view short_code) {
+  if (Tenant* tenant = find(short_code)) return *tenant;
+  std::lock_guard lock(load_mutex_);
+  // Someone may have loaded it while we waited.
+  if (Tenant* tenant = find(short_code)) return *tenant;
+  std::optional<TenantConfig> config = loader_ ? loader_(short_code) : std::nullopt;
+  if (!config) throw Error(ErrorCode::kInvalidArgument, "unknown shortcode " + std::string(short_code));
+  // The table is keyed by the shortcode asked for.
+  config->short_code.assign(short_code);
+  return insert(std::move(*config));
+}
+
+Tenant& TenantRegistry::add(TenantConfig config) {
+  std::lock_guard lock(load_mutex_);
+  if (Tenant* tenant = find(config.short_code)) return *tenant;
+  return insert(std::move(config));
+}
+
+// Callers hold `load_mutex_`, so there is one writer and a plain release
+// store publishes the tenant.
+Tenant& TenantRegistry::insert(TenantConfig config) {
+  if (config.short_code.empty()) throw Error(ErrorCode::kInvalidArgument, "tenant needs a shortcode");
+  if (size_.load(std::memory_order_relaxed) >= options_.max_tenants) {
+    throw Error(ErrorCode::kInvalidArgument, "tenant registry is full");
+  }
+  std::size_t i = static_cast<std::size_t>(hash_short_code(config.short_code)) & mask_;
+  while (slots_[i].load(std::memory_order_relaxed) != nullptr) i = (i + 1) & mask_;
+  auto tenant = std::unique_ptr<Tenant>(new Tenant(std::move(config), http_, async_, endpoint_, options_));
+  slots_[i].store(tenant.get(), std::memory_order_release);
+  size_.fetch_add(1, std::memory_order_release);
+  return *tenant.release();
+}
+
+std::vector<Tenant*> TenantRegistry::tenants() const {
+  std::vector<Tenant*> out;
+  for (std::size_t i = 0; i <= mask_; ++i) {
+    if (Tenant* tenant = slots_[i].load(std::memory_order_acquire)) out.push_back(tenant);
+  }
+  return out;
+}
+
+EventLoop& TenantRegistry::async_loop() {
+  if (async_ == nullptr) throw Error(ErrorCode::kInvalidArgument, "tenant registry has no async client");
+  return async_->loop();
+}
+
+}  // namespace mpesa
@@ -0,0 +1,165 @@
+#include "mpesa/tls.hpp"
+
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <sys/socket.h>
+
+#include "mpesa/error.hpp"
+
+namespace mpesa {
+namespace {
+
+int new_session_cb(SSL* ssl, SSL_SESSION* session) {
+  auto* slot = static_cast<TlsSessionSlot*>(SSL_get_ex_data(ssl, tls_session_slot_index()));
+  if (slot == nullptr || !SSL_SESSION_is_resumable(session)) return 0;
+  slot->store(session);
+  return 1;  // we took the reference
+}
+
+void add_pem_anchors(SSL_CTX* ctx, std::string_view pem) {
+  std::unique_ptr<BIO, decltype(&BIO_free)> bio(BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size())),
+                                               &BIO_free);
+  X509_STORE* store = SSL_CTX_get_cert_store(ctx);
+  int added = 0;
+  while (X509* cert = PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr)) {
+    X509_STORE_add_cert(store, cert);
+    X509_free(cert);
+    ++added;
+  }
+  ERR_clear_error();  // PEM_read_bio_X509 leaves "no start line" at EOF
+  if (added == 0) throw Error(ErrorCode::kInvalidArgument, "ca_pem contains no certificates");
+}
+
+// OpenSSL's socket BIO writes with write(2), which raises SIGPIPE when the
+// peer has already closed. Same BIO, but sending with MSG_NOSIGNAL.
+int nosignal_write(BIO* bio, const char* data, int size) {
+  const int fd = static_cast<int>(BIO_get_fd(bio, nullptr));
+  const int n = static_cast<int>(::send(fd, data, static_cast<std::size_t>(size), MSG_NOSIGNAL));
+  BIO_clear_retry_flags(bio);
+  if (n <= 0 && BIO_sock_should_retry(n)) BIO_set_retry_write(bio);
+  return n;
+}
+
+const BIO_METHOD* nosignal_socket_method() {
+  static const BIO_METHOD* method = [] {
+    const BIO_METHOD* base = BIO_s_socket();
+    BIO_METHOD* m = BIO_meth_new(BIO_TYPE_SOCKET, "socket (MSG_NOSIGNAL)");
+    BIO_meth_set_write(m, nosignal_write);
+    BIO_meth_set_read(m, BIO_meth_get_read(base));
+    BIO_meth_set_puts(m, BIO_meth_get_puts(base));
+    BIO_meth_set_ctrl(m, BIO_meth_get_ctrl(base));
+    BIO_meth_set_create(m, BIO_meth_get_create(base));
+    BIO_meth_set_destroy(m, BIO_meth_get_destroy(base));
+    return m;
+  }();
+  return method;
+}
+
+}  // namespace
+
+void tls_set_socket(ssl_st* ssl, int fd) {
+  BIO* bio = BIO_new(nosignal_socket_method());
+  if (bio == nullptr) throw Error(ErrorCode::kTls, tls_error_string());
+  BIO_set_fd(bio, fd, BIO_NOCLOSE);
+  SSL_set_bio(ssl, bio, bio);
+}
+
+TlsSessionSlot::~TlsSessionSlot() { clear(); }
+
+void TlsSessionSlot::store(ssl_session_st* session) {
+  std::lock_guard lock(mutex_);
+  if (session_ != nullptr) SSL_SESSION_free(session_);
+  session_ = session;
+}
+
+ssl_session_st* TlsSessionSlot::get1() const {
+  std::lock_guard lock(mutex_);
+  if (session_ != nullptr) SSL_SESSION_up_ref(session_);
+  return session_;
+}
+
+void TlsSessionSlot::clear() {
+  std::lock_guard lock(mutex_);
+  if (session_ != nullptr) SSL_SESSION_free(session_);
+  session_ = nullptr;
+}
+
+int tls_session_slot_index() {
+  static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+std::string tls_error_string() {
+  std::string out;
+  char buf[256];
+  while (unsigned long err = ERR_get_error()) {
+    ERR_error_string_n(err, buf, sizeof(buf));
+    if (!out.empty()) out += "; ";
+    out += buf;
+  }
+  return out.empty() ? "unknown TLS error" : out;
+}
+
+TlsContext TlsContext::client(const TlsOptions& options) {
+  SSL_CTX* raw = SSL_CTX_new(TLS_client_method());
+  if (raw == nullptr) throw Error(ErrorCode::kTls, tls_error_string());
+  TlsContext ctx;
+  ctx.ctx_.reset(raw, &SSL_CTX_free);
+  SSL_CTX_set_min_proto_version(raw, TLS1_2_VERSION);
+  SSL_CTX_set_mode(raw, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+  // Servers routinely drop idle keep-alive connections without close_notify.
+  SSL_CTX_set_options(raw, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+
+  if (options.verify_peer) {
+    SSL_CTX_set_verify(raw, SSL_VERIFY_PEER, nullptr);
+    if (!options.ca_file.empty()) {
+      if (SSL_CTX_load_verify_locations(raw, options.ca_file.c_str(), nullptr) != 1) {
+        throw Error(ErrorCode::kTls, "loading " + options.ca_file + ": " + tls_error_string());
+      }
+    } else if (options.ca_pem.empty()) {
+      SSL_CTX_set_default_verify_paths(raw);
+    }
+    if (!options.ca_pem.empty()) add_pem_anchors(raw, options.ca_pem);
+  } else {
+    SSL_CTX_set_verify(raw, SSL_VERIFY_NONE, nullptr);
+  }
+
+  if (options.session_resumption) {
+    SSL_CTX_set_session_cache_mode(raw, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(raw, &new_session_cb);
+    ctx.session_resumption_ = true;
+  } else {
+    SSL_CTX_set_session_cache_mode(raw, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_options(raw, SSL_OP_NO_TICKET);
+  }
+  return ctx;
+}
+
+TlsContext TlsContext::server(std::string_view cert_pem, std::string_view key_pem) {
+  SSL_CTX* raw = SSL_CTX_new(TLS_server_method());
+  if (raw == nullptr) throw Error(ErrorCode::kTls, tls_error_string());
+  TlsContext ctx;
+  ctx.ctx_.reset(raw, &SSL_CTX_free);
+  SSL_CTX_set_min_proto_version(raw, TLS1_2_VERSION);
+  SSL_CTX_set_mode(raw, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+  std::unique_ptr<BIO, decltype(&BIO_free)> cert_bio(
+      BIO_new_mem_buf(cert_pem.data(), static_cast<int>(cert_pem.size())), &BIO_free);
+  std::unique_ptr<X509, decltype(&X509_free)> cert(
+      PEM_read_bio_X509(cert_bio.get(), nullptr, nullptr, nullptr), &X509_free);
+  std::unique_ptr<BIO, decltype(&BIO_free)> key_bio(
+      BIO_new_mem_buf(key_pem.data(), static_cast<int>(key_pem.size())), &BIO_free);
+  std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(
+      PEM_read_bio_PrivateKey(key_bio.get(), nullptr, nullptr, nullptr), &EVP_PKEY_free);
+  if (!cert || !key || SSL_CTX_use_certificate(raw, cert.get()) != 1 ||
+      SSL_CTX_use_PrivateKey(raw, key.get()) != 1 || SSL_CTX_check_private_key(raw) != 1) {
+    throw Error(ErrorCode::kTls, "loading server credentials: " + tls_error_string());
+  }
+  return ctx;
+}
+
+}  // namespace mpesa
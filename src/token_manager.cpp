@@ -0,0 +1,223 @@
+#include "mpesa/token_manager.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mpesa/base64.hpp"
+#include "mpesa/error.hpp"
+#include "mpesa/http_client.hpp"
+#include "mpesa/json.hpp"
+
+namespace mpesa {
+namespace {
+
+std::int64_t to_ns(Clock::time_point t) noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+Clock::time_point from_ns(std::int64_t ns) noexcept {
+  return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(ns)));
+}
+
+}  // namespace
+
+TokenManager::TokenManager(HttpClient& http, Endpoint endpoint, Credentials credentials,
+                           TokenManagerOptions options)
+    : http_(http),
+      endpoint_(std::move(endpoint)),
+      authorization_("Basic " +
+                     base64_encode(credentials.consumer_key + ":" + credentials.consumer_secret)),
+      options_(options) {
+  if (options_.background_refresh) refresher_ = std::thread([this] { refresher_loop(); });
+}
+
+TokenManager::~TokenManager() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  if (refresher_.joinable()) refresher_.join();
+}
+
+void TokenManager::read(AccessToken& out, Clock::time_point* refresh_at) const noexcept {
+  for (;;) {
+    const std::uint64_t begin = seq_.load(std::memory_order_acquire);
+    if ((begin & 1) != 0) continue;  // writer active
+    const std::uint32_t size = std::min<std::uint32_t>(size_.load(std::memory_order_relaxed),
+                                                       AccessToken::kMaxSize);
+    for (std::size_t i = 0; i < (size + 7) / 8; ++i) {
+      const std::uint64_t w = words_[i].load(std::memory_order_relaxed);
+      std::memcpy(out.data_.data() + i * 8, &w, sizeof(w));
+    }
+    out.size_ = size;
+    out.generation_ = generation_.load(std::memory_order_relaxed);
+    out.expires_at_ = from_ns(expires_ns_.load(std::memory_order_relaxed));
+    if (refresh_at != nullptr) *refresh_at = from_ns(refresh_ns_.load(std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq_.load(std::memory_order_relaxed) == begin) return;
+  }
+}
+
+void TokenManager::publish(std::string_view token, Clock::time_point expires_at,
+                           Clock::time_point refresh_at) {
+  const std::uint64_t seq = seq_.load(std::memory_order_relaxed);
+  seq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (std::size_t i = 0; i < (token.size() + 7) / 8; ++i) {
+    std::uint64_t w = 0;
+    std::memcpy(&w, token.data() + i * 8, std::min<std::size_t>(8, token.size() - i * 8));
+    words_[i].store(w, std::memory_order_relaxed);
+  }
+  size_.store(static_cast<std::uint32_t>(token.size()), std::memory_order_relaxed);
+  generation_.store(generation_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  expires_ns_.store(to_ns(expires_at), std::memory_order_relaxed);
+  refresh_ns_.store(to_ns(refresh_at), std::memory_order_relaxed);
+  seq_.store(seq + 2, std::memory_order_release);
+}
+
+bool TokenManager::try_get(AccessToken& out) const noexcept {
+  read(out, nullptr);
+  return !out.empty() && Clock::now() < out.expires_at_;
+}
+
+AccessToken TokenManager::get() {
+  AccessToken token;
+  Clock::time_point refresh_at;
+  read(token, &refresh_at);
+  const auto now = Clock::now();
+  if (!token.empty() && now < token.expires_at_) {
+    // Still valid. Past the refresh point with no refresher thread, exactly
+    // one caller renews it; everyone else keeps using the current token.
+    if (now >= refresh_at && !options_.background_refresh &&
+        !opportunistic_.exchange(true, std::memory_order_acq_rel)) {
+      try {
+        refresh(token.generation_);
+        read(token, nullptr);
+      } catch (const Error&) {
+        // The current token is still good; the next caller past the
+        // refresh point retries.
+      }
+      opportunistic_.store(false, std::memory_order_release);
+    }
+    return token;
+  }
+
+  refresh(token.generation_);
+  read(token, nullptr);
+  if (token.empty() || Clock::now() >= token.expires_at_) {
+    throw Error(ErrorCode::kAuth, "token endpoint returned an expired token");
+  }
+  return token;
+}
+
+void TokenManager::invalidate(const AccessToken& seen) {
+  {
+    std::lock_guard lock(mutex_);
+    if (in_flight_ || generation_.load(std::memory_order_relaxed) != seen.generation_) return;
+    const std::uint64_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    expires_ns_.store(0, std::memory_order_relaxed);
+    refresh_ns_.store(0, std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+  cv_.notify_all();
+}
+
+void TokenManager::refresh(std::uint64_t seen_generation) {
+  std::unique_lock lock(mutex_);
+  if (in_flight_) {
+    const std::uint64_t target = completed_ + 1;
+    cv_.wait(lock, [&] { return completed_ >= target; });
+    if (last_error_) std::rethrow_exception(last_error_);
+    return;
+  }
+  // Someone else refreshed between our read and taking the lock.
+  if (generation_.load(std::memory_order_relaxed) != seen_generation &&
+      Clock::now() < from_ns(refresh_ns_.load(std::memory_order_relaxed))) {
+    return;
+  }
+  in_flight_ = true;
+  lock.unlock();
+
+  std::exception_ptr error;
+  try {
+    fetch_and_publish();
+  } catch (Error& e) {
+    // Token requests are safe to repeat, and the caller's own request has
+    // not gone out yet.
+    e.set_sent(false);
+    error = std::current_exception();
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  lock.lock();
+  in_flight_ = false;
+  ++completed_;
+  last_error_ = error;
+  lock.unlock();
+  cv_.notify_all();
+  if (error) std::rethrow_exception(error);
+}
+
+void TokenManager::fetch_and_publish() {
+  fetches_.fetch_add(1, std::memory_order_relaxed);
+  HttpRequest request;
+  request.method = "GET";
+  request.target = "/oauth/v1/generate?grant_type=client_credentials";
+  request.headers.push_back({"Authorization", authorization_});
+
+  Metrics* const metrics = http_.options().metrics;
+  CallTimer timer(metrics, MetricEndpoint::kOAuth);
+  const auto sent_at = Clock::now();
+  const HttpResponse response = http_.send(endpoint_, request);
+  if (metrics != nullptr) metrics->count_code(MetricEndpoint::kOAuth, CodeKind::kHttpStatus, response.status);
+  if (response.status != 200) {
+    throw Error(ErrorCode::kAuth, "token endpoint returned HTTP " + std::to_string(response.status) +
+                                      ": " + std::string(std::string_view(response.body).substr(0, 256)));
+  }
+  const json::Value doc = json::parse(response.body);
+  const std::string& token = doc.at("access_token").as_string();
+  const std::int64_t expires_in = doc.at("expires_in").as_int64();
+  if (token.empty() || token.size() > AccessToken::kMaxSize) {
+    throw Error(ErrorCode::kAuth, "unexpected access token length " + std::to_string(token.size()));
+  }
+  if (expires_in <= 0) throw Error(ErrorCode::kAuth, "non-positive expires_in");
+
+  // Measure lifetime from when the request left, so network time only ever
+  // makes us refresh early.
+  const auto lifetime = std::chrono::seconds(expires_in);
+  const auto margin = std::min<Clock::duration>(options_.refresh_margin, lifetime / 2);
+  publish(token, sent_at + lifetime, sent_at + lifetime - margin);
+  timer.succeeded();
+}
+
+void TokenManager::refresher_loop() {
+  std::unique_lock lock(mutex_);
+  while (!stopping_) {
+    const std::uint64_t generation = generation_.load(std::memory_order_relaxed);
+    if (generation == 0) {
+      // Nothing to renew until the first caller fetches a token.
+      cv_.wait(lock);
+      continue;
+    }
+    const auto refresh_at = from_ns(refresh_ns_.load(std::memory_order_relaxed));
+    if (Clock::now() < refresh_at) {
+      cv_.wait_until(lock, refresh_at);
+      continue;
+    }
+    lock.unlock();
+    bool failed = false;
+    try {
+      refresh(generation);
+    } catch (const std::exception&) {
+      failed = true;
+    }
+    lock.lock();
+    if (failed) cv_.wait_for(lock, options_.retry_backoff, [this] { return stopping_; });
+  }
+}
+
+}  // namespace mpesa
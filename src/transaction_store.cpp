@@ -0,0 +1,431 @@
+#include "mpesa/transaction_store.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
+#include "mpesa/error.hpp"
+#include "cpu.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MPESA_STORE_AVX2 1
+#endif
+
+namespace mpesa {
+namespace {
+
+// FNV-1a; values are shortcodes and phone numbers.
+std::uint32_t hash_value(std::string_view value) noexcept {
+  std::uint32_t h = 2166136261u;
+  for (const char c : value) h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+  return h;
+}
+
+constexpr std::int64_t kEastAfricaOffset = 3 * 3600;
+
+// Days from 1970-01-01 to y-m-d in the proleptic Gregorian calendar
+// (Howard Hinnant's days_from_civil).
+std::int64_t days_from_civil(std::int64_t y, unsigned m, unsigned d) noexcept {
+  y -= m <= 2;
+  const std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const auto yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+// -1 unless `text[pos, pos + n)` is all digits.
+int digits(std::string_view text, std::size_t pos, std::size_t n) noexcept {
+  int v = 0;
+  for (std::size_t i = pos; i < pos + n; ++i) {
+    if (text[i] < '0' || text[i] > '9') return -1;
+    v = v * 10 + (text[i] - '0');
+  }
+  return v;
+}
+
+std::int64_t civil_seconds(int year, int month, int day, int hour, int minute, int second) noexcept {
+  if (year < 0 || month < 1 || month > 12 || day < 1 || day > 31 || hour < 0 || hour > 23 || minute < 0 ||
+      minute > 59 || second < 0 || second > 60) {
+    return -1;
+  }
+  return days_from_civil(year, static_cast<unsigned>(month), static_cast<unsigned>(day)) * 86400 + hour * 3600 +
+         minute * 60 + second;
+}
+
+std::int64_t now_in_store_time() noexcept {
+  const auto now = std::chrono::system_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::seconds>(now).count() + kEastAfricaOffset;
+}
+
+std::int64_t hour_of(std::int64_t time) noexcept { return time >= 0 ? time / 3600 : (time - 3599) / 3600; }
+
+/// A `TransactionFilter` with the shortcode resolved to its id.
+struct Scan {
+  std::int64_t from = 0;
+  std::int64_t to = 0;
+  std::uint32_t short_code = StringDictionary::npos;  ///< npos: any
+  int source = -1;                                    ///< -1: any
+  bool succeeded_only = true;
+};
+
+/// The columns a scan reads.
+struct Columns {
+  const std::int64_t* times;
+  const std::int64_t* amounts;
+  const std::uint32_t* short_codes;
+  const std::int32_t* result_codes;
+  const std::uint8_t* sources;
+};
+
+bool matches(const Columns& c, std::size_t i, const Scan& s) noexcept {
+  return c.times[i] >= s.from && c.times[i] < s.to &&
+         (s.short_code == StringDictionary::npos || c.short_codes[i] == s.short_code) &&
+         (s.source < 0 || c.sources[i] == s.source) && (!s.succeeded_only || c.result_codes[i] == 0);
+}
+
+void sum_scalar(const Columns& c, std::size_t begin, std::size_t end, const Scan& s, TransactionTotals& out) noexcept {
+  for (std::size_t i = begin; i < end; ++i) {
+    if (!matches(c, i, s)) continue;
+    ++out.count;
+    out.amount_cents += c.amounts[i];
+  }
+}
+
+#ifdef MPESA_STORE_AVX2
+
+// Four rows per step: every predicate becomes an all-ones or all-zeros
+// 64-bit lane, the lanes are ANDed, and the mask both selects the amounts
+// to add and, as -1, counts the rows. No branch depends on the data.
+__attribute__((target("avx2"))) void sum_avx2(const Columns& c, std::size_t begin, std::size_t end, const Scan& s,
+                                              TransactionTotals& out) noexcept {
+  const __m256i from = _mm256_set1_epi64x(s.from);
+  const __m256i to = _mm256_set1_epi64x(s.to);
+  const __m256i short_code = _mm256_set1_epi64x(s.short_code);
+  const __m256i source = _mm256_set1_epi64x(s.source);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i sum = zero;
+  __m256i count = zero;
+  std::size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c.times + i));
+    __m256i keep = _mm256_andnot_si256(_mm256_cmpgt_epi64(from, t), _mm256_cmpgt_epi64(to, t));
+    if (s.short_code != StringDictionary::npos) {
+      const __m128i ids = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c.short_codes + i));
+      keep = _mm256_and_si256(keep, _mm256_cmpeq_epi64(_mm256_cvtepu32_epi64(ids), short_code));
+    }
+    if (s.source >= 0) {
+      int four;
+      std::memcpy(&four, c.sources + i, sizeof(four));
+      keep = _mm256_and_si256(keep, _mm256_cmpeq_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(four)), source));
+    }
+    if (s.succeeded_only) {
+      const __m128i codes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c.result_codes + i));
+      keep = _mm256_and_si256(keep, _mm256_cmpeq_epi64(_mm256_cvtepi32_epi64(codes), zero));
+    }
+    const __m256i amounts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c.amounts + i));
+    sum = _mm256_add_epi64(sum, _mm256_and_si256(keep, amounts));
+    count = _mm256_sub_epi64(count, keep);
+  }
+  alignas(32) std::int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+  out.amount_cents += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), count);
+  out.count += static_cast<std::uint64_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+  sum_scalar(c, i, end, s, out);
+}
+
+#endif
+
+std::optional<Scan> compile(const TransactionFilter& filter, const StringDictionary& short_codes) noexcept {
+  Scan s;
+  s.from = filter.from;
+  s.to = filter.to;
+  s.succeeded_only = filter.succeeded_only;
+  if (filter.source) s.source = static_cast<int>(*filter.source);
+  if (!filter.short_code.empty()) {
+    s.short_code = short_codes.find(filter.short_code);
+    if (s.short_code == StringDictionary::npos) return std::nullopt;
+  }
+  if (s.from >= s.to) return std::nullopt;
+  return s;
+}
+
+}  // namespace
+
+std::int64_t parse_daraja_time(std::string_view text) noexcept {
+  if (text.size() == 14) {
+    return civil_seconds(digits(text, 0, 4), digits(text, 4, 2), digits(text, 6, 2), digits(text, 8, 2),
+                         digits(text, 10, 2), digits(text, 12, 2));
+  }
+  if (text.size() == 19 && text[2] == '.' && text[5] == '.' && text[10] == ' ' && text[13] == ':' &&
+      text[16] == ':') {
+    return civil_seconds(digits(text, 6, 4), digits(text, 3, 2), digits(text, 0, 2), digits(text, 11, 2),
+                         digits(text, 14, 2), digits(text, 17, 2));
+  }
+  return -1;
+}
+
+std::uint32_t StringDictionary::find(std::string_view value) const noexcept {
+  if (slots_.empty()) return npos;
+  const std::uint32_t hash = hash_value(value);
+  const std::size_t mask = slots_.size() - 1;
+  // At most half full, so the probe always reaches an empty slot.
+  for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+    const Slot& slot = slots_[i];
+    if (slot.id == npos) return npos;
+    if (slot.hash == hash && this->value(slot.id) == value) return slot.id;
+  }
+}
+
+std::uint32_t StringDictionary::intern(std::string_view value) {
+  const std::uint32_t found = find(value);
+  if (found != npos) return found;
+  if (ends_.size() >= npos - 1 || text_.size() + value.size() > npos) {
+    throw Error(ErrorCode::kInvalidArgument, "string dictionary is full");
+  }
+  if ((ends_.size() + 1) * 2 > slots_.size()) rehash(std::max<std::size_t>(64, slots_.size() * 2));
+  const auto id = static_cast<std::uint32_t>(ends_.size());
+  text_.append(value);
+  ends_.push_back(static_cast<std::uint32_t>(text_.size()));
+  const std::uint32_t hash = hash_value(value);
+  const std::size_t mask = slots_.size() - 1;
+  std::size_t i = hash & mask;
+  while (slots_[i].id != npos) i = (i + 1) & mask;
+  slots_[i] = {hash, id};
+  return id;
+}
+
+void StringDictionary::rehash(std::size_t slots) {
+  std::vector<Slot> old(slots, Slot{});
+  old.swap(slots_);
+  const std::size_t mask = slots_.size() - 1;
+  for (const Slot& slot : old) {
+    if (slot.id == npos) continue;
+    std::size_t i = slot.hash & mask;
+    while (slots_[i].id != npos) i = (i + 1) & mask;
+    slots_[i] = slot;
+  }
+}
+
+std::size_t StringDictionary::memory_bytes() const noexcept {
+  return text_.capacity() + ends_.capacity() * sizeof(std::uint32_t) + slots_.capacity() * sizeof(Slot);
+}
+
+void StringDictionary::clear() noexcept {
+  text_.clear();
+  ends_.clear();
+  slots_.clear();
+}
+
+void TransactionStore::append(const C2BNotification& n) {
+  const std::int64_t cents = parse_amount_cents(n.trans_amount);
+  const std::int64_t time = parse_daraja_time(n.trans_time);
+  if (cents < 0 || time < 0) throw Error(ErrorCode::kParse, "C2B notification has a malformed TransAmount or TransTime");
+  append(TransactionRecord{TransactionSource::kC2B, time, cents, 0, n.business_short_code, n.msisdn, n.trans_id});
+}
+
+void TransactionStore::append(const StkCallback& cb, std::string_view short_code) {
+  TransactionRecord record{TransactionSource::kStk, now_in_store_time(), 0, cb.result_code, short_code,
+                           cb.phone_number, cb.mpesa_receipt_number};
+  if (cb.succeeded()) {
+    record.amount_cents = parse_amount_cents(cb.amount);
+    record.time = parse_daraja_time(cb.transaction_date);
+    if (record.amount_cents < 0 || record.time < 0) {
+      throw Error(ErrorCode::kParse, "STK callback has a malformed Amount or TransactionDate");
+    }
+  }
+  append(record);
+}
+
+void TransactionStore::append(const ResultCallback& r, std::string_view short_code) {
+  std::string_view party = r.parameter("ReceiverPartyPublicName");
+  party = party.substr(0, party.find(" - "));
+  TransactionRecord record{TransactionSource::kResult, now_in_store_time(), 0, r.result_code, short_code, party,
+                           r.transaction_id};
+  if (r.succeeded()) {
+    record.amount_cents = parse_amount_cents(r.parameter("TransactionAmount"));
+    record.time = parse_daraja_time(r.parameter("TransactionCompletedDateTime"));
+    if (record.amount_cents < 0 || record.time < 0) {
+      throw Error(ErrorCode::kParse, "result has a malformed TransactionAmount or TransactionCompletedDateTime");
+    }
+  }
+  append(record);
+}
+
+void TransactionStore::append(const TransactionRecord& record) {
+  const std::uint32_t short_code = short_codes_.intern(record.short_code);
+  const std::uint32_t msisdn = msisdns_.intern(record.msisdn);
+  if (times_.size() % kBlockRows == 0) zones_.push_back({record.time, record.time});
+  Zone& zone = zones_.back();
+  zone.min_time = std::min(zone.min_time, record.time);
+  zone.max_time = std::max(zone.max_time, record.time);
+  times_.push_back(record.time);
+  amounts_.push_back(record.amount_cents);
+  short_code_ids_.push_back(short_code);
+  msisdn_ids_.push_back(msisdn);
+  result_codes_.push_back(record.result_code);
+  sources_.push_back(static_cast<std::uint8_t>(record.source));
+  receipts_.append(record.receipt);
+  receipt_ends_.push_back(receipts_.size());
+}
+
+TransactionRecord TransactionStore::row(std::size_t i) const noexcept {
+  const std::size_t begin = i == 0 ? 0 : receipt_ends_[i - 1];
+  return {static_cast<TransactionSource>(sources_[i]),
+          times_[i],
+          amounts_[i],
+          result_codes_[i],
+          short_codes_.value(short_code_ids_[i]),
+          msisdns_.value(msisdn_ids_[i]),
+          std::string_view(receipts_).substr(begin, receipt_ends_[i] - begin)};
+}
+
+void TransactionStore::reserve(std::size_t rows) {
+  times_.reserve(rows);
+  amounts_.reserve(rows);
+  short_code_ids_.reserve(rows);
+  msisdn_ids_.reserve(rows);
+  result_codes_.reserve(rows);
+  sources_.reserve(rows);
+  receipt_ends_.reserve(rows);
+  receipts_.reserve(rows * 10);  // M-Pesa receipts are 10 characters
+  zones_.reserve(rows / kBlockRows + 1);
+}
+
+void TransactionStore::clear() noexcept {
+  times_.clear();
+  amounts_.clear();
+  short_code_ids_.clear();
+  msisdn_ids_.clear();
+  result_codes_.clear();
+  sources_.clear();
+  receipts_.clear();
+  receipt_ends_.clear();
+  zones_.clear();
+  short_codes_.clear();
+  msisdns_.clear();
+}
+
+std::size_t TransactionStore::memory_bytes() const noexcept {
+  return times_.capacity() * sizeof(std::int64_t) + amounts_.capacity() * sizeof(std::int64_t) +
+         short_code_ids_.capacity() * sizeof(std::uint32_t) + msisdn_ids_.capacity() * sizeof(std::uint32_t) +
+         result_codes_.capacity() * sizeof(std::int32_t) + sources_.capacity() + receipts_.capacity() +
+         receipt_ends_.capacity() * sizeof(std::uint64_t) + zones_.capacity() * sizeof(Zone) +
+         short_codes_.memory_bytes() + msisdns_.memory_bytes();
+}
+
+TransactionTotals TransactionStore::total(const TransactionFilter& filter) const noexcept {
+  TransactionTotals out;
+  const std::optional<Scan> scan = compile(filter, short_codes_);
+  if (!scan) return out;
+  const Columns columns{times_.data(), amounts_.data(), short_code_ids_.data(), result_codes_.data(),
+                        sources_.data()};
+  // Runs of blocks that may hold matching times, scanned in one call each.
+  std::size_t begin = 0;
+  std::size_t end = 0;
+  const auto flush = [&] {
+    if (begin == end) return;
+#ifdef MPESA_STORE_AVX2
+    if (detail::cpu_has_avx2()) {
+      sum_avx2(columns, begin, end, *scan, out);
+      return;
+    }
+#endif
+    sum_scalar(columns, begin, end, *scan, out);
+  };
+  for (std::size_t b = 0; b < zones_.size(); ++b) {
+    const std::size_t first = b * kBlockRows;
+    const std::size_t last = std::min(size(), first + kBlockRows);
+    if (zones_[b].max_time < scan->from || zones_[b].min_time >= scan->to) {
+      flush();
+      begin = end = last;
+      continue;
+    }
+    end = last;
+  }
+  flush();
+  return out;
+}
+
+TransactionTotals TransactionStore::total_scalar(const TransactionFilter& filter) const noexcept {
+  TransactionTotals out;
+  const std::optional<Scan> scan = compile(filter, short_codes_);
+  if (!scan) return out;
+  const Columns columns{times_.data(), amounts_.data(), short_code_ids_.data(), result_codes_.data(),
+                        sources_.data()};
+  sum_scalar(columns, 0, size(), *scan, out);
+  return out;
+}
+
+std::vector<HourlyTotal> TransactionStore::hourly_totals(const TransactionFilter& filter) const {
+  std::vector<HourlyTotal> out;
+  const std::optional<Scan> scan = compile(filter, short_codes_);
+  if (!scan) return out;
+  const Columns columns{times_.data(), amounts_.data(), short_code_ids_.data(), result_codes_.data(),
+                        sources_.data()};
+
+  // The hours the surviving blocks span, clipped to the filter, size a
+  // dense grid of shortcode x hour; a sparse map takes over only when that
+  // grid would be unreasonably large.
+  std::vector<std::size_t> blocks;
+  std::int64_t lo = std::numeric_limits<std::int64_t>::max();
+  std::int64_t hi = std::numeric_limits<std::int64_t>::min();
+  for (std::size_t b = 0; b < zones_.size(); ++b) {
+    if (zones_[b].max_time < scan->from || zones_[b].min_time >= scan->to) continue;
+    blocks.push_back(b);
+    lo = std::min(lo, std::max(zones_[b].min_time, scan->from));
+    hi = std::max(hi, std::min(zones_[b].max_time, scan->to - 1));
+  }
+  if (blocks.empty()) return out;
+  const std::int64_t first_hour = hour_of(lo);
+  const auto hours = static_cast<std::uint64_t>(hour_of(hi) - first_hour) + 1;
+  const std::uint64_t codes = scan->short_code != StringDictionary::npos ? 1 : short_codes_.size();
+  const auto group_of = [&](std::size_t i) {
+    const std::uint64_t code = scan->short_code != StringDictionary::npos ? 0 : columns.short_codes[i];
+    return code * hours + static_cast<std::uint64_t>(hour_of(columns.times[i]) - first_hour);
+  };
+  const auto emit = [&](std::uint64_t group, const TransactionTotals& t) {
+    const auto code = scan->short_code != StringDictionary::npos ? scan->short_code
+                                                                : static_cast<std::uint32_t>(group / hours);
+    out.push_back({short_codes_.value(code), first_hour + static_cast<std::int64_t>(group % hours), t.count,
+                   t.amount_cents});
+  };
+
+  constexpr std::uint64_t kMaxDenseGroups = std::uint64_t{1} << 22;
+  if (hours <= kMaxDenseGroups / codes) {
+    std::vector<TransactionTotals> grid(codes * hours);
+    for (const std::size_t b : blocks) {
+      const std::size_t end = std::min(size(), (b + 1) * kBlockRows);
+      for (std::size_t i = b * kBlockRows; i < end; ++i) {
+        if (!matches(columns, i, *scan)) continue;
+        TransactionTotals& t = grid[group_of(i)];
+        ++t.count;
+        t.amount_cents += columns.amounts[i];
+      }
+    }
+    for (std::uint64_t g = 0; g < grid.size(); ++g) {
+      if (grid[g].count != 0) emit(g, grid[g]);
+    }
+  } else {
+    std::unordered_map<std::uint64_t, TransactionTotals> groups;
+    for (const std::size_t b : blocks) {
+      const std::size_t end = std::min(size(), (b + 1) * kBlockRows);
+      for (std::size_t i = b * kBlockRows; i < end; ++i) {
+        if (!matches(columns, i, *scan)) continue;
+        TransactionTotals& t = groups[group_of(i)];
+        ++t.count;
+        t.amount_cents += columns.amounts[i];
+      }
+    }
+    for (const auto& [g, t] : groups) emit(g, t);
+  }
+  std::sort(out.begin(), out.end(), [](const HourlyTotal& a, const HourlyTotal& b) {
+    return a.short_code != b.short_code ? a.short_code < b.short_code : a.hour < b.hour;
+  });
+  return out;
+}
+
+}  // namespace mpesa